@@ -0,0 +1,252 @@
+// aio.cc
+//	Routines for asynchronous file I/O: a table of reads and writes
+//	started, and a kernel thread that does them in the background.
+//	See aio.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+#ifndef FILESYS_STUB
+
+#include "copyright.h"
+#include "aio.h"
+#include "main.h"
+#include "synch.h"
+
+//----------------------------------------------------------------------
+// AsyncIO::AsyncIO
+// 	Initialize an empty table of requests.  The worker isn't forked
+//	until there is something for it to do.
+//----------------------------------------------------------------------
+
+AsyncIO::AsyncIO()
+{
+    for (int i = 0; i < MaxAioRequests; i++)
+	requests[i].inUse = FALSE;
+    queue = new List<int>;
+    queued = new Semaphore("aio queued", 0);
+    lock = new Lock("aio");
+    finished = new Condition("aio finished");
+    workerStarted = FALSE;
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::~AsyncIO
+// 	Free the table.  Only called when Nachos halts, so no request is
+//	left to do, and the worker is waiting on "queued".
+//----------------------------------------------------------------------
+
+AsyncIO::~AsyncIO()
+{
+    delete queue;
+    delete queued;
+    delete lock;
+    delete finished;
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::Start
+// 	Queue a read or write of "size" bytes of the file open as "id",
+//	starting "position" bytes into it, and return the request's handle
+//	at once.  Return -1 if the request is no good, or the table is
+//	full.  Whether "id" is an open file is only found out when the
+//	request is done: its result is then -1.
+//
+//	"writing" -- write the bytes, or read them?
+//	"buffer" -- the bytes to write, or where to put the bytes read;
+//		must stay there until the request is done
+//----------------------------------------------------------------------
+
+int
+AsyncIO::Start(bool writing, char *buffer, int size, int position,
+	       OpenFileId id)
+{
+    int handle;
+
+    if (size < 0 || position < 0)
+	return -1;
+    lock->Acquire();
+    for (handle = 0; handle < MaxAioRequests; handle++)
+	if (!requests[handle].inUse)
+	    break;
+    if (handle == MaxAioRequests) {
+	lock->Release();
+	return -1;
+    }
+    AioRequest *request = &requests[handle];
+    request->inUse = TRUE;
+    request->writing = writing;
+    request->buffer = buffer;
+    request->size = size;
+    request->position = position;
+    request->id = id;
+    request->owner = kernel->currentThread;
+    request->done = FALSE;
+    request->result = -1;
+    queue->Append(handle);
+    if (!workerStarted) {
+	Thread *thread = new Thread("aio worker", 0);
+
+	thread->Fork((VoidFunctionPtr) AsyncIO::WorkerThread, (void *) this);
+	workerStarted = TRUE;
+    }
+    lock->Release();
+    DEBUG(dbgFile, "Started aio " << handle << (writing ? ": write " : ": read ")
+	  << size << " bytes at " << position << " of file " << id);
+    queued->V();
+
+    // The first time no thread could run, the timer was turned off
+    // (Kernel::PrepareToEnd), so a thread computing is never made to
+    // give up the CPU; turn time slicing back on, or the worker would
+    // only get to start each disk transfer once we wait for it.  And
+    // let the worker start the first one now, before we go on.
+    kernel->alarm->Enable();
+    kernel->currentThread->Yield();
+    return handle;
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::Poll
+// 	Return 1 if the request "handle" is done, 0 if it isn't yet, or
+//	-1 if there is no such request.  Never waits.
+//----------------------------------------------------------------------
+
+int
+AsyncIO::Poll(int handle)
+{
+    int result;
+
+    if (handle < 0 || handle >= MaxAioRequests)
+	return -1;
+    lock->Acquire();
+    if (!requests[handle].inUse)
+	result = -1;
+    else
+	result = requests[handle].done ? 1 : 0;
+    lock->Release();
+    return result;
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::Wait
+// 	Wait until the request "handle" is done, and return how many bytes
+//	it wrote or read (-1 if it failed, or there is no such request).
+//	The handle is free to be used again after.
+//----------------------------------------------------------------------
+
+int
+AsyncIO::Wait(int handle)
+{
+    int result;
+
+    if (handle < 0 || handle >= MaxAioRequests)
+	return -1;
+    lock->Acquire();
+    if (!requests[handle].inUse) {
+	lock->Release();
+	return -1;
+    }
+    while (!requests[handle].done)
+	finished->Wait(lock);
+    result = requests[handle].result;
+    requests[handle].inUse = FALSE;
+    lock->Release();
+    return result;
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::Drain
+// 	Wait until every request started on the open file "id" is done, so
+//	the file can be closed (or its OpenFileId reused) safely.  The
+//	requests keep their handles: their results can still be waited for.
+//----------------------------------------------------------------------
+
+void
+AsyncIO::Drain(OpenFileId id)
+{
+    bool pending;
+
+    lock->Acquire();
+    do {
+	pending = FALSE;
+	for (int i = 0; i < MaxAioRequests; i++)
+	    if (requests[i].inUse && !requests[i].done && requests[i].id == id)
+		pending = TRUE;
+	if (pending)
+	    finished->Wait(lock);
+    } while (pending);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::DrainProgram
+// 	Wait until every request the program "owner" started is done, and
+//	free their handles.  Called as the program exits: a read must not
+//	land in its memory after that memory is given to the next program,
+//	and the handles it never waited for would otherwise be lost.
+//----------------------------------------------------------------------
+
+void
+AsyncIO::DrainProgram(Thread *owner)
+{
+    bool pending;
+
+    lock->Acquire();
+    do {
+	pending = FALSE;
+	for (int i = 0; i < MaxAioRequests; i++)
+	    if (requests[i].inUse && requests[i].owner == owner) {
+		if (requests[i].done)
+		    requests[i].inUse = FALSE;
+		else
+		    pending = TRUE;
+	    }
+	if (pending)
+	    finished->Wait(lock);
+    } while (pending);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::WorkerThread, AsyncIO::Work
+// 	The I/O worker: take each request off the queue in turn, do it
+//	(without holding the lock, so programs can start and poll others
+//	meanwhile), and wake up whoever is waiting for it.
+//----------------------------------------------------------------------
+
+void
+AsyncIO::WorkerThread(void *arg)
+{
+    ((AsyncIO *) arg)->Work();
+}
+
+void
+AsyncIO::Work()
+{
+    for (;;) {
+	int handle, result;
+	AioRequest *request;
+
+	queued->P();
+	lock->Acquire();
+	handle = queue->RemoveFront();
+	request = &requests[handle];
+	lock->Release();
+
+	if (request->writing)
+	    result = kernel->fileSystem->WriteFileAt(request->buffer,
+			request->size, request->position, request->id);
+	else
+	    result = kernel->fileSystem->ReadFileAt(request->buffer,
+			request->size, request->position, request->id);
+
+	lock->Acquire();
+	request->result = result;
+	request->done = TRUE;
+	finished->Broadcast(lock);
+	lock->Release();
+	DEBUG(dbgFile, "Finished aio " << handle << ": " << result);
+    }
+}
+
+#endif // FILESYS_STUB
@@ -0,0 +1,91 @@
+// aio.h
+//	Data structures for asynchronous file I/O: a user program starts
+//	a read or write of an open file, and goes on computing while a
+//	kernel thread does it; later it asks whether it is done (Poll),
+//	or waits for it (Wait) and gets the result.
+//
+//	Requests are kept in a table, and a request's place in it is its
+//	handle.  Requests started are queued for the I/O worker, a kernel
+//	thread forked when the first one is started, which does them one
+//	at a time, in order, with the file system's ReadFileAt and
+//	WriteFileAt -- waiting for the disk, as the program would have,
+//	while the program runs.  A request names the position in the file
+//	it starts at (as POSIX aio_offset does), so it doesn't depend on
+//	where the file's seek position is by the time it is done.
+//
+//	A request holds its place in the table until the program waits
+//	for it, whether it is done or not; the program may have at most
+//	MaxAioRequests started and not yet waited for.  The handles are
+//	shared by all the programs running.  When a program exits, its
+//	requests are waited for (they read into its memory, which is
+//	about to be given to another program) and their places freed.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef AIO_H
+#define AIO_H
+
+#include "copyright.h"
+#include "filesys.h"
+#include "list.h"
+
+class Lock;
+class Condition;
+class Semaphore;
+class Thread;
+
+const int MaxAioRequests = 16;		// requests started and not yet
+					// waited for, at most
+
+// A read or write started, and its result once it is done.
+
+class AioRequest {
+  public:
+    bool inUse;				// is this place in the table taken?
+    bool writing;			// a write, or a read?
+    char *buffer;			// the bytes to write, or where to
+					// put the bytes read
+    int size;				// how many
+    int position;			// where in the file they go
+    OpenFileId id;			// the open file
+    Thread *owner;			// the program that started it
+    bool done;				// has the worker done it yet?
+    int result;				// bytes written or read, or -1
+};
+
+class AsyncIO {
+  public:
+    AsyncIO();				// Initialize an empty table
+    ~AsyncIO();				// Free it (the worker, if any, is
+					// left waiting for a request)
+
+    int Start(bool writing, char *buffer, int size, int position,
+	      OpenFileId id);		// Queue a read or write; return
+					// its handle, or -1
+    int Poll(int handle);		// 1 if the request is done, 0 if
+					// not, -1 if no such request
+    int Wait(int handle);		// Wait until it is done; return its
+					// result, and free the handle
+    void Drain(OpenFileId id);		// Wait until every request on "id"
+					// is done (before it is closed)
+    void DrainProgram(Thread *owner);	// Wait until every request "owner"
+					// started is done, and free them
+					// (before it exits)
+
+  private:
+    static void WorkerThread(void *arg);
+					// Body of the I/O worker
+    void Work();			// Do the requests queued, forever
+
+    AioRequest requests[MaxAioRequests];
+    List<int> *queue;			// handles of the requests not yet
+					// taken by the worker, in order
+    Semaphore *queued;			// V'ed for each request queued
+    Lock *lock;				// held while using the table
+    Condition *finished;		// broadcast as each request is done
+    bool workerStarted;			// has the worker been forked?
+};
+
+#endif // AIO_H
@@ -0,0 +1,506 @@
+// compfile.cc
+//	Routines to read and write compressed files.  See compfile.h for
+//	how a compressed file is laid out.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+#ifndef FILESYS_STUB
+
+#include "copyright.h"
+#include "main.h"
+#include "compfile.h"
+#include "filehdr.h"
+#include "synchdisk.h"
+#include "synch.h"
+#include "lzss.h"
+#include "slab.h"
+
+static CompressedFile *openFiles[NumInodes];	// the compressed files
+						// open, by inode
+
+//----------------------------------------------------------------------
+// TableSectors
+// 	Return how many sectors the table of a compressed file of
+//	"length" bytes takes.
+//----------------------------------------------------------------------
+
+static int
+TableSectors(int length)
+{
+    int numChunks = divRoundUp(length, ChunkSize);
+
+    return divRoundUp(sizeof(int) + numChunks * sizeof(unsigned short),
+		      SectorSize);
+}
+
+//----------------------------------------------------------------------
+// CompressedFile::DiskBytes
+// 	Return how many bytes of disk a compressed file of "length" bytes
+//	takes: its table, and a slot for each chunk (the last one only as
+//	long as the last chunk).
+//----------------------------------------------------------------------
+
+int
+CompressedFile::DiskBytes(int length)
+{
+    return TableSectors(length) * SectorSize + length;
+}
+
+//----------------------------------------------------------------------
+// CompressedFile::Format
+// 	Write the table of a newly created compressed file: its length,
+//	and every chunk unwritten.
+//
+//	"hdr" -- the file's header, already allocated
+//	"length" -- the number of bytes of data in the file
+//----------------------------------------------------------------------
+
+void
+CompressedFile::Format(FileHeader *hdr, int length)
+{
+    int numSectors = TableSectors(length);
+    char *table = AllocBuffer(numSectors * SectorSize);
+    int *sectors = (int *) AllocBuffer(numSectors * sizeof(int));
+
+    bzero(table, numSectors * SectorSize);
+    bcopy((char *) &length, table, sizeof(int));
+    for (int i = 0; i < numSectors; i++)
+	sectors[i] = hdr->ByteToSector(i * SectorSize);
+    kernel->synchDisk->WriteSectors(numSectors, sectors, table);
+    FreeBuffer((char *) sectors, numSectors * sizeof(int));
+    FreeBuffer(table, numSectors * SectorSize);
+}
+
+//----------------------------------------------------------------------
+// CompressedFile::Open
+// 	Return the compressed file whose header is in "inode", sharing it
+//	with whoever else has it open, or reading it in if no one does.
+//	Each Open must be matched by a Close.
+//
+//	Reading it in waits for the disk, so it is put in the table of
+//	open files first, locked; anyone else opening it meanwhile waits
+//	for the lock, so as not to see it half read.
+//----------------------------------------------------------------------
+
+CompressedFile *
+CompressedFile::Open(int inode)
+{
+    CompressedFile *file = openFiles[inode];
+
+    if (file == NULL) {
+	file = openFiles[inode] = new CompressedFile(inode);
+	file->numOpen++;
+	file->lock->Acquire();
+	file->ReadTable();
+    } else {
+	file->numOpen++;
+	file->lock->Acquire();
+    }
+    file->lock->Release();
+    return file;
+}
+
+//----------------------------------------------------------------------
+// CompressedFile::Close
+// 	Let go of a compressed file.  When the last one who had it open
+//	lets go, write it back to disk and free it -- unless someone
+//	opened it again while it was being written.
+//----------------------------------------------------------------------
+
+void
+CompressedFile::Close()
+{
+    ASSERT(numOpen > 0);
+    if (--numOpen > 0)
+	return;
+    Flush();
+    if (numOpen == 0) {
+	openFiles[inode] = NULL;
+	delete this;
+    }
+}
+
+//----------------------------------------------------------------------
+// CompressedFile::CompressedFile
+// 	Initialize the in-memory copy of a compressed file, with nothing
+//	read in yet.
+//
+//	"inode" -- the inode holding the file's header
+//----------------------------------------------------------------------
+
+CompressedFile::CompressedFile(int inode)
+{
+    this->inode = inode;
+    numOpen = 0;
+    hdr = new FileHeader;
+    lock = new Lock("compressed file");
+    table = NULL;
+    tableSectors = 0;
+    firstDirty = lastDirty = -1;
+    cachedChunk = -1;
+    cache = AllocBuffer(ChunkSize);
+    cacheDirty = FALSE;
+}
+
+//----------------------------------------------------------------------
+// CompressedFile::ReadTable
+// 	Read in the header and the table of a compressed file.  The
+//	table's first sector says how long the file is, and so how many
+//	more sectors there are.
+//----------------------------------------------------------------------
+
+void
+CompressedFile::ReadTable()
+{
+    char *first = AllocBuffer(SectorSize);
+    int *sectors;
+
+    hdr->FetchInode(inode);
+    ASSERT(hdr->IsCompressed());
+    kernel->synchDisk->ReadSector(hdr->ByteToSector(0), first);
+    bcopy(first, (char *) &length, sizeof(int));
+    numChunks = divRoundUp(length, ChunkSize);
+    tableSectors = TableSectors(length);
+    table = AllocBuffer(tableSectors * SectorSize);
+    bcopy(first, table, SectorSize);
+    FreeBuffer(first, SectorSize);
+    if (tableSectors > 1) {
+	sectors = (int *) AllocBuffer(tableSectors * sizeof(int));
+	for (int i = 1; i < tableSectors; i++)
+	    sectors[i - 1] = hdr->ByteToSector(i * SectorSize);
+	kernel->synchDisk->ReadSectors(tableSectors - 1, sectors,
+				       table + SectorSize);
+	FreeBuffer((char *) sectors, tableSectors * sizeof(int));
+    }
+    chunkBytes = (unsigned short *) (table + sizeof(int));
+    DEBUG(dbgFile, "Opened compressed file " << inode << ": " << length <<
+	  " bytes in " << numChunks << " chunks");
+}
+
+//----------------------------------------------------------------------
+// CompressedFile::~CompressedFile
+// 	Free the in-memory copy of a compressed file.  It must have been
+//	flushed already.
+//----------------------------------------------------------------------
+
+CompressedFile::~CompressedFile()
+{
+    ASSERT(!cacheDirty && firstDirty == -1);
+    FreeBuffer(cache, ChunkSize);
+    FreeBuffer(table, tableSectors * SectorSize);
+    delete lock;
+    delete hdr;
+}
+
+//----------------------------------------------------------------------
+// CompressedFile::ChunkLength
+// 	Return how many bytes of data "chunk" holds: ChunkSize, except
+//	for the last chunk of the file.
+//----------------------------------------------------------------------
+
+int
+CompressedFile::ChunkLength(int chunk)
+{
+    return min(ChunkSize, length - chunk * ChunkSize);
+}
+
+//----------------------------------------------------------------------
+// CompressedFile::ChunkSectors
+// 	Fill in the sectors that the bytes stored for "chunk" are in, the
+//	first few of the chunk's slot, and return how many there are.
+//
+//	"sectors" -- room for SectorsPerChunk sector numbers
+//----------------------------------------------------------------------
+
+int
+CompressedFile::ChunkSectors(int chunk, int *sectors)
+{
+    int slot = tableSectors * SectorSize + chunk * ChunkSize;
+    int numSectors = divRoundUp(chunkBytes[chunk], SectorSize);
+
+    for (int i = 0; i < numSectors; i++)
+	sectors[i] = hdr->ByteToSector(slot + i * SectorSize);
+    return numSectors;
+}
+
+//----------------------------------------------------------------------
+// CompressedFile::Expand
+// 	Turn the bytes stored for "chunk" back into its data.  A chunk
+//	stored in as many bytes as it holds was stored as it is.
+//
+//	"stored" -- the sectors the chunk is stored in, as read
+//	"into" -- where to put the chunk's data
+//----------------------------------------------------------------------
+
+void
+CompressedFile::Expand(int chunk, char *stored, char *into)
+{
+    int size = ChunkLength(chunk);
+
+    if (chunkBytes[chunk] == 0) {
+	bzero(into, size);			// never written
+	return;
+    }
+    if (chunkBytes[chunk] == size)
+	bcopy(stored, into, size);		// stored as it is
+    else {
+	int expanded = LzExpand(stored, chunkBytes[chunk], into, size);
+	ASSERT(expanded == size);
+    }
+    kernel->stats->numChunksRead++;
+}
+
+//----------------------------------------------------------------------
+// CompressedFile::Pack
+// 	Compress the data of "chunk" so that it can be written, or keep it
+//	as it is if it doesn't get any smaller, and note in the table how
+//	many bytes are stored for it.  Return how many sectors to write.
+//
+//	"data" -- the chunk's data
+//	"stored" -- where to put what is to be written: room for the
+//		chunk's slot
+//	"sectors" -- where to put the sectors to write it to
+//----------------------------------------------------------------------
+
+int
+CompressedFile::Pack(int chunk, char *data, char *stored, int *sectors)
+{
+    int size = ChunkLength(chunk);
+    int numBytes = LzCompress(data, size, stored, size - 1);
+    int numSectors, entry;
+
+    if (numBytes == -1) {
+	bcopy(data, stored, size);
+	numBytes = size;
+    }
+    numSectors = divRoundUp(numBytes, SectorSize);
+    bzero(stored + numBytes, numSectors * SectorSize - numBytes);
+
+    chunkBytes[chunk] = numBytes;
+    entry = (sizeof(int) + chunk * sizeof(unsigned short)) / SectorSize;
+    if (firstDirty == -1 || entry < firstDirty)
+	firstDirty = entry;
+    if (entry > lastDirty)
+	lastDirty = entry;
+
+    kernel->stats->numChunksWritten++;
+    kernel->stats->chunkBytesIn += size;
+    kernel->stats->chunkBytesOut += numBytes;
+    return ChunkSectors(chunk, sectors);
+}
+
+//----------------------------------------------------------------------
+// CompressedFile::WriteCache
+// 	Write the cached chunk back to disk, if it has changed.
+//----------------------------------------------------------------------
+
+void
+CompressedFile::WriteCache()
+{
+    char *stored;
+    int sectors[SectorsPerChunk];
+    int numSectors;
+
+    if (!cacheDirty)
+	return;
+    stored = AllocBuffer(ChunkSize);	// (kernel stacks are small)
+    numSectors = Pack(cachedChunk, cache, stored, sectors);
+    kernel->synchDisk->WriteSectors(numSectors, sectors, stored);
+    FreeBuffer(stored, ChunkSize);
+    cacheDirty = FALSE;
+}
+
+//----------------------------------------------------------------------
+// CompressedFile::WriteTable
+// 	Write the sectors of the table that have changed back to disk.
+//----------------------------------------------------------------------
+
+void
+CompressedFile::WriteTable()
+{
+    int numSectors = lastDirty - firstDirty + 1;
+    int *sectors;
+
+    if (firstDirty == -1)
+	return;
+    sectors = (int *) AllocBuffer(numSectors * sizeof(int));
+    for (int i = 0; i < numSectors; i++)
+	sectors[i] = hdr->ByteToSector((firstDirty + i) * SectorSize);
+    kernel->synchDisk->WriteSectors(numSectors, sectors,
+				    table + firstDirty * SectorSize);
+    FreeBuffer((char *) sectors, numSectors * sizeof(int));
+    firstDirty = lastDirty = -1;
+}
+
+//----------------------------------------------------------------------
+// CompressedFile::Load
+// 	Make "chunk" the cached chunk, writing back the one there was.
+//----------------------------------------------------------------------
+
+void
+CompressedFile::Load(int chunk)
+{
+    char *stored;
+    int sectors[SectorsPerChunk];
+    int numSectors;
+
+    if (chunk == cachedChunk)
+	return;
+    WriteCache();
+    stored = AllocBuffer(ChunkSize);
+    numSectors = ChunkSectors(chunk, sectors);
+    if (numSectors > 0)
+	kernel->synchDisk->ReadSectors(numSectors, sectors, stored);
+    Expand(chunk, stored, cache);
+    FreeBuffer(stored, ChunkSize);
+    cachedChunk = chunk;
+}
+
+//----------------------------------------------------------------------
+// CompressedFile::Flush
+// 	Write everything that has changed back to disk: the cached chunk,
+//	then the table.
+//----------------------------------------------------------------------
+
+void
+CompressedFile::Flush()
+{
+    lock->Acquire();
+    WriteCache();
+    WriteTable();
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// CompressedFile::ReadAt
+// 	Read part of a compressed file.  A read within one chunk goes
+//	through the cache.  A read of several chunks reads all the sectors
+//	they are stored in at once, so that sectors on different disks are
+//	read in parallel, then expands each chunk in turn (the cached one
+//	is taken from the cache, as it may have changed).
+//
+//	"into" -- the buffer to contain the data read
+//	"numBytes" -- the number of bytes to read
+//	"position" -- the offset within the file of the first byte
+//----------------------------------------------------------------------
+
+int
+CompressedFile::ReadAt(char *into, int numBytes, int position)
+{
+    int first, last, numSectors, chunk;
+    int *sectors;
+    char *stored, *data, *at;
+
+    if ((numBytes <= 0) || (position >= length))
+	return 0;
+    if ((position + numBytes) > length)
+	numBytes = length - position;
+    first = position / ChunkSize;
+    last = (position + numBytes - 1) / ChunkSize;
+
+    lock->Acquire();
+    if (first == last) {
+	Load(first);
+	bcopy(&cache[position - first * ChunkSize], into, numBytes);
+	lock->Release();
+	return numBytes;
+    }
+
+    numSectors = 0;
+    sectors = (int *) AllocBuffer((last - first + 1) * SectorsPerChunk
+				  * sizeof(int));
+    for (chunk = first; chunk <= last; chunk++)
+	if (chunk != cachedChunk)
+	    numSectors += ChunkSectors(chunk, sectors + numSectors);
+    stored = AllocBuffer((last - first + 1) * ChunkSize);
+    if (numSectors > 0)
+	kernel->synchDisk->ReadSectors(numSectors, sectors, stored);
+
+    data = AllocBuffer(ChunkSize);
+    at = stored;
+    for (chunk = first; chunk <= last; chunk++) {
+	int start = max(position, chunk * ChunkSize);
+	int end = min(position + numBytes, chunk * ChunkSize + ChunkSize);
+
+	if (chunk == cachedChunk)
+	    bcopy(&cache[start - chunk * ChunkSize], &into[start - position],
+		  end - start);
+	else {
+	    Expand(chunk, at, data);
+	    at += divRoundUp(chunkBytes[chunk], SectorSize) * SectorSize;
+	    bcopy(&data[start - chunk * ChunkSize], &into[start - position],
+		  end - start);
+	}
+    }
+    lock->Release();
+
+    FreeBuffer(data, ChunkSize);
+    FreeBuffer(stored, (last - first + 1) * ChunkSize);
+    FreeBuffer((char *) sectors, (last - first + 1) * SectorsPerChunk
+				 * sizeof(int));
+    return numBytes;
+}
+
+//----------------------------------------------------------------------
+// CompressedFile::WriteAt
+// 	Write part of a compressed file.  Chunks written only in part go
+//	through the cache.  Chunks written whole are compressed and then
+//	written all at once, without being read first (dropping the
+//	cached copy of one, if there is one).
+//
+//	"from" -- the buffer containing the data to be written
+//	"numBytes" -- the number of bytes to write
+//	"position" -- the offset within the file of the first byte
+//----------------------------------------------------------------------
+
+int
+CompressedFile::WriteAt(char *from, int numBytes, int position)
+{
+    int first, last, numSectors, chunk;
+    int *sectors;
+    char *stored;
+
+    if ((numBytes <= 0) || (position >= length))
+	return 0;
+    if ((position + numBytes) > length)
+	numBytes = length - position;
+    first = position / ChunkSize;
+    last = (position + numBytes - 1) / ChunkSize;
+
+    sectors = (int *) AllocBuffer((last - first + 1) * SectorsPerChunk
+				  * sizeof(int));
+    stored = AllocBuffer((last - first + 1) * ChunkSize);
+    numSectors = 0;
+
+    lock->Acquire();
+    for (chunk = first; chunk <= last; chunk++) {
+	int start = max(position, chunk * ChunkSize);
+	int end = min(position + numBytes, chunk * ChunkSize + ChunkSize);
+
+	if (start == chunk * ChunkSize && end - start == ChunkLength(chunk)) {
+	    if (chunk == cachedChunk) {
+		cachedChunk = -1;
+		cacheDirty = FALSE;
+	    }
+	    numSectors += Pack(chunk, &from[start - position],
+			       &stored[numSectors * SectorSize],
+			       sectors + numSectors);
+	} else {
+	    Load(chunk);
+	    bcopy(&from[start - position], &cache[start - chunk * ChunkSize],
+		  end - start);
+	    cacheDirty = TRUE;
+	}
+    }
+    if (numSectors > 0)
+	kernel->synchDisk->WriteSectors(numSectors, sectors, stored);
+    lock->Release();
+
+    FreeBuffer(stored, (last - first + 1) * ChunkSize);
+    FreeBuffer((char *) sectors, (last - first + 1) * SectorsPerChunk
+				 * sizeof(int));
+    return numBytes;
+}
+
+#endif // FILESYS_STUB
@@ -0,0 +1,105 @@
+// compfile.h
+//	Data structures for reading and writing a compressed file.
+//
+//	A file can be created compressed (see FileSystem::Create).  Its
+//	data is cut into chunks of ChunkSize bytes, and each chunk is
+//	compressed (lzss.h) on its own, so that reading or writing a
+//	few bytes only has to expand the chunk they are in.  A chunk that
+//	does not get smaller is stored as it is.
+//
+//	On disk, a compressed file starts with a table: the file's length
+//	in bytes, then the number of bytes stored for each chunk (0 for a
+//	chunk that has never been written, and reads as zeroes).  After
+//	the table, each chunk has a "slot" of ChunkSize bytes in the file,
+//	and is stored in as many sectors at the start of its slot as it
+//	needs.  The file header allocates all the slots when the file is
+//	created, so a chunk can always be rewritten in place, even if it
+//	compresses less well than before; what compression saves is the
+//	sectors read and written, not the sectors used.
+//
+//	Everyone who has the file open shares one CompressedFile: the
+//	table, and a cache of the chunk last used.  Small reads and writes
+//	go through the cache, so a file read or written a few bytes at a
+//	time expands and compresses each chunk just once.  The cached
+//	chunk is written back when another chunk is cached, or when the
+//	file is flushed -- by a write system call before it returns, and
+//	by the last close.  Reads and writes of whole chunks go straight
+//	to the disk, a batch at a time.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef COMPFILE_H
+#define COMPFILE_H
+
+#include "copyright.h"
+#include "disk.h"
+
+#define SectorsPerChunk	8			// sectors compressed together
+#define ChunkSize	(SectorsPerChunk * SectorSize)	// bytes in them
+
+class FileHeader;
+class Lock;
+
+class CompressedFile {
+  public:
+    static int DiskBytes(int length);	// Bytes a compressed file of
+					// "length" bytes takes in its header
+    static void Format(FileHeader *hdr, int length);
+					// Write the table of a new file,
+					// with every chunk unwritten
+
+    static CompressedFile *Open(int inode);
+					// The compressed file whose header
+					// is "inode", read in if need be
+    void Close();			// Let go of it, writing it back and
+					// freeing it if no one else has it
+
+    int Length() { return length; }	// Bytes of data in the file
+
+    int ReadAt(char *into, int numBytes, int position);
+    int WriteAt(char *from, int numBytes, int position);
+					// As for OpenFile
+
+    void Flush();			// Write the cached chunk and the
+					// table back to disk
+
+  private:
+    CompressedFile(int inode);		// Initialize, with nothing read
+    ~CompressedFile();
+    void ReadTable();			// Read in the header and table
+
+    int ChunkLength(int chunk);		// Bytes of data in "chunk"
+    int ChunkSectors(int chunk, int *sectors);
+					// List the sectors "chunk" is
+					// stored in; return how many
+    void Expand(int chunk, char *stored, char *into);
+					// Expand the bytes stored for "chunk"
+    int Pack(int chunk, char *data, char *stored, int *sectors);
+					// Compress "chunk" for writing,
+					// and list the sectors it goes in
+    void Load(int chunk);		// Make "chunk" the cached chunk
+    void WriteCache();			// Write the cached chunk back
+    void WriteTable();			// Write the changed table sectors
+
+    int inode;				// where the file's header is
+    int numOpen;			// how many have it open
+    FileHeader *hdr;			// the file's header
+    Lock *lock;				// held while using any of this
+
+    int length;				// bytes of data in the file
+    int numChunks;			// chunks they are cut into
+    int tableSectors;			// sectors the table takes
+    char *table;			// the table, as on disk
+    unsigned short *chunkBytes;		// bytes stored for each chunk
+					//  (in "table")
+    int firstDirty, lastDirty;		// table sectors changed since
+					//  written (-1 if none)
+
+    int cachedChunk;			// the chunk in "cache", or -1
+    char *cache;			// its data, expanded
+    bool cacheDirty;			// changed since written?
+};
+
+#endif // COMPFILE_H
@@ -23,6 +23,10 @@
 #include "utility.h"
 #include "filehdr.h"
 #include "directory.h"
+#include "debug.h"
+#include "slab.h"
+
+static ObjectCache *directoryCache = NULL;	// where Directories come from
 
 //----------------------------------------------------------------------
 // Directory::Directory
@@ -36,7 +40,7 @@
 
 Directory::Directory(int size)
 {
-    table = new DirectoryEntry[size];
+    table = (DirectoryEntry *) AllocBuffer(sizeof(DirectoryEntry) * size);
 	
 	// MP4 mod tag
 	memset(table, 0, sizeof(DirectoryEntry) * size);  // dummy operation to keep valgrind happy
@@ -55,9 +59,32 @@ Directory::Directory(int size)
 
 Directory::~Directory()
 { 
-    delete [] table;
+    FreeBuffer((char *) table, sizeof(DirectoryEntry) * tableSize);
 } 
 
+//----------------------------------------------------------------------
+// Directory::operator new, Directory::operator delete
+//	A directory, and its table, is read in for every step of every
+//	path looked up, so both come from slab caches instead of from
+//	the heap.
+//----------------------------------------------------------------------
+
+void *
+Directory::operator new(size_t size)
+{
+    ASSERT(size == sizeof(Directory));
+    if (directoryCache == NULL)
+	directoryCache = new ObjectCache("Directory", sizeof(Directory));
+    return directoryCache->Alloc();
+}
+
+void
+Directory::operator delete(void *dir)
+{
+    if (dir != NULL)
+	directoryCache->Free(dir);
+}
+
 //----------------------------------------------------------------------
 // Directory::FetchFrom
 // 	Read the contents of the directory from disk.
@@ -106,9 +133,9 @@ Directory::FindIndex(char *name)
 
 //----------------------------------------------------------------------
 // Directory::Find
-// 	Look up file name in directory, and return the disk sector number
-//	where the file's header is stored. Return -1 if the name isn't 
-//	in the directory.
+// 	Look up file name in directory, and return the number of the
+//	inode where the file's header is stored. Return -1 if the name
+//	isn't in the directory.
 //
 //	"name" -- the file name to look up
 //----------------------------------------------------------------------
@@ -119,8 +146,8 @@ Directory::Find(char *name)
     int i = FindIndex(name);
 
     if (i != -1) {
-        //printf("Find: %s %d\n", name, table[i].sector);
-	return table[i].sector;
+        //printf("Find: %s %d\n", name, table[i].inode);
+	return table[i].inode;
     }
     return -1;
 }
@@ -143,11 +170,11 @@ Directory::isDirectory(char *name)
 //	additional file names.
 //
 //	"name" -- the name of the file being added
-//	"newSector" -- the disk sector containing the added file's header
+//	"newInode" -- the inode containing the added file's header
 //----------------------------------------------------------------------
 
 bool
-Directory::Add(char *name, int newSector, bool isDirectory)
+Directory::Add(char *name, int newInode, bool isDirectory)
 { 
     if (FindIndex(name) != -1){
 	    return FALSE;
@@ -159,7 +186,7 @@ Directory::Add(char *name, int newSector, bool isDirectory)
                 table[i].isDirectory = TRUE;
             }
             strncpy(table[i].name, name, FileNameMaxLen); 
-            table[i].sector = newSector;
+            table[i].inode = newInode;
             return TRUE;
         }
     return FALSE;	// no space.  Fix when we have extensible files.
@@ -185,6 +212,20 @@ Directory::Remove(char *name)
     return TRUE;	
 }
 
+//----------------------------------------------------------------------
+// Directory::IsEmpty
+// 	Return TRUE if no entry of the directory is in use.
+//----------------------------------------------------------------------
+
+bool
+Directory::IsEmpty()
+{
+    for (int i = 0; i < tableSize; i++)
+        if (table[i].inUse)
+            return FALSE;
+    return TRUE;
+}
+
 //----------------------------------------------------------------------
 // Directory::List
 // 	List all the file names in the directory. 
@@ -214,7 +255,7 @@ Directory::RecursiveList()
         if (table[i].inUse){
             if(table[i].isDirectory){
                 printf("[D]%s\n",table[i].name);
-                directoryObj = new OpenFile(table[i].sector);	// go to next directory
+                directoryObj = new OpenFile(table[i].inode);	// go to next directory
                 subDirectory->FetchFrom(directoryObj);
                 subDirectory->RecursiveList();
             }else{
@@ -226,7 +267,7 @@ Directory::RecursiveList()
 
 //----------------------------------------------------------------------
 // Directory::Print
-// 	List all the file names in the directory, their FileHeader locations,
+// 	List all the file names in the directory, their FileHeader inodes,
 //	and the contents of each file.  For debugging.
 //----------------------------------------------------------------------
 
@@ -238,8 +279,8 @@ Directory::Print()
     printf("Directory contents:\n");
     for (int i = 0; i < tableSize; i++)
 	if (table[i].inUse) {
-	    printf("Name: %s, Sector: %d\n", table[i].name, table[i].sector);
-	    hdr->FetchFrom(table[i].sector);
+	    printf("Name: %s, Inode: %d\n", table[i].name, table[i].inode);
+	    hdr->FetchInode(table[i].inode);
 	    hdr->Print();
 	}
     printf("\n");
@@ -1,10 +1,10 @@
 // directory.h 
 //	Data structures to manage a UNIX-like directory of file names.
 // 
-//      A directory is a table of pairs: <file name, sector #>,
+//      A directory is a table of pairs: <file name, inode #>,
 //	giving the name of each file in the directory, and 
 //	where to find its file header (the data structure describing
-//	where to find the file's data blocks) on disk.
+//	where to find the file's data blocks) in the inode table.
 //
 //      We assume mutual exclusion is provided by the caller.
 //
@@ -34,8 +34,8 @@
 class DirectoryEntry {
   public:
     bool inUse;				// Is this directory entry in use?
-    int sector;				// Location on disk to find the 
-					//   FileHeader for this file 
+    int inode;				// Inode holding the FileHeader
+					//   for this file 
     char name[FileNameMaxLen + 1];	// Text name for file, with +1 for 
 					// the trailing '\0'
     
@@ -58,17 +58,22 @@ class Directory {
 					// with space for "size" files
     ~Directory();			// De-allocate the directory
 
+    void *operator new(size_t size);	// Directories are kept in a
+    void operator delete(void *dir);	//  slab cache (slab.h)
+
     void FetchFrom(OpenFile *file);  	// Init directory contents from disk
     void WriteBack(OpenFile *file);	// Write modifications to 
 					// directory contents back to disk
 
-    int Find(char *name);		// Find the sector number of the 
+    int Find(char *name);		// Find the inode number of the 
 					// FileHeader for file: "name"
 
-    bool Add(char *name, int newSector, bool idDirectory);  // Add a file name into the directory
+    bool Add(char *name, int newInode, bool idDirectory);  // Add a file name into the directory
 
     bool Remove(char *name);		// Remove a file from the directory
 
+    bool IsEmpty();			// Is no name in the directory?
+
     void List();			// Print the names of all the files
 					//  in the directory
     void RecursiveList();
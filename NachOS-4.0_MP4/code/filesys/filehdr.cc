@@ -5,10 +5,11 @@
 //	The file header is used to locate where on disk the
 //	file's data is stored.  We implement this as a fixed size
 //	table of pointers -- each entry in the table points to the
-//	disk sector containing that portion of the file data
-//	(in other words, there are no indirect or doubly indirect
-//	blocks). The table size is chosen so that the file header
-//	will be just big enough to fit in one disk sector,
+//	disk sector containing that portion of the file data, or, for
+//	a larger file, to a sub-header covering a larger portion.
+//	A file's own header is an inode: a small table, packed with
+//	others into the sectors of the inode table.  A sub-header is
+//	a table just big enough to fill one disk sector.
 //
 //      Unlike in a real system, we do not keep track of file permissions,
 //	ownership, last modification date, etc., in the file header.
@@ -27,36 +28,85 @@
 #include "filehdr.h"
 #include "debug.h"
 #include "synchdisk.h"
+#include "refmap.h"
 #include "main.h"
+#include "slab.h"
 
-#define Level2 NumDirect *SectorSize
-#define Level3 NumDirect *NumDirect *SectorSize
-#define Level4 NumDirect *NumDirect *NumDirect *SectorSize
+static ObjectCache *headerCache = NULL;	// where FileHeaders come from
 
 //----------------------------------------------------------------------
 // MP4 mod tag
 // FileHeader::FileHeader
 //	There is no need to initialize a fileheader,
-//	since all the information should be initialized by Allocate or FetchFrom.
+//	since all the information should be initialized by Allocate, FetchInode or FetchFrom.
 //	The purpose of this function is to keep valgrind happy.
+//
+//	"isInode" -- is this a file's own header (kept in the inode
+//		table), rather than one of its sub-headers?
 //----------------------------------------------------------------------
-FileHeader::FileHeader()
+FileHeader::FileHeader(bool isInode)
 {
 	numBytes = -1;
 	numSectors = -1;
-	memset(dataSectors, -1, sizeof(dataSectors));
+	memset(dataSectors, -1, NumDirect * sizeof(int));
+	this->isInode = isInode;
+	compressed = FALSE;
+	shared = FALSE;
+	cached = NULL;
+	cachedSector = -1;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::operator new, FileHeader::operator delete
+//	File headers are made and thrown away for every file opened
+//	and every sub-header read, so they come from a cache of their
+//	own instead of from the heap.
+//----------------------------------------------------------------------
+void *
+FileHeader::operator new(size_t size)
+{
+    ASSERT(size == sizeof(FileHeader));
+    if (headerCache == NULL)
+	headerCache = new ObjectCache("FileHeader", sizeof(FileHeader));
+    return headerCache->Alloc();
+}
+
+void
+FileHeader::operator delete(void *hdr)
+{
+    if (hdr != NULL)
+	headerCache->Free(hdr);
 }
 
 //----------------------------------------------------------------------
 // MP4 mod tag
 // FileHeader::~FileHeader
-//	Currently, there is not need to do anything in destructor function.
-//	However, if you decide to add some "in-core" data in header
-//	Always remember to deallocate their space or you will leak memory
+//	De-allocate the in-core data: the sub-header ByteToSector keeps.
 //----------------------------------------------------------------------
 FileHeader::~FileHeader()
 {
-	// nothing to do now
+	delete cached;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::EntryBytes
+// 	Return how many bytes of the file each entry of dataSectors
+//	covers: SectorSize if they point straight at the data, or else
+//	the size a sub-header with NumDirect entries of the next size
+//	down can cover.  The smallest size that lets the entries cover
+//	the whole file is used.  (With large sectors, that size can be
+//	more than an int holds; then any file fits under one entry.)
+//----------------------------------------------------------------------
+
+int
+FileHeader::EntryBytes()
+{
+	int entries = isInode ? NumInodeDirect : NumDirect;
+	long long bound = SectorSize;
+
+	while (numBytes > bound * entries)
+		bound *= NumDirect;
+	return (int) min(bound, (long long) 0x7fffffff);
 }
 
 //----------------------------------------------------------------------
@@ -75,40 +125,22 @@ FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
 {
     numBytes = fileSize;
 	numSectors = divRoundUp(fileSize, SectorSize);
+	cachedSector = -1;
 	if (freeMap->NumClear() < numSectors) {
 		// cout << "false to all\n";
 		return FALSE; // not enough space
 	}
-	else if (fileSize > Level2) {
-		
-		int bound, i = 0;
-
-		if (fileSize > Level4) {
-			bound = Level4;
-			DEBUG(dbgFile, "filesize is " << fileSize << " allocate level4 header size " << bound);
-		}
-		else if (fileSize > Level3) {
-			bound = Level3;
-			DEBUG(dbgFile, "filesize is " << fileSize << " allocate level3 header size " << bound);
-		}
-		else {
-			bound = Level2;
-			DEBUG(dbgFile, "filesize is " << fileSize << " allocate level2 header size " << bound);
-		}
-		while (fileSize > 0){
+	int bound = EntryBytes();
+	if (bound > SectorSize) {
+		DEBUG(dbgFile, "filesize is " << fileSize << " allocate sub-headers of size " << bound);
+		for (int i = 0; fileSize > 0; i++) {
 			dataSectors[i] = freeMap->FindAndSet();
 			ASSERT(dataSectors[i] >= 0);
-			FileHeader *subheader = new FileHeader;
-			if (fileSize > bound){
-				subheader->Allocate(freeMap, bound);
-				fileSize -= bound; 
-				subheader->WriteBack(dataSectors[i]);
-			} else {
-				subheader->Allocate(freeMap, fileSize);
-				fileSize -= bound;
-				subheader->WriteBack(dataSectors[i]);
-			}
-			i++;
+			FileHeader *subheader = new FileHeader(FALSE);
+			subheader->Allocate(freeMap, min(fileSize, bound));
+			subheader->WriteBack(dataSectors[i]);
+			delete subheader;
+			fileSize -= bound;
 		}
 	}
 	else{
@@ -127,35 +159,288 @@ FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
 
 //----------------------------------------------------------------------
 // FileHeader::Deallocate
-// 	De-allocate all the space allocated for data blocks for this file.
+// 	De-allocate all the space allocated for data blocks for this file,
+//	including the sectors holding its sub-headers, and tell the disk
+//	those sectors are no longer in use.
+//
+//	A sector that other headers point at as well is not freed; there
+//	is just one pointer fewer at it.  (For a sub-header, that leaves
+//	what it points at alone too.)
 //
 //	"freeMap" is the bit map of free disk sectors
+//	"refs" counts the pointers at shared sectors, or is NULL if the
+//		file shares none
 //----------------------------------------------------------------------
 
 void
-FileHeader::Deallocate(PersistentBitmap *freeMap)
+FileHeader::Deallocate(PersistentBitmap *freeMap, RefCountMap *refs)
 {
-	if (numBytes > Level2){
-		int round = divRoundUp(numSectors, NumDirect);
-		FileHeader *subhdr;
-		for (int i = 0; i < round; i++) {
-			subhdr = new FileHeader;
+	FreeEntries(0, freeMap, refs);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FreeEntries
+// 	Free what the entries of dataSectors from "first" on point at:
+//	the data sectors, or the sub-headers and everything below them.
+//	The sectors are only cleared in "freeMap"; the caller writes it
+//	back once, however many there were.  One sub-header is read in
+//	at a time, into the same FileHeader.
+//
+//	"first" -- the first entry to free
+//	"freeMap" is the bit map of free disk sectors
+//	"refs" counts the pointers at shared sectors, or is NULL if the
+//		file shares none
+//----------------------------------------------------------------------
+
+void
+FileHeader::FreeEntries(int first, PersistentBitmap *freeMap,
+			RefCountMap *refs)
+{
+	int bound = EntryBytes();
+	// one sub-header per "bound" bytes, as in Allocate (or, if
+	// "bound" is SectorSize, one data sector each)
+	int round = divRoundUp(numBytes, bound);
+	FileHeader *subhdr = NULL;
+
+	if (bound > SectorSize)
+		subhdr = new FileHeader(FALSE);
+	for (int i = first; i < round; i++) {
+		if (refs != NULL && refs->Release(dataSectors[i]))
+			continue;	// someone else still has it
+		if (subhdr != NULL) {
 			subhdr->FetchFrom(dataSectors[i]);
-			subhdr->Deallocate(freeMap);
+			subhdr->Deallocate(freeMap, refs);
 		}
+		ASSERT(freeMap->Test((int)dataSectors[i])); // ought to be marked!
+		freeMap->Clear((int)dataSectors[i]);
+		kernel->synchDisk->TrimSector((int)dataSectors[i]);
 	}
-	else {
-		for (int i = 0; i < numSectors; i++){
-			ASSERT(freeMap->Test((int)dataSectors[i])); // ought to be marked!
-			freeMap->Clear((int)dataSectors[i]);
+	delete subhdr;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Truncate
+// 	Shrink the part of the file this header covers to "length" bytes.
+//	The entries wholly past the new end are freed (FreeEntries), and
+//	the sub-header holding the new end is shrunk the same way and
+//	written back.  If what is left then fits under fewer levels of
+//	sub-headers, the levels no longer needed are collapsed: this
+//	header takes over the entries of the one sub-header it has left,
+//	and that sector is freed too -- the layout is the one Allocate
+//	would have made for a file of "length" bytes.  The caller writes
+//	this header back, and then "freeMap", once.
+//
+//	"length" -- the new length, no more than the old one
+//	"freeMap" is the bit map of free disk sectors
+//	"refs" counts the pointers at shared sectors, or is NULL if the
+//		file shares none; then the sub-headers on the way to the
+//		new end must already be the file's own (CopyOnWrite)
+//----------------------------------------------------------------------
+
+void
+FileHeader::Truncate(int length, PersistentBitmap *freeMap,
+		     RefCountMap *refs)
+{
+	int bound = EntryBytes();
+	int keep = divRoundUp(length, bound);	// entries left
+
+	ASSERT(length >= 0 && length <= numBytes);
+	cachedSector = -1;
+	FreeEntries(keep, freeMap, refs);
+	if (keep > 0 && bound > SectorSize) {
+		int covered = min(numBytes - (keep - 1) * bound, bound);
+		int wanted = length - (keep - 1) * bound;
+
+		if (wanted < covered) {		// the end is in this one
+			FileHeader *subhdr = new FileHeader(FALSE);
+
+			subhdr->FetchFrom(dataSectors[keep - 1]);
+			subhdr->Truncate(wanted, freeMap, refs);
+			subhdr->WriteBack(dataSectors[keep - 1]);
+			delete subhdr;
 		}
 	}
-	
+	numBytes = length;
+	numSectors = divRoundUp(length, SectorSize);
+
+	// A smaller bound means that the file fits in the one entry left,
+	// and its sub-header covers the whole file.  If this header can
+	// cover that much with entries of the sub-header's size, take its
+	// entries over; if not, it stays, as this header's only entry.
+	while (length > 0 && EntryBytes() < bound) {
+		FileHeader *subhdr = new FileHeader(FALSE);
+		int sector = dataSectors[0];
+
+		subhdr->FetchFrom(sector);
+		bound = subhdr->EntryBytes();
+		if (EntryBytes() > bound) {
+			delete subhdr;
+			break;
+		}
+		memcpy(dataSectors, subhdr->dataSectors,
+		       divRoundUp(length, bound) * sizeof(int));
+		if (refs != NULL && refs->Release(sector))
+			subhdr->Share(refs);	// its entries are in two places
+		else {
+			ASSERT(freeMap->Test(sector));
+			freeMap->Clear(sector);
+			kernel->synchDisk->TrimSector(sector);
+		}
+		delete subhdr;
+	}
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Share
+// 	Count one more pointer at each sector this header points at, for
+//	a clone of the file that is to get a copy of this header.  The
+//	sectors further down are shared along with them, without being
+//	counted again; so cloning a file of any size touches only the
+//	few counts of the sectors its inode points at.
+//
+//	"refs" counts the pointers at shared sectors
+//----------------------------------------------------------------------
+
+void
+FileHeader::Share(RefCountMap *refs)
+{
+	int bound = EntryBytes();
+	int entries = divRoundUp(numBytes, bound);
+
+	for (int i = 0; i < entries; i++)
+		refs->AddRef(dataSectors[i]);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::CopyOnWrite
+// 	Make sure that the sectors holding bytes "from" to "to" - 1 of the
+//	part of the file this header covers belong to this file alone,
+//	before they are written.  Each one that is shared with a clone
+//	is replaced by a copy, and so is each shared sub-header on the
+//	way to it; the clone keeps the original.  A copied sub-header
+//	points at the same sectors as the original, so each of those is
+//	counted once more.  A data sector that the write covers entirely
+//	is not copied, just replaced, as its old contents are about to
+//	be overwritten.
+//
+//	Changed sub-headers are written back here; the caller writes
+//	this header back if it changed.  Return 2 if it did, 1 if only
+//	sub-headers below it did, 0 if nothing was copied, or -1 if the
+//	disk filled up (the sectors unshared so far stay so, the header
+//	may have changed, and it is still consistent).
+//
+//	"from", "to" -- the bytes to be written, from the start of the
+//		part of the file this header covers
+//	"refs" counts the pointers at shared sectors
+//----------------------------------------------------------------------
+
+int
+FileHeader::CopyOnWrite(int from, int to, RefCountMap *refs)
+{
+	int bound = EntryBytes();
+	bool changed = FALSE, copied = FALSE;
+	char *buf;
+
+	cachedSector = -1;			// sub-headers may change
+	for (int i = from / bound; i <= (to - 1) / bound; i++) {
+		int sector = dataSectors[i];
+		bool isShared = refs->Extra(sector) > 0;
+
+		if (isShared) {
+			if ((dataSectors[i] = refs->Copy(sector)) == -1) {
+				dataSectors[i] = sector;
+				return -1;
+			}
+			changed = TRUE;
+		}
+		if (bound > SectorSize) {
+			FileHeader *subhdr = new FileHeader(FALSE);
+			int first = max(from - i * bound, 0);
+			int last = min(to - i * bound, bound);
+			int result;
+
+			subhdr->FetchFrom(sector);
+			if (isShared)
+				subhdr->Share(refs);	// the copy points there too
+			result = subhdr->CopyOnWrite(first, last, refs);
+			if (isShared || result == 2 || result == -1)
+				subhdr->WriteBack(dataSectors[i]);
+			delete subhdr;
+			if (result == -1)
+				return -1;
+			if (result > 0)
+				copied = TRUE;
+		} else if (isShared && (from > i * SectorSize ||
+				      to < (i + 1) * SectorSize)) {
+			buf = AllocBuffer(SectorSize);
+			kernel->synchDisk->ReadSector(sector, buf);
+			kernel->synchDisk->WriteSector(dataSectors[i], buf);
+			FreeBuffer(buf, SectorSize);
+		}
+	}
+	if (changed)
+		return 2;
+	return copied ? 1 : 0;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FetchInode
+// 	Fetch contents of a file's header from its inode.
+//
+//	"inode" is the number of the file's inode in the inode table
+//----------------------------------------------------------------------
+
+void
+FileHeader::FetchInode(int inode)
+{
+	char *buf = AllocBuffer(SectorSize);
+
+	ASSERT(isInode && inode >= 0 && inode < NumInodes);
+	kernel->synchDisk->ReadSector(inode / InodesPerSector, buf);
+	memcpy(&numBytes, buf + (inode % InodesPerSector) * InodeSize,
+	       sizeof(int));
+	memcpy(dataSectors, buf + (inode % InodesPerSector) * InodeSize +
+	       sizeof(int), NumInodeDirect * sizeof(int));
+	FreeBuffer(buf, SectorSize);
+	compressed = (numBytes & CompressedFlag) != 0;
+	shared = (numBytes & SharedFlag) != 0;
+	numBytes &= ~(CompressedFlag | SharedFlag);
+	numSectors = divRoundUp(numBytes, SectorSize);
+	cachedSector = -1;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::WriteInode
+// 	Write the modified contents of a file's header back to its inode,
+//	leaving the other inodes in the same sector as they were.
+//
+//	"inode" is the number of the file's inode in the inode table
+//----------------------------------------------------------------------
+
+void
+FileHeader::WriteInode(int inode)
+{
+	char *buf = AllocBuffer(SectorSize);
+	int size = numBytes;
+
+	if (compressed)
+		size |= CompressedFlag;
+	if (shared)
+		size |= SharedFlag;
+
+	ASSERT(isInode && inode >= 0 && inode < NumInodes);
+	kernel->synchDisk->ReadSector(inode / InodesPerSector, buf);
+	memcpy(buf + (inode % InodesPerSector) * InodeSize, &size,
+	       sizeof(int));
+	memcpy(buf + (inode % InodesPerSector) * InodeSize + sizeof(int),
+	       dataSectors, NumInodeDirect * sizeof(int));
+	kernel->synchDisk->WriteSector(inode / InodesPerSector, buf);
+	FreeBuffer(buf, SectorSize);
 }
 
 //----------------------------------------------------------------------
 // FileHeader::FetchFrom
-// 	Fetch contents of file header from disk.
+// 	Fetch contents of a sub-header from disk.
 //
 //	"sector" is the disk sector containing the file header
 //----------------------------------------------------------------------
@@ -163,7 +448,9 @@ FileHeader::Deallocate(PersistentBitmap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
+	ASSERT(!isInode);
     kernel->synchDisk->ReadSector(sector, (char *)this);
+	cachedSector = -1;
 
 	/*
 		MP4 Hint:
@@ -174,7 +461,7 @@ FileHeader::FetchFrom(int sector)
 
 //----------------------------------------------------------------------
 // FileHeader::WriteBack
-// 	Write the modified contents of the file header back to disk.
+// 	Write the modified contents of a sub-header back to disk.
 //
 //	"sector" is the disk sector to contain the file header
 //----------------------------------------------------------------------
@@ -182,13 +469,14 @@ FileHeader::FetchFrom(int sector)
 void
 FileHeader::WriteBack(int sector)
 {
+	ASSERT(!isInode);
     kernel->synchDisk->WriteSector(sector, (char *)this);
 
 	/*
 		MP4 Hint:
 		After you add some in-core informations, you may not want to write all fields into disk.
 		Use this instead:
-		char buf[SectorSize];
+		char *buf = AllocBuffer(SectorSize);
 		memcpy(buf + offset, &dataToBeWritten, sizeof(dataToBeWritten));
 		...
 	*/
@@ -202,27 +490,37 @@ FileHeader::WriteBack(int sector)
 //	offset in the file) to a physical address (the sector where the
 //	data at the offset is stored).
 //
+//	The sub-header used is kept in memory (with the one below it, and
+//	so on), so going through the file in order reads each sub-header
+//	from disk once, rather than once for every sector.  Threads that
+//	share an OpenFile to read it (as lookups share the root directory,
+//	holding its lock to read) may get here at once, so a sub-header is
+//	only made the cached one after it has been read in whole.  That is
+//	enough when the sub-headers point straight at the data, as a
+//	directory's do: nothing waits between finding the cached one and
+//	using it.  A deeper file's cached sub-header could be replaced
+//	while another thread is still looking through it, so its data is
+//	only read with the file locked to write (FileSystem::ReadFile,
+//	ReadFileAt), one thread at a time.
+//
 //	"offset" is the location within the file of the byte in question
 //----------------------------------------------------------------------
 
 int
 FileHeader::ByteToSector(int offset)
 {
-	if (numBytes > Level2) {
-		int nBytes;
-		int which = -1;
-		int pos = 0;
-		FileHeader *subheader;
-
-		if (numBytes > Level4) nBytes = Level4;
-		else if (numBytes > Level3) nBytes = Level3;
-		else if (numBytes > Level2) nBytes = Level2;
-		
-		which = divRoundDown(offset, nBytes);
-		pos = offset % nBytes;
-		subheader = new FileHeader;
-		subheader->FetchFrom(dataSectors[which]);
-		return subheader->ByteToSector(pos); //test
+	int bound = EntryBytes();
+	if (bound > SectorSize) {
+		int sector = dataSectors[offset / bound];
+		if (cachedSector != sector) {
+			FileHeader *subHdr = new FileHeader(FALSE);
+
+			subHdr->FetchFrom(sector);
+			delete cached;
+			cached = subHdr;
+			cachedSector = sector;
+		}
+		return cached->ByteToSector(offset % bound);
 	} else {
 		return (dataSectors[offset / SectorSize]);
 	}
@@ -240,6 +538,77 @@ FileHeader::FileLength()
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::GetSectors
+// 	Fill in "sectors" with every sector the file occupies besides
+//	this header, in the order Allocate lays them out: each sub-header
+//	of a large file, followed by the sectors it points to; or, for a
+//	small file, just the data sectors.  The data sectors come in file
+//	order.  Return how many sectors there are; if "sectors" is NULL,
+//	just count them.
+//----------------------------------------------------------------------
+
+int
+FileHeader::GetSectors(int *sectors)
+{
+	int bound = EntryBytes();
+	if (bound > SectorSize) {
+		int round = divRoundUp(numBytes, bound);
+		int count = 0;
+		FileHeader *subhdr = new FileHeader(FALSE);
+		for (int i = 0; i < round; i++) {
+			if (sectors != NULL)
+				sectors[count] = dataSectors[i];
+			count++;
+			subhdr->FetchFrom(dataSectors[i]);
+			count += subhdr->GetSectors(sectors == NULL ? NULL : sectors + count);
+		}
+		delete subhdr;
+		return count;
+	}
+	if (sectors != NULL)
+		for (int i = 0; i < numSectors; i++)
+			sectors[i] = dataSectors[i];
+	return numSectors;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Relocate
+// 	Move the file to "sectors", laid out as GetSectors lists them:
+//	write each sub-header, pointing at its new sectors, to its new
+//	place, and point this header at the new data sectors and
+//	sub-headers.  This header itself is only changed in memory; the
+//	caller writes it back, and that one write switches the file over
+//	from the old sectors to the new ones.  Return how many sectors
+//	were used.
+//
+//	The data must already have been copied to the new sectors, and
+//	nothing here touches the old ones.
+//----------------------------------------------------------------------
+
+int
+FileHeader::Relocate(int *sectors)
+{
+	int bound = EntryBytes();
+	cachedSector = -1;
+	if (bound > SectorSize) {
+		int round = divRoundUp(numBytes, bound);
+		int count = 0;
+		FileHeader *subhdr = new FileHeader(FALSE);
+		for (int i = 0; i < round; i++) {
+			subhdr->FetchFrom(dataSectors[i]);
+			dataSectors[i] = sectors[count++];
+			count += subhdr->Relocate(sectors + count);
+			subhdr->WriteBack(dataSectors[i]);
+		}
+		delete subhdr;
+		return count;
+	}
+	for (int i = 0; i < numSectors; i++)
+		dataSectors[i] = sectors[i];
+	return numSectors;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Print
 // 	Print the contents of the file header, and the contents of all
@@ -250,18 +619,17 @@ void
 FileHeader::Print()
 {
   printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
-	int round = 0;
-	OpenFile *openfile;
-	FileHeader *subheader;
-	if (numBytes > Level2)
+	int bound = EntryBytes();
+	if (bound > SectorSize)
 	{
-		round = numSectors / NumDirect;
+		int round = divRoundUp(numBytes, bound);
+		FileHeader *subheader = new FileHeader(FALSE);
 		for (int i = 0; i < round; i++)
 		{
-			openfile = new OpenFile(dataSectors[i]);
-			subheader = openfile->hdr;
+			subheader->FetchFrom(dataSectors[i]);
 			subheader->Print();
 		}
+		delete subheader;
 	}
 	else{
 		int i, j, k;
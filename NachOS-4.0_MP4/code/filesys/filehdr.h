@@ -17,46 +17,104 @@
 #include "disk.h"
 #include "pbitmap.h"
 
+class RefCountMap;
+
 #define NumDirect 	((SectorSize - 2 * sizeof(int)) / sizeof(int))
+#define MaxNumDirect 	((MaxSectorSize - 2 * sizeof(int)) / sizeof(int))
+					// NumDirect with the largest sectors
 #define MaxFileSize 	(NumDirect * SectorSize)
 
+// A file's own header is kept compactly, as an "inode" in a table of
+// them at the start of the disk: just the file's length and this many
+// pointers, to data sectors or to sub-headers.  The sub-headers below
+// it are whole sectors, with NumDirect pointers each.
+#define NumInodeDirect 	7
+#define InodeSize 	((int) ((NumInodeDirect + 1) * sizeof(int)))
+#define InodesPerSector (SectorSize / InodeSize)
+#define NumInodes 	4096	// files (and directories) on the disk
+#define InodeTableSectors (NumInodes / InodesPerSector)
+					// the inode table is in sectors 0
+					// to InodeTableSectors - 1
+#define CompressedFlag	(1 << 30)	// set in a compressed file's inode,
+					// in the word holding its length
+#define SharedFlag	(1 << 29)	// set in the inode of a file that
+					// has been cloned, or is a clone
+
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
 // The file header is organized as a simple table of pointers to
 // data blocks. 
 //
 // The file header data structure can be stored in memory or on disk.
-// When it is on disk, it is stored in a single sector -- this means
-// that we assume the size of this data structure to be the same
-// as one disk sector.  Without indirect addressing, this
-// limits the maximum file length to just under 4K bytes.
+// A file's own header is stored on disk as an inode, InodeSize bytes
+// in the inode table; it is known by its number in the table.  If the
+// file is bigger than NumInodeDirect sectors, the inode points at
+// sub-headers, each stored in a sector of its own, and those at
+// sub-headers or data sectors in turn.
 //
-// There is no constructor; rather the file header can be initialized
-// by allocating blocks for the file (if it is a new file), or by
-// reading it from disk.
+// The file header can be initialized by allocating blocks for the
+// file (if it is a new file), or by reading it from disk.
 
 class FileHeader {
   public:
 	// MP4 mod tag
-	FileHeader(); // dummy constructor to keep valgrind happy
+	FileHeader(bool isInode = TRUE); // a file's inode, or a sub-header
 	~FileHeader();
+
+    void *operator new(size_t size);	// File headers are kept in a
+    void operator delete(void *hdr);	//  slab cache (slab.h)
 	
     bool Allocate(PersistentBitmap *bitMap, int fileSize);// Initialize a file header, 
 						//  including allocating space 
 						//  on disk for the file data
-    void Deallocate(PersistentBitmap *bitMap);  // De-allocate this file's 
-						//  data blocks
+    void Deallocate(PersistentBitmap *bitMap, RefCountMap *refs = NULL);
+						// De-allocate this file's 
+						//  data blocks (those it
+						//  shares, if "refs" is
+						//  given, only once no one
+						//  else has them)
+    void Truncate(int length, PersistentBitmap *freeMap,
+		  RefCountMap *refs = NULL);
+					// Shrink the file to "length" bytes,
+					// freeing the sectors past the end
 
-    void FetchFrom(int sectorNumber); 	// Initialize file header from disk
-    void WriteBack(int sectorNumber); 	// Write modifications to file header
+    void Share(RefCountMap *refs);	// Count another pointer at each
+					// sector this header points at,
+					// for a clone of the file
+    int CopyOnWrite(int from, int to, RefCountMap *refs);
+					// Give the file sectors of its own
+					// for bytes "from" to "to" - 1; 2
+					// if this header changed, 1 if only
+					// ones below it did, 0 if nothing
+					// was copied, -1 if the disk is full
+
+    void FetchInode(int inode); 	// Initialize file header from disk
+    void WriteInode(int inode); 	// Write modifications to file header
 					//  back to disk
 
+    void FetchFrom(int sectorNumber); 	// The same, for a sub-header
+    void WriteBack(int sectorNumber);
+
     int ByteToSector(int offset);	// Convert a byte offset into the file
 					// to the disk sector containing
 					// the byte
 
     int FileLength();			// Return the length of the file 
-					// in bytes
+					// in bytes (for a compressed file,
+					// of what is stored: see compfile.h)
+
+    bool IsCompressed() { return compressed; }
+    void SetCompressed() { compressed = TRUE; }
+					// Is the file compressed? / Make it
+					// so (before WriteInode)
+    bool IsShared() { return shared; }
+    void SetShared() { shared = TRUE; }
+					// May the file share sectors with
+					// a clone? / Note that it may
+
+    int GetSectors(int *sectors);	// List the sectors the file's
+					// sub-headers and data are in
+    int Relocate(int *sectors);		// Move them to "sectors"
 
     void Print();			// Print the contents of the file.
 
@@ -71,16 +129,34 @@ class FileHeader {
 		In order to implement a data structure, you will need to add some "in-core" data
 		to maintain data structure.
 		
-		Disk Part - numBytes, numSectors, dataSectors occupy exactly 128 bytes and will be
-		written to a sector on disk.
-		In-core part - none
+		Disk Part - numBytes, numSectors, dataSectors occupy exactly one sector and will be
+		written to a sector on disk (for an inode, numBytes and the first
+		NumInodeDirect dataSectors go to its slot in the inode table).
+		In-core part - isInode, and the sub-header ByteToSector last read
 		
 	*/
 	
+    int EntryBytes();			// Bytes of the file each entry
+					// of dataSectors covers
+    void FreeEntries(int first, PersistentBitmap *freeMap,
+		     RefCountMap *refs);
+					// Free what the entries from
+					// "first" on point at
+
     int numBytes;			// Number of bytes in the file
     int numSectors;			// Number of data sectors in the file
-    int dataSectors[NumDirect];		// Disk sector numbers for each data 
-					// block in the file
+    int dataSectors[MaxNumDirect];	// Disk sector numbers for each data 
+					// block in the file (the first
+					// NumDirect of them, for this
+					// disk's sector size)
+
+    bool compressed;			// is the file compressed? (on disk,
+					//  CompressedFlag in numBytes)
+    bool shared;			// may it share sectors? (on disk,
+					//  SharedFlag in numBytes)
+    bool isInode;			// in-core: NumInodeDirect entries?
+    FileHeader *cached;			// in-core: the sub-header last used
+    int cachedSector;			//  by ByteToSector, and its sector
 };
 
 #endif // FILEHDR_H
@@ -3,20 +3,24 @@
 //	Implements routines to map from textual file names to files.
 //
 //	Each file in the file system has:
-//	   A file header, stored in a sector on disk
-//		(the size of the file header data structure is arranged
-//		to be precisely the size of 1 disk sector)
+//	   A file header, stored as an inode in the inode table, a
+//		preallocated run of sectors at the start of the disk
+//		holding InodesPerSector inodes each (cf. filehdr.h)
 //	   A number of data blocks
-//	   An entry in the file system directory
+//	   An entry in the file system directory, giving its inode number
 //
 // 	The file system consists of several data structures:
 //	   A bitmap of free disk sectors (cf. bitmap.h)
-//	   A directory of file names and file headers
+//	   A bitmap of free inodes
+//	   A directory of file names and inode numbers
+//	   A count, for each sector, of the files sharing it (cf. refmap.h)
 //
-//      Both the bitmap and the directory are represented as normal
-//	files.  Their file headers are located in specific sectors
-//	(sector 0 and sector 1), so that the file system can find them
-//	on bootup.
+//      The bitmaps, the directory and the counts are represented as normal
+//	files.  Their inodes are at specific places in the inode table
+//	(inodes 0 to 3), so that the file system can find them
+//	on bootup.  A new file's inode is the first free one after its
+//	directory's, so the inodes of a directory's files tend to share
+//	sectors, and a track, with each other and with the directory's.
 //
 //	The file system assumes that the bitmap and directory files are
 //	kept "open" continuously while Nachos is running.
@@ -30,11 +34,16 @@
 //
 // 	Our implementation at this point has the following restrictions:
 //
-//	   there is no synchronization for concurrent accesses
-//	   files have a fixed size, set when the file is created
-//	   files cannot be bigger than about 3KB in size
-//	   there is no hierarchical directory structure, and only a limited
-//	     number of files can be added to the system
+//	   concurrent accesses are only synchronized per file: there is
+//	     a reader/writer lock for each file or directory (by inode),
+//	     and one allocator lock for both bitmaps (see filesys.h)
+//	   files have a fixed size, set when the file is created (they
+//	     can only be shrunk, by Truncate)
+//	   there can be at most NumInodes files and directories in all,
+//	     and at most NumDirEntries of them in any one directory
+//	   a file's size is only bounded by the free space on the disk
+//	     (and by what an int holds): its header grows more levels of
+//	     sub-headers as needed (see FileHeader::EntryBytes)
 //	   there is no attempt to make the system robust to failures
 //	    (if Nachos exits in the middle of an operation that modifies
 //	    the file system, it may corrupt the disk)
@@ -51,29 +60,40 @@
 #include "directory.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "compfile.h"
+#include "refmap.h"
+#include "synchdisk.h"
+#include "main.h"
 
-// Sectors containing the file headers for the bitmap of free sectors,
-// and the directory of files.  These file headers are placed in well-known
-// sectors, so that they can be located on boot-up.
-#define FreeMapSector 		0
-#define DirectorySector 	1
+// Inodes of the file headers for the bitmap of free sectors, the
+// directory of files, and the bitmap of free inodes.  These file headers
+// are placed in well-known inodes, so that they can be located on boot-up.
+#define FreeMapInode 		0
+#define DirectoryInode 		1
+#define InodeMapInode 		2
+#define RefCountInode 		3
 
 // Initial file sizes for the bitmap and directory; until the file system
 // supports extensible files, the directory size sets the maximum number
 // of files that can be loaded onto the disk.
 #define FreeMapFileSize 	(NumSectors / BitsInByte)
+#define InodeMapFileSize 	(NumInodes / BitsInByte)
 #define NumDirEntries 		64
 #define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
 
+// Sectors moved per disk request by Defragment
+#define CopyBatch 		32
+
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
 // 	Initialize the file system.  If format = TRUE, the disk has
 //	nothing on it, and we need to initialize the disk to contain
-//	an empty directory, and a bitmap of free sectors (with almost but
-//	not all of the sectors marked as free).
+//	an empty directory, a bitmap of free sectors (with almost but
+//	not all of the sectors marked as free), and a bitmap of free
+//	inodes.
 //
 //	If format = FALSE, we just have to open the files
-//	representing the bitmap and the directory.
+//	representing the bitmaps and the directory.
 //
 //	"format" -- should we initialize the disk?
 //----------------------------------------------------------------------
@@ -83,22 +103,36 @@ FileSystem::FileSystem(bool format)
     DEBUG(dbgFile, "Initializing the file system.");
     if (format) {
         PersistentBitmap *freeMap = new PersistentBitmap(NumSectors);
+        PersistentBitmap *inodeMap = new PersistentBitmap(NumInodes);
         Directory *directory = new Directory(NumDirEntries);
 		FileHeader *mapHdr = new FileHeader;
 		FileHeader *dirHdr = new FileHeader;
+		FileHeader *inodeMapHdr = new FileHeader;
+		FileHeader *refCountHdr = new FileHeader;
 
         DEBUG(dbgFile, "Formatting the file system.");
 
-		// First, allocate space for FileHeaders for the directory and bitmap
-		// (make sure no one else grabs these!)
-		freeMap->Mark(FreeMapSector);
-		freeMap->Mark(DirectorySector);
+		// First, allocate space for the inode table, and the inodes
+		// for the directory and bitmaps (make sure no one else grabs these!)
+		for (int i = 0; i < InodeTableSectors; i++)
+			freeMap->Mark(i);
+		// and keep out of the sectors the disk can't hold (checksums
+		// take a sector of each track, and a log needs room to
+		// spare; see SynchDisk::Capacity, LogDisk::Capacity)
+		for (int i = kernel->synchDisk->Capacity(); i < NumSectors; i++)
+			freeMap->Mark(i);
+		inodeMap->Mark(FreeMapInode);
+		inodeMap->Mark(DirectoryInode);
+		inodeMap->Mark(InodeMapInode);
+		inodeMap->Mark(RefCountInode);
 
 		// Second, allocate space for the data blocks containing the contents
 		// of the directory and bitmap files.  There better be enough space!
 
 		ASSERT(mapHdr->Allocate(freeMap, FreeMapFileSize));
 		ASSERT(dirHdr->Allocate(freeMap, DirectoryFileSize));
+		ASSERT(inodeMapHdr->Allocate(freeMap, InodeMapFileSize));
+		ASSERT(refCountHdr->Allocate(freeMap, 0));	// see SetUpRefCounts
 
 		// Flush the bitmap and directory FileHeaders back to disk
 		// We need to do this before we can "Open" the file, since open
@@ -106,24 +140,29 @@ FileSystem::FileSystem(bool format)
 		// on it!).
 
         DEBUG(dbgFile, "Writing headers back to disk.");
-		mapHdr->WriteBack(FreeMapSector);
-		dirHdr->WriteBack(DirectorySector);
+		mapHdr->WriteInode(FreeMapInode);
+		dirHdr->WriteInode(DirectoryInode);
+		inodeMapHdr->WriteInode(InodeMapInode);
+		refCountHdr->WriteInode(RefCountInode);
 
 		// OK to open the bitmap and directory files now
-		// The file system operations assume these two files are left open
+		// The file system operations assume these files are left open
 		// while Nachos is running.
 
-        freeMapFile = new OpenFile(FreeMapSector);
-        directoryFile = new OpenFile(DirectorySector);
+        freeMapFile = new OpenFile(FreeMapInode);
+        directoryFile = new OpenFile(DirectoryInode);
+        inodeMapFile = new OpenFile(InodeMapInode);
+        refCountFile = new OpenFile(RefCountInode);
 
 		// Once we have the files "open", we can write the initial version
 		// of each file back to disk.  The directory at this point is completely
-		// empty; but the bitmap has been changed to reflect the fact that
-		// sectors on the disk have been allocated for the file headers and
-		// to hold the file data for the directory and bitmap.
+		// empty; but the bitmaps have been changed to reflect the fact that
+		// sectors on the disk have been allocated for the inode table and
+		// to hold the file data for the directory and bitmaps.
 
-        DEBUG(dbgFile, "Writing bitmap and directory back to disk.");
+        DEBUG(dbgFile, "Writing bitmaps and directory back to disk.");
 		freeMap->WriteBack(freeMapFile);	 // flush changes to disk
+		inodeMap->WriteBack(inodeMapFile);
 		directory->WriteBack(directoryFile);
 
 		if (debug->IsEnabled('f')) {
@@ -131,15 +170,26 @@ FileSystem::FileSystem(bool format)
 			directory->Print();
         }
         delete freeMap;
+        delete inodeMap;
 		delete directory;
 		delete mapHdr;
 		delete dirHdr;
+		delete inodeMapHdr;
+		delete refCountHdr;
     } else {
 		// if we are not formatting the disk, just open the files representing
-		// the bitmap and directory; these are left open while Nachos is running
-        freeMapFile = new OpenFile(FreeMapSector);
-        directoryFile = new OpenFile(DirectorySector);
+		// the bitmaps and directory; these are left open while Nachos is running
+        freeMapFile = new OpenFile(FreeMapInode);
+        directoryFile = new OpenFile(DirectoryInode);
+        inodeMapFile = new OpenFile(InodeMapInode);
+        refCountFile = new OpenFile(RefCountInode);
     }
+    for (int i = 0; i < MaxOpenFiles; i++)
+	fileDescriptorTable[i] = NULL;
+    inodeLocks = new RWLock *[NumInodes];
+    for (int i = 0; i < NumInodes; i++)
+	inodeLocks[i] = NULL;
+    allocLock = new Lock("allocator lock");
 }
 
 //----------------------------------------------------------------------
@@ -150,159 +200,325 @@ FileSystem::~FileSystem()
 {
 	delete freeMapFile;
 	delete directoryFile;
+	delete inodeMapFile;
+	delete refCountFile;
+	for (int i = 0; i < MaxOpenFiles; i++)
+		delete fileDescriptorTable[i];
+	for (int i = 0; i < NumInodes; i++)
+		delete inodeLocks[i];
+	delete [] inodeLocks;
+	delete allocLock;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::StartDirectory
+// 	Return the open directory that a relative name given with "dir"
+//	starts from: the current thread's working directory for
+//	CurrentDirectory, otherwise the directory open as "dir".  Return
+//	NULL if "dir" is neither.
+//----------------------------------------------------------------------
+
+OpenFile *
+FileSystem::StartDirectory(OpenFileId dir)
+{
+    if (dir == CurrentDirectory) {
+	OpenFile *cwd = kernel->currentThread->cwd;
+
+	return (cwd != NULL) ? cwd : directoryFile;
+    }
+    if (dir < FirstFileId || dir >= MaxOpenFiles
+	|| fileDescriptorTable[dir] == NULL || !isDirectoryTable[dir])
+	return NULL;
+    return fileDescriptorTable[dir];
+}
+
+//----------------------------------------------------------------------
+// FileSystem::LockInode
+// FileSystem::UnlockInode
+// 	Lock the file or directory whose header is in "inode", to read
+//	or to write, and unlock it again.  The lock is made the first
+//	time it is needed.
+//----------------------------------------------------------------------
+
+void
+FileSystem::LockInode(int inode, bool writing)
+{
+    if (inodeLocks[inode] == NULL)
+	inodeLocks[inode] = new RWLock("inode lock");
+    if (writing)
+	inodeLocks[inode]->AcquireWrite();
+    else
+	inodeLocks[inode]->AcquireRead();
+}
+
+void
+FileSystem::UnlockInode(int inode)
+{
+    inodeLocks[inode]->Release();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::WalkPath
+// 	Return the open directory that holds the last component of
+//	"path", locked to read or (if "writing") to write, and set
+//	"*leaf" to that component (NULL if "path" has none, as for "/").
+//	An absolute path is walked from the root directory and a
+//	relative one from "start", so a name relative to an open
+//	directory costs a lookup per component of the name, not per
+//	component of its full path.  Each directory on the way is locked
+//	to read until the next one is locked, so none of them can be
+//	removed from under the walk.
+//
+//	Return NULL if "start" is needed but NULL, or if a directory on
+//	the way is missing or is a file.  "path" is changed (by strtok_r:
+//	the walk waits for the disk between components, and another
+//	thread may walk a path of its own meanwhile).
+//	Give the result back with CloseWalk.
+//----------------------------------------------------------------------
+
+OpenFile *
+FileSystem::WalkPath(OpenFile *start, char *path, char **leaf, bool writing)
+{
+    OpenFile *dirFile = (path[0] == '/') ? directoryFile : start;
+    Directory *directory;
+    char *name, *next, *rest;
+    int inode;
+
+    if (dirFile == NULL)
+	return NULL;
+    name = strtok_r(path, "/", &rest);
+    next = (name != NULL) ? strtok_r(NULL, "/", &rest) : NULL;
+    LockInode(dirFile->Inode(), writing && next == NULL);
+    directory = new Directory(NumDirEntries);
+    while (next != NULL) {
+	directory->FetchFrom(dirFile);
+	inode = directory->Find(name);
+	if (inode == -1 || directory->isDirectory(name) != TRUE) {
+	    CloseWalk(dirFile, start);
+	    delete directory;
+	    return NULL;
+	}
+	name = next;
+	next = strtok_r(NULL, "/", &rest);
+	LockInode(inode, writing && next == NULL);
+	CloseWalk(dirFile, start);
+	dirFile = new OpenFile(inode);
+    }
+    delete directory;
+    *leaf = name;
+    return dirFile;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CloseWalk
+// 	Unlock "dirFile", a directory that WalkPath returned, and close
+//	it unless it is one that stays open anyway: "start", or the root
+//	directory.
+//----------------------------------------------------------------------
+
+void
+FileSystem::CloseWalk(OpenFile *dirFile, OpenFile *start)
+{
+    UnlockInode(dirFile->Inode());
+    if (dirFile != start && dirFile != directoryFile)
+	delete dirFile;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Lookup
+// 	Open the file or directory "name" (relative names start at
+//	"start"), or return NULL if there is none.  If "isDirectory" is
+//	not NULL, set it to whether "name" is a directory.  "name" is
+//	changed (by strtok_r, in WalkPath).
+//
+//	The file is opened while its directory is still locked, so it
+//	can't be removed in between.
+//----------------------------------------------------------------------
+
+OpenFile *
+FileSystem::Lookup(OpenFile *start, char *name, bool *isDirectory)
+{
+    OpenFile *dirFile = WalkPath(start, name, &name, FALSE);
+    OpenFile *openFile = NULL;
+    bool directoryFound = TRUE;
+
+    if (dirFile == NULL)
+	return NULL;
+    if (name == NULL)			// "name" is the directory itself
+	openFile = new OpenFile(dirFile->Inode());
+    else {
+	Directory *directory = new Directory(NumDirEntries);
+	int inode;
+
+	directory->FetchFrom(dirFile);
+	inode = directory->Find(name);
+	directoryFound = (directory->isDirectory(name) == TRUE);
+	if (inode != -1)
+	    openFile = new OpenFile(inode);
+	delete directory;
+    }
+    CloseWalk(dirFile, start);
+    if (isDirectory != NULL)
+	*isDirectory = directoryFound;
+    return openFile;
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Create
 // 	Create a file in the Nachos file system (similar to UNIX create).
 //	Since we can't increase the size of files dynamically, we have
-//	to give Create the initial size of the file.
+//	to give Create the initial size of the file.  A relative "name"
+//	is created in the current directory; see MakeEntry for the rest.
+//
+//	"name" -- name of file to be created
+//	"initialSize" -- size of file to be created
+//	"compressed" -- should its data be kept compressed?
+//----------------------------------------------------------------------
+
+int
+FileSystem::Create(char *name, int initialSize, bool compressed)
+{
+    return MakeEntry(CurrentDirectory, name, initialSize, FALSE, compressed);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CreateAdirectory
+// 	Create an empty directory "name" (similar to UNIX mkdir).
+//----------------------------------------------------------------------
+
+int
+FileSystem::CreateAdirectory(char *name)
+{
+    return MakeEntry(CurrentDirectory, name, DirectoryFileSize, TRUE, FALSE);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CreateAt
+// FileSystem::MkdirAt
+// 	Create and CreateAdirectory, with a relative "name" created
+//	under the directory open as "dir" (or the current directory, for
+//	CurrentDirectory).
+//----------------------------------------------------------------------
+
+int
+FileSystem::CreateAt(OpenFileId dir, char *name, int initialSize)
+{
+    return MakeEntry(dir, name, initialSize, FALSE, FALSE);
+}
+
+int
+FileSystem::MkdirAt(OpenFileId dir, char *name)
+{
+    return MakeEntry(dir, name, DirectoryFileSize, TRUE, FALSE);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::MakeEntry
+// 	Create a file, or an empty directory, of "initialSize" bytes.
+//	A compressed file is given room for its table as well, and the
+//	table is written with the header.
 //
 //	The steps to create a file are:
+//	  Find the directory to create it in
 //	  Make sure the file doesn't already exist
-//        Allocate a sector for the file header
+//        Allocate an inode for the file header, near its directory's
 // 	  Allocate space on disk for the data blocks for the file
 //	  Add the name to the directory
-//	  Store the new file header on disk
+//	  Store the new file header (and, for a directory, its empty
+//	  table of entries) on disk
 //	  Flush the changes to the bitmap and the directory back to disk
 //
 //	Return TRUE if everything goes ok, otherwise, return FALSE.
 //
-// 	Create fails if:
+// 	MakeEntry fails if:
+//		a directory on the way to the file doesn't exist
 //   		file is already in directory
-//	 	no free space for file header
+//	 	no free inode for file header
 //	 	no free entry for file in directory
 //	 	no free space for data blocks for the file
 //
-// 	Note that this implementation assumes there is no concurrent access
-//	to the file system!
-//
-//	"name" -- name of file to be created
-//	"initialSize" -- size of file to be created
+//	The directory stays locked to write (by WalkPath) until the entry
+//	is in it, so two threads can't both add "name"; the inode and the
+//	data sectors are taken from the bitmaps under the allocator lock.
 //----------------------------------------------------------------------
 
 int
-FileSystem::Create(char *name, int initialSize)
+FileSystem::MakeEntry(OpenFileId dir, char *name, int initialSize,
+		      bool isDirectory, bool compressed)
 {
-    Directory *directory = new Directory(NumDirEntries);
-    PersistentBitmap *freeMap;
+    OpenFile *start = StartDirectory(dir);
+    OpenFile *dirFile;
+    Directory *directory;
+    PersistentBitmap *freeMap, *inodeMap;
     FileHeader *hdr;
-    int sector;
+    char *leaf;
+    int inode, diskSize;
     bool success;
 
-    DEBUG(dbgFile, "Creating file " << name << " size " << initialSize);
-
-    directory->FetchFrom(directoryFile);
-
-    char *tmpName = strtok(name, "/");
-    OpenFile *directoryObj = directoryFile;
-    while(tmpName != NULL){
-        sector = directory->Find(tmpName);
-        // cout << "Find " << tmpName << sector << endl;
-        if(sector == -1)    break;
-        // cout << "create in " << tmpName << ' ' << sector << endl;
-        directoryObj = new OpenFile(sector);
-        directory->FetchFrom(directoryObj);
-        tmpName = strtok(NULL, "/");
-    }
-
-    // cout << "create file " << tmpName << endl;
-    if (directory->Find(tmpName) != -1) //returns -1 of it's not in the directory
-        success = FALSE;			// file is already in directory
-    else {
-        // cout << "sadjhlasd\n";
-        freeMap = new PersistentBitmap(freeMapFile, NumSectors);
-        // cout << "?????\n";
-        sector = freeMap->FindAndSet();	// find a sector to hold the file header
-        // cout << "!!!!!!!!!\n";
-    	// bool isAdd = directory->Add(tmpName, sector, FALSE);
-        if (sector == -1)
-            success = FALSE;		// no free block for file header
-        else if (!directory->Add(tmpName, sector, FALSE))
-            success = FALSE;	// no space in directory
-        else {
-            // cout << "else\n";
-            hdr = new FileHeader;
-            if (!hdr->Allocate(freeMap, initialSize))
-                success = FALSE;	// no space on disk for data
-            else {
-                success = TRUE;
-            // everthing worked, flush all changes back to disk
-                hdr->WriteBack(sector);
-                directory->WriteBack(directoryObj);
-                freeMap->WriteBack(freeMapFile);
-            }
-            delete hdr;
-        }
-        delete freeMap;
+    if (isDirectory) {
+	DEBUG(dbgFile, "Creating a directory " << name);
+    } else {
+	DEBUG(dbgFile, "Creating file " << name << " size " << initialSize);
     }
-    // cout << success << endl;
-    delete directory;
-    return success;
-}
-
-int
-FileSystem::CreateAdirectory(char *name)
-{
-    Directory *directory = new Directory(NumDirEntries);
-    Directory *subDirectory = new Directory(NumDirEntries);
-    OpenFile* subDirectoryFile;
-    PersistentBitmap *freeMap;
-    FileHeader *hdr;
-    int sector;
-    bool success;
-
-
-    DEBUG(dbgFile, "Creating a directory " << name);
+    if (compressed)
+	diskSize = CompressedFile::DiskBytes(initialSize);
+    else
+	diskSize = initialSize;
 
-    directory->FetchFrom(directoryFile);
+    dirFile = WalkPath(start, name, &leaf, TRUE);
+    if (dirFile == NULL)
+	return FALSE;			// no such directory
+    if (leaf == NULL) {
+	CloseWalk(dirFile, start);
+	return FALSE;			// no name to give the file
+    }
 
-    char *tmpName = strtok(name, "/");
-    char *lastName = tmpName;
-    OpenFile *directoryObj = directoryFile;
-    char *Name;
-    while(tmpName != NULL){
-        sector = directory->Find(tmpName);
-        if(sector == -1)    break;
-        directoryObj = new OpenFile(sector);
-        directory->FetchFrom(directoryObj);
-        lastName = tmpName;
-        tmpName = strtok(NULL, "/");
-    }
-
-    if(tmpName == NULL)
-        Name = lastName;
-    else Name = tmpName;
-    
-    if (directory->Find(Name) != -1)
-      success = FALSE;			// file is already in directory
+    directory = new Directory(NumDirEntries);
+    directory->FetchFrom(dirFile);
+    if (directory->Find(leaf) != -1)
+	success = FALSE;		// file is already in directory
     else {
-        freeMap = new PersistentBitmap(freeMapFile,NumSectors);
-        sector = freeMap->FindAndSet();	// find a sector to hold the file header
-    	// cout << ":" << NumSectors << endl;
-        bool isAdd = directory->Add(Name, sector, TRUE);
-        
-        if (sector == -1 || !isAdd) // not a directory
-            success = FALSE;
-        else {
-            hdr = new FileHeader;
-            if (!hdr->Allocate(freeMap, DirectoryFileSize))
-                success = FALSE;	// no space on disk for data
-            else {
-                success = TRUE;  // everthing worked, flush all changes back to disk
-                hdr->WriteBack(sector);
-                subDirectoryFile = new OpenFile(sector);
-				subDirectory->WriteBack(subDirectoryFile);
-                directory->WriteBack(directoryObj);
-                freeMap->WriteBack(freeMapFile);
-            }
-            delete hdr;
-        }
-        delete freeMap;
+	allocLock->Acquire();
+	freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+	inodeMap = new PersistentBitmap(inodeMapFile, NumInodes);
+	inode = inodeMap->FindAndSetNear(dirFile->Inode());
+					// find an inode to hold the file header
+	if (inode == -1)
+	    success = FALSE;		// no free inode for file header
+	else if (!directory->Add(leaf, inode, isDirectory))
+	    success = FALSE;		// no space in directory
+	else {
+	    hdr = new FileHeader;
+	    if (!hdr->Allocate(freeMap, diskSize))
+		success = FALSE;	// no space on disk for data
+	    else {
+		success = TRUE;
+		// everthing worked, flush all changes back to disk
+		if (compressed)
+		    hdr->SetCompressed();
+		hdr->WriteInode(inode);
+		if (compressed)
+		    CompressedFile::Format(hdr, initialSize);
+		if (isDirectory) {
+		    Directory *newDirectory = new Directory(NumDirEntries);
+		    OpenFile *newDirectoryFile = new OpenFile(inode);
+
+		    newDirectory->WriteBack(newDirectoryFile);
+		    delete newDirectoryFile;
+		    delete newDirectory;
+		}
+		directory->WriteBack(dirFile);
+		freeMap->WriteBack(freeMapFile);
+		inodeMap->WriteBack(inodeMapFile);
+	    }
+	    delete hdr;
+	}
+	allocLock->Release();
+	delete freeMap;
+	delete inodeMap;
     }
-    delete subDirectoryFile;
-	delete subDirectory;
     delete directory;
+    CloseWalk(dirFile, start);
     return success;
 }
 
@@ -313,273 +529,1039 @@ FileSystem::CreateAdirectory(char *name)
 //	  Find the location of the file's header, using the directory
 //	  Bring the header into memory
 //
-//	"name" -- the text name of the file to be opened
+//	Return NULL if there is no such file.  The caller deletes the
+//	result.
+//
+//	"name" -- the text name of the file to be opened (a relative
+//	name starts at the current directory)
 //----------------------------------------------------------------------
 
 OpenFile *
 FileSystem::Open(char *name)
 {
-    Directory *directory = new Directory(NumDirEntries);
-    OpenFile *openFile = NULL;
-    int sector;
-
-    char *tmpName = strtok(name,"/");
-    OpenFile *directoryObj = directoryFile;
     DEBUG(dbgFile, "Opening file" << name);
-
-    while(tmpName!=NULL){
-        directory->FetchFrom(directoryObj);
-        sector = directory->Find(tmpName);
-        if(sector == -1)
-            break;
-        directoryObj = new OpenFile(sector);
-        tmpName = strtok(NULL,"/");
-    }
-    
-    delete directory;
-    return directoryObj; // return NULL if not found
+    return Lookup(StartDirectory(CurrentDirectory), name, NULL);
 }
 
-//  The OpenAFile function is used for kernel open system call
-OpenFileId FileSystem::OpenAFile(char *name) {
-    Directory *directory = new Directory(NumDirEntries);
-    OpenFile *openFile = NULL;
-    int sector;
-
-    char *tmpName = strtok(name, "/");
-    char *lastName = tmpName;
-    OpenFile *directoryObj = directoryFile;
+//----------------------------------------------------------------------
+// FileSystem::OpenAt
+// 	Open the file or directory "name" for a user program, and return
+//	its OpenFileId, or -1 if there is no such file or the open file
+//	table is full.  A relative "name" starts at the directory open as
+//	"dir" (or the current directory, for CurrentDirectory).  An open
+//	directory can only be closed, or passed as the "dir" of the *At
+//	calls.
+//----------------------------------------------------------------------
 
-    while(tmpName != NULL){
-        sector = directory->Find(tmpName);
-        if(sector == -1) break;
-        directoryObj = new OpenFile(sector);
-        directory->FetchFrom(directoryObj);
-        lastName = tmpName;
-        tmpName = strtok(NULL, "/");
-    }
+OpenFileId
+FileSystem::OpenAt(OpenFileId dir, char *name)
+{
+    OpenFile *openFile;
+    OpenFileId id;
+    bool isDirectory;
 
     DEBUG(dbgFile, "Opening A file" << name);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(tmpName);
-    if(sector >= 0){
-        fileDescriptor = new OpenFile(sector);
-        delete directory;
-        return sector;
-    }
-    delete directory;
-    return -1;
+    openFile = Lookup(StartDirectory(dir), name, &isDirectory);
+    if (openFile == NULL)
+	return -1;
+    for (id = FirstFileId; id < MaxOpenFiles; id++)
+	if (fileDescriptorTable[id] == NULL) {
+	    fileDescriptorTable[id] = openFile;
+	    isDirectoryTable[id] = isDirectory;
+	    return id;
+	}
+    delete openFile;
+    return -1;				// too many open files
+}
+
+//  The OpenAFile function is used for kernel open system call
+OpenFileId FileSystem::OpenAFile(char *name) {
+    return OpenAt(CurrentDirectory, name);
 }
 
 int FileSystem::WriteFile(char *buffer, int size, OpenFileId id){
-    if (size >= 0 && fileDescriptor != NULL){
-        int num = fileDescriptor->Write(buffer, size);
+    if (size >= 0 && id >= FirstFileId && id < MaxOpenFiles
+        && fileDescriptorTable[id] != NULL && !isDirectoryTable[id]){
+        OpenFile *openFile = fileDescriptorTable[id];
+        LockInode(openFile->Inode(), TRUE);
+        int num = openFile->Write(buffer, size);
+        openFile->Flush();
+        UnlockInode(openFile->Inode());
         return num;
     } else return -1;
 }
 
 int FileSystem::ReadFile(char *buffer, int size, OpenFileId id){
-    if (size >= 0 && fileDescriptor != NULL){
-        int num = fileDescriptor->Read(buffer, size);
+    if (size >= 0 && id >= FirstFileId && id < MaxOpenFiles
+        && fileDescriptorTable[id] != NULL && !isDirectoryTable[id]){
+        OpenFile *openFile = fileDescriptorTable[id];
+        // locked to write: the open file may be shared, and reading
+        // moves its seek position (and its header's cached sub-header)
+        LockInode(openFile->Inode(), TRUE);
+        int num = openFile->Read(buffer, size);
+        UnlockInode(openFile->Inode());
         return num;
     } else return -1;
 }
 
+//----------------------------------------------------------------------
+// FileSystem::WriteFileV
+// FileSystem::ReadFileV
+// 	Write the bytes of "count" pieces, one after the other, to the
+//	file open as "id" (UNIX writev), or read from it into them, one
+//	piece after the other (UNIX readv).  Return how many bytes were
+//	written or read in all, or -1 if "id" is not an open file or the
+//	pieces are no good.
+//
+//	The pieces are gathered into one buffer first (or scattered from
+//	it after), so the file sees one write or read, as WriteFile or
+//	ReadFile would: a sector that holds the end of one piece and the
+//	start of the next is read and written once, not once per piece.
+//
+//	"pieces" -- where each piece is
+//	"sizes" -- how many bytes are in each
+//	"count" -- how many pieces (at most MaxIoPieces)
+//	"id" -- the open file
+//----------------------------------------------------------------------
+
+// Total bytes in the pieces, or -1 if there are too many, any has a
+// negative size, or together they are more than the disk holds (no
+// file can be that big, and the sum could overflow).
+
+static int
+PiecesSize(int *sizes, int count)
+{
+    int limit = NumSectors * SectorSize;
+    int total = 0;
+
+    if (count < 0 || count > MaxIoPieces)
+	return -1;
+    for (int i = 0; i < count; i++) {
+	if (sizes[i] < 0 || sizes[i] > limit - total)
+	    return -1;
+	total += sizes[i];
+    }
+    return total;
+}
+
+int
+FileSystem::WriteFileV(char **pieces, int *sizes, int count, OpenFileId id)
+{
+    int total = PiecesSize(sizes, count);
+    char *buffer;
+    int offset = 0, num;
+
+    if (total < 0)
+	return -1;
+    buffer = new char[total];
+    for (int i = 0; i < count; i++) {
+	memcpy(&buffer[offset], pieces[i], sizes[i]);
+	offset += sizes[i];
+    }
+    num = WriteFile(buffer, total, id);
+    delete [] buffer;
+    return num;
+}
+
+int
+FileSystem::ReadFileV(char **pieces, int *sizes, int count, OpenFileId id)
+{
+    int total = PiecesSize(sizes, count);
+    char *buffer;
+    int offset = 0, num;
+
+    if (total < 0)
+	return -1;
+    buffer = new char[total];
+    num = ReadFile(buffer, total, id);
+    for (int i = 0; i < count && offset < num; i++) {
+	memcpy(pieces[i], &buffer[offset], min(sizes[i], num - offset));
+	offset += sizes[i];
+    }
+    delete [] buffer;
+    return num;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::WriteFileAt
+// FileSystem::ReadFileAt
+// 	Write "size" bytes to the file open as "id", or read them from it,
+//	starting "position" bytes into the file, as WriteFile and ReadFile
+//	do at the file's seek position -- which is left where it was.
+//	Return how many bytes were written or read, or -1 if "id" is not
+//	an open file.  The asynchronous I/O worker (aio.h) uses these, so
+//	a request started doesn't depend on reads and writes done since.
+//----------------------------------------------------------------------
+
+int
+FileSystem::WriteFileAt(char *buffer, int size, int position, OpenFileId id)
+{
+    OpenFile *openFile;
+    int num;
+
+    if (size < 0 || position < 0 || id < FirstFileId || id >= MaxOpenFiles
+	|| fileDescriptorTable[id] == NULL || isDirectoryTable[id])
+	return -1;
+    openFile = fileDescriptorTable[id];
+    LockInode(openFile->Inode(), TRUE);
+    num = openFile->WriteAt(buffer, size, position);
+    openFile->Flush();
+    UnlockInode(openFile->Inode());
+    return num;
+}
+
+int
+FileSystem::ReadFileAt(char *buffer, int size, int position, OpenFileId id)
+{
+    OpenFile *openFile;
+    int num;
+
+    if (size < 0 || position < 0 || id < FirstFileId || id >= MaxOpenFiles
+	|| fileDescriptorTable[id] == NULL || isDirectoryTable[id])
+	return -1;
+    openFile = fileDescriptorTable[id];
+    LockInode(openFile->Inode(), TRUE);	// as ReadFile, for the header
+    num = openFile->ReadAt(buffer, size, position);
+    UnlockInode(openFile->Inode());
+    return num;
+}
+
 int FileSystem::CloseFile(OpenFileId id){
-    if (fileDescriptor != NULL){
-        delete fileDescriptor;
-        fileDescriptor = NULL;
+    if (id >= FirstFileId && id < MaxOpenFiles
+        && fileDescriptorTable[id] != NULL){
+        delete fileDescriptorTable[id];
+        fileDescriptorTable[id] = NULL;
         return 1;
     } else return -1;
 }
+
+//----------------------------------------------------------------------
+// FileSystem::Chdir
+// 	Make the directory "name" the current thread's working directory,
+//	the one its relative names start at.  The thread keeps it open,
+//	so later relative names don't walk down to it again.  Return
+//	FALSE if "name" is not a directory.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Chdir(char *name)
+{
+    Thread *thread = kernel->currentThread;
+    OpenFile *openFile;
+    bool isDirectory;
+
+    DEBUG(dbgFile, "Changing directory to " << name);
+    openFile = Lookup(StartDirectory(CurrentDirectory), name, &isDirectory);
+    if (openFile == NULL || !isDirectory) {
+	delete openFile;
+	return FALSE;
+    }
+    delete thread->cwd;
+    thread->cwd = openFile;
+    if (openFile->Inode() == DirectoryInode) {
+	thread->cwd = NULL;		// the root is always open
+	delete openFile;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ReadDir
+// 	Fill "entries" with up to "n" of the names in the directory open
+//	as "dir" (or the current directory, for CurrentDirectory): each
+//	one's name, whether it is a directory, and its length in bytes.
+//	"*cursor" is the directory slot to start at -- 0 the first time --
+//	and is moved past the names returned, so the next call carries on
+//	from there.  The directory is read once per call, however many
+//	names it returns; each name costs a read of its file header.
+//	Return how many entries were filled in (0 once there are no
+//	more), or -1 if "dir" is not a directory.
+//
+//	The directory is locked to read meanwhile, so none of the files
+//	in it can be removed while their headers are being read.
+//----------------------------------------------------------------------
+
+int
+FileSystem::ReadDir(OpenFileId dir, DirEntry *entries, int n, int *cursor)
+{
+    OpenFile *dirFile = StartDirectory(dir);
+    Directory *directory;
+    int count = 0;
+    int slot;
+
+    if (dirFile == NULL || n < 0 || *cursor < 0)
+	return -1;
+    LockInode(dirFile->Inode(), FALSE);
+    directory = new Directory(NumDirEntries);
+    directory->FetchFrom(dirFile);
+    for (slot = *cursor; slot < directory->tableSize && count < n; slot++) {
+	DirectoryEntry *entry = &directory->table[slot];
+	OpenFile *openFile;
+
+	if (!entry->inUse)
+	    continue;
+	strncpy(entries[count].name, entry->name, sizeof(entries[count].name));
+	entries[count].type = entry->isDirectory ? DirEntryDirectory
+						 : DirEntryFile;
+	openFile = new OpenFile(entry->inode);
+	entries[count].size = openFile->Length();
+	delete openFile;
+	count++;
+    }
+    *cursor = slot;
+    UnlockInode(dirFile->Inode());
+    delete directory;
+    return count;
+}
+
 //----------------------------------------------------------------------
 // FileSystem::Remove
-// 	Delete a file from the file system.  This requires:
+// 	Delete a file, or an empty directory, from the file system.  A
+//	relative "name" starts at the current directory.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Remove(char *name)
+{
+    return RemoveAt(CurrentDirectory, name);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::RemoveAt
+// 	Delete a file, or an empty directory, from the file system.
+//	This requires:
 //	    Remove it from the directory
-//	    Delete the space for its header
+//	    Free the inode holding its header
 //	    Delete the space for its data blocks
-//	    Write changes to directory, bitmap back to disk
+//	    Write changes to directory, bitmaps back to disk
 //
 //	Return TRUE if the file was deleted, FALSE if the file wasn't
-//	in the file system.
+//	in the file system (or is a directory that still has files).
 //
+//	"dir" -- where a relative "name" starts: an open directory, or
+//	CurrentDirectory
 //	"name" -- the text name of the file to be removed
 //----------------------------------------------------------------------
 
 bool
-FileSystem::Remove(char *name)
+FileSystem::RemoveAt(OpenFileId dir, char *name)
 {
-    Directory *directory = new Directory(NumDirEntries);
-    PersistentBitmap *freeMap;
+    OpenFile *start = StartDirectory(dir);
+    OpenFile *dirFile;
+    Directory *directory;
+    PersistentBitmap *freeMap, *inodeMap;
     FileHeader *fileHdr;
-    int sector;
-
-    directory->FetchFrom(directoryFile);
+    char *leaf;
+    int inode;
 
-    OpenFile *directoryObj = directoryFile;
-    OpenFile *prevdirectoryObj = directoryFile;
-    // cout << "ori name " << name << endl;
-    char *tmpName = strtok(name, "/");
-    char *lastName = tmpName;
-    bool isFile = FALSE;
-    
-    while(tmpName != NULL){
-        sector = directory->Find(tmpName);
-        if(sector == -1 || !directory->isDirectory(tmpName)){
-            isFile = TRUE;
-            break;
-        }
-        prevdirectoryObj = directoryObj;
-        directoryObj = new OpenFile(sector);
-        directory->FetchFrom(directoryObj);
-        lastName = tmpName;
-        tmpName = strtok(NULL, "/");
+    dirFile = WalkPath(start, name, &leaf, TRUE);
+    if (dirFile == NULL)
+	return FALSE;			// no such directory
+    directory = new Directory(NumDirEntries);
+    directory->FetchFrom(dirFile);
+    inode = (leaf == NULL) ? -1 : directory->Find(leaf);
+    if (inode == -1) {
+	delete directory;
+	CloseWalk(dirFile, start);
+	return FALSE;			// file not found
     }
 
-    if (tmpName == NULL){
-        tmpName = lastName;
-        // cout << "NULL?\n";
-    }
+    // wait for whoever is reading or writing the file to finish
+    LockInode(inode, TRUE);
+    if (directory->isDirectory(leaf) == TRUE) {
+	Directory *contents = new Directory(NumDirEntries);
+	OpenFile *contentsFile = new OpenFile(inode);
+	bool isEmpty;
 
-    // cout << "normal remove\n";
-    // cout << "tmp Name " << tmpName << endl;
-    // cout << "nname " << lastName << endl;
-    if (sector == -1) {
-       return FALSE;			 // file not found
+	contents->FetchFrom(contentsFile);
+	isEmpty = contents->IsEmpty();
+	delete contentsFile;
+	delete contents;
+	if (!isEmpty) {
+	    UnlockInode(inode);
+	    delete directory;
+	    CloseWalk(dirFile, start);
+	    return FALSE;		// remove its files first
+	}
     }
 
-    if (isFile) {
-        // cout << tmpName << " is a file\n";
-        directory->FetchFrom(directoryObj);
-    } else {
-        // cout << tmpName << " is a dir\n";
-        directory->FetchFrom(prevdirectoryObj);
-    }
-    sector = directory->Find(tmpName);
     fileHdr = new FileHeader;
-    fileHdr->FetchFrom(sector);
+    fileHdr->FetchInode(inode);
+    allocLock->Acquire();
     freeMap = new PersistentBitmap(freeMapFile,NumSectors);
-    fileHdr->Deallocate(freeMap);  		// remove data blocks
-    freeMap->Clear(sector);			// remove header block
-    directory->Remove(tmpName);
+    inodeMap = new PersistentBitmap(inodeMapFile, NumInodes);
+    if (fileHdr->IsShared()) {
+	// sectors a clone still has are left to it
+	RefCountMap *refs = new RefCountMap(refCountFile, freeMapFile);
+
+	fileHdr->Deallocate(freeMap, refs);
+	refs->WriteBack();
+	delete refs;
+    } else
+	fileHdr->Deallocate(freeMap);  		// remove data blocks
+    inodeMap->Clear(inode);			// remove header inode
+    directory->Remove(leaf);
     freeMap->WriteBack(freeMapFile);		// flush to disk
-    if(isFile)
-        directory->WriteBack(directoryObj);        // flush to disk
-    else
-        directory->WriteBack(prevdirectoryObj);
-    // cout << "normal remove success\n";
+    inodeMap->WriteBack(inodeMapFile);
+    allocLock->Release();
+    directory->WriteBack(dirFile);		// flush to disk
+    UnlockInode(inode);
     delete fileHdr;
     delete directory;
     delete freeMap;
-    // cout << "normal remove success1\n";
+    delete inodeMap;
+    CloseWalk(dirFile, start);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Clone
+// 	Make a new file "to" with the same contents as the file "from",
+//	without copying any data: the clone's header is a copy of the
+//	original's, and the sectors they both point at are counted once
+//	more (refmap.h).  Both files are marked as sharing sectors, so
+//	that whichever is written first gets copies of the sectors it
+//	writes (CopyOnWrite).  However big the file is, this writes just
+//	the two inodes, the few sectors of counts the original's inode
+//	points into, and the directory and inode map.  Relative names
+//	start at the current directory.
+//
+//	Return FALSE if "from" is not a file, or is compressed (its
+//	CompressedFile is shared by inode, and clones would not have the
+//	same one); if "to" already exists or its directory doesn't; or if
+//	there is no free inode or directory entry for it.  The first clone
+//	on a disk also makes the file of counts (SetUpRefCounts), and
+//	fails if there is no room for that.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Clone(char *from, char *to)
+{
+    OpenFile *start = StartDirectory(CurrentDirectory);
+    OpenFile *source, *dirFile;
+    Directory *directory;
+    PersistentBitmap *inodeMap;
+    RefCountMap *refs;
+    FileHeader *hdr;
+    char *leaf;
+    int src, inode;
+    bool isDirectory, success;
+
+    DEBUG(dbgFile, "Cloning " << from << " as " << to);
+    if (!SetUpRefCounts())
+	return FALSE;			// no room for the counts
+    source = Lookup(start, from, &isDirectory);
+    if (source == NULL)
+	return FALSE;			// no such file
+    src = source->Inode();
+    delete source;
+    if (isDirectory)
+	return FALSE;
+
+    dirFile = WalkPath(start, to, &leaf, TRUE);
+    if (dirFile == NULL)
+	return FALSE;			// no such directory
+    directory = new Directory(NumDirEntries);
+    directory->FetchFrom(dirFile);
+    if (leaf == NULL || directory->Find(leaf) != -1) {
+	delete directory;
+	CloseWalk(dirFile, start);
+	return FALSE;			// no name, or already in directory
+    }
+
+    // wait for whoever is writing the original to finish
+    LockInode(src, TRUE);
+    hdr = new FileHeader;
+    hdr->FetchInode(src);
+    allocLock->Acquire();
+    inodeMap = new PersistentBitmap(inodeMapFile, NumInodes);
+    if (!inodeMap->Test(src) || hdr->IsCompressed())
+	success = FALSE;		// removed meanwhile, or compressed
+    else if ((inode = inodeMap->FindAndSetNear(dirFile->Inode())) == -1)
+	success = FALSE;		// no free inode for file header
+    else if (!directory->Add(leaf, inode, FALSE))
+	success = FALSE;		// no space in directory
+    else {
+	success = TRUE;
+	refs = new RefCountMap(refCountFile, freeMapFile);
+	hdr->Share(refs);
+	hdr->SetShared();
+	hdr->WriteInode(src);
+	hdr->WriteInode(inode);
+	refs->WriteBack();
+	inodeMap->WriteBack(inodeMapFile);
+	delete refs;
+    }
+    allocLock->Release();
+    if (success) {
+	directory->WriteBack(dirFile);
+	OpenFile::HeaderChanged(src);	// open copies must see it shared
+    }
+    UnlockInode(src);
+    delete inodeMap;
+    delete hdr;
+    delete directory;
+    CloseWalk(dirFile, start);
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::SetUpRefCounts
+// 	Make the file of reference counts (refmap.h), the first time a
+//	file is cloned.  Until then, no sector is shared, and the file is
+//	empty; so a disk that has no clones on it does not have the
+//	counts' sectors in between its metadata and its files, and
+//	formatting it does not write them.  Every count starts out 0.
+//
+//	Return FALSE if there is no room on the disk for the counts.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::SetUpRefCounts()
+{
+    PersistentBitmap *freeMap;
+    FileHeader *hdr;
+    char *zeroes;
+    bool success = TRUE;
+
+    allocLock->Acquire();
+    if (refCountFile->Length() == 0) {
+	DEBUG(dbgFile, "Making the file of reference counts");
+	freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+	hdr = new FileHeader;
+	if (!hdr->Allocate(freeMap, RefCountFileSize))
+	    success = FALSE;
+	else {
+	    hdr->WriteInode(RefCountInode);
+	    OpenFile::HeaderChanged(RefCountInode);
+	    zeroes = new char[RefCountFileSize];
+	    memset(zeroes, 0, RefCountFileSize);
+	    refCountFile->WriteAt(zeroes, RefCountFileSize, 0);
+	    delete [] zeroes;
+	    freeMap->WriteBack(freeMapFile);
+	}
+	delete hdr;
+	delete freeMap;
+    }
+    allocLock->Release();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CopyOnWrite
+// 	Make sure that the file whose header is in "inode", which may
+//	share sectors with clones, has sectors of its own to write bytes
+//	"position" to "position" + "numBytes" - 1 to.  "hdr" is read in
+//	again, and left pointing at the sectors to write; the other files
+//	open on "inode" read the header again too, if it changed.  The
+//	caller is writing the file, so holds its lock, or is the kernel
+//	with nothing else running.
+//
+//	Return FALSE if the disk is too full for the copies.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::CopyOnWrite(int inode, FileHeader *hdr, int position,
+			int numBytes)
+{
+    RefCountMap *refs;
+    int result;
+
+    allocLock->Acquire();
+    refs = new RefCountMap(refCountFile, freeMapFile);
+    hdr->FetchInode(inode);
+    result = hdr->CopyOnWrite(position, position + numBytes, refs);
+    if (result == 2 || result == -1)
+	hdr->WriteInode(inode);		// the sectors copied before a
+					// full disk are kept, too
+    refs->WriteBack();
+    allocLock->Release();
+    delete refs;
+    if (result != 0)
+	OpenFile::HeaderChanged(inode);
+    return result != -1;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Truncate
+// FileSystem::FTruncate
+// 	Shrink a file to its first "length" bytes, freeing the sectors
+//	it no longer needs: the file named "name" (a relative name starts
+//	at the current directory), or the one open as "id".  Return FALSE
+//	if there is no such file, it is a directory or compressed, or it
+//	is shorter than "length" (files can't grow).
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Truncate(char *name, int length)
+{
+    OpenFile *openFile;
+    bool isDirectory;
+    int inode;
+
+    DEBUG(dbgFile, "Truncating " << name << " to " << length);
+    openFile = Lookup(StartDirectory(CurrentDirectory), name, &isDirectory);
+    if (openFile == NULL)
+	return FALSE;			// no such file
+    inode = openFile->Inode();
+    delete openFile;
+    if (isDirectory)
+	return FALSE;
+    return TruncateInode(inode, length);
+}
+
+bool
+FileSystem::FTruncate(OpenFileId id, int length)
+{
+    if (id < FirstFileId || id >= MaxOpenFiles
+	|| fileDescriptorTable[id] == NULL || isDirectoryTable[id])
+	return FALSE;
+    return TruncateInode(fileDescriptorTable[id]->Inode(), length);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::TruncateInode
+// 	Shrink the file whose header is in "inode" to "length" bytes
+//	(FileHeader::Truncate).  The sectors freed, however many, are
+//	cleared in the free map in memory and written back together,
+//	after the header, so shrinking a file of any size writes the
+//	header, the sub-header holding the new end, and the few sectors
+//	of the free map that changed.  Files open on "inode" read the
+//	header again before their next read or write.
+//
+//	A file that may share sectors with clones is first given sectors
+//	of its own on the way to its new end (CopyOnWrite), so that the
+//	sub-header shrunk there is its own; the sectors past the end that
+//	a clone still has are left to it.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::TruncateInode(int inode, int length)
+{
+    PersistentBitmap *freeMap;
+    RefCountMap *refs = NULL;
+    FileHeader *hdr;
+    bool success = TRUE;
+
+    // wait for whoever is reading or writing the file to finish
+    LockInode(inode, TRUE);
+    hdr = new FileHeader;
+    hdr->FetchInode(inode);
+    if (length < 0 || length > hdr->FileLength() || hdr->IsCompressed())
+	success = FALSE;
+    else if (hdr->IsShared() && length > 0
+	     && !CopyOnWrite(inode, hdr, length - 1, 1))
+	success = FALSE;		// no room for the copies
+    if (!success) {
+	UnlockInode(inode);
+	delete hdr;
+	return FALSE;
+    }
+
+    allocLock->Acquire();
+    freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+    if (hdr->IsShared())
+	refs = new RefCountMap(refCountFile, freeMapFile);
+    hdr->Truncate(length, freeMap, refs);
+    hdr->WriteInode(inode);
+    if (refs != NULL) {
+	refs->WriteBack();
+	delete refs;
+    }
+    freeMap->WriteBack(freeMapFile);
+    allocLock->Release();
+    OpenFile::HeaderChanged(inode);
+    UnlockInode(inode);
+    delete freeMap;
+    delete hdr;
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// FileSystem::RecursiveRemove
+// 	Delete a file, or a directory and everything under it, from the
+//	file system.  Each file is removed with Remove, so it takes the
+//	same locks; the directory is only locked to read while its names
+//	are fetched, as removing them locks it to write.
+//
+//	Return TRUE if everything was deleted, FALSE if "name" wasn't in
+//	the file system or something under it couldn't be removed (say,
+//	a file another thread added meanwhile).
+//
+//	"name" -- the text name of the file or directory to be removed
+//----------------------------------------------------------------------
+
 bool
 FileSystem::RecursiveRemove(char *name)
 {
-    Directory *directory = new Directory(NumDirEntries);
-	PersistentBitmap *freeMap;
-	FileHeader *fileHdr;
-    directory->FetchFrom(directoryFile);
-    int sector, currentSector;
-    OpenFile *directoryObj = directoryFile;
-    char current[255], buffer[255];
-    strcpy(current, name);
-    // cout << "ori name " << name << endl;
-    char *tmpName = strtok(name, "/");
-    char *lastName = tmpName;
-    while (tmpName!=NULL){
-        sector = directory->Find(tmpName);
-        if (sector == -1 || !directory->isDirectory(tmpName)){
-            break;
-        }
-        directoryObj = new OpenFile(sector);
-        directory->FetchFrom(directoryObj);
-        lastName = tmpName;
-        tmpName = strtok(NULL, "/");
-    }
-
-    currentSector = sector;
-    if(tmpName==NULL){
-        tmpName = lastName;
-        // cout << "rNULL?\n";
-    }
-
-    // cout << "rr now\n";
-    // cout << "tmpName is " << tmpName << endl;
-    // cout << "lastName is " << lastName << endl; 
-
-    DirectoryEntry *directoryTable = directory->table;
-    if(directory->isDirectory(tmpName)){
-        for(int i=0;i<directory->tableSize;i++){
-            if(directoryTable[i].inUse){
-                if(directoryTable[i].isDirectory){
-                    int x = sprintf(buffer,"%s/%s", current, directoryTable[i].name);
-                    RecursiveRemove(buffer);
-                }else{
-                    int x = sprintf(buffer,"%s/%s", current, directoryTable[i].name);
-                    Remove(buffer);
-                }
-            }
-        } 
-        Remove(current);
-    }else{
-        Remove(current);
+    char *path = new char[strlen(name) + 1];
+    OpenFile *openFile;
+    bool isDirectory, success = TRUE;
+
+    strcpy(path, name);			// Lookup takes the path apart
+    openFile = Lookup(StartDirectory(CurrentDirectory), path, &isDirectory);
+    delete [] path;
+    if (openFile == NULL)
+	return FALSE;			// no such file
+    if (isDirectory) {
+	Directory *directory = new Directory(NumDirEntries);
+
+	LockInode(openFile->Inode(), FALSE);
+	directory->FetchFrom(openFile);
+	UnlockInode(openFile->Inode());
+	for (int i = 0; i < directory->tableSize; i++) {
+	    DirectoryEntry *entry = &directory->table[i];
+	    char *child;
+
+	    if (!entry->inUse)
+		continue;
+	    child = new char[strlen(name) + FileNameMaxLen + 2];
+	    sprintf(child, "%s/%s", name, entry->name);
+	    if (!(entry->isDirectory ? RecursiveRemove(child) : Remove(child)))
+		success = FALSE;
+	    delete [] child;
+	}
+	delete directory;
     }
-    return TRUE;
+    delete openFile;
+    if (!Remove(name))
+	success = FALSE;
+    return success;
 }
 
 //----------------------------------------------------------------------
 // FileSystem::List
-// 	List all the files in the file system directory.
+// 	List all the files in the directory "name".  "name" is changed
+//	(by strtok_r, in WalkPath).
 //----------------------------------------------------------------------
 
 void
 FileSystem::List(char *name)
+{
+    OpenFile *dirFile;
+    bool isDirectory;
+
+    dirFile = Lookup(StartDirectory(CurrentDirectory), name, &isDirectory);
+    if (dirFile != NULL && isDirectory) {
+	Directory *directory = new Directory(NumDirEntries);
+
+	LockInode(dirFile->Inode(), FALSE);
+	directory->FetchFrom(dirFile);
+	UnlockInode(dirFile->Inode());
+	directory->List();
+	delete directory;
+    }
+    delete dirFile;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::RecursiveList
+// 	List all the files in the directory "name", and in everything
+//	under it.  "name" is changed (by strtok_r, in WalkPath).
+//----------------------------------------------------------------------
+
+void
+FileSystem::RecursiveList(char *name)
+{
+    OpenFile *dirFile;
+    bool isDirectory;
+
+    dirFile = Lookup(StartDirectory(CurrentDirectory), name, &isDirectory);
+    if (dirFile != NULL && isDirectory)
+	ListWalk(dirFile);
+    delete dirFile;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ListWalk
+// 	Print the names in the directory "dirFile", each subdirectory's
+//	followed by the names under it.  The directory stays locked to
+//	read while we are under it, so none of it can be removed, and
+//	locks are taken from the top down, as WalkPath takes them.
+//----------------------------------------------------------------------
+
+void
+FileSystem::ListWalk(OpenFile *dirFile)
 {
     Directory *directory = new Directory(NumDirEntries);
-    int sector;
-    directory->FetchFrom(directoryFile);
-    char *tmpName = strtok(name, "/");
-    OpenFile *directoryObj = directoryFile;
-    // cout << name << endl;
-    while(tmpName != NULL){
-        sector = directory->Find(tmpName);
-        // cout << sector << endl;
-        // cout << "name:" << tmpName << endl;
-        if(sector == -1)    break;
-        directoryObj = new OpenFile(sector);
-        directory->FetchFrom(directoryObj);
-        tmpName = strtok(NULL, "/");
-    }
-    directory->List();
+
+    LockInode(dirFile->Inode(), FALSE);
+    directory->FetchFrom(dirFile);
+    for (int i = 0; i < directory->tableSize; i++) {
+        DirectoryEntry *entry = &directory->table[i];
+        if (!entry->inUse)
+            continue;
+        if (entry->isDirectory) {
+            OpenFile *subDirectoryFile = new OpenFile(entry->inode);
+
+            printf("[D]%s\n", entry->name);
+            ListWalk(subDirectoryFile);
+            delete subDirectoryFile;
+        } else
+            printf("[F]%s\n", entry->name);
+    }
+    UnlockInode(dirFile->Inode());
     delete directory;
-    delete tmpName;
-    delete directoryObj;
 }
 
+//----------------------------------------------------------------------
+// CountFragments
+// 	Return the number of runs of consecutive sectors in "sectors",
+//	a file's sectors as FileHeader::GetSectors lists them (0 for an
+//	empty file).
+//----------------------------------------------------------------------
+
+static int
+CountFragments(int *sectors, int numSectors)
+{
+    int fragments = (numSectors > 0) ? 1 : 0;
+
+    for (int i = 1; i < numSectors; i++)
+        if (sectors[i] != sectors[i - 1] + 1)
+            fragments++;
+    return fragments;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FindHeader
+// 	Return the inode holding the header of the file or directory
+//	"name" ("/" is the root directory, and a relative name starts at
+//	the current directory), or -1 if there is no such file.  "name"
+//	is not changed.
+//----------------------------------------------------------------------
+
+int
+FileSystem::FindHeader(char *name)
+{
+    char path[256];
+
+    OpenFile *openFile;
+    int inode;
+
+    strncpy(path, name, sizeof(path) - 1);
+    path[sizeof(path) - 1] = '\0';
+    openFile = Lookup(StartDirectory(CurrentDirectory), path, NULL);
+    if (openFile == NULL)
+	return -1;
+    inode = openFile->Inode();
+    delete openFile;
+    return inode;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FragWalk
+// 	Print the fragmentation of each file in the directory "dirFile"
+//	(whose path is "path"), and of everything under its
+//	subdirectories, adding to "totals": the number of files, of
+//	sectors, and of fragments (runs of consecutive sectors).
+//----------------------------------------------------------------------
+
 void
-FileSystem::RecursiveList(char *name)
+FileSystem::FragWalk(OpenFile *dirFile, char *path, int *totals)
 {
     Directory *directory = new Directory(NumDirEntries);
-    int sector;
-    char *tmpName = strtok(name, "/");
-    OpenFile *directoryObj = directoryFile;
-    while(tmpName != NULL){
-        directory->FetchFrom(directoryObj);
-        sector = directory->Find(tmpName);
-        if(sector == -1)    break;
-        directoryObj = new OpenFile(sector);
-        tmpName = strtok(NULL, "/");
+    FileHeader *hdr = new FileHeader;
+    char name[256];
+
+    directory->FetchFrom(dirFile);
+    for (int i = 0; i < directory->tableSize; i++) {
+        DirectoryEntry *entry = &directory->table[i];
+        if (!entry->inUse)
+            continue;
+        snprintf(name, sizeof(name), "%s/%s", path, entry->name);
+        hdr->FetchInode(entry->inode);
+        int numSectors = hdr->GetSectors(NULL);
+        int *sectors = new int[numSectors + 1];
+        hdr->GetSectors(sectors);
+        int fragments = CountFragments(sectors, numSectors);
+        delete [] sectors;
+
+        printf("%s%s: %d sectors, %d fragments\n", name,
+               entry->isDirectory ? "/" : "", numSectors, fragments);
+        totals[0]++;
+        totals[1] += numSectors;
+        totals[2] += fragments;
+        if (entry->isDirectory) {
+            OpenFile *subDirectoryFile = new OpenFile(entry->inode);
+            FragWalk(subDirectoryFile, name, totals);
+            delete subDirectoryFile;
+        }
     }
-    directory->FetchFrom(directoryObj);
-    directory->RecursiveList();
-    if(tmpName != NULL){
-        delete directory;
-        delete tmpName;
-        delete directoryObj;
+    delete hdr;
+    delete directory;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FragReport
+// 	Print how fragmented the file system is: for every file and
+//	directory, how many runs of consecutive sectors ("fragments") its
+//	data and sub-headers are in; the average over all of them, and
+//	the average run length; and a histogram of the runs of free
+//	sectors, by size in powers of two, which says how big a file can
+//	still be placed contiguously.
+//----------------------------------------------------------------------
+
+void
+FileSystem::FragReport()
+{
+    PersistentBitmap *freeMap = new PersistentBitmap(freeMapFile,NumSectors);
+    const int NumBuckets = 31;		// 2^30 > NumSectors
+    int runs[NumBuckets], sectors[NumBuckets];
+    int totals[3] = { 0, 0, 0 };	// files, sectors, fragments
+
+    FragWalk(directoryFile, "", totals);
+    printf("%d files, %d sectors, %d fragments", totals[0], totals[1],
+           totals[2]);
+    if (totals[2] > 0)
+        printf(": %.2f fragments per file, %.1f sectors per run",
+               (double)totals[2] / totals[0], (double)totals[1] / totals[2]);
+    printf("\n");
+
+    for (int b = 0; b < NumBuckets; b++)
+        runs[b] = sectors[b] = 0;
+    for (int i = 0; i < NumSectors; ) {
+        int run = 0;
+        while (i < NumSectors && !freeMap->Test(i)) {
+            run++;
+            i++;
+        }
+        if (run == 0) {
+            i++;
+            continue;
+        }
+        int b = 0;
+        while ((2 << b) <= run)
+            b++;
+        runs[b]++;
+        sectors[b] += run;
+    }
+    printf("Free space: %d sectors\n", freeMap->NumClear());
+    for (int b = 0; b < NumBuckets; b++)
+        if (runs[b] > 0)
+            printf("  runs of %d-%d sectors: %d runs, %d sectors\n",
+                   1 << b, (2 << b) - 1, runs[b], sectors[b]);
+    delete freeMap;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Defragment
+// 	Move the data and sub-headers of the file "name" into as few runs
+//	of consecutive sectors as the free space allows -- one, if there
+//	is a free run big enough -- laid out as Allocate would lay out a
+//	new file, so that reading it through is one sequential sweep.
+//	The file's own header stays where it is.
+//
+//	The steps are ordered so that the file is never lost, whenever
+//	Nachos stops:
+//	  reserve the new sectors in the free map, and write the map
+//	  copy the data, and write new sub-headers, to the new sectors
+//	  write the header, pointing at the new sectors
+//	  free the old sectors, and write the map again
+//	Only the header write changes what the file is made of, and it
+//	is within a single sector.  A crash before it leaves the old file intact,
+//	and after it, the new one; at worst, the sectors of the copy no
+//	longer in use are leaked.
+//
+//	Return FALSE if there is no such file, or no placement with
+//	fewer fragments than it has now.  A file that may share sectors
+//	with a clone is not moved either, as the clone would have to
+//	move with it.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Defragment(char *name)
+{
+    FileHeader *hdr;
+    PersistentBitmap *freeMap;
+    int sector, numSectors, got, before, after;
+    int *oldSectors, *newSectors;
+    char *data;
+
+    if ((sector = FindHeader(name)) == -1) {
+        printf("Defragment: no such file %s\n", name);
+        return FALSE;
+    }
+    LockInode(sector, TRUE);
+    hdr = new FileHeader;
+    hdr->FetchInode(sector);
+    if (hdr->IsShared()) {
+        printf("Defragment: %s shares sectors with a clone\n", name);
+        UnlockInode(sector);
+        delete hdr;
+        return FALSE;
+    }
+    numSectors = hdr->GetSectors(NULL);
+    oldSectors = new int[numSectors + 1];
+    newSectors = new int[numSectors + 1];
+    hdr->GetSectors(oldSectors);
+    before = CountFragments(oldSectors, numSectors);
+
+    // take the first free run that holds the rest of the file, or
+    // failing that, the longest free run there is
+    allocLock->Acquire();
+    freeMap = new PersistentBitmap(freeMapFile,NumSectors);
+    for (got = 0; got < numSectors; ) {
+        int start, length = numSectors - got;
+        if ((start = freeMap->FindClearRun(length)) == -1 &&
+            (length = freeMap->LongestClearRun(&start)) == 0)
+            break;
+        for (int i = 0; i < length; i++) {
+            freeMap->Mark(start + i);
+            newSectors[got++] = start + i;
+        }
+    }
+    after = CountFragments(newSectors, got);
+
+    if (got < numSectors || after >= before) {
+        printf("Defragment: %s is in %d fragments, can't do better\n",
+               name, before);
+        allocLock->Release();
+        delete freeMap;		// not written back: nothing was reserved
+        UnlockInode(sector);
+        delete [] oldSectors;
+        delete [] newSectors;
+        delete hdr;
+        return FALSE;
+    }
+    DEBUG(dbgFile, "Defragmenting " << name << ": " << numSectors <<
+          " sectors, " << before << " -> " << after << " fragments");
+    freeMap->WriteBack(freeMapFile);
+    allocLock->Release();
+    delete freeMap;
+
+    // copy a batch of sectors at a time, so a queued or striped disk
+    // can work on several at once; the sub-headers are copied too,
+    // then rewritten by Relocate to point at the new sectors
+    data = new char[CopyBatch * SectorSize];
+    for (int i = 0; i < numSectors; i += CopyBatch) {
+        int count = min(CopyBatch, numSectors - i);
+        kernel->synchDisk->ReadSectors(count, oldSectors + i, data);
+        kernel->synchDisk->WriteSectors(count, newSectors + i, data);
+    }
+    delete [] data;
+
+    hdr->Relocate(newSectors);
+    hdr->WriteInode(sector);
+
+    // others may have changed the free map while we copied
+    allocLock->Acquire();
+    freeMap = new PersistentBitmap(freeMapFile,NumSectors);
+    for (int i = 0; i < numSectors; i++) {
+        ASSERT(freeMap->Test(oldSectors[i]));
+        freeMap->Clear(oldSectors[i]);
+        kernel->synchDisk->TrimSector(oldSectors[i]);
     }
+    freeMap->WriteBack(freeMapFile);
+    allocLock->Release();
+    UnlockInode(sector);
+
+    printf("Defragmented %s: %d sectors, %d -> %d fragments\n", name,
+           numSectors, before, after);
+    delete freeMap;
+    delete [] oldSectors;
+    delete [] newSectors;
+    delete hdr;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -601,11 +1583,11 @@ FileSystem::Print()
     Directory *directory = new Directory(NumDirEntries);
 
     printf("Bit map file header:\n");
-    bitHdr->FetchFrom(FreeMapSector);
+    bitHdr->FetchInode(FreeMapInode);
     bitHdr->Print();
 
     printf("Directory file header:\n");
-    dirHdr->FetchFrom(DirectorySector);
+    dirHdr->FetchInode(DirectoryInode);
     dirHdr->Print();
 
     freeMap->Print();
@@ -619,4 +1601,221 @@ FileSystem::Print()
     delete directory;
 }
 
+
+//----------------------------------------------------------------------
+// FileSystem::SelfTest, SelfTestWorker, SelfTestCheck
+// 	Stress the file system's locking, and measure how much work
+//	several threads get done at once, compared to one thread.
+//
+//	Each worker makes a directory of its own under TestDirectory, and
+//	through a handle on it creates TestFiles files; then, TestRounds
+//	times, writes each one through and reads each back and checks it;
+//	then removes every other one.  So the workers add to and remove
+//	from TestDirectory and the bitmaps at once, and read and write
+//	their own files at once.
+//
+//	The same work is done twice: by the main thread, one worker's
+//	share after another, and then by "numWorkers" threads at once.
+//	After each pass, every file left must still hold what was written
+//	to it, and once they are all removed, the free sector and free
+//	inode bitmaps must be just as they were before the pass.
+//----------------------------------------------------------------------
+
+static const int TestFiles = 8;
+static const int TestFileSize = 16384;
+static const int TestRounds = 4;
+static char TestDirectory[] = "/fstest";
+
+static FileSystem *testFileSystem;
+static Semaphore *testDone;
+static int testErrors;
+
+static char
+TestByte(int worker, int file, int offset)
+{
+    return (char) (worker * 31 + file * 7 + offset);
+}
+
+static void
+SelfTestFile(FileSystem *fs, OpenFileId dir, int which, int file,
+	     bool writing, char *buffer)
+{
+    char name[32];
+    OpenFileId id;
+
+    sprintf(name, "f%d", file);
+    if ((id = fs->OpenAt(dir, name)) == -1) {
+	testErrors++;
+	return;
+    }
+    if (writing) {
+	for (int j = 0; j < TestFileSize; j++)
+	    buffer[j] = TestByte(which, file, j);
+	if (fs->WriteFile(buffer, TestFileSize, id) != TestFileSize)
+	    testErrors++;
+    } else {
+	if (fs->ReadFile(buffer, TestFileSize, id) != TestFileSize)
+	    testErrors++;
+	for (int j = 0; j < TestFileSize; j++)
+	    if (buffer[j] != TestByte(which, file, j)) {
+		testErrors++;
+		break;
+	    }
+    }
+    fs->CloseFile(id);
+}
+
+static void
+SelfTestWorker(int which)
+{
+    FileSystem *fs = testFileSystem;
+    char name[32], *buffer = new char[TestFileSize];
+    OpenFileId dir;
+
+    sprintf(name, "%s/w%d", TestDirectory, which);
+    if (!fs->MkdirAt(CurrentDirectory, name))
+	testErrors++;
+    sprintf(name, "%s/w%d", TestDirectory, which);
+    if ((dir = fs->OpenAt(CurrentDirectory, name)) == -1) {
+	testErrors++;
+	delete [] buffer;
+	return;
+    }
+    for (int i = 0; i < TestFiles; i++) {
+	sprintf(name, "f%d", i);
+	if (!fs->CreateAt(dir, name, TestFileSize))
+	    testErrors++;
+    }
+    for (int r = 0; r < TestRounds; r++) {
+	for (int i = 0; i < TestFiles; i++)
+	    SelfTestFile(fs, dir, which, i, TRUE, buffer);
+	for (int i = 0; i < TestFiles; i++)
+	    SelfTestFile(fs, dir, which, i, FALSE, buffer);
+    }
+    for (int i = 1; i < TestFiles; i += 2) {
+	sprintf(name, "f%d", i);
+	if (!fs->RemoveAt(dir, name))
+	    testErrors++;
+    }
+    fs->CloseFile(dir);
+    delete [] buffer;
+}
+
+static void
+SelfTestThread(int which)
+{
+    SelfTestWorker(which);
+    testDone->V();
+}
+
+static void
+SelfTestCheck(FileSystem *fs, int numWorkers, Bitmap *freeMap,
+	      Bitmap *inodeMap, OpenFile *freeMapFile, OpenFile *inodeMapFile)
+{
+    char name[64], *buffer = new char[TestFileSize];
+    PersistentBitmap *map;
+    int changed;
+
+    for (int w = 0; w < numWorkers; w++) {
+	for (int i = 0; i < TestFiles; i += 2) {
+	    OpenFile *openFile;
+
+	    sprintf(name, "%s/w%d/f%d", TestDirectory, w, i);
+	    if ((openFile = fs->Open(name)) == NULL) {
+		testErrors++;
+		continue;
+	    }
+	    if (openFile->ReadAt(buffer, TestFileSize, 0) != TestFileSize)
+		testErrors++;
+	    for (int j = 0; j < TestFileSize; j++)
+		if (buffer[j] != TestByte(w, i, j)) {
+		    testErrors++;
+		    break;
+		}
+	    delete openFile;
+	    sprintf(name, "%s/w%d/f%d", TestDirectory, w, i);
+	    if (!fs->Remove(name))
+		testErrors++;
+	}
+	sprintf(name, "%s/w%d", TestDirectory, w);
+	if (!fs->Remove(name))
+	    testErrors++;		// not empty, or not there
+    }
+    delete [] buffer;
+
+    changed = 0;
+    map = new PersistentBitmap(freeMapFile, NumSectors);
+    for (int i = 0; i < NumSectors; i++)
+	if (map->Test(i) != freeMap->Test(i))
+	    changed++;
+    delete map;
+    map = new PersistentBitmap(inodeMapFile, NumInodes);
+    for (int i = 0; i < NumInodes; i++)
+	if (map->Test(i) != inodeMap->Test(i))
+	    changed++;
+    delete map;
+    if (changed > 0) {
+	cout << "  " << changed << " sectors and inodes leaked or lost\n";
+	testErrors += changed;
+    }
+}
+
+void
+FileSystem::SelfTest(int numWorkers)
+{
+    PersistentBitmap *freeMap, *inodeMap;
+    int start, elapsed;
+    double bytes;
+    char name[32];
+
+    // each worker holds a handle on its directory and on one file
+    numWorkers = min(numWorkers, (MaxOpenFiles - FirstFileId) / 2);
+    bytes = 2.0 * numWorkers * TestRounds * TestFiles * TestFileSize;
+    cout << "File system test: " << numWorkers << " workers x ";
+    cout << TestFiles << " files of " << TestFileSize << " bytes\n";
+
+    testFileSystem = this;
+    testErrors = 0;
+    strcpy(name, TestDirectory);
+    if (!CreateAdirectory(name)) {
+	cout << "  can't make " << TestDirectory << "\n";
+	return;
+    }
+    freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+    inodeMap = new PersistentBitmap(inodeMapFile, NumInodes);
+
+    start = kernel->stats->totalTicks;
+    for (int w = 0; w < numWorkers; w++)
+	SelfTestWorker(w);
+    elapsed = kernel->stats->totalTicks - start;
+    SelfTestCheck(this, numWorkers, freeMap, inodeMap, freeMapFile,
+		  inodeMapFile);
+    cout << "  one thread: " << elapsed << " ticks, ";
+    cout << bytes * 1000000.0 / elapsed << " bytes per million ticks\n";
+
+    start = kernel->stats->totalTicks;
+    testDone = new Semaphore("file system test done", 0);
+    for (int w = 0; w < numWorkers; w++) {
+	Thread *worker = new Thread("file system worker", w + 1);
+	worker->Fork((VoidFunctionPtr) SelfTestThread, (void *) w);
+    }
+    for (int w = 0; w < numWorkers; w++)
+	testDone->P();
+    delete testDone;
+    elapsed = kernel->stats->totalTicks - start;
+    SelfTestCheck(this, numWorkers, freeMap, inodeMap, freeMapFile,
+		  inodeMapFile);
+    cout << "  " << numWorkers << " threads: " << elapsed << " ticks, ";
+    cout << bytes * 1000000.0 / elapsed << " bytes per million ticks\n";
+
+    strcpy(name, TestDirectory);
+    Remove(name);
+    delete freeMap;
+    delete inodeMap;
+    if (testErrors == 0)
+	cout << "  consistent\n";
+    else
+	cout << "  " << testErrors << " errors\n";
+}
+
 #endif // FILESYS_STUB
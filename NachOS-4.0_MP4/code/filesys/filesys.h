@@ -26,6 +26,21 @@
 //	stored as files in the Nachos file system -- this causes an interesting
 //	bootstrap problem when the simulated disk is initialized. 
 //
+//	Several threads may use the file system at once.  Each file and
+//	directory has a reader/writer lock, found by its inode, and the
+//	two bitmaps (free sectors and free inodes) share one allocator
+//	lock.  Looking a name up, or listing a directory, holds locks to
+//	read; changing a directory, or reading, writing or moving a file,
+//	holds them to write (a read moves the seek position of an open file
+//	that may be shared).  To keep from deadlocking, locks are taken in
+//	this order:
+//	  directories, from the top of the path down (a path walk keeps
+//	    each directory locked until it has locked the next one);
+//	  the file or directory being opened, read, written, or removed;
+//	  the allocator lock.
+//	The open file table and the threads' current directories only
+//	change between disk waits, so they need no lock.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -36,6 +51,8 @@
 #include "copyright.h"
 #include "sysdep.h"
 #include "openfile.h"
+#include "dirlist.h"	// CurrentDirectory, and the DirEntry ReadDir
+			// fills in, as user programs see them
 
 typedef int OpenFileId;
 
@@ -68,6 +85,15 @@ class FileSystem {
 };
 
 #else // FILESYS
+#define MaxOpenFiles		16	// size of the open file table
+#define FirstFileId		2	// 0 and 1 are the console (syscall.h)
+#define MaxIoPieces		16	// most pieces in a WriteFileV or
+					// ReadFileV
+
+class Lock;
+class RWLock;
+class FileHeader;
+
 class FileSystem {
   public:
     FileSystem(bool format);		// Initialize the file system.
@@ -79,35 +105,126 @@ class FileSystem {
 	// MP4 mod tag
 	~FileSystem();
 
-    int Create(char *name, int initialSize);  	
-					// Create a file (UNIX creat)
+    int Create(char *name, int initialSize, bool compressed = FALSE);
+					// Create a file (UNIX creat),
+					// compressed if asked (compfile.h)
 
 	int CreateAdirectory(char *name);
 
     OpenFile* Open(char *name); 	// Open a file (UNIX open)
 
     bool Remove(char *name);  		// Delete a file (UNIX unlink)
+					// (a relative name in any of these
+					// starts at the current directory)
+
+    bool Chdir(char *name);		// Change the current thread's
+					// directory (UNIX chdir)
+
+    int CreateAt(OpenFileId dir, char *name, int initialSize);
+    OpenFileId OpenAt(OpenFileId dir, char *name);
+    bool RemoveAt(OpenFileId dir, char *name);
+    int MkdirAt(OpenFileId dir, char *name);
+					// As above, but a relative name
+					// starts at the directory open
+					// as "dir" (UNIX openat etc.)
+    int ReadDir(OpenFileId dir, DirEntry *entries, int n,
+		int *cursor);
+					// List up to "n" names in the
+					// directory open as "dir", from
+					// "*cursor" on (UNIX getdents)
+
+    bool Clone(char *from, char *to);	// Make "to" a copy of file "from",
+					// sharing its sectors until either
+					// one is written (refmap.h)
+    bool CopyOnWrite(int inode, FileHeader *hdr, int position,
+		     int numBytes);	// Give a file that may share sectors
+					// its own ones to write "numBytes"
+					// at "position" to
+    bool Truncate(char *name, int length);
+    bool FTruncate(OpenFileId id, int length);
+					// Shrink a file, by name or open,
+					// to "length" bytes (UNIX truncate,
+					// ftruncate)
+
+	bool RecursiveRemove(char *name);	// Delete a file, or a directory
+					// and everything under it
+
+    void List(char *name);			// List all the files in a directory
+
+	void RecursiveList(char *name);		// ... and under it
 
-	bool RecursiveRemove(char *name);
-
-    void List(char *name);			// List all the files in the file system
+    void Print();			// List all the files and their contents
 
-	void RecursiveList(char *name);
+    int FindHeader(char *name);		// Inode of the header of "name"
 
-    void Print();			// List all the files and their contents
+    void FragReport();			// Print how fragmented the files
+					// and the free space are
+    bool Defragment(char *name);	// Move a file's data into as few
+					// contiguous runs as will fit
 
 	OpenFileId OpenAFile(char *name);
     int WriteFile(char *buffer, int size, OpenFileId id);
     int ReadFile(char *buffer, int size, OpenFileId id);
+    int WriteFileV(char **pieces, int *sizes, int count, OpenFileId id);
+    int ReadFileV(char **pieces, int *sizes, int count, OpenFileId id);
+					// As WriteFile and ReadFile, but
+					// gathering the bytes from (or
+					// scattering them to) "count"
+					// pieces, in one file operation
+    int WriteFileAt(char *buffer, int size, int position, OpenFileId id);
+    int ReadFileAt(char *buffer, int size, int position, OpenFileId id);
+					// As WriteFile and ReadFile, but
+					// at "position", leaving the file's
+					// seek position alone (AsyncIO)
     int CloseFile(OpenFileId id);
 
-	OpenFile *fileDescriptor;
+    void SelfTest(int numWorkers);	// Stress test: several threads
+					// creating, writing, reading and
+					// removing files at once
 
   private:
+    void LockInode(int inode, bool writing);
+					// Lock a file or directory
+    void UnlockInode(int inode);	// Unlock it again
+
+    OpenFile *StartDirectory(OpenFileId dir);
+					// Where a relative name given
+					// with "dir" starts
+    OpenFile *WalkPath(OpenFile *start, char *path, char **leaf,
+		       bool writing);	// Directory holding the last
+					// component of "path", locked
+    void CloseWalk(OpenFile *dirFile, OpenFile *start);
+					// Unlock what WalkPath returned
+					// (and close it)
+    OpenFile *Lookup(OpenFile *start, char *name, bool *isDirectory);
+					// Open "name", or NULL
+    int MakeEntry(OpenFileId dir, char *name, int initialSize,
+		  bool isDirectory, bool compressed);
+					// Create, CreateAt and MkdirAt
+    bool TruncateInode(int inode, int length);
+					// Truncate and FTruncate
+    bool SetUpRefCounts();		// Make the file of reference counts,
+					// if no file has been cloned yet
+
+   void FragWalk(OpenFile *dirFile, char *path, int *totals);
+					// FragReport for one directory
+   void ListWalk(OpenFile *dirFile);	// RecursiveList for one directory
+
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
+   OpenFile* inodeMapFile;		// Bit map of free inodes,
+					// represented as a file
+   OpenFile* refCountFile;		// Count of pointers at each sector
+					// (refmap.h), represented as a file
+   OpenFile *fileDescriptorTable[MaxOpenFiles];
+					// Files open by user programs,
+					// indexed by OpenFileId
+   bool isDirectoryTable[MaxOpenFiles];	// Which of those are directories
+   RWLock **inodeLocks;			// Lock of each file and directory,
+					// by inode (NULL until first used)
+   Lock *allocLock;			// Held while changing the bitmaps
 };
 
 #endif // FILESYS
@@ -0,0 +1,771 @@
+// logdisk.cc
+//	Routines to keep the disk as a log: sectors written are appended
+//	to the segment being filled, and a map says where each one is.
+//	See logdisk.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "logdisk.h"
+#include "main.h"
+#include "slab.h"
+
+const int LogMagic = 0x4c4f4731;	// "LOG1", in the header sector
+
+//----------------------------------------------------------------------
+// SegmentStart, SegmentOf, SlotOf
+// 	Where segment "segment" starts on the disk; and which segment, and
+//	which slot of it, the disk sector "where" is in.
+//----------------------------------------------------------------------
+
+static int
+SegmentStart(int segment)
+{
+    return LogFirstSegment + segment * LogSegmentSectors;
+}
+
+static int
+SegmentOf(int where)
+{
+    return (where - LogFirstSegment) / LogSegmentSectors;
+}
+
+static int
+SlotOf(int where)
+{
+    return (where - LogFirstSegment) % LogSegmentSectors;
+}
+
+//----------------------------------------------------------------------
+// ComparePlaces
+// 	Order two sectors to be read by where they are on the disk, for
+//	qsort.
+//----------------------------------------------------------------------
+
+class LogPlace {
+  public:
+    int where;				// where on the disk the sector is
+    int index;				// which of the sectors asked for
+};
+
+static int
+ComparePlaces(const void *x, const void *y)
+{
+    return ((LogPlace *) x)->where - ((LogPlace *) y)->where;
+}
+
+//----------------------------------------------------------------------
+// LogDisk::LogDisk
+// 	Initialize the disks, as for SynchDisk, and then the log on them:
+//	an empty one if "format", otherwise the one the last checkpoint
+//	left.  The segments fill the disk, up to what checksums take.
+//----------------------------------------------------------------------
+
+LogDisk::LogDisk(char *fileName, int numDisks, int stripeUnit,
+		 int queueDepth, int flashBlocks, bool trim,
+		 char *overlayBase, bool checksums, bool format)
+    : SynchDisk(fileName, numDisks, stripeUnit, queueDepth, flashBlocks,
+		trim, overlayBase, checksums)
+{
+    numSegments = (SynchDisk::Capacity() - LogFirstSegment)
+	/ LogSegmentSectors;
+    mapChunk = LogMapChunk;
+    while (divRoundUp(LogMapSectors, mapChunk)
+	   > (SectorSize - 2 * (int) sizeof(int)) * BitsInByte)
+	mapChunk *= 2;			// a bit for each in the header
+    numChunks = divRoundUp(LogMapSectors, mapChunk);
+    lock = new Lock("log");
+    map = new int[LogMapSectors * LogMapEntries];
+    for (int i = 0; i < LogMapSectors * LogMapEntries; i++)
+	map[i] = -1;
+    chunkLoaded = new bool[numChunks];
+    mapChanged = new Bitmap(LogMapSectors);
+    usage = new SegmentUsage[LogUsageSectors * LogUsageEntries];
+    usageChanged = new Bitmap(LogUsageSectors);
+    freeSegments = new Bitmap(numSegments);
+    numFree = 0;
+    numLive = 0;
+    header = (LogHeader *) AllocBuffer(SectorSize);
+
+    current = -1;
+    segment = AllocBuffer(LogSegmentSectors * SectorSize);
+    summary = (int *) (segment + LogSlots * SectorSize);
+    filled = flushed = LogSlots;	// so the first write starts one
+    cache = AllocBuffer(LogCacheSectors * SectorSize);
+    for (int i = 0; i < LogCacheSectors; i++)
+	cacheSector[i] = -1;
+    cacheNext = 0;
+
+    changed = FALSE;
+    cleaning = FALSE;
+    syncing = FALSE;
+    if (format)
+	Format();
+    else
+	Mount();
+}
+
+//----------------------------------------------------------------------
+// LogDisk::~LogDisk
+// 	Free the log's tables.  Nachos is halting, so anything not yet
+//	written has been written by Kernel::StartSync.
+//----------------------------------------------------------------------
+
+LogDisk::~LogDisk()
+{
+    delete lock;
+    delete [] map;
+    delete [] chunkLoaded;
+    delete mapChanged;
+    delete [] usage;
+    delete usageChanged;
+    delete freeSegments;
+    FreeBuffer((char *) header, SectorSize);
+    FreeBuffer(segment, LogSegmentSectors * SectorSize);
+    FreeBuffer(cache, LogCacheSectors * SectorSize);
+}
+
+//----------------------------------------------------------------------
+// LogDisk::Format
+// 	Start an empty log: nothing is mapped, and every segment is free.
+//	The map has never been written, so none of it need be.
+//----------------------------------------------------------------------
+
+void
+LogDisk::Format()
+{
+    memset((char *) header, 0, SectorSize);
+    header->magic = LogMagic;
+    header->clock = 0;
+    for (int i = 0; i < numChunks; i++)
+	chunkLoaded[i] = TRUE;
+    memset((char *) usage, 0, LogUsageSectors * SectorSize);
+    for (int i = 0; i < LogUsageSectors; i++)
+	usageChanged->Mark(i);
+    for (int i = 0; i < numSegments; i++)
+	freeSegments->Mark(i);
+    numFree = numSegments;
+    Checkpoint();
+}
+
+//----------------------------------------------------------------------
+// LogDisk::Mount
+// 	Read the checkpoint: the header and the usage table.  The map is
+//	read as it is needed (Entry).  A segment is free if nothing the
+//	map points at is in it.
+//----------------------------------------------------------------------
+
+void
+LogDisk::Mount()
+{
+    int *sectors = new int[LogUsageSectors];
+
+    SynchDisk::ReadSector(0, (char *) header);
+    ASSERT(header->magic == LogMagic);	// formatted without -lfs?
+    for (int i = 0; i < LogUsageSectors; i++)
+	sectors[i] = LogFirstUsageSector + i;
+    SynchDisk::ReadSectors(LogUsageSectors, sectors, (char *) usage);
+    delete [] sectors;
+    for (int i = 0; i < numChunks; i++)
+	chunkLoaded[i] = FALSE;
+    for (int i = 0; i < numSegments; i++)
+	if (usage[i].live == 0) {
+	    freeSegments->Mark(i);
+	    numFree++;
+	} else
+	    numLive += usage[i].live;
+    lastCheckpoint = header->clock;
+}
+
+//----------------------------------------------------------------------
+// LogDisk::Capacity
+// 	Return how many sectors the file system may use: LogMaxUse percent
+//	of the slots in the log.  The file system marks the rest in use
+//	when it formats the disk, and never writes them.
+//----------------------------------------------------------------------
+
+int
+LogDisk::Capacity()
+{
+    return numSegments * LogSlots / 100 * LogMaxUse;
+}
+
+//----------------------------------------------------------------------
+// LogDisk::ReadSector, LogDisk::ReadSectors
+// 	Read sectors from wherever they were last written.  A sector read
+//	on its own is looked for in the cache first, and kept there; the
+//	cache is small, and a sector read from it is as likely to be read
+//	again as any, so the place used longest ago is reused.
+//----------------------------------------------------------------------
+
+void
+LogDisk::ReadSector(int sectorNumber, char* data)
+{
+    int place;
+
+    lock->Acquire();
+    if ((place = Cached(sectorNumber)) != -1)
+	memcpy(data, cache + place * SectorSize, SectorSize);
+    else {
+	Read(1, &sectorNumber, data);
+	place = cacheNext;
+	cacheNext = (cacheNext + 1) % LogCacheSectors;
+	cacheSector[place] = sectorNumber;
+	memcpy(cache + place * SectorSize, data, SectorSize);
+    }
+    lock->Release();
+}
+
+void
+LogDisk::ReadSectors(int numSectors, int *sectorNumbers, char* data)
+{
+    lock->Acquire();
+    Read(numSectors, sectorNumbers, data);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// LogDisk::Read
+// 	Read sectors for ReadSector(s).  A sector never written (or freed
+//	since) reads as zeroes, as on a new disk; one in the segment being
+//	filled is copied from memory.  The rest are read from the disk in
+//	one request, in the order they are on the disk: sectors written
+//	together in place (say, the free map) may have been written again
+//	one by one since, and be scattered over several segments, so
+//	reading them in the order asked for could seek back and forth
+//	between the segments for each sector.
+//----------------------------------------------------------------------
+
+void
+LogDisk::Read(int numSectors, int *sectorNumbers, char *data)
+{
+    LogPlace *places = new LogPlace[numSectors];
+    int numPlaces = 0;
+
+    for (int i = 0; i < numSectors; i++) {
+	int where = *Entry(sectorNumbers[i]);
+
+	if (where == -1)
+	    memset(data + i * SectorSize, 0, SectorSize);
+	else if (SegmentOf(where) == current)
+	    memcpy(data + i * SectorSize, segment + SlotOf(where) * SectorSize,
+		   SectorSize);
+	else {
+	    places[numPlaces].where = where;
+	    places[numPlaces].index = i;
+	    numPlaces++;
+	}
+    }
+    if (numPlaces > 0) {
+	int *sectors = new int[numPlaces];
+	char *buffer = AllocBuffer(numPlaces * SectorSize);
+
+	qsort(places, numPlaces, sizeof(LogPlace), ComparePlaces);
+	for (int i = 0; i < numPlaces; i++)
+	    sectors[i] = places[i].where;
+	SynchDisk::ReadSectors(numPlaces, sectors, buffer);
+	for (int i = 0; i < numPlaces; i++)
+	    memcpy(data + places[i].index * SectorSize,
+		   buffer + i * SectorSize, SectorSize);
+	FreeBuffer(buffer, numPlaces * SectorSize);
+	delete [] sectors;
+    }
+    delete [] places;
+}
+
+//----------------------------------------------------------------------
+// LogDisk::Cached
+// 	Return where in the cache "sector" is, or -1 if it isn't there.
+//----------------------------------------------------------------------
+
+int
+LogDisk::Cached(int sector)
+{
+    for (int i = 0; i < LogCacheSectors; i++)
+	if (cacheSector[i] == sector)
+	    return i;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// LogDisk::WriteSector, LogDisk::WriteSectors
+// 	Append sectors to the log.  They are only in memory until their
+//	segment fills up, or the next checkpoint.
+//----------------------------------------------------------------------
+
+void
+LogDisk::WriteSector(int sectorNumber, char* data)
+{
+    lock->Acquire();
+    Append(sectorNumber, data);
+    kernel->stats->numLogSectors++;
+    lock->Release();
+}
+
+void
+LogDisk::WriteSectors(int numSectors, int *sectorNumbers, char* data)
+{
+    lock->Acquire();
+    for (int i = 0; i < numSectors; i++)
+	Append(sectorNumbers[i], data + i * SectorSize);
+    kernel->stats->numLogSectors += numSectors;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// LogDisk::TrimSector
+// 	The file system has freed a sector: forget where it is, so that
+//	its slot is dead and the cleaner need not copy it, and drop it from
+//	the cache.  The log needs this whether or not the device is told
+//	about freed sectors, so -notrim does not turn it off.
+//----------------------------------------------------------------------
+
+void
+LogDisk::TrimSector(int sectorNumber)
+{
+    int *entry, place;
+
+    lock->Acquire();
+    if ((place = Cached(sectorNumber)) != -1)
+	cacheSector[place] = -1;
+    entry = Entry(sectorNumber);
+    if (*entry != -1) {
+	Kill(*entry);
+	*entry = -1;
+	MapChanged(sectorNumber);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// LogDisk::Entry
+// 	Return the map entry of "sector", reading in the chunk of the map
+//	it is in, if that hasn't been read yet.  A chunk that has never
+//	been written maps nothing.
+//----------------------------------------------------------------------
+
+int *
+LogDisk::Entry(int sector)
+{
+    int chunk = sector / (LogMapEntries * mapChunk);
+
+    ASSERT((sector >= 0) && (sector < NumSectors));
+    if (!chunkLoaded[chunk]) {
+	if (header->chunkWritten[chunk / BitsInWord]
+	    & (1 << (chunk % BitsInWord))) {
+	    int numSectors = ChunkSectors(chunk);
+	    int *sectors = new int[numSectors];
+
+	    for (int i = 0; i < numSectors; i++)
+		sectors[i] = LogFirstMapSector + chunk * mapChunk + i;
+	    SynchDisk::ReadSectors(numSectors, sectors,
+			(char *) &map[chunk * mapChunk * LogMapEntries]);
+	    delete [] sectors;
+	}
+	chunkLoaded[chunk] = TRUE;
+    }
+    return &map[sector];
+}
+
+//----------------------------------------------------------------------
+// LogDisk::ChunkSectors
+// 	Return how many sectors of the map are in "chunk": mapChunk, except
+//	perhaps in the last one.
+//----------------------------------------------------------------------
+
+int
+LogDisk::ChunkSectors(int chunk)
+{
+    return min(mapChunk, LogMapSectors - chunk * mapChunk);
+}
+
+//----------------------------------------------------------------------
+// LogDisk::MapChanged
+// 	Note that the map entry of "sector" has changed, so its sector of
+//	the map must be written at the next checkpoint.  The first time a
+//	chunk of the map changes, all of it is written, since what the
+//	disk holds there is garbage.
+//----------------------------------------------------------------------
+
+void
+LogDisk::MapChanged(int sector)
+{
+    int mapSector = sector / LogMapEntries;
+    int chunk = mapSector / mapChunk;
+    unsigned int bit = 1 << (chunk % BitsInWord);
+
+    if (!(header->chunkWritten[chunk / BitsInWord] & bit)) {
+	header->chunkWritten[chunk / BitsInWord] |= bit;
+	for (int i = 0; i < ChunkSectors(chunk); i++)
+	    mapChanged->Mark(chunk * mapChunk + i);
+    } else
+	mapChanged->Mark(mapSector);
+    changed = TRUE;
+}
+
+//----------------------------------------------------------------------
+// LogDisk::Kill
+// 	The map no longer points at the slot at disk sector "where": count
+//	one live slot fewer in its segment.
+//----------------------------------------------------------------------
+
+void
+LogDisk::Kill(int where)
+{
+    int seg = SegmentOf(where);
+
+    ASSERT(usage[seg].live > 0);
+    usage[seg].live--;
+    numLive--;
+    UsageChanged(seg);
+}
+
+//----------------------------------------------------------------------
+// LogDisk::UsageChanged
+// 	Note that the usage of "seg" has changed.
+//----------------------------------------------------------------------
+
+void
+LogDisk::UsageChanged(int seg)
+{
+    usageChanged->Mark(seg / LogUsageEntries);
+    changed = TRUE;
+}
+
+//----------------------------------------------------------------------
+// LogDisk::Append
+// 	Put the contents of "sector" at the head of the log, and point the
+//	map at them.  If the sector is already in the segment being filled,
+//	and that part of it hasn't been written yet, just change it there.
+//	If it is in the cache, change it there too.
+//----------------------------------------------------------------------
+
+void
+LogDisk::Append(int sector, char *data)
+{
+    int *entry = Entry(sector);
+    int slot, place;
+
+    if ((place = Cached(sector)) != -1)
+	memcpy(cache + place * SectorSize, data, SectorSize);
+
+    if (*entry != -1 && SegmentOf(*entry) == current
+	&& SlotOf(*entry) >= flushed) {
+	memcpy(segment + SlotOf(*entry) * SectorSize, data, SectorSize);
+	changed = TRUE;
+	return;
+    }
+
+    // NextSlot may clean, and move the sector, so look at the entry
+    // again afterwards
+    slot = NextSlot();
+    if (*entry != -1)
+	Kill(*entry);
+    memcpy(segment + slot * SectorSize, data, SectorSize);
+    summary[slot] = sector;
+    *entry = SegmentStart(current) + slot;
+    usage[current].live++;
+    numLive++;
+    UsageChanged(current);
+    MapChanged(sector);
+}
+
+//----------------------------------------------------------------------
+// LogDisk::NextSlot
+// 	Return the next free slot in the segment being filled.  If it is
+//	full, write it, and start another -- first checkpointing, if it is
+//	time, and cleaning, if few segments are free.
+//----------------------------------------------------------------------
+
+int
+LogDisk::NextSlot()
+{
+    if (filled == LogSlots) {
+	FlushSegment();
+	if (!cleaning) {
+	    if (header->clock - lastCheckpoint >= LogCheckpointInterval)
+		Checkpoint();
+	    if (numFree < LogCleanLow || Sparse(LogSparseUse))
+		Clean();
+	}
+	if (filled == LogSlots)		// (the cleaner may have started one)
+	    NewSegment();
+    }
+    return filled++;
+}
+
+//----------------------------------------------------------------------
+// LogDisk::FlushSegment
+// 	Write the slots of the segment being filled that aren't on the
+//	disk yet, in one sequential request, and then its summary.
+//----------------------------------------------------------------------
+
+void
+LogDisk::FlushSegment()
+{
+    int start;
+
+    if (current == -1 || flushed == filled)
+	return;
+    start = SegmentStart(current);
+    for (int i = flushed; i < filled; i++)
+	segmentSectors[i - flushed] = start + i;
+    SynchDisk::WriteSectors(filled - flushed, segmentSectors,
+			    segment + flushed * SectorSize);
+    for (int i = 0; i < LogSummarySectors; i++)
+	segmentSectors[i] = start + LogSlots + i;
+    SynchDisk::WriteSectors(LogSummarySectors, segmentSectors,
+			    (char *) summary);
+    flushed = filled;
+    kernel->stats->numLogSegments++;
+}
+
+//----------------------------------------------------------------------
+// LogDisk::NewSegment
+// 	Start filling the next free segment after the current one, so the
+//	log moves across the disk in one direction.  If none is free, a
+//	checkpoint may free some; Capacity keeps the file system from
+//	filling the log, so that the cleaner always has work it can do.
+//----------------------------------------------------------------------
+
+void
+LogDisk::NewSegment()
+{
+    int next = current;
+
+    if (numFree == 0)
+	Checkpoint();
+    ASSERT(numFree > 0);
+    do {
+	next = (next + 1) % numSegments;
+    } while (!freeSegments->Test(next));
+    freeSegments->Clear(next);
+    numFree--;
+
+    current = next;
+    filled = flushed = 0;
+    for (int i = 0; i < LogSummarySectors * LogMapEntries; i++)
+	summary[i] = -1;
+    ASSERT(usage[current].live == 0);
+    usage[current].stamp = header->clock++;
+    UsageChanged(current);
+}
+
+//----------------------------------------------------------------------
+// LogDisk::Clean
+// 	Clean segments until enough are free, or will be at the checkpoint
+//	that ends the cleaning, and the segments in use are full enough.
+//	Segments the file system emptied on its own are reclaimed without
+//	copying anything.
+//----------------------------------------------------------------------
+
+void
+LogDisk::Clean()
+{
+    int victim;
+
+    cleaning = TRUE;
+    while ((numFree + Reclaimable() < LogCleanHigh || Sparse(LogDenseUse))
+	   && (victim = PickVictim()) != -1)
+	CleanSegment(victim);
+    Checkpoint();
+    cleaning = FALSE;
+}
+
+//----------------------------------------------------------------------
+// LogDisk::Reclaimable
+// 	Return how many segments the next checkpoint will free: those with
+//	no live slots, that aren't free already.
+//----------------------------------------------------------------------
+
+int
+LogDisk::Reclaimable()
+{
+    int count = 0;
+
+    for (int i = 0; i < numSegments; i++)
+	if (!freeSegments->Test(i) && i != current && usage[i].live == 0)
+	    count++;
+    return count;
+}
+
+//----------------------------------------------------------------------
+// LogDisk::Sparse
+// 	Return TRUE if the segments in use, not counting those the next
+//	checkpoint frees, are on average less than "percent" full of live
+//	slots.  A log of only a few segments is never sparse.
+//----------------------------------------------------------------------
+
+bool
+LogDisk::Sparse(int percent)
+{
+    int inUse = numSegments - numFree - Reclaimable();
+
+    return inUse > LogCleanHigh && numLive * 100 < inUse * LogSlots * percent;
+}
+
+//----------------------------------------------------------------------
+// LogDisk::PickVictim
+// 	Return the segment best worth cleaning, or -1 if none is worth it.
+//	As in Sprite LFS, weigh the space cleaning it frees, 1 - u for a
+//	segment with a fraction u of its slots live, against the cost of
+//	reading it and writing out its live slots, 1 + u; and favour older
+//	segments, whose live data is less likely to die soon on its own.
+//----------------------------------------------------------------------
+
+int
+LogDisk::PickVictim()
+{
+    int best = -1;
+    double bestScore = 0;
+
+    for (int i = 0; i < numSegments; i++) {
+	double u, score;
+
+	if (freeSegments->Test(i) || i == current || usage[i].live == 0
+	    || usage[i].live == LogSlots)
+	    continue;
+	u = (double) usage[i].live / LogSlots;
+	score = (1 - u) * (header->clock - usage[i].stamp) / (1 + u);
+	if (best == -1 || score > bestScore) {
+	    best = i;
+	    bestScore = score;
+	}
+    }
+    return best;
+}
+
+//----------------------------------------------------------------------
+// LogDisk::CleanSegment
+// 	Read segment "seg", and append each slot of it that the map still
+//	points at to the head of the log.  The segment is left with no
+//	live slots, to be freed at the next checkpoint.
+//----------------------------------------------------------------------
+
+void
+LogDisk::CleanSegment(int seg)
+{
+    char *buffer = AllocBuffer(LogSegmentSectors * SectorSize);
+    int *slots = (int *) (buffer + LogSlots * SectorSize);
+    int start = SegmentStart(seg);
+
+    for (int i = 0; i < LogSegmentSectors; i++)
+	segmentSectors[i] = start + i;
+    SynchDisk::ReadSectors(LogSegmentSectors, segmentSectors, buffer);
+    for (int i = 0; i < LogSlots; i++)
+	if (slots[i] != -1 && *Entry(slots[i]) == start + i) {
+	    Append(slots[i], buffer + i * SectorSize);
+	    kernel->stats->numLogCopied++;
+	}
+    ASSERT(usage[seg].live == 0);
+    FreeBuffer(buffer, LogSegmentSectors * SectorSize);
+    kernel->stats->numLogCleaned++;
+}
+
+//----------------------------------------------------------------------
+// LogDisk::Checkpoint
+// 	Write out the segment so far, then the parts of the map and the
+//	usage table that have changed, and then the header.  Only now can
+//	the segments with no live slots be written over: until the header
+//	is written, the checkpoint on the disk is the last one, which may
+//	still point into them.
+//----------------------------------------------------------------------
+
+void
+LogDisk::Checkpoint()
+{
+    FlushSegment();
+    WriteChanged(mapChanged, LogMapSectors, LogFirstMapSector,
+		 (char *) map);
+    WriteChanged(usageChanged, LogUsageSectors, LogFirstUsageSector,
+		 (char *) usage);
+    SynchDisk::WriteSector(0, (char *) header);
+    for (int i = 0; i < numSegments; i++)
+	if (!freeSegments->Test(i) && i != current && usage[i].live == 0) {
+	    freeSegments->Mark(i);
+	    numFree++;
+	}
+    lastCheckpoint = header->clock;
+    changed = FALSE;
+    kernel->stats->numCheckpoints++;
+}
+
+//----------------------------------------------------------------------
+// LogDisk::WriteChanged
+// 	Write the sectors of a table in the checkpoint region that are
+//	marked in "changed", one request for each run of them, and clear
+//	the marks.
+//
+//	"changed" -- which sectors of the table have changed
+//	"numSectors" -- how many sectors the table has
+//	"firstSector" -- where on the disk it starts
+//	"from" -- the table in memory
+//----------------------------------------------------------------------
+
+void
+LogDisk::WriteChanged(Bitmap *changed, int numSectors, int firstSector,
+		      char *from)
+{
+    int *sectors = new int[numSectors];
+
+    for (int i = 0; i < numSectors; ) {
+	int run = 0;
+
+	while (i + run < numSectors && changed->Test(i + run)) {
+	    sectors[run] = firstSector + i + run;
+	    changed->Clear(i + run);
+	    run++;
+	}
+	if (run > 0)
+	    SynchDisk::WriteSectors(run, sectors, from + i * SectorSize);
+	i += max(run, 1);
+    }
+    delete [] sectors;
+}
+
+//----------------------------------------------------------------------
+// LogDisk::Sync
+// 	Make everything written so far safe on the disk: write the segment
+//	being filled, and checkpoint.
+//----------------------------------------------------------------------
+
+void
+LogDisk::Sync()
+{
+    lock->Acquire();
+    if (changed)
+	Checkpoint();
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// LogDisk::StartSync, LogDisk::SyncThread
+// 	Called with interrupts off, when Nachos is about to halt because
+//	no thread has anything left to do.  If anything has been written
+//	since the last checkpoint, fork a thread to Sync, and return TRUE:
+//	Nachos halts once that thread is done.
+//----------------------------------------------------------------------
+
+bool
+LogDisk::StartSync()
+{
+    Thread *thread;
+
+    if (!changed || syncing)
+	return FALSE;
+    syncing = TRUE;
+    thread = new Thread("log sync", 0);
+    thread->Fork((VoidFunctionPtr) LogDisk::SyncThread, (void *) this);
+    return TRUE;
+}
+
+void
+LogDisk::SyncThread(void *arg)
+{
+    LogDisk *log = (LogDisk *) arg;
+
+    log->Sync();
+    log->syncing = FALSE;
+}
@@ -0,0 +1,232 @@
+// logdisk.h
+//	Data structures for a log-structured disk: a synchronous disk that
+//	never writes a sector back where it was, but appends it to a log.
+//
+//	The file system keeps using sector numbers as before, but they
+//	are only names: a map says where on the disk each one was last
+//	written.  Sectors written are gathered in memory, LogSlots at a
+//	time, into a "segment", and a segment goes to the disk in one
+//	sequential write, however scattered the sectors in it are -- a
+//	file's data, its header in the inode table, the directory and the
+//	free map all go to the same place.  So the part of the map for the
+//	inode table is an inode map: it finds the file headers wherever
+//	they were last written.  A sector written again while its segment
+//	is still in memory is just changed there, so a bitmap or inode
+//	sector rewritten by every file created goes to the disk once.
+//
+//	Each segment ends with a summary: which sector each of its slots
+//	holds.  A slot is live as long as the map still points at it; a
+//	sector written again, or freed (TrimSector), leaves a dead slot
+//	behind.  When few free segments are left, the cleaner picks the
+//	segments most worth cleaning (fewest live slots, weighed by how
+//	long they have gone unchanged, as in Sprite LFS), copies their live
+//	sectors to the head of the log, and frees them.  It also cleans
+//	when the segments in use are mostly dead slots, even with plenty
+//	of segments free: the live sectors are then spread thinly over
+//	the whole disk, and reading them costs a long seek each.
+//
+//	The map, and a table of the live slots and age of each segment, are
+//	kept at the start of the disk, in the checkpoint region, and are
+//	only written there at a checkpoint: when Sync is called, every
+//	LogCheckpointInterval segments, after cleaning, and when Nachos
+//	halts (Kernel::StartSync).  A crash loses what was written since
+//	the last checkpoint, but leaves the file system as it was then; so
+//	a segment emptied since the last checkpoint is not written over
+//	until after the next one.  The map is read in LogMapChunk sectors
+//	at a time, as it is used; the checkpoint notes which chunks have
+//	ever been written, so formatting need not clear the map.
+//
+//	A sector read on its own (ReadSector) is kept in a small cache:
+//	those are file headers, and the headers of the maps and of the
+//	root directory are read for nearly every file created, but never
+//	written, so they stay where the log was when the disk was
+//	formatted.  Without the cache, each of them would cost a seek
+//	from the head of the log back to there, and further each time
+//	the log moves on.  (Sprite LFS relies on the file cache for this.)
+//
+//	The file system is kept from filling more than LogMaxUse percent
+//	of the log (see Capacity), so that the cleaner can always find
+//	segments with dead slots to clean.
+//
+//	One lock covers the log; a read or write holds it while it waits
+//	for the disk, so the cleaner never moves a sector while it is
+//	being read.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef LOGDISK_H
+#define LOGDISK_H
+
+#include "copyright.h"
+#include "synchdisk.h"
+#include "bitmap.h"
+
+// The layout of the log depends on the disk's geometry (disk.h), so
+// most of it is worked out from SectorSize and NumSectors as it is used.
+
+const int LogSegmentSectors = 256;	// sectors in a segment (8 tracks,
+					// by default)
+#define LogSummarySectors divRoundUp(LogSegmentSectors * (int) sizeof(int), \
+				     SectorSize)
+					// of them, the summary at the end
+#define LogSlots	(LogSegmentSectors - LogSummarySectors)
+					// slots for sectors in a segment
+#define LogMapEntries	((int) (SectorSize / sizeof(int)))
+					// map entries in a sector
+#define LogMapSectors	divRoundUp(NumSectors, LogMapEntries)
+const int LogMapChunk = 32;		// map sectors read in at once
+					// (more, if there are too many
+					// chunks to note in the header)
+#define LogMaxSegments	(NumSectors / LogSegmentSectors)
+
+// How full a segment is, and how old: the checkpoint region has a table
+// of these, one per segment.
+
+class SegmentUsage {
+  public:
+    int live;				// slots the map points at
+    int stamp;				// when the segment was last
+					// started (segments written
+					// before it)
+};
+
+#define LogUsageEntries	((int) (SectorSize / sizeof(SegmentUsage)))
+#define LogUsageSectors	divRoundUp(LogMaxSegments, LogUsageEntries)
+
+// The checkpoint region: a header sector, then the map, then the table
+// of segment usage; the segments follow, from LogFirstSegment on.
+
+const int LogFirstMapSector = 1;
+#define LogFirstUsageSector (LogFirstMapSector + LogMapSectors)
+#define LogFirstSegment	(divRoundUp(LogFirstUsageSector + LogUsageSectors, \
+				    LogSegmentSectors) * LogSegmentSectors)
+
+const int LogMaxUse = 80;		// most of the log the file system
+					// may fill, in percent
+const int LogCleanLow = 4;		// clean when fewer segments than
+					// this are free ...
+const int LogCleanHigh = 16;		// ... until this many are (or will
+					// be, at the checkpoint)
+const int LogSparseUse = 50;		// also clean when the segments in
+					// use are less full than this, in
+					// percent ...
+const int LogDenseUse = 60;		// ... until they are this full
+const int LogCheckpointInterval = 64;	// segments between checkpoints
+const int LogCacheSectors = 64;		// sectors read on their own
+					// kept in memory
+
+// The header sector of the checkpoint region.
+
+class LogHeader {
+  public:
+    int magic;				// LogMagic, if the disk has a log
+    int clock;				// segments started so far
+    unsigned int chunkWritten[(MaxSectorSize - 2 * sizeof(int))
+			      / sizeof(unsigned int)];
+					// bit per map chunk: ever written?
+					// (if not, it maps nothing); only
+					// what fits in a sector is used
+};
+
+class LogDisk : public SynchDisk {
+  public:
+    LogDisk(char *fileName, int numDisks, int stripeUnit, int queueDepth,
+	    int flashBlocks, bool trim, char *overlayBase, bool checksums,
+	    bool format);			// Initialize a log on the disk
+					// (as SynchDisk), making a new,
+					// empty one if "format"
+    ~LogDisk();				// Free the map and the segment
+					// (without writing anything)
+
+    void ReadSector(int sectorNumber, char* data);
+    void WriteSector(int sectorNumber, char* data);
+    void ReadSectors(int numSectors, int *sectorNumbers, char* data);
+    void WriteSectors(int numSectors, int *sectorNumbers, char* data);
+					// As for SynchDisk, but a write
+					// only waits if it fills a segment
+    void TrimSector(int sectorNumber);	// The sector's slot is dead
+
+    int Capacity();			// Sectors the file system may use
+    void Sync();			// Write the segment so far, and
+					// checkpoint
+    bool StartSync();			// Fork a thread to Sync, if anything
+					// has changed since the checkpoint
+
+  private:
+    void Format();			// Start an empty log
+    void Mount();			// Read the checkpoint
+    int *Entry(int sector);		// Where "sector" is mapped to,
+					// reading in the map chunk if need be
+    int ChunkSectors(int chunk);	// Map sectors in a chunk (the last
+					// may be short)
+    void MapChanged(int sector);	// Note that its entry changed
+    void Kill(int slotSector);		// A slot is dead
+    void UsageChanged(int segment);	// Note that its usage changed
+    void Read(int numSectors, int *sectorNumbers, char *data);
+					// Read sectors, from the segment
+					// in memory or the disk
+    int Cached(int sector);		// Where "sector" is in the cache
+					// (-1 if it isn't)
+    void Append(int sector, char *data);
+					// Put "sector" at the head of the log
+    int NextSlot();			// A slot in the segment, writing
+					// it and starting another if full
+    void FlushSegment();		// Write the segment's new slots,
+					// and its summary
+    void NewSegment();			// Start filling a free segment
+    void Clean();			// Free segments by copying out
+					// their live slots
+    int PickVictim();			// The segment best worth cleaning
+    void CleanSegment(int segment);	// Copy out its live slots
+    int Reclaimable();			// Segments with no live slots,
+					// free after the next checkpoint
+    bool Sparse(int percent);		// Are the segments in use less
+					// full than "percent", on average?
+    void Checkpoint();			// Write the segment, the map and
+					// the usage table
+    void WriteChanged(Bitmap *changed, int numSectors, int firstSector,
+		      char *from);	// Write the sectors of a table
+					// marked in "changed"
+    static void SyncThread(void *arg);	// Body of StartSync's thread
+
+    int numSegments;			// segments on the disk
+    int mapChunk;			// map sectors in a chunk
+    int numChunks;			// chunks in the map
+    Lock *lock;				// held while using the log
+    int *map;				// where each sector was last written
+					// (-1 if nowhere)
+    bool *chunkLoaded;			// which chunks of it are read in
+    Bitmap *mapChanged;			// map sectors changed since the
+					// checkpoint
+    SegmentUsage *usage;		// live slots and age of each segment
+    Bitmap *usageChanged;		// its sectors changed since then
+    Bitmap *freeSegments;		// segments that can be written
+    int numFree;			// how many
+    int numLive;			// live slots in all the segments
+    LogHeader *header;			// the checkpoint header, padded to
+					// a sector
+
+    int current;			// segment being filled (-1 if none)
+    char *segment;			// its slots, then its summary
+    int *summary;			// which sector each slot holds (-1
+					// if none), in "segment"
+    int filled;				// slots used
+    int flushed;			// of those, slots on the disk
+    int segmentSectors[LogSegmentSectors];
+					// sector numbers for a transfer
+
+    char *cache;			// sectors read on their own
+    int cacheSector[LogCacheSectors];	// which sector is in each place
+					// (-1 if none)
+    int cacheNext;			// place to be reused next
+
+    bool changed;			// anything written since the last
+					// checkpoint?
+    int lastCheckpoint;			// header->clock then
+    bool cleaning;			// is the cleaner running?
+    bool syncing;			// is StartSync's thread running?
+};
+
+#endif // LOGDISK_H
@@ -17,20 +17,32 @@
 #include "filehdr.h"
 #include "openfile.h"
 #include "synchdisk.h"
+#include "compfile.h"
+#include "slab.h"
+
+static ObjectCache *openFileCache = NULL;	// where OpenFiles come from
+static int headerVersions[NumInodes];	// times each header has changed
+					// under files open on it
 
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
 //	into memory while the file is open.
 //
-//	"sector" -- the location on disk of the file header for this file
+//	"inode" -- the inode holding the file header for this file
 //----------------------------------------------------------------------
 
-OpenFile::OpenFile(int sector)
+OpenFile::OpenFile(int inode)
 { 
     hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    hdr->FetchInode(inode);
+    this->inode = inode;
+    hdrVersion = headerVersions[inode];
     seekPosition = 0;
+    if (hdr->IsCompressed())
+	compressed = CompressedFile::Open(inode);
+    else
+	compressed = NULL;
 }
 
 //----------------------------------------------------------------------
@@ -40,9 +52,61 @@ OpenFile::OpenFile(int sector)
 
 OpenFile::~OpenFile()
 {
+    if (compressed != NULL)
+	compressed->Close();
     delete hdr;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::operator new, OpenFile::operator delete
+//	Every name looked up opens the directories on its path, so open
+//	files come from a cache of their own instead of from the heap.
+//----------------------------------------------------------------------
+
+void *
+OpenFile::operator new(size_t size)
+{
+    ASSERT(size == sizeof(OpenFile));
+    if (openFileCache == NULL)
+	openFileCache = new ObjectCache("OpenFile", sizeof(OpenFile));
+    return openFileCache->Alloc();
+}
+
+void
+OpenFile::operator delete(void *file)
+{
+    if (file != NULL)
+	openFileCache->Free(file);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::HeaderChanged
+// 	Note that the header in "inode" has been written since the files
+//	open on it read it in: the file has been cloned, or given sectors
+//	of its own by a write through another OpenFile.  Each of them
+//	reads the header again before its next read or write.
+//----------------------------------------------------------------------
+
+void
+OpenFile::HeaderChanged(int inode)
+{
+    headerVersions[inode]++;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Refresh
+// 	Read the file's header in again, if it has changed since it was.
+//----------------------------------------------------------------------
+
+void
+OpenFile::Refresh()
+{
+    if (hdrVersion != headerVersions[inode]) {
+	hdr->FetchInode(inode);
+	hdrVersion = headerVersions[inode];
+    }
+}
+
 //----------------------------------------------------------------------
 // OpenFile::Seek
 // 	Change the current location within the open file -- the point at
@@ -110,15 +174,27 @@ OpenFile::Write(char *into, int numBytes)
 //	"numBytes" -- the number of bytes to transfer
 //	"position" -- the offset within the file of the first byte to be
 //			read/written
+//
+//	The data of a compressed file is not in its sectors as it is, so
+//	reads and writes of one are left to its CompressedFile.  A file
+//	that may share sectors with a clone is first given sectors of its
+//	own for the bytes it writes (FileSystem::CopyOnWrite); if the
+//	disk is too full for that, nothing is written.
 //----------------------------------------------------------------------
 
 int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
-    int fileLength = hdr->FileLength();
+    int fileLength;
     int i, firstSector, lastSector, numSectors;
+    int *sectors;
     char *buf;
 
+    if (compressed != NULL)
+	return compressed->ReadAt(into, numBytes, position);
+    Refresh();
+    fileLength = hdr->FileLength();
+
     if ((numBytes <= 0) || (position >= fileLength))
     	return 0; 				// check request
     if ((position + numBytes) > fileLength)		
@@ -129,37 +205,51 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
     numSectors = 1 + lastSector - firstSector;
 
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
+    // read in all the full and partial sectors that we need, 
+    // all at once, so that sectors on different disks are read in parallel
+    // (into buffers from the pool, as there is a pair for every read)
+    buf = AllocBuffer(numSectors * SectorSize);
+    sectors = (int *) AllocBuffer(numSectors * sizeof(int));
     for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
+        sectors[i - firstSector] = hdr->ByteToSector(i * SectorSize);
+    kernel->synchDisk->ReadSectors(numSectors, sectors, buf);
+    FreeBuffer((char *) sectors, numSectors * sizeof(int));
 
     // copy the part we want
     bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete [] buf;
+    FreeBuffer(buf, numSectors * SectorSize);
     return numBytes;
 }
 
 int
 OpenFile::WriteAt(char *from, int numBytes, int position)
 {
-    int fileLength = hdr->FileLength();
+    int fileLength;
     int i, firstSector, lastSector, numSectors;
+    int *sectors;
     bool firstAligned, lastAligned;
     char *buf;
 
+    if (compressed != NULL)
+	return compressed->WriteAt(from, numBytes, position);
+    Refresh();
+    fileLength = hdr->FileLength();
     if ((numBytes <= 0) || (position >= fileLength))
 	return 0;				// check request
     if ((position + numBytes) > fileLength)
 	numBytes = fileLength - position;
+    if (hdr->IsShared()) {
+	if (!kernel->fileSystem->CopyOnWrite(inode, hdr, position, numBytes))
+	    return 0;				// disk full
+	hdrVersion = headerVersions[inode];
+    }
     DEBUG(dbgFile, "Writing " << numBytes << " bytes at " << position << " from file of length " << fileLength);
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
     numSectors = 1 + lastSector - firstSector;
 
-    buf = new char[numSectors * SectorSize];
+    buf = AllocBuffer(numSectors * SectorSize);
 	
 	// Mp4 mod tag
 	memset(buf, 0, sizeof(char) * numSectors * SectorSize); // dummy operation to keep valgrind happy
@@ -178,13 +268,29 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
     bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
 
 // write modified sectors back
+    sectors = (int *) AllocBuffer(numSectors * sizeof(int));
     for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-    delete [] buf;
+        sectors[i - firstSector] = hdr->ByteToSector(i * SectorSize);
+    kernel->synchDisk->WriteSectors(numSectors, sectors, buf);
+    FreeBuffer((char *) sectors, numSectors * sizeof(int));
+    FreeBuffer(buf, numSectors * SectorSize);
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::Flush
+// 	Make sure what has been written to the file is on disk.  Only a
+//	compressed file holds on to anything; the rest of the writes to
+//	a file go straight to the disk.
+//----------------------------------------------------------------------
+
+void
+OpenFile::Flush()
+{
+    if (compressed != NULL)
+	compressed->Flush();
+}
+
 //----------------------------------------------------------------------
 // OpenFile::Length
 // 	Return the number of bytes in the file.
@@ -193,6 +299,8 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
 int
 OpenFile::Length() 
 { 
+    if (compressed != NULL)
+	return compressed->Length();
     return hdr->FileLength(); 
 }
 
@@ -61,13 +61,17 @@ class OpenFile {
 
 #else // FILESYS
 class FileHeader;
+class CompressedFile;
 
 class OpenFile {
   public:
-    OpenFile(int sector);		// Open a file whose header is located
-					// at "sector" on the disk
+    OpenFile(int inode);		// Open a file whose header is in
+					// inode "inode" of the inode table
     ~OpenFile();			// Close the file
 
+    void *operator new(size_t size);	// Open files are kept in a
+    void operator delete(void *file);	//  slab cache (slab.h)
+
     void Seek(int position); 		// Set the position from which to 
 					// start reading/writing -- UNIX lseek
 
@@ -82,6 +86,16 @@ class OpenFile {
 					// bypassing the implicit position.
     int WriteAt(char *from, int numBytes, int position);
 
+    void Flush();			// Write back anything a compressed
+					// file is holding on to
+
+    static void HeaderChanged(int inode);
+					// Note that the header in "inode"
+					// has been changed on disk, so every
+					// open copy of it must be read again
+
+    int Inode() { return inode; }	// The inode holding this file's header
+
     int Length(); 			// Return the number of bytes in the
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
@@ -90,7 +104,13 @@ class OpenFile {
 	FileHeader *hdr;			// Header for this file 
     
   private:
+    int inode;				// Where the header is on disk
     int seekPosition;			// Current position within the file
+    CompressedFile *compressed;		// The file's chunks, if it is
+					// compressed (compfile.h), else NULL
+    int hdrVersion;			// Changes to the header seen so far
+    void Refresh();			// Read the header again if it has
+					// changed since
 };
 
 #endif // FILESYS
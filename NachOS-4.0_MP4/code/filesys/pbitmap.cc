@@ -7,7 +7,12 @@
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
+#include "debug.h"
 #include "pbitmap.h"
+#include "disk.h"
+#include "slab.h"
+
+static ObjectCache *bitmapCache = NULL;	// where PersistentBitmaps come from
 
 //----------------------------------------------------------------------
 // PersistentBitmap::PersistentBitmap(int)
@@ -21,6 +26,7 @@
 
 PersistentBitmap::PersistentBitmap(int numItems):Bitmap(numItems) 
 { 
+    onDisk = NULL;
 }
 
 //----------------------------------------------------------------------
@@ -40,7 +46,8 @@ PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems):Bitmap(numItems
     // map has already been initialized by the BitMap constructor,
     // but we will just overwrite that with the contents of the
     // map found in the file
-    file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    onDisk = NULL;
+    FetchFrom(file);
 }
 
 //----------------------------------------------------------------------
@@ -50,6 +57,32 @@ PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems):Bitmap(numItems
 
 PersistentBitmap::~PersistentBitmap()
 { 
+    if (onDisk != NULL)
+	FreeBuffer((char *)onDisk, numWords * sizeof(unsigned));
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::operator new, PersistentBitmap::operator delete
+//	The free sector and free inode maps are read in for each file
+//	created or removed, so they come from a cache of their own
+//	instead of from the heap.  (Bitmap pools the bits themselves.)
+//----------------------------------------------------------------------
+
+void *
+PersistentBitmap::operator new(size_t size)
+{
+    ASSERT(size == sizeof(PersistentBitmap));
+    if (bitmapCache == NULL)
+	bitmapCache = new ObjectCache("PersistentBitmap",
+				      sizeof(PersistentBitmap));
+    return bitmapCache->Alloc();
+}
+
+void
+PersistentBitmap::operator delete(void *map)
+{
+    if (map != NULL)
+	bitmapCache->Free(map);
 }
 
 //----------------------------------------------------------------------
@@ -63,17 +96,48 @@ void
 PersistentBitmap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    if (onDisk == NULL)
+	onDisk = (unsigned int *)AllocBuffer(numWords * sizeof(unsigned));
+    memcpy(onDisk, map, numWords * sizeof(unsigned));
 }
 
 //----------------------------------------------------------------------
 // PersistentBitmap::WriteBack
 // 	Store the contents of a persistent bitmap to a Nachos file.
 //
+//	If the map was read from the file, only the sectors of it that
+//	have changed since are written -- each run of them in one write
+//	-- so allocating or freeing any number of sectors near each other
+//	costs a sector or two, not the whole map.  (The caller holds the
+//	lock that keeps anyone else from changing the file meanwhile.)
+//
 //	"file" is the place to write the bitmap to
 //----------------------------------------------------------------------
 
 void
 PersistentBitmap::WriteBack(OpenFile *file)
 {
-   file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
+    int size = numWords * sizeof(unsigned);
+    char *now = (char *)map, *was = (char *)onDisk;
+
+    if (onDisk == NULL) {
+	file->WriteAt(now, size, 0);
+	onDisk = (unsigned int *)AllocBuffer(size);
+    } else
+	for (int start = 0; start < size; ) {
+	    int end = start;
+
+	    // find the next run of sectors that changed
+	    while (end < size && memcmp(&now[end], &was[end],
+					min(SectorSize, size - end)) != 0)
+		end += SectorSize;
+	    if (end == start) {
+		start += SectorSize;
+		continue;
+	    }
+	    end = min(end, size);
+	    file->WriteAt(&now[start], end - start, start);
+	    start = end;
+	}
+    memcpy(onDisk, map, size);
 }
@@ -28,8 +28,17 @@ class PersistentBitmap : public Bitmap {
 
     ~PersistentBitmap(); 			// deallocate bitmap
 
+    void *operator new(size_t size);	// Kept in a slab cache (slab.h)
+    void operator delete(void *map);
+
     void FetchFrom(OpenFile *file);     // read bitmap from the disk
     void WriteBack(OpenFile *file); 	// write bitmap contents to disk 
+					// (only the sectors changed since
+					// it was read, if it was)
+
+  private:
+    unsigned int *onDisk;		// the map as last read or written
+					// (NULL if it never was)
 };
 
 #endif // PBITMAP_H
@@ -0,0 +1,201 @@
+// refmap.cc
+//	Routines to keep count of the pointers at each disk sector, so
+//	that files can share sectors.  See refmap.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+#ifndef FILESYS_STUB
+
+#include "copyright.h"
+#include "debug.h"
+#include "refmap.h"
+#include "filehdr.h"
+#include "openfile.h"
+#include "pbitmap.h"
+#include "slab.h"
+
+#define CountsPerSector	(SectorSize / sizeof(unsigned short))
+#define RefCountSectors	((int) (RefCountFileSize / SectorSize))
+#define WindowSectors	min(MaxRefSectors, RefCountSectors)
+					// a small disk has fewer than
+					// MaxRefSectors
+
+//----------------------------------------------------------------------
+// RefCountMap::RefCountMap
+// 	Initialize a map of the counts in "file", with none of them read
+//	in yet.  The free map in "freeMapFile" is only read if a sector
+//	has to be allocated.
+//----------------------------------------------------------------------
+
+RefCountMap::RefCountMap(OpenFile *file, OpenFile *freeMapFile)
+{
+    this->file = file;
+    this->freeMapFile = freeMapFile;
+    freeMap = NULL;
+    freeMapChanged = FALSE;
+    first = -1;
+    window = NULL;
+    firstDirty = lastDirty = -1;
+}
+
+//----------------------------------------------------------------------
+// RefCountMap::~RefCountMap
+// 	Free the window of counts, and the free map.  Anything changed
+//	since the last WriteBack is forgotten.
+//----------------------------------------------------------------------
+
+RefCountMap::~RefCountMap()
+{
+    if (window != NULL)
+	FreeBuffer(window, WindowSectors * SectorSize);
+    delete freeMap;
+}
+
+//----------------------------------------------------------------------
+// RefCountMap::Count
+// 	Return where the count of "sector" is in the window.  If it isn't
+//	in the window, write back what changed there, and read the window
+//	in again starting with the sector of counts that has it (or as
+//	near as the end of the file allows).
+//----------------------------------------------------------------------
+
+unsigned short *
+RefCountMap::Count(int sector)
+{
+    int which = sector / CountsPerSector;
+
+    ASSERT(sector >= 0 && sector < NumSectors);
+    if (first == -1 || which < first || which >= first + WindowSectors) {
+	if (window == NULL)
+	    window = AllocBuffer(WindowSectors * SectorSize);
+	WriteCounts();
+	first = min(which, RefCountSectors - WindowSectors);
+	file->ReadAt(window, WindowSectors * SectorSize, first * SectorSize);
+    }
+    return (unsigned short *) window + (sector - first * CountsPerSector);
+}
+
+//----------------------------------------------------------------------
+// RefCountMap::Changed
+// 	Note that the count of "sector", in the window, has changed.
+//----------------------------------------------------------------------
+
+void
+RefCountMap::Changed(int sector)
+{
+    int which = sector / CountsPerSector - first;
+
+    if (firstDirty == -1 || which < firstDirty)
+	firstDirty = which;
+    if (which > lastDirty)
+	lastDirty = which;
+}
+
+//----------------------------------------------------------------------
+// RefCountMap::Extra
+// 	Return how many pointers there are at "sector" besides the first.
+//----------------------------------------------------------------------
+
+int
+RefCountMap::Extra(int sector)
+{
+    return *Count(sector);
+}
+
+//----------------------------------------------------------------------
+// RefCountMap::AddRef
+// 	Count another pointer at "sector".  Each pointer is in a header of
+//	a different file, so there can't be more than there are inodes.
+//----------------------------------------------------------------------
+
+void
+RefCountMap::AddRef(int sector)
+{
+    unsigned short *count = Count(sector);
+
+    ASSERT(*count < NumInodes);
+    (*count)++;
+    Changed(sector);
+}
+
+//----------------------------------------------------------------------
+// RefCountMap::Release
+// 	Count one pointer fewer at "sector", if there are others.  Return
+//	FALSE if there were none: the pointer going away was the only
+//	one, and it is up to the caller to free the sector.
+//----------------------------------------------------------------------
+
+bool
+RefCountMap::Release(int sector)
+{
+    unsigned short *count = Count(sector);
+
+    if (*count == 0)
+	return FALSE;
+    (*count)--;
+    Changed(sector);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// RefCountMap::Copy
+// 	Allocate a free sector for the caller's own copy of "sector",
+//	which it shares, and count one pointer fewer at "sector".  A free
+//	sector has a count of 0, so the new one starts out with just the
+//	caller's pointer.  The caller does the copying.
+//
+//	Return the new sector, or -1 if the disk is full.
+//----------------------------------------------------------------------
+
+int
+RefCountMap::Copy(int sector)
+{
+    int copy;
+    bool shared;
+
+    if (freeMap == NULL)
+	freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+    if ((copy = freeMap->FindAndSet()) == -1)
+	return -1;
+    freeMapChanged = TRUE;
+    ASSERT(Extra(copy) == 0);
+    shared = Release(sector);
+    ASSERT(shared);
+    return copy;
+}
+
+//----------------------------------------------------------------------
+// RefCountMap::WriteBack
+// 	Write back the counts that have changed, and the free map if any
+//	sectors have been allocated since the last time.
+//----------------------------------------------------------------------
+
+void
+RefCountMap::WriteBack()
+{
+    WriteCounts();
+    if (freeMapChanged) {
+	freeMap->WriteBack(freeMapFile);
+	freeMapChanged = FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// RefCountMap::WriteCounts
+// 	Write back the sectors of the window that have changed, in one
+//	write.
+//----------------------------------------------------------------------
+
+void
+RefCountMap::WriteCounts()
+{
+    if (firstDirty == -1)
+	return;
+    file->WriteAt(window + firstDirty * SectorSize,
+		  (lastDirty - firstDirty + 1) * SectorSize,
+		  (first + firstDirty) * SectorSize);
+    firstDirty = lastDirty = -1;
+}
+
+#endif // FILESYS_STUB
@@ -0,0 +1,88 @@
+// refmap.h
+//	Data structures for keeping count of how many file headers point
+//	at each disk sector, so that files can share sectors.
+//
+//	A clone of a file (FileSystem::Clone) gets a header of its own,
+//	pointing at the same sub-headers and data sectors as the original.
+//	Whichever file writes to a shared sector first gets a copy of it
+//	(and of the sub-headers on the way to it) to write to; the other
+//	keeps the original.  A sector is only freed once nothing points at
+//	it any more.
+//
+//	The counts are kept in a file, with one unsigned short per sector
+//	on the disk: how many pointers at the sector there are besides the
+//	first.  So a sector in use by one file counts 0, just as a free one
+//	does; a file that has never been cloned never needs its counts
+//	read, and the file is only made when the first file on the disk is
+//	cloned.  A pointer counts once however
+//	many files share the header it is in; so cloning a file only adds
+//	to the counts of the few sectors its own header points at, and
+//	copying a shared sub-header adds to the counts of the sectors it
+//	points at.
+//
+//	The counts are read a window of MaxRefSectors sectors at a time,
+//	starting at the first one needed, and only the part of the window
+//	that changed is written back.  Removing a file reads its counts in
+//	the order of its sectors, so the window keeps the disk from
+//	seeking between the file and the counts for each sector of counts.
+//	The caller holds the file system's allocator lock while using the
+//	map.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef REFMAP_H
+#define REFMAP_H
+
+#include "copyright.h"
+#include "disk.h"
+
+class OpenFile;
+class PersistentBitmap;
+
+#define RefCountFileSize (NumSectors * sizeof(unsigned short))
+#define MaxRefSectors	32		// sectors of counts read at once
+
+class RefCountMap {
+  public:
+    RefCountMap(OpenFile *file, OpenFile *freeMapFile);
+					// Use the counts in "file", and
+					// the free map in "freeMapFile"
+    ~RefCountMap();			// Free the buffers (without
+					// writing anything back)
+
+    int Extra(int sector);		// Pointers at "sector" besides
+					// the first
+    void AddRef(int sector);		// Count another pointer at it
+    bool Release(int sector);		// Count one pointer fewer, if it
+					// has others: return FALSE if it
+					// was the only one (the caller
+					// frees the sector)
+    int Copy(int sector);		// Allocate a sector to hold a copy
+					// of shared "sector", and count one
+					// pointer fewer at it; return the
+					// new sector, or -1 if the disk
+					// is full
+
+    void WriteBack();			// Write the changed counts, and
+					// the free map if Copy changed it
+
+  private:
+    unsigned short *Count(int sector);	// Where the count of "sector" is
+					// (the window is moved if need be)
+    void Changed(int sector);		// Note that it has changed
+    void WriteCounts();			// Write the changed counts back
+
+    OpenFile *file;			// the counts, one per sector
+    OpenFile *freeMapFile;		// the free map
+    PersistentBitmap *freeMap;		// read in by the first Copy
+    bool freeMapChanged;		// by Copy, since written back?
+    int first;				// first sector of "file" in the
+					// window (-1 if none yet)
+    char *window;			// the window's contents
+    int firstDirty, lastDirty;		// sectors of the window changed
+					// since read (-1 if none)
+};
+
+#endif // REFMAP_H
@@ -5,10 +5,16 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Use a semaphore per thread request to synchronize the interrupt
+//	handlers with the pending requests.  And, because the physical
+//	disk can only queue a limited number of operations at a time
+//	(usually one), keep the requests it can't take yet in a queue,
+//	and send them along as earlier ones finish.
+//
+//	The sectors may be striped across several disks; each has its
+//	own queue, so requests for different disks proceed in parallel.
+//	Each disk may also hold checksums of its sectors, which are
+//	written with them and checked when they are read.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,20 +22,129 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "flashdisk.h"
+#include "main.h"
+#include "slab.h"
+#include "crc32c.h"
+
+
+//----------------------------------------------------------------------
+// DiskMember::DiskMember
+// 	Remember which SynchDisk, and which of its disks, to report
+//	interrupts for.
+//----------------------------------------------------------------------
 
+DiskMember::DiskMember(SynchDisk *owner, int which)
+{
+    this->owner = owner;
+    this->which = which;
+}
+
+//----------------------------------------------------------------------
+// DiskMember::CallBack
+// 	Disk interrupt handler for one of the SynchDisk's disks.
+//----------------------------------------------------------------------
+
+void
+DiskMember::CallBack()
+{
+    owner->RequestDone(which);
+}
+
+//----------------------------------------------------------------------
+// SynchDiskRequest::operator new, SynchDiskRequest::operator delete
+// 	There is a request for every sector read or written, so they come
+//	from a cache instead of from the heap.
+//----------------------------------------------------------------------
+
+static ObjectCache *requestCache = NULL;
+
+void *
+SynchDiskRequest::operator new(size_t size)
+{
+    ASSERT(size == sizeof(SynchDiskRequest));
+    if (requestCache == NULL)
+	requestCache = new ObjectCache("SynchDiskRequest",
+				       sizeof(SynchDiskRequest));
+    return requestCache->Alloc();
+}
+
+void
+SynchDiskRequest::operator delete(void *request)
+{
+    if (request != NULL)
+	requestCache->Free(request);
+}
 
 //----------------------------------------------------------------------
 // SynchDisk::SynchDisk
 // 	Initialize the synchronous interface to the physical disk, in turn
-//	initializing the physical disk.
+//	initializing the physical disks.
+//
+//	A single disk is kept in UNIX file "fileName"; with more than
+//	one, they are <fileName>_a, _b, and so on.
 //
+//	"fileName" -- the UNIX file holding the disk
+//	"numDisks" -- how many disks to stripe the sectors across
+//	"stripeUnit" -- how many consecutive sectors go to each disk
+//	"queueDepth" -- how many requests each disk may have outstanding
+//	"flashBlocks" -- if not 0, use flash devices of this many erase
+//		blocks instead of disks
+//	"trim" -- tell the device about sectors the file system frees
+//	"overlayBase" -- if not NULL, keep each disk as an overlay on this
+//		base image (with more than one disk, on <overlayBase>_a,
+//		<overlayBase>_b, and so on)
+//	"checksums" -- keep a checksum of each sector
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk()
+SynchDisk::SynchDisk(char *fileName, int numDisks, int stripeUnit,
+		     int queueDepth, int flashBlocks, bool trim,
+		     char *overlayBase, bool checksums)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
-    disk = new Disk(this);
+    char name[MaxDiskName];
+    char baseName[MaxDiskName];
+    char *base;
+
+    ASSERT((numDisks >= 1) && (numDisks <= MaxDisks));
+    ASSERT(strlen(fileName) + 2 < MaxDiskName);
+    ASSERT(overlayBase == NULL || strlen(overlayBase) + 2 < MaxDiskName);
+    ASSERT(stripeUnit >= 1);
+    this->numDisks = numDisks;
+    this->stripeUnit = stripeUnit;
+    doneRequests = new List<int>;
+    bottomHalf = new BottomHalf("synch disk", SynchDisk::WakeUp, this);
+    for (int i = 0; i < numDisks; i++) {
+	if (numDisks == 1)
+	    strcpy(name, fileName);
+	else
+	    sprintf(name, "%s_%c", fileName, 'a' + i);
+	member[i] = new DiskMember(this, i);
+	if (overlayBase == NULL)
+	    base = NULL;
+	else if (numDisks == 1)
+	    base = overlayBase;
+	else {
+	    sprintf(baseName, "%s_%c", overlayBase, 'a' + i);
+	    base = baseName;
+	}
+	if (flashBlocks > 0)
+	    disk[i] = new FlashDisk(member[i], queueDepth, name, base,
+				    flashBlocks);
+	else
+	    disk[i] = new Disk(member[i], queueDepth, name, base);
+	waiting[i] = new List<SynchDiskRequest *>;
+	numInFlight[i] = 0;
+	sums[i] = NULL;
+	sumsLoaded[i] = NULL;
+	if (checksums) {
+	    ASSERT(SumsPerTrack >= 1 && SectorsPerTrack <= SumsPerSector);
+	    sums[i] = new unsigned int[NumTracks * SumsPerSector];
+	    sumsLoaded[i] = new bool[NumTracks];
+	    for (int track = 0; track < NumTracks; track++)
+		sumsLoaded[i][track] = FALSE;
+	}
+    }
+    trimEnabled = trim;
 }
 
 //----------------------------------------------------------------------
@@ -40,9 +155,15 @@ SynchDisk::SynchDisk()
 
 SynchDisk::~SynchDisk()
 {
-    delete disk;
-    delete lock;
-    delete semaphore;
+    for (int i = 0; i < numDisks; i++) {
+	delete disk[i];
+	delete member[i];
+	delete waiting[i];
+	delete [] sums[i];
+	delete [] sumsLoaded[i];
+    }
+    delete bottomHalf;
+    delete doneRequests;
 }
 
 //----------------------------------------------------------------------
@@ -57,10 +178,7 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    Transfer(1, &sectorNumber, data, FALSE);
 }
 
 //----------------------------------------------------------------------
@@ -75,20 +193,451 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    Transfer(1, &sectorNumber, data, TRUE);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadSectors/WriteSectors
+// 	Read/write several disk sectors, which need not be consecutive.
+//	All of the requests are queued before we wait for any of them,
+//	so sectors on different disks are transferred at the same time.
+//	Return only after all the data has been read/written.
+//
+//	"numSectors" -- how many sectors to read/write
+//	"sectorNumbers" -- the disk sectors to read/write
+//	"data" -- the buffer holding the contents of the sectors, one
+//		after the other
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadSectors(int numSectors, int *sectorNumbers, char* data)
+{
+    Transfer(numSectors, sectorNumbers, data, FALSE);
+}
+
+void
+SynchDisk::WriteSectors(int numSectors, int *sectorNumbers, char* data)
+{
+    Transfer(numSectors, sectorNumbers, data, TRUE);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Capacity
+// 	Return how many sectors the file system may use: all of them,
+//	unless a sector of each track holds checksums.
+//----------------------------------------------------------------------
+
+int
+SynchDisk::Capacity()
+{
+    if (sums[0] == NULL)
+	return NumSectors;
+    return NumTracks * SumsPerTrack;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Transfer
+// 	Queue a request for each sector on the disk that holds it, start
+//	every disk that can take more work, then wait for all of the
+//	requests to finish.
+//
+//	With checksums, a write also writes the checksum sector of each
+//	track it writes to (once, if the sectors of a track come one after
+//	the other); the request writes from the checksums in memory, so
+//	whichever request for the sector the disk does last writes the
+//	latest checksums.  A read is checked once it is done.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Transfer(int numSectors, int *sectorNumbers, char *data,
+		    bool writing)
+{
+    Semaphore *done = new Semaphore("synch disk request", 0);
+    int numRequests = numSectors;
+    unsigned int *sectorSums = NULL;	// checksums of the sectors written,
+					// or before they were read
+    int lastTrack[MaxDisks];		// last checksum sector queued
+    IntStatus oldLevel;
+
+    if (sums[0] != NULL) {
+	LoadSums(numSectors, sectorNumbers);
+	sectorSums = new unsigned int[numSectors];
+	if (writing) {
+	    double start = HostTime();
+
+	    for (int i = 0; i < numSectors; i++)
+		sectorSums[i] = Crc32c(&data[i * SectorSize], SectorSize);
+	    kernel->stats->checksumTime += HostTime() - start;
+	    kernel->stats->numSectorsSummed += numSectors;
+	}
+	for (int which = 0; which < numDisks; which++)
+	    lastTrack[which] = -1;
+    }
+
+    // don't let the interrupt handler start a disk while we are
+    // still filling its queue
+    oldLevel = kernel->interrupt->SetLevel(IntOff);
+    for (int i = 0; i < numSectors; i++) {
+	int diskSector;
+	int which = MapSector(sectorNumbers[i], &diskSector);
+	int track = diskSector / SectorsPerTrack;
+	unsigned int *trackSums;
+
+	Queue(which, diskSector, &data[i * SectorSize], writing, done);
+	if (sums[which] == NULL)
+	    continue;
+	trackSums = &sums[which][track * SumsPerSector];
+	if (!writing) {
+	    sectorSums[i] = trackSums[diskSector % SectorsPerTrack];
+	    continue;
+	}
+	trackSums[0] = SumsMagic;
+	trackSums[diskSector % SectorsPerTrack] = sectorSums[i];
+	if (track != lastTrack[which]) {
+	    Queue(which, track * SectorsPerTrack, (char *) trackSums, TRUE,
+		  done);
+	    lastTrack[which] = track;
+	    numRequests++;
+	    kernel->stats->numSumsWritten++;
+	}
+    }
+    for (int which = 0; which < numDisks; which++)
+	Dispatch(which);
+    (void) kernel->interrupt->SetLevel(oldLevel);
+
+    for (int i = 0; i < numRequests; i++)
+	done->P();			// wait for interrupts
+    delete done;
+
+    if (sectorSums != NULL) {
+	if (!writing)
+	    CheckSums(numSectors, sectorNumbers, data, sectorSums);
+	delete [] sectorSums;
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Queue
+// 	Queue a request to read/write a sector of disk "which", to be sent
+//	to it by Dispatch.  Interrupts are off.
+//
+//	"which" -- the disk
+//	"diskSector" -- where the sector is on that disk
+//	"data" -- the bytes to write, or where to put the bytes read
+//	"writing" -- write request?
+//	"done" -- V'ed when the request finishes
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Queue(int which, int diskSector, char *data, bool writing,
+		 Semaphore *done)
+{
+    SynchDiskRequest *request = new SynchDiskRequest;
+
+    request->sector = diskSector;
+    request->data = data;
+    request->writing = writing;
+    request->done = done;
+    waiting[which]->Append(request);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::LoadSums
+// 	Read in the checksum sectors of the tracks holding the sectors,
+//	for those not read in yet, all at once.  Another thread may read
+//	in the same track meanwhile; whichever finishes first keeps what
+//	it read, since the checksums may change as soon as it has.  A
+//	checksum sector that was never written is all zeros: nothing to
+//	check yet.
+//
+//	"numSectors" -- how many sectors are to be read or written
+//	"sectorNumbers" -- the sectors
+//----------------------------------------------------------------------
+
+void
+SynchDisk::LoadSums(int numSectors, int *sectorNumbers)
+{
+    int *missing = new int[numSectors];	// disk * NumTracks + track
+    int numMissing = 0;
+    Semaphore *done;
+    char *buffer;
+    IntStatus oldLevel;
+
+    for (int i = 0; i < numSectors; i++) {
+	int diskSector;
+	int which = MapSector(sectorNumbers[i], &diskSector);
+	int track = diskSector / SectorsPerTrack;
+	int j;
+
+	if (sumsLoaded[which][track])
+	    continue;
+	for (j = numMissing - 1; j >= 0; j--)
+	    if (missing[j] == which * NumTracks + track)
+		break;
+	if (j < 0)
+	    missing[numMissing++] = which * NumTracks + track;
+    }
+    if (numMissing == 0) {
+	delete [] missing;
+	return;
+    }
+
+    done = new Semaphore("checksum read", 0);
+    buffer = new char[numMissing * SectorSize];
+    oldLevel = kernel->interrupt->SetLevel(IntOff);
+    for (int j = 0; j < numMissing; j++)
+	Queue(missing[j] / NumTracks,
+	      (missing[j] % NumTracks) * SectorsPerTrack,
+	      &buffer[j * SectorSize], FALSE, done);
+    for (int which = 0; which < numDisks; which++)
+	Dispatch(which);
+    (void) kernel->interrupt->SetLevel(oldLevel);
+    for (int j = 0; j < numMissing; j++)
+	done->P();
+    delete done;
+    kernel->stats->numSumsRead += numMissing;
+
+    for (int j = 0; j < numMissing; j++) {
+	int which = missing[j] / NumTracks;
+	int track = missing[j] % NumTracks;
+	unsigned int *trackSums = &sums[which][track * SumsPerSector];
+
+	if (sumsLoaded[which][track])
+	    continue;
+	memcpy(trackSums, &buffer[j * SectorSize], SectorSize);
+	if (trackSums[0] != SumsMagic)
+	    memset(trackSums, 0, SectorSize);
+	sumsLoaded[which][track] = TRUE;
+    }
+    delete [] buffer;
+    delete [] missing;
 }
 
 //----------------------------------------------------------------------
-// SynchDisk::CallBack
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// SynchDisk::CheckSums
+// 	Check each sector read against its checksum, and complain about
+//	any that doesn't match.  A sector written while it was being read
+//	may hold what was there before or after; either will do.
+//
+//	"numSectors" -- how many sectors were read
+//	"sectorNumbers" -- the sectors
+//	"data" -- what was read
+//	"before" -- the sectors' checksums when the read was queued
 //----------------------------------------------------------------------
 
 void
-SynchDisk::CallBack()
-{ 
-    semaphore->V();
+SynchDisk::CheckSums(int numSectors, int *sectorNumbers, char *data,
+		     unsigned int *before)
+{
+    double start = HostTime();
+
+    for (int i = 0; i < numSectors; i++) {
+	int diskSector;
+	int which = MapSector(sectorNumbers[i], &diskSector);
+	unsigned int after = sums[which][(diskSector / SectorsPerTrack)
+					 * SumsPerSector
+					 + diskSector % SectorsPerTrack];
+	unsigned int sum;
+
+	if (before[i] == 0 && after == 0)
+	    continue;			// never written: nothing to check
+	sum = Crc32c(&data[i * SectorSize], SectorSize);
+	kernel->stats->numSectorsChecked++;
+	if (sum != after && sum != before[i]) {
+	    kernel->stats->numChecksumErrors++;
+	    cerr << "Checksum error: sector " << sectorNumbers[i];
+	    cerr << " (disk " << which << ", sector " << diskSector << ")\n";
+	}
+    }
+    kernel->stats->checksumTime += HostTime() - start;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Dispatch
+// 	Send queued requests to disk "which", as long as it has room.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Dispatch(int which)
+{
+    while (!waiting[which]->IsEmpty()
+	   && numInFlight[which] < disk[which]->QueueDepth()) {
+	SynchDiskRequest *request = waiting[which]->RemoveFront();
+	int tag;
+
+	if (request->writing)
+	    tag = disk[which]->WriteRequest(request->sector, request->data);
+	else
+	    tag = disk[which]->ReadRequest(request->sector, request->data);
+	inFlight[which][tag] = request;
+	numInFlight[which]++;
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::MapSector
+// 	Return which disk holds a sector, and set "diskSector" to where
+//	it is on that disk.
+//----------------------------------------------------------------------
+
+int
+SynchDisk::MapSector(int sectorNumber, int *diskSector)
+{
+    int stripe = sectorNumber / stripeUnit;
+
+    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    *diskSector = (stripe / numDisks) * stripeUnit + sectorNumber % stripeUnit;
+    if (sums[0] != NULL) {
+	// skip the checksum sector at the start of each track
+	ASSERT(*diskSector < NumTracks * SumsPerTrack);
+	*diskSector = (*diskSector / SumsPerTrack) * SectorsPerTrack + 1
+	    + *diskSector % SumsPerTrack;
+    }
+    return stripe % numDisks;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::TrimSector
+// 	Tell the device that the file system has freed a sector, so its
+//	contents need not be preserved.  The device only updates its
+//	bookkeeping, so there is nothing to wait for.
+//
+//	"sectorNumber" -- the disk sector no longer in use
+//----------------------------------------------------------------------
+
+void
+SynchDisk::TrimSector(int sectorNumber)
+{
+    int diskSector;
+
+    if (trimEnabled) {
+	int which = MapSector(sectorNumber, &diskSector);
+	disk[which]->Trim(diskSector);
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::RequestDone
+// 	Disk interrupt handler.  Note which request finished -- the disk
+//	may already be working on the next one -- and defer waking up
+//	the thread waiting for it to a bottom half, so that it happens
+//	with interrupts enabled.
+//
+//	"which" -- the disk whose request finished
+//----------------------------------------------------------------------
+
+void
+SynchDisk::RequestDone(int which)
+{
+    doneRequests->Append(which * MaxQueueDepth + disk[which]->DoneTag());
+    bottomHalf->Raise();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WakeUp
+// 	Bottom half of the disk interrupt handler.  Retire the oldest disk
+//	request that finished, give its disk more work if any is waiting,
+//	and wake up the thread waiting for the request.  Called once for
+//	each interrupt.
+//
+//	"arg" -- the SynchDisk whose request completed
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WakeUp(void *arg)
+{
+    SynchDisk *synchDisk = (SynchDisk *)arg;
+    int done = synchDisk->doneRequests->RemoveFront();
+    int which = done / MaxQueueDepth;
+    SynchDiskRequest *request = synchDisk->inFlight[which][done % MaxQueueDepth];
+
+    synchDisk->numInFlight[which]--;
+    synchDisk->Dispatch(which);
+    request->done->V();
+    delete request;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::SelfTest, SelfTestReader
+// 	Measure disk read throughput, two ways:
+//
+//	First, with several threads reading scattered sectors at once.
+//	With a queue depth greater than one, the disk can choose among
+//	the readers' requests, so the same reads should take fewer ticks
+//	than with one request at a time.  Each reader uses its own fixed
+//	sequence of sectors, so runs with different queue depths do the
+//	same work.  The reads are kept within the first TestTracks tracks,
+//	roughly the span of a busy file system, so that seeks don't swamp
+//	the rotational delays.
+//
+//	Second, with one thread reading consecutive sectors, TestRun at a
+//	time, as a large file read would.  With the sectors striped over
+//	several disks, each run keeps all of them busy.
+//----------------------------------------------------------------------
+
+static const int TestTracks = 256;
+static const int TestRun = 64;
+static const int TestSequential = 4096;
+
+static SynchDisk *testDisk;
+static Semaphore *testDone;
+static int testReads;
+
+static void
+SelfTestReader(int which)
+{
+    char *buffer = new char[SectorSize];
+    unsigned int seed = which * 7919 + 1;
+
+    for (int i = 0; i < testReads; i++) {
+	seed = seed * 1103515245 + 12345;
+	testDisk->ReadSector((seed >> 8) % (min(TestTracks, NumTracks)
+					    * SectorsPerTrack), buffer);
+    }
+    delete [] buffer;
+    testDone->V();
+}
+
+void
+SynchDisk::SelfTest(int numReaders, int numReads)
+{
+    int start = kernel->stats->totalTicks;
+    int elapsed;
+    int sectors[TestRun];
+    char *buffer;
+
+    cout << "Disk test: " << numDisks << " disks, stripe unit " << stripeUnit;
+    cout << ", queue depth " << disk[0]->QueueDepth() << "\n";
+
+    testDisk = this;
+    testDone = new Semaphore("disk test done", 0);
+    testReads = numReads;
+    for (int i = 0; i < numReaders; i++) {
+	Thread *reader = new Thread("disk reader", i + 1);
+	reader->Fork((VoidFunctionPtr) SelfTestReader, (void *) i);
+    }
+    for (int i = 0; i < numReaders; i++)
+	testDone->P();
+    delete testDone;
+
+    elapsed = kernel->stats->totalTicks - start;
+    cout << "  random: " << numReaders << " readers x " << numReads << " reads";
+    cout << ", " << elapsed << " ticks";
+    cout << ", " << (numReaders * numReads * 1000000.0) / elapsed;
+    cout << " sectors (" << SectorSize << " bytes) per million ticks\n";
+
+    start = kernel->stats->totalTicks;
+    buffer = new char[TestRun * SectorSize];
+    for (int first = 0; first < TestSequential; first += TestRun) {
+	for (int i = 0; i < TestRun; i++)
+	    sectors[i] = first + i;
+	ReadSectors(TestRun, sectors, buffer);
+    }
+    delete [] buffer;
+
+    elapsed = kernel->stats->totalTicks - start;
+    cout << "  sequential: " << TestSequential << " sectors";
+    cout << ", " << elapsed << " ticks";
+    cout << ", " << (TestSequential * 1000000.0) / elapsed;
+    cout << " sectors (" << SectorSize << " bytes) per million ticks\n";
 }
@@ -1,9 +1,9 @@
-// synchdisk.h 
-// 	Data structures to export a synchronous interface to the raw 
+// synchdisk.h
+// 	Data structures to export a synchronous interface to the raw
 //	disk device.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
-// All rights reserved.  See copyright.h for copyright notice and limitation 
+// All rights reserved.  See copyright.h for copyright notice and limitation
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
@@ -12,44 +12,179 @@
 #define SYNCHDISK_H
 
 #include "disk.h"
+#include "interrupt.h"
 #include "synch.h"
 #include "callback.h"
+#include "list.h"
+
+const int MaxDisks = 8;			// most disks we can stripe over
+#define SumsPerTrack	(SectorsPerTrack - 1)
+					// with checksums, sectors of data in
+					// a track; the first sector holds
+					// their checksums
+#define SumsPerSector	((int) (SectorSize / sizeof(unsigned int)))
+					// checksums a sector has room for
+const unsigned int SumsMagic = 0x43524331;
+					// first word of a checksum sector
+
+class SynchDisk;
+
+// The following class connects one of the raw disks to the SynchDisk,
+// so that when the disk's interrupt arrives, the SynchDisk knows which
+// disk it came from.
+
+class DiskMember : public CallBackObj {
+  public:
+    DiskMember(SynchDisk *owner, int which);
+    void CallBack();			// Tell the owner that disk "which"
+					// finished a request
+
+  private:
+    SynchDisk *owner;
+    int which;
+};
+
+// A read or write of one sector, from when a thread asks for it until
+// the disk finishes it.
+
+class SynchDiskRequest {
+  public:
+    int sector;				// sector on the member disk
+    char *data;				// the bytes to write, or where
+					// to put the bytes read
+    bool writing;			// write request?
+    Semaphore *done;			// V'ed when the request finishes
+
+    void *operator new(size_t size);	// Kept in a slab cache (slab.h)
+    void operator delete(void *request);
+};
 
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
 // requests to read or write portions of the disk return immediately,
 // and an interrupt occurs later to signal that the operation completed.
-// (Also, the physical characteristics of the disk device assume that
-// only one operation can be requested at a time).
+// (Also, the physical characteristics of the disk device limit how
+// many operations can be outstanding at a time -- one, unless the
+// disk is set up to queue requests).
 //
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
-// returning.
+// returning.  Requests the disk can't take yet wait in a queue here,
+// and are sent as earlier requests finish.
+//
+// The synchronous disk may be made of several raw disks, with the
+// sectors striped across them (RAID-0): the first "stripeUnit" sectors
+// are on the first disk, the next "stripeUnit" on the second, and so
+// on, wrapping around to the first disk again.  A request for many
+// sectors (ReadSectors/WriteSectors) keeps all the disks busy at once.
+//
+// The disks may also keep a checksum (CRC-32C) of each sector, to catch
+// sectors damaged since they were written.  The first sector of each
+// track then holds the checksums of the others -- SumsMagic, then one
+// word per sector, 0 if it was never written -- so the sector numbers
+// the file system uses skip over it.  Sectors written have their
+// checksums written along with them, in the same batch of requests and
+// on the same track; a sector read is checked against its checksum.
+// The checksums of a track are read the first time any of its sectors
+// is used, and kept in memory from then on.
+//
+// The file system only uses the sectors through the virtual routines,
+// so a LogDisk (logdisk.h) can stand in for a SynchDisk, and put each
+// sector written wherever its log is up to.
 
-class SynchDisk : public CallBackObj {
+class SynchDisk {
   public:
-    SynchDisk();    		        // Initialize a synchronous disk,
-					// by initializing the raw Disk.
-    ~SynchDisk();			// De-allocate the synch disk data
-    
-    void ReadSector(int sectorNumber, char* data);
+    SynchDisk(char *fileName, int numDisks, int stripeUnit,
+	      int queueDepth, int flashBlocks, bool trim,
+	      char *overlayBase, bool checksums);
+    					// Initialize a synchronous disk,
+					// by initializing the raw Disks
+					// (kept in UNIX file fileName)
+					// (flash devices with flashBlocks
+					// erase blocks, if that is not 0;
+					// overlays on base images, if
+					// overlayBase is not NULL; with
+					// checksums, if asked).
+    virtual ~SynchDisk();		// De-allocate the synch disk data
+
+    virtual void ReadSector(int sectorNumber, char* data);
     					// Read/write a disk sector, returning
-    					// only once the data is actually read 
+    					// only once the data is actually read
 					// or written.  These call
     					// Disk::ReadRequest/WriteRequest and
 					// then wait until the request is done.
-    void WriteSector(int sectorNumber, char* data);
-    
-    void CallBack();			// Called by the disk device interrupt
-					// handler, to signal that the
-					// current disk operation is complete.
+    virtual void WriteSector(int sectorNumber, char* data);
+    virtual void ReadSectors(int numSectors, int *sectorNumbers, char* data);
+    virtual void WriteSectors(int numSectors, int *sectorNumbers,
+			      char* data);
+    					// Read/write several sectors, to
+					// or from consecutive SectorSize
+					// pieces of "data"; the requests
+					// all go out before we wait
+    virtual void TrimSector(int sectorNumber);
+					// Tell the device the sector
+					// is no longer in use
+
+    virtual int Capacity();
+					// How many sectors, from 0 up,
+					// the file system may use
+    virtual void Sync() {}		// Write out anything written but
+					// not yet on the disk (logdisk.h)
+    virtual bool StartSync() { return FALSE; }
+					// The same, from a thread of its
+					// own; FALSE if there is nothing
+					// to write
+
+    void RequestDone(int which);	// Called by the disk device interrupt
+					// handler, to signal that a
+					// disk operation is complete.
+
+    static void WakeUp(void *arg);	// Bottom half of RequestDone: wake up
+					// the thread waiting for the request
+
+    void SelfTest(int numReaders, int numReads);
+    					// Measure read throughput with
+					// several concurrent readers, and
+					// with one sequential reader
 
   private:
-    Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    int numDisks;			// # of raw disks striped over
+    int stripeUnit;			// # of consecutive sectors that
+					// go to the same disk
+    Disk *disk[MaxDisks];		// Raw disk devices
+    DiskMember *member[MaxDisks];	// Their interrupt handlers
+    List<SynchDiskRequest *> *waiting[MaxDisks];
+    					// Requests not yet sent to each disk
+    SynchDiskRequest *inFlight[MaxDisks][MaxQueueDepth];
+    					// Requests at each disk, by tag
+    int numInFlight[MaxDisks];		// # of requests at each disk
+    List<int> *doneRequests;		// Completed (disk, tag) pairs not
+					// yet woken up
+    BottomHalf *bottomHalf;		// Deferred part of the disk interrupt
+    bool trimEnabled;			// pass TrimSector on to the device?
+    unsigned int *sums[MaxDisks];	// checksums of each disk's sectors,
+					// by where they are on it, a
+					// sector's worth per track, so laid
+					// out as on the disk (NULL if the
+					// disks have no checksums)
+    bool *sumsLoaded[MaxDisks];		// which tracks' checksums are read in
+
+    int MapSector(int sectorNumber, int *diskSector);
+    					// Which disk, and which sector on
+					// it, holds a sector
+    void Transfer(int numSectors, int *sectorNumbers, char *data,
+		  bool writing);	// Read/write sectors, and wait
+    void Queue(int which, int diskSector, char *data, bool writing,
+	       Semaphore *done);	// Queue a request for disk "which"
+    void LoadSums(int numSectors, int *sectorNumbers);
+					// Read in the checksums of the
+					// sectors, if they aren't yet
+    void CheckSums(int numSectors, int *sectorNumbers, char *data,
+		   unsigned int *before);
+					// Check the sectors read against
+					// their checksums
+    void Dispatch(int which);		// Send queued requests to a disk
+					// while it has room for them
 };
 
 #endif // SYNCHDISK_H
@@ -9,6 +9,7 @@
 #include "copyright.h"
 #include "debug.h"
 #include "bitmap.h"
+#include "slab.h"
 
 //----------------------------------------------------------------------
 // BitMap::BitMap
@@ -20,21 +21,14 @@
 
 Bitmap::Bitmap(int numItems)
 {
-    int i;
-
     ASSERT(numItems > 0);
 
     numBits = numItems;
     numWords = divRoundUp(numBits, BitsInWord);
-    map = new unsigned int[numWords];
-    for (i = 0; i < numWords; i++)
-    {
-        map[i] = 0; // initialize map to keep Purify happy
-    }
-    for (i = 0; i < numBits; i++)
-    {
-        Clear(i);
-    }
+    // the file system makes and frees a bitmap of every sector for
+    // each file it creates or removes, so the storage is pooled
+    map = (unsigned int *)AllocBuffer(numWords * sizeof(unsigned int));
+    bzero(map, numWords * sizeof(unsigned int)); // every bit clear
 }
 
 //----------------------------------------------------------------------
@@ -44,7 +38,7 @@ Bitmap::Bitmap(int numItems)
 
 Bitmap::~Bitmap()
 {
-    delete[] map;
+    FreeBuffer((char *)map, numWords * sizeof(unsigned int));
 }
 
 //----------------------------------------------------------------------
@@ -122,6 +116,30 @@ int Bitmap::FindAndSet()
     return -1;
 }
 
+//----------------------------------------------------------------------
+// Bitmap::FindAndSetNear
+// 	Like FindAndSet, but look for a clear bit starting at "which",
+//	going on to the end, then from the start; so the bit allocated
+//	is as close after "which" as it can be.
+//
+//	If no bits are clear, return -1.
+//----------------------------------------------------------------------
+
+int Bitmap::FindAndSetNear(int which)
+{
+    ASSERT(which >= 0 && which < numBits);
+    for (int i = 0; i < numBits; i++)
+    {
+        int bit = (which + i) % numBits;
+        if (!Test(bit))
+        {
+            Mark(bit);
+            return bit;
+        }
+    }
+    return -1;
+}
+
 //----------------------------------------------------------------------
 // Bitmap::NumClear
 // 	Return the number of clear bits in the bitmap.
@@ -142,6 +160,53 @@ int Bitmap::NumClear() const
     return count;
 }
 
+//----------------------------------------------------------------------
+// Bitmap::FindClearRun
+// 	Return the number of the first bit of the first run of "length"
+//	clear bits in a row, or -1 if there is no such run.  Nothing is
+//	set; the caller marks the bits it decides to use.
+//----------------------------------------------------------------------
+
+int Bitmap::FindClearRun(int length) const
+{
+    int run = 0;
+
+    ASSERT(length > 0);
+    for (int i = 0; i < numBits; i++)
+    {
+        run = Test(i) ? 0 : run + 1;
+        if (run == length)
+        {
+            return i - length + 1;
+        }
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::LongestClearRun
+// 	Return the length of the longest run of clear bits in a row (the
+//	first one, if there is a tie), and set "*start" to its first bit.
+//	Return 0 if every bit is set.
+//----------------------------------------------------------------------
+
+int Bitmap::LongestClearRun(int *start) const
+{
+    int run = 0, best = 0;
+
+    *start = -1;
+    for (int i = 0; i < numBits; i++)
+    {
+        run = Test(i) ? 0 : run + 1;
+        if (run > best)
+        {
+            best = run;
+            *start = i - run + 1;
+        }
+    }
+    return best;
+}
+
 //----------------------------------------------------------------------
 // Bitmap::Print
 // 	Print the contents of the bitmap, for debugging.
@@ -180,8 +245,17 @@ void Bitmap::SelfTest()
     ASSERT(Test(0) && Test(31));
 
     ASSERT(FindAndSet() == 1);
+    ASSERT(FindAndSetNear(2) == 2);
+    i = (numBits > 32) ? 32 : 3; // past bit 31, or wrapped around
+    ASSERT(FindAndSetNear(31) == i);
+    Clear(2);
+    Clear(i);
     Clear(0);
     Clear(1);
+
+    ASSERT(FindClearRun(31) == 0); // runs stop at the set bit 31
+    ASSERT(FindClearRun(32) == (numBits >= 64 ? 32 : -1));
+    ASSERT(LongestClearRun(&i) >= 31 && (i == 0 || i == 32));
     Clear(31);
 
     for (i = 0; i < numBits; i++)
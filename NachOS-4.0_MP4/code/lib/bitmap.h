@@ -43,7 +43,16 @@ public:
     int FindAndSet();           // Return the # of a clear bit, and as a side
         // effect, set the bit.
         // If no bits are clear, return -1.
+    int FindAndSetNear(int which);
+                          // The same, but the first clear bit at or
+                          // after "which", wrapping around to 0
     int NumClear() const; // Return the number of clear bits
+    int FindClearRun(int length) const;
+                          // Return the first of "length" clear bits
+                          // in a row, or -1 if there are none
+    int LongestClearRun(int *start) const;
+                          // Return the length of the longest run of
+                          // clear bits, and where it starts
 
     void Print() const; // Print contents of bitmap
     void SelfTest();    // Test whether bitmap is working
@@ -0,0 +1,147 @@
+// crc32c.cc
+//	Routines to compute CRC-32C checksums.  See crc32c.h.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "debug.h"
+#include "crc32c.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+static const unsigned int Polynomial = 0x82f63b78;
+					// the CRC-32C polynomial, bit-reversed
+static const unsigned int CheckValue = 0xe3069283;
+					// CRC-32C of "123456789"
+
+static unsigned int table[8][256];	// table[k][b]: the CRC of byte b
+					// followed by k zero bytes
+static int useHardware = -1;		// use SSE4.2?  (-1: not decided)
+
+//----------------------------------------------------------------------
+// MakeTables
+// 	Fill in the tables for SoftwareCrc.
+//----------------------------------------------------------------------
+
+static void
+MakeTables()
+{
+    for (int b = 0; b < 256; b++) {
+	unsigned int crc = b;
+
+	for (int bit = 0; bit < 8; bit++)
+	    crc = (crc >> 1) ^ ((crc & 1) ? Polynomial : 0);
+	table[0][b] = crc;
+    }
+    for (int k = 1; k < 8; k++)
+	for (int b = 0; b < 256; b++)
+	    table[k][b] = (table[k - 1][b] >> 8)
+		^ table[0][table[k - 1][b] & 0xff];
+}
+
+//----------------------------------------------------------------------
+// SoftwareCrc
+// 	Continue the CRC "crc" over "numBytes" bytes at "p", eight bytes
+//	at a time: the CRC of eight bytes is the XOR of what each of them
+//	contributes, which is in the table for how far from the end it is.
+//----------------------------------------------------------------------
+
+static unsigned int
+SoftwareCrc(unsigned int crc, unsigned char *p, int numBytes)
+{
+    for (; numBytes >= 8; p += 8, numBytes -= 8) {
+	crc ^= p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+	crc = table[7][crc & 0xff] ^ table[6][(crc >> 8) & 0xff]
+	    ^ table[5][(crc >> 16) & 0xff] ^ table[4][crc >> 24]
+	    ^ table[3][p[4]] ^ table[2][p[5]] ^ table[1][p[6]] ^ table[0][p[7]];
+    }
+    for (; numBytes > 0; p++, numBytes--)
+	crc = (crc >> 8) ^ table[0][(crc ^ *p) & 0xff];
+    return crc;
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+
+//----------------------------------------------------------------------
+// HardwareCrc
+// 	Continue the CRC "crc" over "numBytes" bytes at "p", with the
+//	SSE4.2 crc32 instruction, a word at a time.  Compiled for SSE4.2
+//	whatever the rest of Nachos is compiled for, so only call it if
+//	the host has it.
+//----------------------------------------------------------------------
+
+__attribute__((target("sse4.2"))) static unsigned int
+HardwareCrc(unsigned int crc, unsigned char *p, int numBytes)
+{
+#ifdef __x86_64__
+    unsigned long long crc64 = crc, word64;
+
+    for (; numBytes >= 8; p += 8, numBytes -= 8) {
+	memcpy(&word64, p, 8);
+	crc64 = _mm_crc32_u64(crc64, word64);
+    }
+    crc = (unsigned int) crc64;
+#endif
+    unsigned int word;
+
+    for (; numBytes >= 4; p += 4, numBytes -= 4) {
+	memcpy(&word, p, 4);
+	crc = _mm_crc32_u32(crc, word);
+    }
+    for (; numBytes > 0; p++, numBytes--)
+	crc = _mm_crc32_u8(crc, *p);
+    return crc;
+}
+
+#endif
+
+//----------------------------------------------------------------------
+// Crc32cHardware
+// 	Return whether the SSE4.2 instruction is used: if the host has
+//	it, and it gets the right answer for the standard check string.
+//	The tables are made in any case, so the answers can be compared.
+//----------------------------------------------------------------------
+
+bool
+Crc32cHardware()
+{
+    if (useHardware == -1) {
+	MakeTables();
+	ASSERT(~SoftwareCrc(~0u, (unsigned char *)"123456789", 9)
+	       == CheckValue);
+	useHardware = 0;
+#if defined(__i386__) || defined(__x86_64__)
+	if (__builtin_cpu_supports("sse4.2")
+	    && ~HardwareCrc(~0u, (unsigned char *)"123456789", 9)
+	       == CheckValue)
+	    useHardware = 1;
+#endif
+    }
+    return useHardware == 1;
+}
+
+//----------------------------------------------------------------------
+// Crc32c
+// 	Return the CRC-32C of a block of bytes.
+//
+//	"data" -- the bytes to check
+//	"numBytes" -- how many there are
+//----------------------------------------------------------------------
+
+unsigned int
+Crc32c(char *data, int numBytes)
+{
+    unsigned char *p = (unsigned char *)data;
+
+#if defined(__i386__) || defined(__x86_64__)
+    if (Crc32cHardware())
+	return ~HardwareCrc(~0u, p, numBytes);
+#else
+    (void) Crc32cHardware();
+#endif
+    return ~SoftwareCrc(~0u, p, numBytes);
+}
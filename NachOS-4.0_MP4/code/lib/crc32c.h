@@ -0,0 +1,27 @@
+// crc32c.h
+//	Routine to compute the CRC-32C (Castagnoli) checksum of a block of
+//	bytes, the CRC used by iSCSI, SCTP and ext4 to catch damaged data.
+//
+//	x86 processors since SSE4.2 have an instruction for this CRC, which
+//	does four (or, on x86-64, eight) bytes at once; if the host has it,
+//	it is used, otherwise the bytes are done eight at a time with tables
+//	("slicing-by-8").  Both give the same checksums.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include "copyright.h"
+
+// Return the CRC-32C of the "numBytes" bytes at "data".
+
+extern unsigned int Crc32c(char *data, int numBytes);
+
+// Return whether Crc32c is using the SSE4.2 instruction.
+
+extern bool Crc32cHardware();
+
+#endif // CRC32C_H
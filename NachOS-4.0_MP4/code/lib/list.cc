@@ -33,6 +33,34 @@ ListElement<T>::ListElement(T itm)
 }
 
 
+//----------------------------------------------------------------------
+// ListElement<T>::operator new, ListElement<T>::operator delete
+// 	An element is made for every item put on a list, and thrown away
+//	when it comes off, so elements come from a cache instead of from
+//	the heap.
+//----------------------------------------------------------------------
+
+template <class T>
+ObjectCache *ListElement<T>::cache = NULL;
+
+template <class T>
+void *
+ListElement<T>::operator new(size_t size)
+{
+    ASSERT(size == sizeof(ListElement<T>));
+    if (cache == NULL)
+	cache = ObjectCache::Find("ListElement", sizeof(ListElement<T>));
+    return cache->Alloc();
+}
+
+template <class T>
+void
+ListElement<T>::operator delete(void *element)
+{
+    if (element != NULL)
+	cache->Free(element);
+}
+
 //----------------------------------------------------------------------
 // List<T>::List
 //	Initialize a list, empty to start with.
@@ -59,6 +87,29 @@ List<T>::~List()
 { 
 }
 
+//----------------------------------------------------------------------
+// List<T>::operator new, List<T>::operator delete
+//	Every semaphore has a list of its waiting threads, and one is
+//	made for each disk transfer, so lists are kept in the buffer
+//	pool.  A SortedList is bigger than a List; the destructor is
+//	virtual, so delete is given the size of the one being freed.
+//----------------------------------------------------------------------
+
+template <class T>
+void *
+List<T>::operator new(size_t size)
+{
+    return AllocBuffer(size);
+}
+
+template <class T>
+void
+List<T>::operator delete(void *list, size_t size)
+{
+    if (list != NULL)
+	FreeBuffer((char *) list, size);
+}
+
 //----------------------------------------------------------------------
 // List<T>::Append
 //      Append an "item" to the end of the list.
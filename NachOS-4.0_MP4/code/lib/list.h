@@ -15,6 +15,7 @@
 
 #include "copyright.h"
 #include "debug.h"
+#include "slab.h"
 
 // The following class defines a "list element" -- which is
 // used to keep track of one item on a list.  It is equivalent to a
@@ -30,6 +31,13 @@ class ListElement {
     ListElement(T itm); 	// initialize a list element
     ListElement *next;	     	// next element on list, NULL if this is last
     T item; 	   	     	// item on the list
+
+    void *operator new(size_t size);	// list elements are kept in
+    void operator delete(void *element);//  a slab cache (slab.h)
+
+  private:
+    static ObjectCache *cache;	// the cache (shared by the lists
+				//  of items of the same size)
 };
 
 // The following class defines a "list" -- a singly linked list of
@@ -46,6 +54,10 @@ class List {
     List();			// initialize the list
     virtual ~List();		// de-allocate the list
 
+    void *operator new(size_t size);	// lists come from the buffer
+    void operator delete(void *list, size_t size);
+				//  pool (slab.h), by size
+
     virtual void Prepend(T item);// Put item at the beginning of the list
     virtual void Append(T item); // Put item at the end of the list
 
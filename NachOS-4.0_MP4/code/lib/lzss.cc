@@ -0,0 +1,161 @@
+// lzss.cc
+//	Routines to compress and expand blocks of bytes.  See lzss.h
+//	for the format.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "debug.h"
+#include "lzss.h"
+
+static const int HashSize = 4096; // entries in the table of places seen
+
+//----------------------------------------------------------------------
+// Hash
+// 	Hash the MinMatch bytes starting at "p" into the table of places.
+//----------------------------------------------------------------------
+
+static int
+Hash(unsigned char *p)
+{
+    return ((p[0] << 7) ^ (p[1] << 4) ^ p[2] ^ (p[0] >> 3)) & (HashSize - 1);
+}
+
+//----------------------------------------------------------------------
+// LzCompress
+// 	Compress a block of bytes.  At each place, look up the last place
+//	the next MinMatch bytes were seen; if that is close enough, and
+//	the bytes there really match, emit a match as long as they go on
+//	matching, otherwise emit one byte as it is.
+//
+//	"from" -- the bytes to compress
+//	"numBytes" -- how many there are
+//	"into" -- where to put the compressed bytes
+//	"room" -- how many bytes there is room for at "into"
+//----------------------------------------------------------------------
+
+int
+LzCompress(char *from, int numBytes, char *into, int room)
+{
+    unsigned char *in = (unsigned char *)from;
+    int last[HashSize]; // where each hash was last seen
+    int at = 0, out = 0;
+
+    for (int i = 0; i < HashSize; i++)
+    {
+        last[i] = -1;
+    }
+    while (at < numBytes)
+    {
+        int flagsAt = out++, flags = 0;
+
+        for (int bit = 0; bit < 8 && at < numBytes; bit++)
+        {
+            int length = 0, match = -1;
+
+            if (at + MinMatch <= numBytes)
+            {
+                int hash = Hash(in + at);
+
+                match = last[hash];
+                last[hash] = at;
+                if (match >= 0 && at - match <= MaxOffset)
+                {
+                    int longest = min(MaxMatch, numBytes - at);
+                    while (length < longest && in[match + length] == in[at + length])
+                    {
+                        length++;
+                    }
+                }
+            }
+            if (length >= MinMatch)
+            {
+                int item = ((length - MinMatch) << 10) | (at - match - 1);
+
+                if (out + 2 > room)
+                {
+                    return -1;
+                }
+                into[out++] = item & 0xff;
+                into[out++] = item >> 8;
+                flags |= 1 << bit;
+                // remember the places inside the match too
+                for (int i = 1; i < length && at + i + MinMatch <= numBytes; i++)
+                {
+                    last[Hash(in + at + i)] = at + i;
+                }
+                at += length;
+            }
+            else
+            {
+                if (out + 1 > room)
+                {
+                    return -1;
+                }
+                into[out++] = in[at++];
+            }
+        }
+        into[flagsAt] = flags; // (the items' checks cover its room)
+    }
+    return out;
+}
+
+//----------------------------------------------------------------------
+// LzExpand
+// 	Expand a block compressed by LzCompress.  A match may overlap the
+//	bytes it is producing (a run of one byte is a match one byte back),
+//	so it is copied a byte at a time.
+//
+//	"from" -- the compressed bytes
+//	"numBytes" -- how many there are
+//	"into" -- where to put the expanded bytes
+//	"room" -- how many bytes there is room for at "into"
+//----------------------------------------------------------------------
+
+int
+LzExpand(char *from, int numBytes, char *into, int room)
+{
+    unsigned char *in = (unsigned char *)from;
+    int at = 0, out = 0;
+
+    while (at < numBytes)
+    {
+        int flags = in[at++];
+
+        for (int bit = 0; bit < 8 && at < numBytes; bit++)
+        {
+            if (flags & (1 << bit))
+            {
+                int item, offset, length;
+
+                if (at + 2 > numBytes)
+                {
+                    return -1;
+                }
+                item = in[at] | (in[at + 1] << 8);
+                at += 2;
+                offset = (item & (MaxOffset - 1)) + 1;
+                length = (item >> 10) + MinMatch;
+                if (offset > out || out + length > room)
+                {
+                    return -1;
+                }
+                for (int i = 0; i < length; i++, out++)
+                {
+                    into[out] = into[out - offset];
+                }
+            }
+            else
+            {
+                if (out + 1 > room)
+                {
+                    return -1;
+                }
+                into[out++] = in[at++];
+            }
+        }
+    }
+    return out;
+}
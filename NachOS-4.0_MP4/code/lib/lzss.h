@@ -0,0 +1,43 @@
+// lzss.h
+//	Routines to compress and expand a block of bytes, with the LZSS
+//	variant of Lempel-Ziv compression (as used, for instance, for the
+//	compressed files of several PC file systems).
+//
+//	The compressed form is a series of groups: a byte of flags, then
+//	eight items, one for each flag, starting at the low bit.  An item
+//	whose flag is clear is one byte to copy as it is; one whose flag
+//	is set is a "match", two bytes (low byte first) giving how many
+//	bytes to copy (MinMatch to MaxMatch), from how far back (1 to
+//	MaxOffset) in what has already been expanded.  The last group
+//	may have fewer than eight items.
+//
+//	Matches are found with a table of the last place each hash of
+//	MinMatch bytes was seen; this finds most of what a full search
+//	would, for much less work.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef LZSS_H
+#define LZSS_H
+
+#include "copyright.h"
+
+const int MinMatch = 3;                // shortest match worth encoding
+const int MaxMatch = MinMatch + 63;    // longest match (6 bits of length)
+const int MaxOffset = 1024;            // farthest back (10 bits of offset)
+
+// Compress the "numBytes" bytes at "from" into "into", which has room
+// for "room" bytes.  Return the compressed size, or -1 if it would not
+// fit in "room".
+
+extern int LzCompress(char *from, int numBytes, char *into, int room);
+
+// Expand the "numBytes" compressed bytes at "from" into "into", which
+// has room for "room" bytes.  Return the expanded size, or -1 if the
+// compressed bytes are corrupt or expand to more than "room".
+
+extern int LzExpand(char *from, int numBytes, char *into, int room);
+
+#endif // LZSS_H
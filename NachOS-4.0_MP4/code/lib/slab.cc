@@ -0,0 +1,255 @@
+// slab.cc
+//	Routines to manage object caches, and the pool of buffers
+//	built from them.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "debug.h"
+#include "slab.h"
+
+ObjectCache *ObjectCache::caches = NULL;
+
+//----------------------------------------------------------------------
+// ObjectCache::ObjectCache
+// 	Initialize an empty cache of objects of one size.  Slabs are only
+//	got from the heap once objects are asked for.
+//
+//	"name" is what the cache holds, for printing statistics.
+//	"size" is the number of bytes in each object.
+//----------------------------------------------------------------------
+
+ObjectCache::ObjectCache(char *name, int size)
+{
+    ASSERT(size > 0);
+
+    this->name = name;
+    objectSize = divRoundUp(size, SlabAlign) * SlabAlign;
+    perSlab = (SlabSize - SlabAlign) / objectSize;
+    if (perSlab == 0)
+    {
+        perSlab = 1; // a big object gets a slab of its own
+    }
+    freeList = NULL;
+    slabs = NULL;
+    numSlabs = numAllocs = numInUse = maxInUse = 0;
+
+    nextCache = caches;
+    caches = this;
+}
+
+//----------------------------------------------------------------------
+// ObjectCache::~ObjectCache
+// 	Give all the slabs back to the heap.  Every object must have been
+//	freed already.
+//----------------------------------------------------------------------
+
+ObjectCache::~ObjectCache()
+{
+    ObjectCache **prev;
+
+    ASSERT(numInUse == 0);
+    while (slabs != NULL)
+    {
+        char *slab = (char *)slabs;
+        slabs = *(void **)slab;
+        delete[] slab;
+    }
+    for (prev = &caches; *prev != this; prev = &(*prev)->nextCache)
+        ;
+    *prev = nextCache;
+}
+
+//----------------------------------------------------------------------
+// ObjectCache::Grow
+// 	Get another slab from the heap, and put each of its objects on
+//	the free list.  The first SlabAlign bytes of the slab link it
+//	to the other slabs, so that they can be freed.
+//----------------------------------------------------------------------
+
+void ObjectCache::Grow()
+{
+    char *slab = new char[SlabAlign + perSlab * objectSize];
+
+    *(void **)slab = slabs;
+    slabs = slab;
+    numSlabs++;
+    for (int i = perSlab - 1; i >= 0; i--)
+    {
+        void *object = slab + SlabAlign + i * objectSize;
+        *(void **)object = freeList;
+        freeList = object;
+    }
+}
+
+//----------------------------------------------------------------------
+// ObjectCache::Alloc
+// 	Return an object off the free list, getting another slab first
+//	if it is empty.  The object's contents are left over from its
+//	last use.
+//----------------------------------------------------------------------
+
+void *ObjectCache::Alloc()
+{
+    void *object;
+
+    if (freeList == NULL)
+    {
+        Grow();
+    }
+    object = freeList;
+    freeList = *(void **)object;
+    numAllocs++;
+    if (++numInUse > maxInUse)
+    {
+        maxInUse = numInUse;
+    }
+    return object;
+}
+
+//----------------------------------------------------------------------
+// ObjectCache::Free
+// 	Put an object back on the free list, for the next Alloc.
+//
+//	"object" must have come from this cache.
+//----------------------------------------------------------------------
+
+void ObjectCache::Free(void *object)
+{
+    ASSERT(object != NULL && numInUse > 0);
+
+    *(void **)object = freeList;
+    freeList = object;
+    numInUse--;
+}
+
+//----------------------------------------------------------------------
+// ObjectCache::Find
+// 	Return the cache with this name, of objects of this size, or make
+//	one.  This lets the kinds of object that share a name -- the list
+//	elements of different lists, say -- share a cache if they are of
+//	the same size.
+//
+//	"name" is what the cache holds.
+//	"size" is the number of bytes in each object.
+//----------------------------------------------------------------------
+
+ObjectCache *
+ObjectCache::Find(char *name, int size)
+{
+    int objectSize = divRoundUp(size, SlabAlign) * SlabAlign;
+
+    for (ObjectCache *cache = caches; cache != NULL; cache = cache->nextCache)
+    {
+        if (cache->objectSize == objectSize && strcmp(cache->name, name) == 0)
+        {
+            return cache;
+        }
+    }
+    return new ObjectCache(name, size);
+}
+
+//----------------------------------------------------------------------
+// ObjectCache::Print
+// 	Print how much the cache has been used: how many objects were
+//	asked for, against how many times it had to go to the heap.
+//----------------------------------------------------------------------
+
+void ObjectCache::Print()
+{
+    cout << "  " << name << " (" << objectSize << " bytes): allocs ";
+    cout << numAllocs << ", in use " << numInUse << ", most " << maxInUse;
+    cout << ", slabs " << numSlabs << "\n";
+}
+
+//----------------------------------------------------------------------
+// ObjectCache::PrintAll
+// 	Print the statistics of every cache that has been used.
+//----------------------------------------------------------------------
+
+void ObjectCache::PrintAll()
+{
+    cout << "Slab caches:\n";
+    for (ObjectCache *cache = caches; cache != NULL; cache = cache->nextCache)
+    {
+        if (cache->numAllocs > 0)
+        {
+            cache->Print();
+        }
+    }
+}
+
+// The buffer pool: one cache for each power of two from MinBufferSize
+// to MaxBufferSize, made when first needed.
+
+static const int NumBufferSizes = 13; // log2(MaxBufferSize / MinBufferSize) + 1
+static ObjectCache *bufferCaches[NumBufferSizes];
+
+//----------------------------------------------------------------------
+// BufferCache
+// 	Return the cache for buffers of "size" bytes, or NULL if they are
+//	too big to be pooled.
+//----------------------------------------------------------------------
+
+static ObjectCache *
+BufferCache(int size)
+{
+    int which = 0;
+
+    if (size > MaxBufferSize)
+    {
+        return NULL;
+    }
+    while ((MinBufferSize << which) < size)
+    {
+        which++;
+    }
+    if (bufferCaches[which] == NULL)
+    {
+        bufferCaches[which] =
+            new ObjectCache("buffer", MinBufferSize << which);
+    }
+    return bufferCaches[which];
+}
+
+//----------------------------------------------------------------------
+// AllocBuffer
+// 	Return a buffer of at least "size" bytes.  Like new, this does not
+//	clear it.
+//----------------------------------------------------------------------
+
+char *
+AllocBuffer(int size)
+{
+    ObjectCache *cache = BufferCache(size);
+
+    ASSERT(size > 0);
+    if (cache == NULL)
+    {
+        return new char[size];
+    }
+    return (char *)cache->Alloc();
+}
+
+//----------------------------------------------------------------------
+// FreeBuffer
+// 	Give back a buffer from AllocBuffer.
+//
+//	"size" is the size it was asked for with.
+//----------------------------------------------------------------------
+
+void FreeBuffer(char *buffer, int size)
+{
+    ObjectCache *cache = BufferCache(size);
+
+    if (cache == NULL)
+    {
+        delete[] buffer;
+    }
+    else
+    {
+        cache->Free(buffer);
+    }
+}
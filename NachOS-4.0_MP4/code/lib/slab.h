@@ -0,0 +1,85 @@
+// slab.h
+//	Data structures for a slab allocator -- caches of small kernel
+//	objects of one size, and a pool of buffers of a few sizes.
+//
+//	The kernel news and deletes the same few kinds of object over
+//	and over: file headers, open files, list elements, pending
+//	interrupts, and a buffer of a few sectors for every read or write.
+//	Rather than go to the host's heap each time, each kind of object
+//	gets an "object cache".  The cache carves its objects out of
+//	larger "slabs" that it gets from the heap; an object that is
+//	deleted goes on the cache's free list, and is handed out again
+//	by the next new.  Slabs are never given back, so a cache only
+//	grows to the most objects of its kind that were in use at once.
+//
+//	A class uses a cache by defining its own operator new and
+//	operator delete to call Alloc and Free.  Buffers come from
+//	AllocBuffer, and go back through FreeBuffer with the same size;
+//	sizes are rounded up to a power of two, with a cache for each,
+//	and buffers bigger than the largest of these come from the heap.
+//
+//	Nachos threads only switch when interrupts are re-enabled, and
+//	Alloc and Free never enable them, so the caches need no lock.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "copyright.h"
+#include "utility.h"
+
+const int SlabSize = 4096;      // bytes got from the heap at a time
+const int SlabAlign = 8;        // objects are aligned to this many bytes
+const int MinBufferSize = 16;   // smallest buffer size kept in the pool
+const int MaxBufferSize = 65536; // largest (a 512K-sector bitmap)
+
+// The following class defines an "object cache" -- a free list of
+// objects of one size, carved out of slabs.  "Alloc" and "Free" take
+// a few instructions, unless the free list is empty, when Alloc gets
+// another slab from the heap.
+
+class ObjectCache
+{
+public:
+    ObjectCache(char *name, int size); // Initialize an empty cache
+                                       // of "size"-byte objects
+    ~ObjectCache();                    // Give the slabs back to the heap
+
+    void *Alloc();           // Return a free object
+    void Free(void *object); // Put "object" back on the free list
+
+    static ObjectCache *Find(char *name, int size);
+                          // Return the cache of "size"-byte objects
+                          // called "name", making it if need be
+
+    void Print();         // Print how much the cache was used
+    static void PrintAll(); // ... for every cache there is
+
+private:
+    void Grow(); // Get another slab, and free its objects
+
+    char *name;      // what is kept in the cache, for Print
+    int objectSize;  // bytes per object, rounded up to SlabAlign
+    int perSlab;     // objects in each slab
+    void *freeList;  // free objects, each pointing at the next
+    void *slabs;     // slabs got from the heap, each pointing at
+                     // the next from its first word
+    int numSlabs;    // number of slabs
+    int numAllocs;   // calls to Alloc
+    int numInUse;    // objects handed out and not yet freed
+    int maxInUse;    // the most there have been at once
+
+    ObjectCache *nextCache;      // next cache, for PrintAll
+    static ObjectCache *caches;  // every cache, for PrintAll
+};
+
+// Buffers of any size, pooled by size.  FreeBuffer must be given the
+// size that the buffer was allocated with.
+
+extern char *AllocBuffer(int size);
+extern void FreeBuffer(char *buffer, int size);
+
+#endif // SLAB_H
@@ -33,6 +33,7 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <cerrno>
+#include <pthread.h>
 
 #ifdef SOLARIS
 // KMS
@@ -149,6 +150,22 @@ UDelay(unsigned int useconds)
 
 }
 
+//----------------------------------------------------------------------
+// HostTime
+// 	Return the wall-clock time of the UNIX process running Nachos,
+//	in microseconds.  This has nothing to do with simulated time;
+//	it is used to measure how long the simulator spends doing things.
+//----------------------------------------------------------------------
+
+double
+HostTime()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000.0 + tv.tv_usec;
+}
+
 //----------------------------------------------------------------------
 // Abort
 // 	Quit and drop core.
@@ -330,6 +347,23 @@ OpenForReadWrite(char *name, bool crashOnError)
     return fd;
 }
 
+//----------------------------------------------------------------------
+// OpenForReadOnly
+// 	Open a file for reading only.
+//	Return the file descriptor, or error if it doesn't exist.
+//
+//	"name" -- file name
+//----------------------------------------------------------------------
+
+int
+OpenForReadOnly(char *name, bool crashOnError)
+{
+    int fd = open(name, O_RDONLY, 0);
+
+    ASSERT(!crashOnError || fd >= 0);
+    return fd;
+}
+
 //----------------------------------------------------------------------
 // Read
 // 	Read characters from an open file.  Abort if read fails.
@@ -420,6 +454,140 @@ Unlink(char *name)
     return unlink(name);
 }
 
+//----------------------------------------------------------------------
+// ReadAsync, WriteAsync, WaitAsync, FlushAsync
+// 	Read/write part of an open file, at a given offset, in the
+//	background.  The I/O is done by a helper thread (started the
+//	first time it is needed), in the order it was asked for, so a
+//	read always sees the data of earlier writes.  The caller can go
+//	on while the host does the I/O.  Abort if the read/write fails.
+//
+//	ReadAsync returns a handle to pass to WaitAsync; the caller must
+//	not touch the buffer until WaitAsync says the read is done.
+//	WriteAsync copies the data, so there is nothing to wait for;
+//	FlushAsync waits until every write so far is done (call it
+//	before closing the file).
+//----------------------------------------------------------------------
+
+struct AsyncRequest {
+    int fd;
+    char *buffer;
+    int nBytes;
+    int offset;
+    bool writing;
+    bool done;
+    AsyncRequest *next;
+};
+
+static pthread_mutex_t asyncLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t asyncWork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t asyncDone = PTHREAD_COND_INITIALIZER;
+static AsyncRequest *asyncFirst = NULL, *asyncLast = NULL;
+static int asyncPending = 0;		// requests queued or in progress
+static bool asyncStarted = FALSE;
+
+static void *
+AsyncHelper(void *unused)
+{
+    pthread_mutex_lock(&asyncLock);
+    for (;;) {
+	while (asyncFirst == NULL)
+	    pthread_cond_wait(&asyncWork, &asyncLock);
+	AsyncRequest *request = asyncFirst;
+	asyncFirst = request->next;
+	if (asyncFirst == NULL)
+	    asyncLast = NULL;
+	pthread_mutex_unlock(&asyncLock);
+
+	int retVal;
+	if (request->writing)
+	    retVal = pwrite(request->fd, request->buffer, request->nBytes,
+			    request->offset);
+	else
+	    retVal = pread(request->fd, request->buffer, request->nBytes,
+			   request->offset);
+	ASSERT(retVal == request->nBytes);
+
+	pthread_mutex_lock(&asyncLock);
+	asyncPending--;
+	if (request->writing) {		// nobody waits for writes
+	    delete [] request->buffer;
+	    delete request;
+	} else
+	    request->done = TRUE;
+	pthread_cond_broadcast(&asyncDone);
+    }
+    return NULL;
+}
+
+static AsyncRequest *
+StartAsync(int fd, char *buffer, int nBytes, int offset, bool writing)
+{
+    AsyncRequest *request = new AsyncRequest;
+
+    request->fd = fd;
+    request->buffer = buffer;
+    request->nBytes = nBytes;
+    request->offset = offset;
+    request->writing = writing;
+    request->done = FALSE;
+    request->next = NULL;
+
+    pthread_mutex_lock(&asyncLock);
+    if (!asyncStarted) {
+	pthread_t helper;
+	int retVal = pthread_create(&helper, NULL, AsyncHelper, NULL);
+	ASSERT(retVal == 0);
+	pthread_detach(helper);
+	asyncStarted = TRUE;
+    }
+    if (asyncLast == NULL)
+	asyncFirst = request;
+    else
+	asyncLast->next = request;
+    asyncLast = request;
+    asyncPending++;
+    pthread_cond_signal(&asyncWork);
+    pthread_mutex_unlock(&asyncLock);
+    return request;
+}
+
+void *
+ReadAsync(int fd, char *buffer, int nBytes, int offset)
+{
+    return StartAsync(fd, buffer, nBytes, offset, FALSE);
+}
+
+void
+WriteAsync(int fd, char *buffer, int nBytes, int offset)
+{
+    char *copy = new char[nBytes];
+
+    bcopy(buffer, copy, nBytes);
+    StartAsync(fd, copy, nBytes, offset, TRUE);
+}
+
+void
+WaitAsync(void *handle)
+{
+    AsyncRequest *request = (AsyncRequest *)handle;
+
+    pthread_mutex_lock(&asyncLock);
+    while (!request->done)
+	pthread_cond_wait(&asyncDone, &asyncLock);
+    pthread_mutex_unlock(&asyncLock);
+    delete request;
+}
+
+void
+FlushAsync()
+{
+    pthread_mutex_lock(&asyncLock);
+    while (asyncPending > 0)
+	pthread_cond_wait(&asyncDone, &asyncLock);
+    pthread_mutex_unlock(&asyncLock);
+}
+
 //----------------------------------------------------------------------
 // OpenSocket
 // 	Open an interprocess communication (IPC) connection.  For now, 
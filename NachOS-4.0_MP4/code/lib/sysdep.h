@@ -25,6 +25,9 @@ extern void Exit(int exitCode);
 extern void Delay(int seconds);
 extern void UDelay(unsigned int usec);// rcgood - to avoid spinners.
 
+// Host wall-clock time in microseconds, for measuring the simulator itself
+extern double HostTime();
+
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(void (*cleanup)(int));
 
@@ -45,6 +48,7 @@ extern bool PollFile(int fd);
 // For simulating the disk and the console devices.
 extern int OpenForWrite(char *name);
 extern int OpenForReadWrite(char *name, bool crashOnError);
+extern int OpenForReadOnly(char *name, bool crashOnError);
 extern void Read(int fd, char *buffer, int nBytes);
 extern int ReadPartial(int fd, char *buffer, int nBytes);
 extern void WriteFile(int fd, char *buffer, int nBytes);
@@ -53,6 +57,12 @@ extern int Tell(int fd);
 extern int Close(int fd);
 extern bool Unlink(char *name);
 
+// Read/write at an offset in the background; wait for it to finish
+extern void *ReadAsync(int fd, char *buffer, int nBytes, int offset);
+extern void WriteAsync(int fd, char *buffer, int nBytes, int offset);
+extern void WaitAsync(void *handle);
+extern void FlushAsync();
+
 // Other C library routines that are used by Nachos.
 // These are assumed to be portable, so we don't include a wrapper.
 extern "C" {
@@ -0,0 +1,178 @@
+// cache.cc
+//	Routines to emulate the caches between the CPU and main memory.
+//	See cache.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "cache.h"
+#include "debug.h"
+#include "sysdep.h"
+
+//----------------------------------------------------------------------
+// CacheCounts::CacheCounts
+// 	Initialize the counts to zero, when a program starts (or, for
+//	the totals, when Nachos starts).
+//----------------------------------------------------------------------
+
+CacheCounts::CacheCounts()
+{
+    for (int i = 0; i < NumCacheLevels; i++)
+	accesses[i] = misses[i] = 0;
+    stallTicks = 0;
+}
+
+//----------------------------------------------------------------------
+// CacheCounts::Print
+// 	Print how many references each cache got, and how many of them
+//	hit and missed.  Caches that got none (because there is no level
+//	2 cache) are left out.
+//
+//	"who" -- the program the counts are for
+//----------------------------------------------------------------------
+
+void
+CacheCounts::Print(char *who)
+{
+    static char *names[] = { "L1I", "L1D", "L2" };
+
+    cout << "Caches (" << who << "):\n";
+    for (int i = 0; i < NumCacheLevels; i++) {
+	if (accesses[i] == 0)
+	    continue;
+	cout << "  " << names[i] << ": references " << accesses[i];
+	cout << ", hits " << accesses[i] - misses[i];
+	cout << ", misses " << misses[i];
+	cout << ", miss rate " << 100.0 * misses[i] / accesses[i] << "%\n";
+    }
+    cout << "  stall ticks " << stallTicks << "\n";
+}
+
+//----------------------------------------------------------------------
+// Cache::Cache
+// 	Initialize an empty cache.
+//
+//	"name" -- for debugging
+//	"size" -- bytes of data the cache holds
+//	"assoc" -- lines per set; size / lineSize for a fully
+//		associative cache
+//	"lineSize" -- bytes per line
+//	"policy" -- which line of a set to replace on a miss
+//----------------------------------------------------------------------
+
+Cache::Cache(char *name, int size, int assoc, int lineSize,
+	     ReplacementPolicy policy)
+{
+    ASSERT(size > 0 && assoc > 0 && lineSize > 0);
+    ASSERT(size % (assoc * lineSize) == 0);
+
+    this->name = name;
+    this->size = size;
+    this->assoc = assoc;
+    this->lineSize = lineSize;
+    this->policy = policy;
+    numSets = size / (assoc * lineSize);
+    tags = new unsigned int[numSets * assoc];
+    valid = new bool[numSets * assoc];
+    stamps = new unsigned int[numSets * assoc];
+    for (int i = 0; i < numSets * assoc; i++) {
+	valid[i] = FALSE;
+	stamps[i] = 0;
+    }
+    clock = 0;
+    DEBUG(dbgMach, "Cache " << name << ": " << size << " bytes, " << assoc
+	  << "-way, " << lineSize << "-byte lines, " << numSets << " sets");
+}
+
+//----------------------------------------------------------------------
+// Cache::~Cache
+// 	Deallocate the cache.
+//----------------------------------------------------------------------
+
+Cache::~Cache()
+{
+    delete [] tags;
+    delete [] valid;
+    delete [] stamps;
+}
+
+//----------------------------------------------------------------------
+// Cache::Parse
+// 	Create the cache a "-l1i", "-l1d" or "-l2" flag describes:
+//	"size,assoc,lineSize" in bytes, optionally followed by ",lru",
+//	",fifo" or ",random" (LRU if not).  "0" means no cache at all;
+//	return NULL.
+//
+//	"name" -- for debugging
+//	"spec" -- the flag's argument
+//----------------------------------------------------------------------
+
+Cache *
+Cache::Parse(char *name, char *spec)
+{
+    int size, assoc, lineSize;
+    char policyName[8];
+    ReplacementPolicy policy = LRUReplacement;
+    int numFields;
+
+    if (strcmp(spec, "0") == 0)
+	return NULL;
+    numFields = sscanf(spec, "%d,%d,%d,%7s", &size, &assoc, &lineSize,
+		       policyName);
+    ASSERT(numFields >= 3);
+    if (numFields == 4) {
+	if (strcmp(policyName, "fifo") == 0)
+	    policy = FIFOReplacement;
+	else if (strcmp(policyName, "random") == 0)
+	    policy = RandomReplacement;
+	else
+	    ASSERT(strcmp(policyName, "lru") == 0);
+    }
+    return new Cache(name, size, assoc, lineSize, policy);
+}
+
+//----------------------------------------------------------------------
+// Cache::Access
+// 	Reference the byte at physical address "physAddr".  Look for its
+//	line in the one set it can be in; if it isn't there, load it into
+//	an empty way of the set, or else replace the way the policy picks.
+//	Return TRUE if the line was there (a hit).
+//----------------------------------------------------------------------
+
+bool
+Cache::Access(unsigned int physAddr)
+{
+    unsigned int line = physAddr / lineSize;
+    int first = (line % numSets) * assoc;	// the set's first way
+    int victim = first;
+
+    clock++;
+    for (int i = first; i < first + assoc; i++) {
+	if (valid[i] && tags[i] == line) {
+	    if (policy == LRUReplacement)
+		stamps[i] = clock;
+	    return TRUE;
+	}
+    }
+
+    // a miss: use an empty way if there is one, or else the oldest
+    // (or any, for random)
+    for (int i = first; i < first + assoc; i++) {
+	if (!valid[i]) {
+	    victim = i;
+	    break;
+	}
+	if (stamps[i] < stamps[victim])
+	    victim = i;
+    }
+    if (valid[victim] && policy == RandomReplacement)
+	victim = first + RandomNumber() % assoc;
+    DEBUG(dbgMach, "Cache " << name << " miss at " << physAddr
+	  << ", way " << victim - first);
+    tags[victim] = line;
+    valid[victim] = TRUE;
+    stamps[victim] = clock;
+    return FALSE;
+}
@@ -0,0 +1,94 @@
+// cache.h
+//	Data structures to emulate the caches between the CPU and main
+//	memory, so that user programs are charged for where their memory
+//	references go, not just for how many instructions they execute.
+//
+//	The hierarchy is a split level 1 -- one cache for instruction
+//	fetches, one for loads and stores -- backed by a unified level 2
+//	cache (optional), backed by main memory.  Each cache is set
+//	associative, with its own size, associativity, line size and
+//	replacement policy.  The caches are indexed by physical address,
+//	and hold tags only: the data is always read from and written to
+//	"mainMemory", so the caches only affect timing.
+//
+//	A reference that hits in level 1 costs nothing beyond the
+//	instruction's tick.  A miss costs L2Time ticks if the line is in
+//	the level 2 cache, and MemoryTime ticks more if it isn't (see
+//	stats.h).  A store that misses loads the line, like a load does
+//	(write allocate); dirty lines are written back to memory through a
+//	write buffer, for free.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "copyright.h"
+
+// The caches of the hierarchy, in the order of the "-l1i", "-l1d" and
+// "-l2" flags (see main.cc).
+
+enum CacheLevel { L1ICache, L1DCache, L2Cache, NumCacheLevels };
+
+// Which line of a set to replace on a miss.
+
+enum ReplacementPolicy {
+    LRUReplacement,			// the one used longest ago
+    FIFOReplacement,			// the one loaded longest ago
+    RandomReplacement			// any one
+};
+
+// The following class counts the references to each cache and how
+// many missed, for one user program (see AddrSpace) or for all of
+// them (see Statistics).
+
+class CacheCounts {
+  public:
+    CacheCounts();			// Initialize the counts to zero
+
+    int accesses[NumCacheLevels];	// references to each cache
+    int misses[NumCacheLevels];		// how many of them missed
+    int stallTicks;			// time spent waiting for the
+					// misses to be filled
+
+    void Print(char *who);		// Print the hit and miss rates
+};
+
+// The following class defines one set associative cache.
+
+class Cache {
+  public:
+    Cache(char *name, int size, int assoc, int lineSize,
+	  ReplacementPolicy policy);
+    					// Create an empty cache of "size"
+					// bytes, with "assoc" lines of
+					// "lineSize" bytes per set
+    ~Cache();				// Deallocate the cache
+
+    static Cache *Parse(char *name, char *spec);
+    					// Create a cache described as
+					// "size,assoc,lineSize[,policy]";
+					// NULL if "spec" is "0"
+
+    bool Access(unsigned int physAddr);	// Reference the byte at
+					// "physAddr": TRUE if it hit; if
+					// not, load its line
+
+  private:
+    char *name;				// for printing
+    int size;				// bytes of data held
+    int assoc;				// lines per set
+    int lineSize;			// bytes per line
+    int numSets;
+    ReplacementPolicy policy;
+    unsigned int *tags;			// line number held by each way of
+					// each set (numSets * assoc)
+    bool *valid;			// does the way hold a line?
+    unsigned int *stamps;		// when each way was last used (LRU)
+					// or loaded (FIFO)
+    unsigned int clock;			// references so far, for stamps
+};
+
+#endif // CACHE_H
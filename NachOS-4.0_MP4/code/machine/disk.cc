@@ -7,6 +7,13 @@
 //	Disk operations are asynchronous, so we have to invoke an interrupt
 //	handler when the simulated operation completes.
 //
+//	The UNIX file I/O itself can also be done asynchronously (see
+//	"-aio" in main.cc): it is started when the simulated operation
+//	starts, and a read only has to be finished by the time the
+//	simulated operation completes (a write's data is copied, so it
+//	need not even be finished then).  This changes nothing in the
+//	simulation, it just lets Nachos run on while the host does the I/O.
+//
 //  DO NOT CHANGE -- part of the machine emulation
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -15,49 +22,217 @@
 
 #include "copyright.h"
 #include "disk.h"
+#include "bitmap.h"
 #include "debug.h"
 #include "sysdep.h"
 #include "main.h"
 
+// The geometry of the disks (see disk.h); until it is set, the default.
+
+int SectorSize = DefaultSectorSize;
+int SectorsPerTrack = DefaultSectorsPerTrack;
+int NumTracks = DefaultNumTracks;
+int NumSectors = DefaultSectorsPerTrack * DefaultNumTracks;
+
 // We put a magic number at the front of the UNIX file representing the
 // disk, to make it less likely we will accidentally treat a useful file
 // as a disk (which would probably trash the file's contents).
 
 const int MagicNumber = 0x456789ab;
 const int MagicSize = sizeof(int);
-const int DiskSize = (MagicSize + (NumSectors * SectorSize));
+
+// A disk made now starts instead with a label: a magic number of its
+// own, then the disk's geometry.  A disk with the old magic number has
+// the default geometry.
+
+const int LabelMagicNumber = 0x456789ac;
+
+class DiskLabel {
+  public:
+    int magic;				// LabelMagicNumber
+    int sectorSize;			// SectorSize of the disk
+    int sectorsPerTrack;		// SectorsPerTrack
+    int numTracks;			// NumTracks
+};
+
+#define DiskSize	((int) sizeof(DiskLabel) + NumSectors * SectorSize)
+
+// An overlay file has a different magic number, so that it can't be
+// mistaken for a full disk, and vice versa.  Its sector data starts
+// after the map of which sectors it holds.  (Its geometry is that of
+// its base image.)
+
+const int OverlayMagicNumber = 0x4f564c31;
+#define OverlayMapSize	(NumSectors / BitsInByte)
+#define OverlayDataSize	(MagicSize + OverlayMapSize)
+
+//----------------------------------------------------------------------
+// SetGeometry
+// 	Set the geometry of the disks.  The disk file, and an overlay's
+//	sector offsets, must stay within what a UNIX file offset can
+//	address.
+//
+//	"sectorSize" -- bytes per sector (0: DefaultSectorSize)
+//	"sectorsPerTrack" -- sectors per track (0: DefaultSectorsPerTrack)
+//	"numTracks" -- tracks on the disk (0: as many as make the disk
+//		as big as the default one)
+//----------------------------------------------------------------------
+
+void
+SetGeometry(int sectorSize, int sectorsPerTrack, int numTracks)
+{
+    if (sectorSize == 0)
+        sectorSize = DefaultSectorSize;
+    if (sectorsPerTrack == 0)
+        sectorsPerTrack = DefaultSectorsPerTrack;
+    ASSERT(sectorSize >= MinSectorSize && sectorSize <= MaxSectorSize);
+    ASSERT((sectorSize & (sectorSize - 1)) == 0); // a power of two
+    ASSERT(sectorsPerTrack >= 1);
+    if (numTracks == 0)
+        numTracks = max(1, (int) ((long long) DefaultSectorSize *
+                                  DefaultSectorsPerTrack * DefaultNumTracks /
+                                  ((long long) sectorSize * sectorsPerTrack)));
+    ASSERT(numTracks >= 1);
+    ASSERT((long long) sectorsPerTrack * numTracks * (sectorSize + 1)
+           + sizeof(DiskLabel) <= 0x7fffffff);
+
+    SectorSize = sectorSize;
+    SectorsPerTrack = sectorsPerTrack;
+    NumTracks = numTracks;
+    NumSectors = sectorsPerTrack * numTracks;
+    ASSERT(NumSectors % BitsInWord == 0); // the free map is whole words
+}
+
+//----------------------------------------------------------------------
+// ReadLabel
+// 	Read the magic number or label at the front of a disk's UNIX file
+//	into "label", filling in the default geometry for a file from
+//	before there were labels.  Return how many bytes it takes.
+//----------------------------------------------------------------------
+
+static int
+ReadLabel(int fd, DiskLabel *label)
+{
+    Read(fd, (char *)&label->magic, MagicSize);
+    if (label->magic == LabelMagicNumber)
+    {
+        Read(fd, (char *)&label->sectorSize, sizeof(DiskLabel) - MagicSize);
+        return sizeof(DiskLabel);
+    }
+    ASSERT(label->magic == MagicNumber);
+    label->sectorSize = DefaultSectorSize;
+    label->sectorsPerTrack = DefaultSectorsPerTrack;
+    label->numTracks = DefaultNumTracks;
+    return MagicSize;
+}
+
+//----------------------------------------------------------------------
+// LabelMatches
+// 	Is "label" for a disk of the geometry now in use?
+//----------------------------------------------------------------------
+
+static bool
+LabelMatches(DiskLabel *label)
+{
+    return label->sectorSize == SectorSize
+        && label->sectorsPerTrack == SectorsPerTrack
+        && label->numTracks == NumTracks;
+}
+
+//----------------------------------------------------------------------
+// ReadGeometry
+// 	Set the geometry of the disks from the label of an existing disk
+//	file, or to the default if there is no such file yet.
+//
+//	"fileName" -- the UNIX file holding a disk (not an overlay)
+//----------------------------------------------------------------------
+
+void
+ReadGeometry(char *fileName)
+{
+    int fd = OpenForReadOnly(fileName, FALSE);
+    DiskLabel label;
+
+    if (fd < 0)
+    {
+        SetGeometry(0, 0, 0);
+        return;
+    }
+    ReadLabel(fd, &label);
+    Close(fd);
+    SetGeometry(label.sectorSize, label.sectorsPerTrack, label.numTracks);
+}
 
 //----------------------------------------------------------------------
 // Disk::Disk()
 // 	Initialize a simulated disk.  Open the UNIX file (creating it
 //	if it doesn't exist), and check the magic number to make sure it's
-// 	ok to treat it as Nachos disk storage.
+// 	ok to treat it as Nachos disk storage.  A disk file labelled with
+//	another geometry is made afresh: the geometry was read from the
+//	disk's label, so this only happens when it is being formatted
+//	with a new one.
+//
+//	With a base image, the UNIX file is instead an overlay on it: it
+//	holds only the sectors written since the overlay was started,
+//	and the rest are read from the base image, which is never written
+//	(unless the overlay is committed to it at shutdown).
 //
 //	"toCall" -- object to call when disk read/write request completes
+//	"queueDepth" -- how many requests the disk will queue at once
+//	"fileName" -- the UNIX file holding the disk's contents
+//	"baseName" -- the UNIX file holding the base image, or NULL
 //----------------------------------------------------------------------
 
-Disk::Disk(CallBackObj *toCall)
+Disk::Disk(CallBackObj *toCall, int queueDepth, char *fileName,
+           char *baseName)
 {
-    int magicNum;
+    DiskLabel label;
     int tmp = 0;
 
-    DEBUG(dbgDisk, "Initializing the disk.");
+    DEBUG(dbgDisk, "Initializing the disk, queue depth " << queueDepth);
+    ASSERT((queueDepth >= 1) && (queueDepth <= MaxQueueDepth));
     callWhenDone = toCall;
     lastSector = 0;
     bufferInit = 0;
-
-    sprintf(diskname, "DISK_%d", kernel->hostName);
+    this->queueDepth = queueDepth;
+    for (int i = 0; i < MaxQueueDepth; i++)
+        queue[i].inUse = FALSE;
+    numQueued = 0;
+    activeTag = doneTag = -1;
+    hostIO = NULL;
+    baseFile = -1;
+    copied = NULL;
+    sectorTime = RotationTime * SectorSize / DefaultSectorSize;
+
+    ASSERT(strlen(fileName) < sizeof(diskname));
+    strcpy(diskname, fileName);
+    if (baseName != NULL)
+    {
+        OpenOverlay(baseName);
+        active = FALSE;
+        return;
+    }
     fileno = OpenForReadWrite(diskname, FALSE);
     if (fileno >= 0)
     { // file exists, check magic number
-        Read(fileno, (char *)&magicNum, MagicSize);
-        ASSERT(magicNum == MagicNumber);
+        headerSize = ReadLabel(fileno, &label);
+        if (!LabelMatches(&label))
+        { // being formatted with another geometry: start over
+            DEBUG(dbgDisk, "Remaking " << diskname << " with " << SectorSize << "-byte sectors");
+            Close(fileno);
+            Unlink(diskname);
+            fileno = -1;
+        }
     }
-    else
+    if (fileno < 0)
     { // file doesn't exist, create it
         fileno = OpenForWrite(diskname);
-        magicNum = MagicNumber;
-        WriteFile(fileno, (char *)&magicNum, MagicSize); // write magic number
+        label.magic = LabelMagicNumber;
+        label.sectorSize = SectorSize;
+        label.sectorsPerTrack = SectorsPerTrack;
+        label.numTracks = NumTracks;
+        WriteFile(fileno, (char *)&label, sizeof(DiskLabel)); // write label
+        headerSize = sizeof(DiskLabel);
 
         // need to write at end of file, so that reads will not return EOF
         Lseek(fileno, DiskSize - sizeof(int), 0);
@@ -69,12 +244,157 @@ Disk::Disk(CallBackObj *toCall)
 //----------------------------------------------------------------------
 // Disk::~Disk()
 // 	Clean up disk simulation, by closing the UNIX file representing the
-//	disk.
+//	disk.  An overlay is kept for the next run, unless we were asked
+//	to commit it to the base image or to discard it.
+//
+//	Note that the debug object is gone by now; don't use DEBUG here.
 //----------------------------------------------------------------------
 
 Disk::~Disk()
 {
+    if (hostIO != NULL)
+        WaitAsync(hostIO);
+    if (kernel->asyncHostIO)
+        FlushAsync();
+    if (copied == NULL)
+    {
+        Close(fileno);
+        return;
+    }
+    if (kernel->commitOverlay)
+        CommitOverlay();
+    Close(baseFile);
     Close(fileno);
+    if (kernel->commitOverlay || kernel->discardOverlay)
+        Unlink(diskname);
+    delete [] copied;
+}
+
+//----------------------------------------------------------------------
+// Disk::OpenOverlay
+// 	Open the base image (read-only, unless the overlay will be
+//	committed to it), and the overlay file, creating it if it doesn't
+//	exist.  The overlay starts with its own magic number, then one
+//	bit per sector, set if the overlay holds the sector; the sectors
+//	it holds follow, each at the same place it would be in a full
+//	disk file.  The UNIX file system only allocates space for the
+//	sectors actually written.
+//----------------------------------------------------------------------
+
+void Disk::OpenOverlay(char *baseName)
+{
+    int magicNum;
+    DiskLabel label;
+
+    DEBUG(dbgDisk, "Overlay " << diskname << " on base image " << baseName);
+    if (kernel->commitOverlay)
+        baseFile = OpenForReadWrite(baseName, TRUE);
+    else
+        baseFile = OpenForReadOnly(baseName, TRUE);
+    headerSize = ReadLabel(baseFile, &label);
+    ASSERT(LabelMatches(&label));
+
+    copied = new unsigned char[OverlayMapSize];
+    fileno = OpenForReadWrite(diskname, FALSE);
+    if (fileno >= 0)
+    { // overlay exists, check magic number and load the map
+        Read(fileno, (char *)&magicNum, MagicSize);
+        ASSERT(magicNum == OverlayMagicNumber);
+        Read(fileno, (char *)copied, OverlayMapSize);
+    }
+    else
+    { // start an empty overlay
+        fileno = OpenForWrite(diskname);
+        magicNum = OverlayMagicNumber;
+        bzero(copied, OverlayMapSize);
+        WriteFile(fileno, (char *)&magicNum, MagicSize);
+        WriteFile(fileno, (char *)copied, OverlayMapSize);
+    }
+}
+
+//----------------------------------------------------------------------
+// Disk::CommitOverlay
+// 	Copy every sector the overlay holds into the base image.
+//----------------------------------------------------------------------
+
+void Disk::CommitOverlay()
+{
+    char *buffer = new char[SectorSize];
+
+    for (int sector = 0; sector < NumSectors; sector++)
+    {
+        if (!(copied[sector / BitsInByte] & (1 << (sector % BitsInByte))))
+            continue;
+        Lseek(fileno, OverlayDataSize + sector * SectorSize, 0);
+        Read(fileno, buffer, SectorSize);
+        Lseek(baseFile, headerSize + sector * SectorSize, 0);
+        WriteFile(baseFile, buffer, SectorSize);
+    }
+    delete [] buffer;
+}
+
+//----------------------------------------------------------------------
+// Disk::HostRead/HostWrite
+// 	Do the UNIX file I/O for a sector read/write, in the background
+//	if asked to (see disk.h).  With an overlay, a read comes from the
+//	overlay if it holds the sector, otherwise from the base image;
+//	a write always goes to the overlay, and the first write of a
+//	sector also updates the overlay's map.
+//----------------------------------------------------------------------
+
+void Disk::HostRead(int sectorNumber, char *data)
+{
+    int fd = fileno;
+    int offset = headerSize + sectorNumber * SectorSize;
+
+    if (copied != NULL)
+    {
+        if (copied[sectorNumber / BitsInByte] &
+            (1 << (sectorNumber % BitsInByte)))
+            offset = OverlayDataSize + sectorNumber * SectorSize;
+        else
+            fd = baseFile;
+    }
+    if (kernel->asyncHostIO)
+        hostIO = ReadAsync(fd, data, SectorSize, offset);
+    else
+    {
+        Lseek(fd, offset, 0);
+        Read(fd, data, SectorSize);
+    }
+}
+
+void Disk::HostWrite(int sectorNumber, char *data)
+{
+    int offset = headerSize + sectorNumber * SectorSize;
+    unsigned char *mapByte = NULL;
+
+    if (copied != NULL)
+    {
+        offset = OverlayDataSize + sectorNumber * SectorSize;
+        mapByte = &copied[sectorNumber / BitsInByte];
+        if (*mapByte & (1 << (sectorNumber % BitsInByte)))
+            mapByte = NULL; // already in the overlay
+        else
+            *mapByte |= 1 << (sectorNumber % BitsInByte);
+    }
+    if (kernel->asyncHostIO)
+    {
+        WriteAsync(fileno, data, SectorSize, offset);
+        if (mapByte != NULL)
+            WriteAsync(fileno, (char *)mapByte, 1,
+                       MagicSize + (mapByte - copied));
+    }
+    else
+    {
+        Lseek(fileno, offset, 0);
+        WriteFile(fileno, data, SectorSize);
+        if (mapByte != NULL)
+        {
+            Lseek(fileno, MagicSize + (mapByte - copied), 0);
+            WriteFile(fileno, (char *)mapByte, 1);
+        }
+    }
 }
 
 //----------------------------------------------------------------------
@@ -101,10 +421,11 @@ PrintSector(bool writing, int sector, char *data)
 //----------------------------------------------------------------------
 // Disk::ReadRequest/WriteRequest
 // 	Simulate a request to read/write a single disk sector
-//	   Do the read/write immediately to the UNIX file
-//	   Set up an interrupt handler to be called later,
-//	      that will notify the caller when the simulator says
-//	      the operation has completed.
+//	   Queue the request under a free tag
+//	   If the disk is idle, start servicing it right away
+//	Return the tag; the caller is notified when the simulator
+//	says the operation has completed, and can find out which
+//	request it was from DoneTag().
 //
 //	Note that a disk only allows an entire sector to be read/written,
 //	not part of a sector.
@@ -113,52 +434,133 @@ PrintSector(bool writing, int sector, char *data)
 //	"data" -- the bytes to be written, the buffer to hold the incoming bytes
 //----------------------------------------------------------------------
 
-void Disk::ReadRequest(int sectorNumber, char *data)
+int Disk::ReadRequest(int sectorNumber, char *data)
 {
-    int ticks = ComputeLatency(sectorNumber, FALSE);
+    return Enqueue(sectorNumber, data, FALSE);
+}
 
-    ASSERT(!active); // only one request at a time
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+int Disk::WriteRequest(int sectorNumber, char *data)
+{
+    return Enqueue(sectorNumber, data, TRUE);
+}
 
-    DEBUG(dbgDisk, "Reading from sector " << sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
-    if (debug->IsEnabled('d'))
-        PrintSector(FALSE, sectorNumber, data);
+//----------------------------------------------------------------------
+// Disk::Enqueue
+// 	Put a request in a free queue slot, and start the disk if it is
+//	not already busy.  Return the tag of the new request.
+//----------------------------------------------------------------------
 
-    active = TRUE;
-    UpdateLast(sectorNumber);
-    kernel->stats->numDiskReads++;
-    kernel->interrupt->Schedule(this, ticks, DiskInt);
+int Disk::Enqueue(int sectorNumber, char *data, bool writing)
+{
+    int tag;
+
+    ASSERT(numQueued < queueDepth); // only queueDepth requests at a time
+    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+
+    for (tag = 0; queue[tag].inUse; tag++)
+        ;
+    queue[tag].inUse = TRUE;
+    queue[tag].writing = writing;
+    queue[tag].sector = sectorNumber;
+    queue[tag].data = data;
+    numQueued++;
+    DEBUG(dbgDisk, "Queued request " << tag << " for sector " << sectorNumber << ", " << numQueued << " queued");
+
+    if (!active)
+        StartNext();
+    return tag;
 }
 
-void Disk::WriteRequest(int sectorNumber, char *data)
+//----------------------------------------------------------------------
+// Disk::StartNext
+// 	Pick the queued request the head can reach soonest (shortest
+//	positioning time, using the same seek/rotation model as
+//	ComputeLatency), do the read/write to the UNIX file, and set up
+//	an interrupt for when the simulated operation completes.
+//----------------------------------------------------------------------
+
+void Disk::StartNext()
 {
-    int ticks = ComputeLatency(sectorNumber, TRUE);
+    int best = -1, bestTicks = 0;
 
-    ASSERT(!active);
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT(!active && numQueued > 0);
+    for (int tag = 0; tag < queueDepth; tag++)
+    {
+        if (!queue[tag].inUse)
+            continue;
+        int ticks = ComputeLatency(queue[tag].sector, queue[tag].writing);
+        if (best == -1 || ticks < bestTicks)
+        {
+            best = tag;
+            bestTicks = ticks;
+        }
+    }
 
-    DEBUG(dbgDisk, "Writing to sector " << sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
-    if (debug->IsEnabled('d'))
-        PrintSector(TRUE, sectorNumber, data);
+    DiskRequest *req = &queue[best];
+    if (req->writing)
+    {
+        DEBUG(dbgDisk, "Writing to sector " << req->sector);
+        HostWrite(req->sector, req->data);
+        kernel->stats->numDiskWrites++;
+    }
+    else
+    {
+        DEBUG(dbgDisk, "Reading from sector " << req->sector);
+        HostRead(req->sector, req->data);
+        kernel->stats->numDiskReads++;
+    }
+    if (debug->IsEnabled('d') && hostIO == NULL)
+        PrintSector(req->writing, req->sector, req->data);
 
     active = TRUE;
+    activeTag = best;
+    kernel->interrupt->Schedule(this, StartAccess(req->sector, req->writing),
+                                DiskInt);
+}
+
+//----------------------------------------------------------------------
+// Disk::StartAccess
+// 	Called when the disk starts servicing a request.  Note where the
+//	head will be afterwards (so we know what is in the track buffer),
+//	and return how long the request takes.
+//
+//	Other kinds of storage device override this to model their own
+//	service time.
+//----------------------------------------------------------------------
+
+int Disk::StartAccess(int sectorNumber, bool writing)
+{
+    int ticks = ComputeLatency(sectorNumber, writing);
+
     UpdateLast(sectorNumber);
-    kernel->stats->numDiskWrites++;
-    kernel->interrupt->Schedule(this, ticks, DiskInt);
+    return ticks;
 }
 
 //----------------------------------------------------------------------
 // Disk::CallBack()
 // 	Called by the machine simulation when the disk interrupt occurs.
+//	Wait for the host to finish the read/write, if it was done in the
+//	background, retire the request that finished, start on the next
+//	queued one (if any), and tell the caller which tag completed.
 //----------------------------------------------------------------------
 
 void Disk::CallBack()
 {
+    if (hostIO != NULL)
+    { // the host must be done with the data by now
+        WaitAsync(hostIO);
+        hostIO = NULL;
+        if (debug->IsEnabled('d'))
+            PrintSector(queue[activeTag].writing, queue[activeTag].sector,
+                        queue[activeTag].data);
+    }
     active = FALSE;
+    doneTag = activeTag;
+    activeTag = -1;
+    queue[doneTag].inUse = FALSE;
+    numQueued--;
+    if (numQueued > 0)
+        StartNext();
     callWhenDone->CallBack();
 }
 
@@ -170,7 +572,7 @@ void Disk::CallBack()
 //	we also return how long until the head is at the next sector boundary.
 //
 //   	Disk seeks at one track per SeekTime ticks (cf. stats.h)
-//   	and rotates at one sector per RotationTime ticks
+//   	and rotates at one sector per sectorTime ticks
 //----------------------------------------------------------------------
 
 int Disk::TimeToSeek(int newSector, int *rotation)
@@ -179,13 +581,13 @@ int Disk::TimeToSeek(int newSector, int *rotation)
     int oldTrack = lastSector / SectorsPerTrack;
     int seek = abs(newTrack - oldTrack) * SeekTime;
     // how long will seek take?
-    int over = (kernel->stats->totalTicks + seek) % RotationTime;
+    int over = (kernel->stats->totalTicks + seek) % sectorTime;
     // will we be in the middle of a sector when
     // we finish the seek?
 
     *rotation = 0;
     if (over > 0) // if so, need to round up to next full sector
-        *rotation = RotationTime - over;
+        *rotation = sectorTime - over;
     return seek;
 }
 
@@ -210,7 +612,7 @@ int Disk::ModuloDiff(int to, int from)
 //
 //   	Latency = seek time + rotational latency + transfer time
 //   	Disk seeks at one track per SeekTime ticks (cf. stats.h)
-//   	and rotates at one sector per RotationTime ticks
+//   	and rotates at one sector per sectorTime ticks
 //
 //   	To find the rotational latency, we first must figure out where the
 //   	disk head will be after the seek (if any).  We then figure out
@@ -232,17 +634,17 @@ int Disk::ComputeLatency(int newSector, bool writing)
 
 #ifndef NOTRACKBUF // turn this on if you don't want the track buffer stuff
     // check if track buffer applies
-    if ((writing == FALSE) && (seek == 0) && (((timeAfter - bufferInit) / RotationTime) > ModuloDiff(newSector, bufferInit / RotationTime)))
+    if ((writing == FALSE) && (seek == 0) && (((timeAfter - bufferInit) / sectorTime) > ModuloDiff(newSector, bufferInit / sectorTime)))
     {
-        DEBUG(dbgDisk, "Request latency = " << RotationTime);
-        return RotationTime; // time to transfer sector from the track buffer
+        DEBUG(dbgDisk, "Request latency = " << sectorTime);
+        return sectorTime; // time to transfer sector from the track buffer
     }
 #endif
 
-    rotation += ModuloDiff(newSector, timeAfter / RotationTime) * RotationTime;
+    rotation += ModuloDiff(newSector, timeAfter / sectorTime) * sectorTime;
 
-    DEBUG(dbgDisk, "Request latency = " << (seek + rotation + RotationTime));
-    return (seek + rotation + RotationTime);
+    DEBUG(dbgDisk, "Request latency = " << (seek + rotation + sectorTime));
+    return (seek + rotation + sectorTime);
 }
 
 //----------------------------------------------------------------------
@@ -4,6 +4,10 @@
 //	when the request is satisfied, the CPU gets an interrupt, and 
 //	the next request can be sent to the disk.
 //
+//	Optionally, the disk can queue several tagged requests at once
+//	(as with SATA native command queuing), and choose which one to
+//	service next by how soon the head can get to it.
+//
 //	Disk contents are preserved across machine crashes, but if
 //	a file system operation (eg, create a file) is in progress when the 
 //	system shuts down, the file system may be corrupted.
@@ -46,47 +50,151 @@
 // disks these days now come with a track buffer.
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+//
+// With a queue depth greater than one, up to that many requests may be
+// outstanding.  Each request is given a tag when it is sent; the disk
+// services one request at a time, always picking the queued request with
+// the shortest positioning time from the current head position, and
+// once a request finishes, "DoneTag" tells the caller which one it was.
+// With a queue depth of one, the disk behaves exactly as before.
+//
+// The disk can also be kept as a copy-on-write overlay on a base image
+// (another disk's UNIX file): sectors written go to the overlay's UNIX
+// file, sectors never written are read from the base image, and the
+// base image is left alone.  So one prepared disk can be the starting
+// point of many runs.  At shutdown the overlay is kept for the next
+// run, or, if asked, either thrown away or copied into the base image.
+//
+// The geometry of the disk -- how big its sectors are, and how many
+// of them there are -- is chosen when it is formatted (see "-ss" in
+// main.cc), and kept in a label at the front of its UNIX file, so
+// every later run finds it there.  It is the same for every disk in
+// the machine, and must be set (SetGeometry or ReadGeometry) before
+// the first disk is made.  A disk file from before there were labels
+// has the default geometry.  A sector takes RotationTime (stats.h)
+// to pass under the head for every DefaultSectorSize bytes in it, so
+// the disk moves data at the same rate whatever its sector size.
+
+extern int SectorSize;			// number of bytes per disk sector
+extern int SectorsPerTrack;		// number of sectors per disk track 
+extern int NumTracks;			// number of tracks per disk
+extern int NumSectors;			// total # of sectors per disk
+					// (SectorsPerTrack * NumTracks)
+
+const int DefaultSectorSize = 128;	// the geometry of a disk with no
+const int DefaultSectorsPerTrack = 32;	// label, and the one chosen by
+const int DefaultNumTracks = 16384;	// default
+const int MinSectorSize = 128;		// sector sizes allowed (powers
+const int MaxSectorSize = 4096;		// of two in between)
+
+extern void SetGeometry(int sectorSize, int sectorsPerTrack, int numTracks);
+					// Use this geometry (0 for the
+					// default; with the default
+					// number of tracks, the disk
+					// holds as many bytes as the
+					// default disk)
+extern void ReadGeometry(char *fileName);
+					// Use the geometry in the label
+					// of a UNIX disk file (the
+					// default if it has none, or
+					// doesn't exist)
+
+const int MaxQueueDepth = 32;		// most requests the disk can queue
+const int MaxDiskName = 256;		// longest UNIX file name for a disk
 
-const int SectorSize = 128;		// number of bytes per disk sector
-const int SectorsPerTrack  = 32;	// number of sectors per disk track 
-const int NumTracks = 16384;		// number of tracks per disk
-const int NumSectors = (SectorsPerTrack * NumTracks);
-					// total # of sectors per disk
+// A request waiting in (or being serviced from) the disk's queue.
+
+class DiskRequest {
+  public:
+    bool inUse;				// is this tag allocated?
+    bool writing;			// write request?
+    int sector;				// the sector to read/write
+    char *data;				// where the bytes come from/go to
+};
 
 class Disk : public CallBackObj {
   public:
-    Disk(CallBackObj *toCall);          // Create a simulated disk.  
+    Disk(CallBackObj *toCall, int queueDepth, char *fileName,
+	 char *baseName);		// Create a simulated disk, stored
+					// in UNIX file fileName (as an
+					// overlay on UNIX file baseName,
+					// if that is not NULL), that
+					// accepts up to queueDepth requests.
 					// Invoke toCall->CallBack() 
 					// when each request completes.
-    ~Disk();				// Deallocate the disk.
+    virtual ~Disk();			// Deallocate the disk.
     
-    void ReadRequest(int sectorNumber, char* data);
+    int ReadRequest(int sectorNumber, char* data);
     					// Read/write an single disk sector.
 					// These routines send a request to 
-    					// the disk and return immediately.
-    					// Only one request allowed at a time!
-    void WriteRequest(int sectorNumber, char* data);
+    					// the disk and return immediately,
+					// with the tag of the request.
+    					// At most queueDepth requests
+					// allowed at a time!
+    int WriteRequest(int sectorNumber, char* data);
 
     void CallBack();			// Invoked when disk request 
 					// finishes. In turn calls, callWhenDone.
 
-    int ComputeLatency(int newSector, bool writing);	
+    int DoneTag() { return doneTag; }	// Tag of the request that just
+					// finished; valid in callWhenDone
+    int QueueDepth() { return queueDepth; }
+    char *FileName() { return diskname; }
+
+    virtual int ComputeLatency(int newSector, bool writing);	
     					// Return how long a request to 
 					// newSector will take: 
 					// (seek + rotational delay + transfer)
 
+    virtual void Trim(int sectorNumber) {}
+    					// The sector's contents are no
+					// longer needed.  Only matters to
+					// devices (such as flash) that 
+					// can make use of the hint.
+
+  protected:
+    virtual int StartAccess(int sectorNumber, bool writing);
+    					// Update the device state for a
+					// request being serviced now, and
+					// return how long it will take
+
   private:
     int fileno;				// UNIX file number for simulated disk 
-    char diskname[32];			// name of simulated disk's file
+    int headerSize;			// bytes before sector 0 in it
+					// (its magic number or label)
+    char diskname[MaxDiskName];		// name of simulated disk's file
     CallBackObj *callWhenDone;		// Invoke when any disk request finishes
     bool active;     			// Is a disk operation in progress?
+    int queueDepth;			// how many requests may be queued
+    DiskRequest queue[MaxQueueDepth];	// queued requests, indexed by tag
+    int numQueued;			// # of tags in use
+    int activeTag;			// request being serviced
+    int doneTag;			// request that just finished
+    void *hostIO;			// UNIX file read for the active
+					// request, if still in progress
+    int baseFile;			// UNIX file number of the base
+					// image, if the disk is an overlay
+    unsigned char *copied;		// bit per sector: is it in the
+					// overlay?  NULL if not an overlay
     int lastSector;			// The previous disk request 
     int bufferInit;			// When the track buffer started 
 					// being loaded
 
+    int sectorTime;			// ticks for a sector to rotate
+					// past the head
+
     int TimeToSeek(int newSector, int *rotate); // time to get to the new track
     int ModuloDiff(int to, int from);        // # sectors between to and from
     void UpdateLast(int newSector);
+    int Enqueue(int sectorNumber, char* data, bool writing);
+    					// Queue a request, start it if idle
+    void StartNext();			// Service the queued request with
+					// the shortest positioning time
+    void HostRead(int sectorNumber, char *data);
+    void HostWrite(int sectorNumber, char *data);
+    					// Read/write the sector's UNIX file
+    void OpenOverlay(char *baseName);	// Open the overlay and base image
+    void CommitOverlay();		// Copy the overlay into the base
 };
 
 #endif // DISK_H
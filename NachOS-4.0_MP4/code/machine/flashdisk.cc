@@ -0,0 +1,290 @@
+// flashdisk.cc
+//	Routines to simulate a flash storage device.  Requests are queued,
+//	serviced and completed exactly as by the physical disk (see
+//	disk.cc); only the time each request takes is different.  That
+//	time comes from a page-mapped flash translation layer, with greedy
+//	garbage collection.
+//
+//	See flashdisk.h for details about the behavior of flash devices.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "flashdisk.h"
+#include "debug.h"
+#include "sysdep.h"
+#include "main.h"
+
+// The FTL state file (the disk's UNIX file name plus ".ftl") starts
+// with its own magic number, so we don't read an unrelated file as FTL
+// state.
+
+const int FTLMagicNumber = 0x46544c31;
+
+//----------------------------------------------------------------------
+// FlashDisk::FlashDisk
+// 	Initialize a simulated flash device.  The sector contents are
+//	kept by the Disk; restore the FTL state from the last run, if
+//	there is one for a device of this size.
+//
+//	"toCall" -- object to call when a read/write request completes
+//	"queueDepth" -- how many requests the device will queue at once
+//	"fileName" -- the UNIX file holding the sector contents
+//	"baseName" -- the base image it is an overlay on, or NULL
+//		(the FTL state belongs to fileName either way)
+//	"numBlocks" -- how many erase blocks the flash has
+//----------------------------------------------------------------------
+
+FlashDisk::FlashDisk(CallBackObj *toCall, int queueDepth, char *fileName,
+		     char *baseName, int numBlocks)
+    : Disk(toCall, queueDepth, fileName, baseName)
+{
+    ASSERT(numBlocks > GCFreeBlocks);
+    this->numBlocks = numBlocks;
+    numPages = numBlocks * PagesPerBlock;
+    DEBUG(dbgDisk, "Initializing flash, " << numBlocks << " erase blocks");
+
+    mapping = new int[NumSectors];
+    owner = new int[numPages];
+    validPages = new int[numBlocks];
+    programmed = new int[numBlocks];
+
+    sprintf(ftlname, "%s.ftl", fileName);
+    Load();
+}
+
+//----------------------------------------------------------------------
+// FlashDisk::~FlashDisk
+// 	Save the FTL state for the next run, and clean up.
+//----------------------------------------------------------------------
+
+FlashDisk::~FlashDisk()
+{
+    Save();
+    delete [] mapping;
+    delete [] owner;
+    delete [] validPages;
+    delete [] programmed;
+}
+
+//----------------------------------------------------------------------
+// FlashDisk::ComputeLatency
+// 	Return how long a read or write of a sector will take.  Unlike a
+//	disk, this doesn't depend on where the sector is; a write may
+//	take longer than this if it has to wait for garbage collection.
+//----------------------------------------------------------------------
+
+int
+FlashDisk::ComputeLatency(int newSector, bool writing)
+{
+    return writing ? FlashProgramTime : FlashReadTime;
+}
+
+//----------------------------------------------------------------------
+// FlashDisk::StartAccess
+// 	Called when the device starts servicing a request.  A read just
+//	reads the sector's page.  A write turns the sector's old page
+//	into garbage and programs a new one, first collecting garbage
+//	if the device is running out of erased blocks.
+//----------------------------------------------------------------------
+
+int
+FlashDisk::StartAccess(int sectorNumber, bool writing)
+{
+    int ticks = ComputeLatency(sectorNumber, writing);
+
+    if (!writing)
+	return ticks;
+
+    Invalidate(sectorNumber);
+    while (numFreeBlocks < GCFreeBlocks)
+	ticks += CollectGarbage();
+    Program(sectorNumber);
+    kernel->stats->numFlashWrites++;
+    DEBUG(dbgDisk, "Flash write of sector " << sectorNumber << " to page "
+	  << mapping[sectorNumber] << ", latency " << ticks);
+    return ticks;
+}
+
+//----------------------------------------------------------------------
+// FlashDisk::Trim
+// 	The file system no longer needs this sector, so its page is
+//	garbage, and need not be copied by the garbage collector.
+//----------------------------------------------------------------------
+
+void
+FlashDisk::Trim(int sectorNumber)
+{
+    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    Invalidate(sectorNumber);
+    kernel->stats->numTrims++;
+}
+
+//----------------------------------------------------------------------
+// FlashDisk::Invalidate
+// 	Mark the page holding a sector (if any) as garbage.
+//----------------------------------------------------------------------
+
+void
+FlashDisk::Invalidate(int sectorNumber)
+{
+    int page = mapping[sectorNumber];
+
+    if (page == -1)
+	return;
+    owner[page] = -1;
+    validPages[page / PagesPerBlock]--;
+    mapping[sectorNumber] = -1;
+}
+
+//----------------------------------------------------------------------
+// FlashDisk::Program
+// 	Write a sector to the next page of the active block, starting a
+//	new block if the active one is full.
+//----------------------------------------------------------------------
+
+void
+FlashDisk::Program(int sectorNumber)
+{
+    int page;
+
+    if (activeBlock == -1 || programmed[activeBlock] == PagesPerBlock)
+	activeBlock = TakeFreeBlock();
+    page = activeBlock * PagesPerBlock + programmed[activeBlock]++;
+    owner[page] = sectorNumber;
+    mapping[sectorNumber] = page;
+    validPages[activeBlock]++;
+}
+
+//----------------------------------------------------------------------
+// FlashDisk::TakeFreeBlock
+// 	Return an erased block to write to.  Search round-robin from
+//	where we left off, so that erases are spread over the device.
+//----------------------------------------------------------------------
+
+int
+FlashDisk::TakeFreeBlock()
+{
+    ASSERT(numFreeBlocks > 0);
+    for (int i = 0; i < numBlocks; i++) {
+	int block = (nextFree + i) % numBlocks;
+	if (programmed[block] == 0 && block != activeBlock) {
+	    nextFree = (block + 1) % numBlocks;
+	    numFreeBlocks--;
+	    return block;
+	}
+    }
+    ASSERTNOTREACHED();
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// FlashDisk::CollectGarbage
+// 	Reclaim the full block with the fewest live pages: copy its live
+//	pages to the active block, then erase it.  Return how long that
+//	took (a read and a program per copied page, plus the erase).
+//----------------------------------------------------------------------
+
+int
+FlashDisk::CollectGarbage()
+{
+    int victim = -1;
+    int ticks = 0;
+
+    for (int block = 0; block < numBlocks; block++) {
+	if (programmed[block] != PagesPerBlock || block == activeBlock)
+	    continue;
+	if (victim == -1 || validPages[block] < validPages[victim])
+	    victim = block;
+    }
+    // if every block is full of live data, the flash is too small
+    // for what the file system has stored on it
+    ASSERT(victim != -1 && validPages[victim] < PagesPerBlock);
+
+    DEBUG(dbgDisk, "Collecting flash block " << victim << ", "
+	  << validPages[victim] << " live pages");
+    for (int page = victim * PagesPerBlock;
+	 page < (victim + 1) * PagesPerBlock; page++) {
+	int sector = owner[page];
+	if (sector == -1)
+	    continue;
+	Invalidate(sector);
+	Program(sector);
+	ticks += FlashReadTime + FlashProgramTime;
+	kernel->stats->numFlashGCWrites++;
+    }
+    ASSERT(validPages[victim] == 0);
+    programmed[victim] = 0;
+    numFreeBlocks++;
+    kernel->stats->numFlashErases++;
+    return ticks + FlashEraseTime;
+}
+
+//----------------------------------------------------------------------
+// FlashDisk::Load
+// 	Restore the FTL state saved by the last run.  If there is none,
+//	or it was for a different size of flash, start with every block
+//	erased.
+//
+//	The file holds the magic number, the number of blocks, the active
+//	block, then owner[] and programmed[]; the rest is derived.
+//----------------------------------------------------------------------
+
+void
+FlashDisk::Load()
+{
+    int header[3];
+    int fd = OpenForReadWrite(ftlname, FALSE);
+    bool restored = FALSE;
+
+    if (fd >= 0) {
+	if (ReadPartial(fd, (char *)header, sizeof(header)) == sizeof(header)
+	    && header[0] == FTLMagicNumber && header[1] == numBlocks) {
+	    activeBlock = header[2];
+	    Read(fd, (char *)owner, numPages * sizeof(int));
+	    Read(fd, (char *)programmed, numBlocks * sizeof(int));
+	    restored = TRUE;
+	}
+	Close(fd);
+    }
+    if (!restored) {
+	activeBlock = -1;
+	for (int page = 0; page < numPages; page++)
+	    owner[page] = -1;
+	for (int block = 0; block < numBlocks; block++)
+	    programmed[block] = 0;
+    }
+
+    for (int sector = 0; sector < NumSectors; sector++)
+	mapping[sector] = -1;
+    numFreeBlocks = 0;
+    for (int block = 0; block < numBlocks; block++) {
+	validPages[block] = 0;
+	if (programmed[block] == 0 && block != activeBlock)
+	    numFreeBlocks++;
+    }
+    for (int page = 0; page < numPages; page++) {
+	if (owner[page] != -1) {
+	    mapping[owner[page]] = page;
+	    validPages[page / PagesPerBlock]++;
+	}
+    }
+    nextFree = 0;
+}
+
+void
+FlashDisk::Save()
+{
+    int header[3];
+    int fd = OpenForWrite(ftlname);
+
+    header[0] = FTLMagicNumber;
+    header[1] = numBlocks;
+    header[2] = activeBlock;
+    WriteFile(fd, (char *)header, sizeof(header));
+    WriteFile(fd, (char *)owner, numPages * sizeof(int));
+    WriteFile(fd, (char *)programmed, numBlocks * sizeof(int));
+    Close(fd);
+}
@@ -0,0 +1,94 @@
+// flashdisk.h
+//	Data structures to emulate a flash (SSD) storage device, as an
+//	alternative to the seek/rotation model of the physical disk.
+//
+//	Flash is organized in pages, grouped into erase blocks.  A page
+//	can only be programmed once after its block has been erased, and
+//	only whole blocks can be erased.  So the device never overwrites a
+//	sector in place: a flash translation layer (FTL) maps each sector
+//	to the page that currently holds it, every write goes to a fresh
+//	page, and the old page becomes garbage.  When free blocks run
+//	low, the garbage collector picks the block with the fewest live
+//	pages, copies those pages elsewhere, and erases the block.  The
+//	copies are extra writes the file system never asked for -- the
+//	ratio of total page programs to requested writes is the "write
+//	amplification".
+//
+//	TRIM tells the device that a sector's contents are dead, so the
+//	garbage collector need not copy it.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FLASHDISK_H
+#define FLASHDISK_H
+
+#include "copyright.h"
+#include "disk.h"
+
+// The following class defines a flash device with the same interface
+// as the physical disk: the same number of sectors, the same queued,
+// asynchronous requests, and the same UNIX file holding the sector
+// contents (which is addressed by sector, not by flash page -- where
+// a sector lives in flash only affects timing).
+//
+// Each flash page holds one sector.  The flash may have fewer pages
+// than the disk has sectors; that is fine as long as the live data
+// (sectors written and not trimmed) fits, with some room to spare for
+// the garbage collector.
+//
+// The FTL state is saved in a second UNIX file next to the disk's, so
+// that wear and garbage carry over from one run of Nachos to the next,
+// as they would on a real device.
+
+const int PagesPerBlock = 64;		// flash pages per erase block
+const int GCFreeBlocks = 2;		// collect garbage when fewer
+					// blocks than this are free
+
+class FlashDisk : public Disk {
+  public:
+    FlashDisk(CallBackObj *toCall, int queueDepth, char *fileName,
+	      char *baseName, int numBlocks);
+    					// Create a simulated flash device
+					// with numBlocks erase blocks
+    ~FlashDisk();			// Save the FTL state, and
+					// deallocate the device
+
+    int ComputeLatency(int newSector, bool writing);
+    					// Return how long a page read or
+					// program takes, not counting
+					// garbage collection
+
+    void Trim(int sectorNumber);	// Forget the sector's contents
+
+  protected:
+    int StartAccess(int sectorNumber, bool writing);
+    					// Map the sector to a new page if
+					// writing, collecting garbage if
+					// needed; return the time taken
+
+  private:
+    char ftlname[MaxDiskName + 4];	// UNIX file holding the FTL state
+    int numBlocks;			// # of erase blocks
+    int numPages;			// # of flash pages
+    int *mapping;			// sector -> page, -1 if unmapped
+    int *owner;				// page -> sector, -1 if the page
+					// is erased or holds garbage
+    int *validPages;			// # of live pages in each block
+    int *programmed;			// # of pages written in each block
+					// since it was last erased
+    int activeBlock;			// block new pages are written to
+    int numFreeBlocks;			// # of erased blocks
+    int nextFree;			// where to look for an erased block
+
+    void Invalidate(int sectorNumber);	// The sector's page is garbage
+    void Program(int sectorNumber);	// Write the sector to a new page
+    int TakeFreeBlock();		// Pick an erased block to write to
+    int CollectGarbage();		// Reclaim one block; return the
+					// time it took
+    void Load();			// Read/write the FTL state from/to
+    void Save();			// its UNIX file
+};
+
+#endif // FLASHDISK_H
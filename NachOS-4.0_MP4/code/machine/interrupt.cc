@@ -23,6 +23,7 @@
 #include "copyright.h"
 #include "interrupt.h"
 #include "main.h"
+#include "slab.h"
 
 // String definitions for debugging messages
 
@@ -49,6 +50,78 @@ PendingInterrupt::PendingInterrupt(CallBackObj *callOnInt,
     type = kind;
 }
 
+//----------------------------------------------------------------------
+// PendingInterrupt::operator new, PendingInterrupt::operator delete
+// 	One of these is made for every disk, console and timer interrupt
+//	scheduled, so they come from a cache instead of from the heap.
+//----------------------------------------------------------------------
+
+static ObjectCache *pendingCache = NULL;
+
+void *
+PendingInterrupt::operator new(size_t size)
+{
+    ASSERT(size == sizeof(PendingInterrupt));
+    if (pendingCache == NULL)
+        pendingCache = new ObjectCache("PendingInterrupt",
+                                       sizeof(PendingInterrupt));
+    return pendingCache->Alloc();
+}
+
+void
+PendingInterrupt::operator delete(void *toOccur)
+{
+    if (toOccur != NULL)
+        pendingCache->Free(toOccur);
+}
+
+//----------------------------------------------------------------------
+// BottomHalf::BottomHalf
+// 	Initialize a piece of deferred work that an interrupt handler
+//	can hand off to be run after the handler returns.
+//
+//	"debugName" is an arbitrary name, useful for debugging
+//	"func" is the procedure to call to do the deferred work
+//	"arg" is the argument to pass to "func"
+//----------------------------------------------------------------------
+
+BottomHalf::BottomHalf(char *debugName, VoidFunctionPtr func, void *arg)
+{
+    name = debugName;
+    this->func = func;
+    this->arg = arg;
+    pending = 0;
+    queued = FALSE;
+}
+
+//----------------------------------------------------------------------
+// BottomHalf::Raise
+// 	Called by an interrupt handler (with interrupts disabled) to
+//	schedule the deferred work.  If the bottom half is already
+//	waiting to run, we just count one more invocation.
+//----------------------------------------------------------------------
+
+void BottomHalf::Raise()
+{
+    pending++;
+    kernel->interrupt->ScheduleBottomHalf(this);
+}
+
+//----------------------------------------------------------------------
+// BottomHalf::Run
+// 	Do the deferred work, once for every time the bottom half was
+//	raised since it last ran.
+//----------------------------------------------------------------------
+
+void BottomHalf::Run()
+{
+    while (pending > 0)
+    {
+        pending--;
+        (*func)(arg);
+    }
+}
+
 //----------------------------------------------------------------------
 // PendingCompare
 //	Compare to interrupts based on which should occur first.
@@ -85,6 +158,9 @@ Interrupt::Interrupt()
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
+    bottomHalves = new List<BottomHalf *>;
+    deferBottomHalves = TRUE;
+    inBottomHalf = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -99,6 +175,7 @@ Interrupt::~Interrupt()
         delete pending->RemoveFront();
     }
     delete pending;
+    delete bottomHalves;
 }
 
 //----------------------------------------------------------------------
@@ -159,8 +236,9 @@ void Interrupt::OneTick()
     MachineStatus oldStatus = status;
     Statistics *stats = kernel->stats;
 
-    // advance simulated time
-    if (status == SystemMode)
+    // advance simulated time (the kernel's, if a bottom half run
+    // from Idle enabled interrupts)
+    if (status != UserMode)
     {
         stats->totalTicks += SystemTick;
         stats->systemTicks += SystemTick;
@@ -178,6 +256,14 @@ void Interrupt::OneTick()
         // interrupts disabled)
     CheckIfDue(FALSE);          // check for pending interrupts
     ChangeLevel(IntOff, IntOn); // re-enable interrupts
+    if (!bottomHalves->IsEmpty())
+    {   // run the deferred part of the handlers
+        // with interrupts enabled, before we
+        // return to the interrupted code
+        status = SystemMode;
+        RunBottomHalves();
+        status = oldStatus;
+    }
     if (yieldOnReturn)
     {   // if the timer device handler asked
         // for a context switch, ok to do it now
@@ -222,6 +308,17 @@ void Interrupt::Idle()
     status = IdleMode;
     if (CheckIfDue(TRUE))
     { // check for any pending interrupts
+        if (!bottomHalves->IsEmpty())
+        {   // nothing was interrupted, so the deferred
+            // work can run right here, before we look
+            // for a runnable thread -- but with
+            // interrupts enabled, as in OneTick.  We
+            // stay in IdleMode, so that the timer
+            // doesn't make the sleeping thread yield.
+            ChangeLevel(IntOff, IntOn);
+            RunBottomHalves();
+            ChangeLevel(IntOn, IntOff);
+        }
         status = SystemMode;
         return; // return in case there's now
                 // a runnable thread
@@ -232,6 +329,13 @@ void Interrupt::Idle()
     // operating, there are *always* pending interrupts, so this code
     // is not reached.  Instead, the halt must be invoked by the user program.
 
+    // the disk may still have writes buffered, which need a thread
+    if (kernel->StartSync())
+    {
+        status = SystemMode;
+        return;
+    }
+
     DEBUG(dbgInt, "Machine idle.  No interrupts to do.");
     // MP4 mod tag
     /*
@@ -253,6 +357,10 @@ void Interrupt::Halt()
     cout << "This is halt\n";
     kernel->stats->Print();
 	*/
+    if (kernel->printStats)
+    {
+        kernel->stats->Print();
+    }
     delete debug;
 
     delete kernel; // Never returns.
@@ -284,6 +392,71 @@ void Interrupt::Schedule(CallBackObj *toCall, int fromNow, IntType type)
     pending->Insert(toOccur);
 }
 
+//----------------------------------------------------------------------
+// Interrupt::ScheduleBottomHalf
+// 	Called (via BottomHalf::Raise) by an interrupt handler to queue
+//	its deferred work.  A bottom half is queued at most once; it will
+//	run once for every Raise when its turn comes.
+//
+//	If deferral is turned off, the work is done immediately, inside
+//	the interrupt handler -- the way Nachos device handlers have
+//	always worked.  This is useful to compare the time spent with
+//	interrupts disabled.
+//
+//	"bottomHalf" is the deferred work to schedule
+//----------------------------------------------------------------------
+void Interrupt::ScheduleBottomHalf(BottomHalf *bottomHalf)
+{
+    ASSERT(inHandler == TRUE);
+
+    if (!deferBottomHalves)
+    {
+        bottomHalf->Run();
+        return;
+    }
+    if (!bottomHalf->queued)
+    {
+        DEBUG(dbgInt, "Queueing bottom half " << bottomHalf->getName());
+        bottomHalf->queued = TRUE;
+        bottomHalves->Append(bottomHalf);
+    }
+}
+
+//----------------------------------------------------------------------
+// Interrupt::RunBottomHalves
+// 	Run all the deferred work raised by interrupt handlers, in the
+//	order it was raised.  Called after the handlers return, always
+//	with interrupts enabled, so the deferred work can itself advance
+//	simulated time (and so new interrupts may raise more bottom
+//	halves while we are here -- those are picked up by the same loop,
+//	rather than by a nested call).
+//----------------------------------------------------------------------
+void Interrupt::RunBottomHalves()
+{
+    Statistics *stats = kernel->stats;
+    BottomHalf *bottomHalf;
+    double start;
+
+    ASSERT(level == IntOn);
+    if (inBottomHalf || bottomHalves->IsEmpty())
+    {
+        return;
+    }
+    inBottomHalf = TRUE;
+    start = HostTime();
+    stats->numBottomHalfBatches++;
+    while (!bottomHalves->IsEmpty())
+    {
+        bottomHalf = bottomHalves->RemoveFront();
+        bottomHalf->queued = FALSE;
+        DEBUG(dbgInt, "Running bottom half " << bottomHalf->getName());
+        stats->numBottomHalves += bottomHalf->pending;
+        bottomHalf->Run();
+    }
+    stats->bottomHalfTime += HostTime() - start;
+    inBottomHalf = FALSE;
+}
+
 //----------------------------------------------------------------------
 // Interrupt::CheckIfDue
 // 	Check if any interrupts are scheduled to occur, and if so,
@@ -338,8 +511,11 @@ bool Interrupt::CheckIfDue(bool advanceClock)
     inHandler = TRUE;
     do
     {
+        double start = HostTime();
         next = pending->RemoveFront();     // pull interrupt off list
         next->callOnInterrupt->CallBack(); // call the interrupt handler
+        stats->handlerTime[next->type] += HostTime() - start;
+        stats->numHandlerCalls[next->type]++;
         delete next;
     } while (!pending->IsEmpty() && (pending->Front()->when <= stats->totalTicks));
     inHandler = FALSE;
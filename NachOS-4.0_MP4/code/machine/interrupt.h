@@ -34,6 +34,7 @@
 #define INTERRUPT_H
 
 #include "copyright.h"
+#include "utility.h"
 #include "list.h"
 #include "callback.h"
 
@@ -50,6 +51,7 @@ enum MachineStatus {IdleMode, SystemMode, UserMode};
 // display and keyboard, and a network.
 enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt, 
 			NetworkSendInt, NetworkRecvInt};
+const int NumIntTypes = NetworkRecvInt + 1;
 
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
@@ -61,6 +63,9 @@ class PendingInterrupt {
 				// initialize an interrupt that will
 				// occur in the future
 
+    void *operator new(size_t size);	// kept in a slab cache (slab.h)
+    void operator delete(void *toOccur);
+
     CallBackObj *callOnInterrupt;// The object (in the hardware device
 				// emulator) to call when the interrupt occurs
     
@@ -68,6 +73,39 @@ class PendingInterrupt {
     IntType type;		// for debugging
 };
 
+// The following class defines a "bottom half" -- work that a device
+// interrupt handler (the "top half") defers, so that it runs after the
+// handler returns, with interrupts enabled, instead of with interrupts
+// disabled inside the handler.  The top half just calls Raise().
+//
+// Raising a bottom half that is already waiting to run only bumps its
+// count; all the bottom halves raised by the handlers fired in one
+// CheckIfDue are run together, in a single batch, before the
+// interrupted code (possibly a user program) resumes.
+
+class BottomHalf {
+  public:
+    BottomHalf(char *debugName, VoidFunctionPtr func, void *arg);
+				// "func(arg)" is the deferred work,
+				// called once per Raise()
+
+    void Raise();		// Called by an interrupt handler, to
+				// schedule the deferred work
+    void Run();			// Do the deferred work for every Raise()
+				// since the last Run()
+
+    char *getName() { return name; }
+
+  private:
+    char *name;			// for debugging
+    VoidFunctionPtr func;	// deferred work
+    void *arg;
+    int pending;		// # of Raise() calls not yet run
+    bool queued;		// is this on the interrupt's run list?
+
+    friend class Interrupt;
+};
+
 // The following class defines the data structures for the simulation
 // of hardware interrupts.  We record whether interrupts are enabled
 // or disabled, and any hardware interrupts that are scheduled to occur
@@ -107,6 +145,13 @@ class Interrupt {
         			// idle, kernel, user
 
     void DumpState();		// Print interrupt state
+
+    void ScheduleBottomHalf(BottomHalf *bottomHalf);
+				// Queue deferred work from an interrupt
+				// handler (see BottomHalf::Raise)
+    void SetDeferBottomHalves(bool defer) { deferBottomHalves = defer; }
+				// If FALSE, bottom halves run immediately
+				// inside the handler that raises them
     
 
     // NOTE: the following are internal to the hardware simulation code.
@@ -133,6 +178,11 @@ class Interrupt {
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
     MachineStatus status;	// idle, kernel mode, user mode
+    List<BottomHalf *> *bottomHalves;
+    				// deferred work raised by handlers,
+				// waiting to run
+    bool deferBottomHalves;	// run bottom halves after the handler?
+    bool inBottomHalf;		// TRUE if we are running bottom halves
 
     // these functions are internal to the interrupt simulation code
 
@@ -142,6 +192,9 @@ class Interrupt {
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 			IntStatus now); // simulated time
+
+    void RunBottomHalves();	// Run any deferred work raised by
+				// the interrupt handlers
 };
 
 #endif // INTERRRUPT_H
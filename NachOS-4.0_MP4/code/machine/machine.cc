@@ -18,6 +18,24 @@ static char *exceptionNames[] = {"no exception", "syscall",
                                  "bus error", "address error", "overflow",
                                  "illegal instruction"};
 
+// The cost models "-cost" can name (see main.cc): how many ticks an
+// instruction of each class takes -- ALU, multiply or divide, load or
+// store, branch taken (or jump), branch not taken.
+
+static struct CostModel {
+    char *name;
+    int ticks[NumInstrClasses];
+} costModels[] = {
+    { "unit", { 1, 1, 1, 1, 1 } },	// UserTick each, as with no model;
+					// just count the classes
+    { "pipeline", { 1, 20, 2, 3, 1 } }	// a simple 5-stage pipeline: a
+					// load's result is a cycle late,
+					// a taken branch flushes the two
+					// instructions fetched after it,
+					// and multiplies and divides are
+					// done in several steps
+};
+
 //----------------------------------------------------------------------
 // CheckEndian
 // 	Check to be sure that the host really uses the format it says it
@@ -72,6 +90,12 @@ Machine::Machine(bool debug)
 #endif
 
     singleStep = debug;
+    cachesEnabled = FALSE;
+    for (i = 0; i < NumCacheLevels; i++)
+        caches[i] = NULL;
+    cacheCounts = NULL;
+    instrTicks = NULL;
+    extraTicks = 0;
     CheckEndian();
 }
 
@@ -85,6 +109,66 @@ Machine::~Machine()
     delete[] mainMemory;
     if (tlb != NULL)
         delete[] tlb;
+    for (int i = 0; i < NumCacheLevels; i++)
+        delete caches[i];
+}
+
+//----------------------------------------------------------------------
+// Machine::EnableCaches
+// 	Simulate caches between the CPU and main memory (see cache.h),
+//	from now on.  Each is described as for Cache::Parse; "0" leaves
+//	that cache out.
+//
+//	"l1i" -- the level 1 instruction cache
+//	"l1d" -- the level 1 data cache
+//	"l2" -- the unified level 2 cache
+//----------------------------------------------------------------------
+
+void Machine::EnableCaches(char *l1i, char *l1d, char *l2)
+{
+    caches[L1ICache] = Cache::Parse("L1I", l1i);
+    caches[L1DCache] = Cache::Parse("L1D", l1d);
+    caches[L2Cache] = Cache::Parse("L2", l2);
+    cachesEnabled = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::SetCostModel
+// 	From now on, charge each user instruction by its class, rather
+//	than UserTick for every one: an instruction takes the ticks the
+//	cost model gives its class (see InstrClass in stats.h).  Count
+//	the instructions of each class, too.  An instruction that traps
+//	(a system call, or an exception) is still charged UserTick.
+//
+//	"model" -- the name of one of "costModels", or the ticks for
+//		each class, as "<alu>,<mul/div>,<load/store>,<taken>,
+//		<not taken>"; none may be less than UserTick
+//----------------------------------------------------------------------
+
+void Machine::SetCostModel(char *model)
+{
+    int numModels = sizeof(costModels) / sizeof(costModels[0]);
+    int i, numFields;
+
+    for (i = 0; i < numModels; i++)
+        if (strcmp(model, costModels[i].name) == 0)
+            break;
+    if (i < numModels)
+    {
+        for (int j = 0; j < NumInstrClasses; j++)
+            costTable[j] = costModels[i].ticks[j];
+    }
+    else
+    {
+        numFields = sscanf(model, "%d,%d,%d,%d,%d", &costTable[ALUInstr],
+                           &costTable[MulDivInstr], &costTable[MemoryInstr],
+                           &costTable[TakenBranchInstr],
+                           &costTable[UntakenBranchInstr]);
+        ASSERT(numFields == NumInstrClasses);
+    }
+    for (i = 0; i < NumInstrClasses; i++)
+        ASSERT(costTable[i] >= UserTick);
+    instrTicks = costTable;
 }
 
 //----------------------------------------------------------------------
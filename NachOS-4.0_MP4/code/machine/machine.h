@@ -24,6 +24,8 @@
 #include "copyright.h"
 #include "utility.h"
 #include "translate.h"
+#include "cache.h"
+#include "stats.h"
 
 // Definitions related to the size, and format of user memory
 
@@ -141,11 +143,24 @@ public:
 	TranslationEntry *pageTable;
 	unsigned int pageTableSize;
 
-	bool ReadMem(int addr, int size, int *value);
+	bool ReadMem(int addr, int size, int *value, bool fetch = FALSE);
 	bool WriteMem(int addr, int size, int value);
 	// Read or write 1, 2, or 4 bytes of virtual
 	// memory (at addr).  Return FALSE if a
 	// correct translation couldn't be found.
+	// "fetch" is TRUE for instruction fetches.
+
+	void EnableCaches(char *l1i, char *l1d, char *l2);
+	// Simulate caches between the CPU and
+	// memory, described as for Cache::Parse
+	bool CachesEnabled() { return cachesEnabled; }
+
+	void SetCostModel(char *model);
+	// Charge user instructions by their class,
+	// by a named model or a list of ticks
+
+	CacheCounts *cacheCounts; // the running program's cache hits and
+		// misses (set by AddrSpace::RestoreState)
 private:
 	// Routines internal to the machine simulation -- DO NOT call these directly
 	void DelayedLoad(int nextReg, int nextVal);
@@ -161,6 +176,14 @@ private:
 	// and return an exception code if the
 	// translation couldn't be completed.
 
+	void CacheAccess(int physAddr, CacheLevel level);
+	// Reference a physical address through the
+	// caches, adding the time its misses take
+	// to "extraTicks"
+	bool CacheHit(CacheLevel level, int physAddr);
+	// Reference it in one cache, and count
+	// whether it hit
+
 	void RaiseException(ExceptionType which, int badVAddr);
 	// Trap to the Nachos kernel, because of a
 	// system call or other exception.
@@ -177,6 +200,15 @@ private:
 	int runUntilTime; // drop back into the debugger when simulated
 		// time reaches this value
 
+	bool cachesEnabled; // are the caches simulated?
+	Cache *caches[NumCacheLevels]; // NULL for a level left out
+	int *instrTicks; // time each class of instruction takes
+		// (see SetCostModel), or NULL for UserTick
+	int costTable[NumInstrClasses]; // where instrTicks points
+	int extraTicks; // time the instruction being run takes
+		// beyond UserTick: waiting for cache misses,
+		// and what the cost model charges
+
 	friend class Interrupt; // calls DelayedLoad()
 };
 
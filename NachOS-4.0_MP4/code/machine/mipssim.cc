@@ -66,6 +66,11 @@ void Machine::Run()
 	for (;;)
 	{
 		OneInstruction(instr);
+		if (extraTicks > 0)
+		{ // the instruction took longer than UserTick
+			kernel->stats->totalTicks += extraTicks;
+			extraTicks = 0;
+		}
 		kernel->interrupt->OneTick();
 		if (singleStep && (runUntilTime <= kernel->stats->totalTicks))
 			Debugger();
@@ -95,6 +100,59 @@ TypeToReg(RegType reg, Instruction *instr)
 	}
 }
 
+//----------------------------------------------------------------------
+// InstrClassOf
+// 	Return the class of an instruction, for the cost model (see
+//	Machine::SetCostModel).  A conditional branch is returned as not
+//	taken; OneInstruction knows whether it was.
+//----------------------------------------------------------------------
+
+static InstrClass
+InstrClassOf(int opCode)
+{
+	switch (opCode)
+	{
+	case OP_MULT:
+	case OP_MULTU:
+	case OP_DIV:
+	case OP_DIVU:
+		return MulDivInstr;
+
+	case OP_LB:
+	case OP_LBU:
+	case OP_LH:
+	case OP_LHU:
+	case OP_LW:
+	case OP_LWL:
+	case OP_LWR:
+	case OP_SB:
+	case OP_SH:
+	case OP_SW:
+	case OP_SWL:
+	case OP_SWR:
+		return MemoryInstr;
+
+	case OP_BEQ:
+	case OP_BGEZ:
+	case OP_BGEZAL:
+	case OP_BGTZ:
+	case OP_BLEZ:
+	case OP_BLTZ:
+	case OP_BLTZAL:
+	case OP_BNE:
+		return UntakenBranchInstr;
+
+	case OP_J:
+	case OP_JAL:
+	case OP_JALR:
+	case OP_JR:
+		return TakenBranchInstr;
+
+	default:
+		return ALUInstr;
+	}
+}
+
 //----------------------------------------------------------------------
 // Machine::OneInstruction
 // 	Execute one instruction from a user-level program
@@ -130,7 +188,7 @@ void Machine::OneInstruction(Instruction *instr)
 		// in the future
 
 	// Fetch instruction
-	if (!ReadMem(registers[PCReg], 4, &raw))
+	if (!ReadMem(registers[PCReg], 4, &raw, TRUE))
 		return; // exception occurred
 	instr->value = raw;
 	instr->Decode();
@@ -697,6 +755,19 @@ void Machine::OneInstruction(Instruction *instr)
 
 	// Now we have successfully executed the instruction.
 
+	// Charge it what the cost model says its class takes (a branch
+	// was taken if it changed where we go after the delay slot)
+	if (instrTicks != NULL)
+	{
+		InstrClass which = InstrClassOf(instr->opCode);
+
+		if (which == UntakenBranchInstr && pcAfter != registers[NextPCReg] + 4)
+			which = TakenBranchInstr;
+		kernel->stats->numUserInstrs[which]++;
+		kernel->stats->costTicks += instrTicks[which] - UserTick;
+		extraTicks += instrTicks[which] - UserTick;
+	}
+
 	// Do any delayed load operation
 	DelayedLoad(nextLoadReg, nextLoadValue);
 
@@ -27,9 +27,10 @@ NetworkInput::NetworkInput(CallBackObj *toCall)
     inHdr.length = 0;
 
     sock = OpenSocket();
-    sprintf(sockName, "SOCKET_%d", kernel->hostName);
+    kernel->InstanceFileName(sockName, sizeof(sockName), "SOCKET",
+                             kernel->hostName);
     AssignNameToSocket(sockName, sock); // Bind socket to a filename
-                                        // in the current directory.
+                                        // in the instance's directory.
 
     // start polling for incoming packets
     kernel->interrupt->Schedule(this, NetworkTime, NetworkRecvInt);
@@ -159,9 +160,9 @@ void NetworkOutput::CallBack()
 
 void NetworkOutput::Send(PacketHeader hdr, char *data)
 {
-    char toName[32];
+    char toName[MaxSocketName];
 
-    sprintf(toName, "SOCKET_%d", (int)hdr.to);
+    kernel->InstanceFileName(toName, sizeof(toName), "SOCKET", (int)hdr.to);
 
     ASSERT((sendBusy == FALSE) && (hdr.length > 0) &&
            (hdr.length <= MaxPacketSize) && (hdr.from == kernel->hostName));
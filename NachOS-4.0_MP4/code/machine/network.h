@@ -39,6 +39,7 @@ public:
                          // MailHeader prepended by the post office)
 };
 
+#define MaxSocketName 108 // longest UNIX socket file name
 #define MaxWireSize 64 // largest packet that can go out on the wire
 #define MaxPacketSize (MaxWireSize - sizeof(struct PacketHeader))
 // data "payload" of the largest packet
@@ -71,7 +72,7 @@ public:
 
 private:
     int sock;          // UNIX socket number for incoming packets
-    char sockName[32]; // File name corresponding to UNIX socket
+    char sockName[MaxSocketName]; // File name corresponding to UNIX socket
 
     CallBackObj *callWhenAvail; // Interrupt handler, signalling packet has
         // 	arrived.
@@ -10,6 +10,8 @@
 #include "copyright.h"
 #include "debug.h"
 #include "stats.h"
+#include "slab.h"
+#include "crc32c.h"
 
 //----------------------------------------------------------------------
 // Statistics::Statistics
@@ -22,6 +24,23 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numFlashWrites = numFlashGCWrites = numFlashErases = numTrims = 0;
+    numChunksRead = numChunksWritten = 0;
+    chunkBytesIn = chunkBytesOut = 0;
+    numLogSectors = numLogSegments = numLogCleaned = numLogCopied = 0;
+    numCheckpoints = 0;
+    numSectorsSummed = numSectorsChecked = numChecksumErrors = 0;
+    numSumsRead = numSumsWritten = 0;
+    checksumTime = 0;
+    for (int i = 0; i < NumInstrClasses; i++)
+	numUserInstrs[i] = 0;
+    costTicks = 0;
+    for (int i = 0; i < NumIntTypes; i++) {
+	handlerTime[i] = 0;
+	numHandlerCalls[i] = 0;
+    }
+    bottomHalfTime = 0;
+    numBottomHalves = numBottomHalfBatches = 0;
 }
 
 //----------------------------------------------------------------------
@@ -42,4 +61,77 @@ Statistics::Print()
     cout << "Paging: faults " << numPageFaults << "\n";
     cout << "Network I/O: packets received " << numPacketsRecvd;
 		cout << ", sent " << numPacketsSent << "\n";
+    if (numFlashWrites > 0 || numTrims > 0) {
+	cout << "Flash: writes " << numFlashWrites;
+	cout << ", GC writes " << numFlashGCWrites;
+	cout << ", erases " << numFlashErases;
+	cout << ", trims " << numTrims;
+	if (numFlashWrites > 0) {
+	    cout << ", write amplification ";
+	    cout << (double)(numFlashWrites + numFlashGCWrites) / numFlashWrites;
+	}
+	cout << "\n";
+    }
+    if (numChunksRead > 0 || numChunksWritten > 0) {
+	cout << "Compression: chunks read " << numChunksRead;
+	cout << ", written " << numChunksWritten;
+	cout << ", bytes " << chunkBytesIn << " -> " << chunkBytesOut;
+	if (chunkBytesOut > 0)
+	    cout << ", ratio " << (double)chunkBytesIn / chunkBytesOut;
+	cout << "\n";
+    }
+    if (numCheckpoints > 0) {
+	cout << "Log: sectors written " << numLogSectors;
+	cout << ", segment writes " << numLogSegments;
+	cout << ", checkpoints " << numCheckpoints;
+	cout << ", segments cleaned " << numLogCleaned;
+	cout << ", sectors copied " << numLogCopied << "\n";
+    }
+    if (numSumsRead > 0 || numSumsWritten > 0) {
+	cout << "Checksums: sectors summed " << numSectorsSummed;
+	cout << ", checked " << numSectorsChecked;
+	cout << ", errors " << numChecksumErrors << "\n";
+	cout << "  checksum sectors read " << numSumsRead;
+	cout << ", written " << numSumsWritten;
+	cout << ", host usec " << checksumTime;
+	cout << (Crc32cHardware() ? " (SSE4.2)" : " (tables)") << "\n";
+    }
+    if (numUserInstrs[ALUInstr] > 0) {	// a cost model is used
+	cout << "User instructions: ALU " << numUserInstrs[ALUInstr];
+	cout << ", mul/div " << numUserInstrs[MulDivInstr];
+	cout << ", load/store " << numUserInstrs[MemoryInstr];
+	cout << ", branches taken " << numUserInstrs[TakenBranchInstr];
+	cout << ", not taken " << numUserInstrs[UntakenBranchInstr] << "\n";
+	cout << "  ticks beyond " << UserTick << " each " << costTicks << "\n";
+    }
+    if (cacheCounts.accesses[L1ICache] > 0 || cacheCounts.stallTicks > 0)
+	cacheCounts.Print("all programs");	// the caches are simulated
+    PrintInterrupts();
+    ObjectCache::PrintAll();
+}
+
+//----------------------------------------------------------------------
+// Statistics::PrintInterrupts
+// 	Print how long (in host time) the device interrupt handlers kept
+//	interrupts disabled, and how much work they deferred to bottom
+//	halves.
+//----------------------------------------------------------------------
+
+void
+Statistics::PrintInterrupts()
+{
+    static char *names[] = { "timer", "disk", "console write",
+			     "console read", "network send", "network recv" };
+
+    cout << "Interrupt handlers (host usec with interrupts off):\n";
+    for (int i = 0; i < NumIntTypes; i++) {
+	if (numHandlerCalls[i] == 0)
+	    continue;
+	cout << "  " << names[i] << ": calls " << numHandlerCalls[i];
+	cout << ", total " << handlerTime[i];
+	cout << ", per call " << handlerTime[i] / numHandlerCalls[i] << "\n";
+    }
+    cout << "Bottom halves: run " << numBottomHalves;
+    cout << ", batches " << numBottomHalfBatches;
+    cout << ", host usec " << bottomHalfTime << "\n";
 }
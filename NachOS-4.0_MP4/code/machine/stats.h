@@ -12,6 +12,20 @@
 #define STATS_H
 
 #include "copyright.h"
+#include "interrupt.h"
+#include "cache.h"
+
+// Classes of user instructions, which a cost model can charge different
+// times for (see Machine::SetCostModel).
+
+enum InstrClass {
+    ALUInstr,			// arithmetic, logic, shifts and moves
+    MulDivInstr,		// multiplies and divides
+    MemoryInstr,		// loads and stores
+    TakenBranchInstr,		// branches taken, and jumps
+    UntakenBranchInstr,		// branches not taken
+    NumInstrClasses
+};
 
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
@@ -35,10 +49,54 @@ class Statistics {
     int numPageFaults;		// number of virtual memory page faults
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int numFlashWrites;		// number of flash pages written for
+				// disk write requests
+    int numFlashGCWrites;	// number of flash pages copied by the
+				// garbage collector
+    int numFlashErases;		// number of flash blocks erased
+    int numTrims;		// number of sectors trimmed
+    int numChunksRead;		// number of compressed chunks expanded
+    int numChunksWritten;	// number of compressed chunks written
+    int chunkBytesIn;		// bytes of data in the chunks written
+    int chunkBytesOut;		// bytes they were stored in
+    int numLogSectors;		// number of sectors the file system
+				// wrote to the log (filesys/logdisk.h)
+    int numLogSegments;		// number of segment writes
+    int numLogCleaned;		// number of segments cleaned
+    int numLogCopied;		// number of live sectors the cleaner
+				// copied
+    int numCheckpoints;		// number of log checkpoints
+    int numSectorsSummed;	// number of sectors written with a
+				// checksum (filesys/synchdisk.h)
+    int numSectorsChecked;	// number of sectors read and checked
+				// against their checksums
+    int numChecksumErrors;	// number that didn't match
+    int numSumsRead;		// number of checksum sectors read
+    int numSumsWritten;		// number of checksum sectors written
+    double checksumTime;	// host time (usec) spent computing
+				// checksums
+    int numUserInstrs[NumInstrClasses];
+    				// user instructions of each class run
+				// (if a cost model is used)
+    int costTicks;		// time they took beyond UserTick each
+    CacheCounts cacheCounts;	// references to the caches by all user
+				// programs, and how many missed (if the
+				// caches are simulated: see cache.h)
+
+    double handlerTime[NumIntTypes];
+    				// host time (usec) spent with interrupts
+				// disabled in each kind of device handler
+    int numHandlerCalls[NumIntTypes];
+    				// number of interrupts of each kind
+    double bottomHalfTime;	// host time (usec) spent running bottom
+				// halves deferred by the handlers
+    int numBottomHalves;	// number of deferred work items run
+    int numBottomHalfBatches;	// number of times bottom halves were run
 
     Statistics(); 		// initialize everything to zero
 
     void Print();		// print collected statistics
+    void PrintInterrupts();	// print interrupt handler timing
 };
 
 // Constants used to reflect the relative time an operation would
@@ -53,6 +111,12 @@ const int UserTick = 	   1;	// advance for each user-level instruction
 const int SystemTick =	  10; 	// advance each time interrupts are enabled
 const int RotationTime = 500; 	// time disk takes to rotate one sector
 const int SeekTime =	 500;  	// time disk takes to seek past one track
+const int L2Time =	  10;	// time to fill a level 1 cache line from
+				// the level 2 cache
+const int MemoryTime =	 100;	// time to fill a cache line from memory
+const int FlashReadTime =  25;	// time to read one flash page
+const int FlashProgramTime = 200; // time to write one flash page
+const int FlashEraseTime = 1500; // time to erase one flash block
 const int ConsoleTime =	 100;	// time to read or write one character
 const int NetworkTime =	 100;  	// time to send or receive one packet
 const int TimerTicks = 	 100;  	// (average) time between timer interrupts
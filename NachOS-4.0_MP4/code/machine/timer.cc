@@ -40,9 +40,24 @@ Timer::Timer(bool doRandom, CallBackObj *toCall)
     randomize = doRandom;
     callPeriodically = toCall;
     disable = FALSE;
+    pending = FALSE;
     SetInterrupt();
 }
 
+//----------------------------------------------------------------------
+// Timer::Enable
+//      Turn the timer device back on after Disable.  If the interrupt
+//	that was scheduled before it was turned off hasn't come yet, it
+//	will schedule the next one as usual; otherwise schedule one now.
+//----------------------------------------------------------------------
+
+void Timer::Enable()
+{
+    disable = FALSE;
+    if (!pending)
+        SetInterrupt();
+}
+
 //----------------------------------------------------------------------
 // Timer::CallBack
 //      Routine called when interrupt is generated by the hardware
@@ -51,6 +66,8 @@ Timer::Timer(bool doRandom, CallBackObj *toCall)
 //----------------------------------------------------------------------
 void Timer::CallBack()
 {
+    pending = FALSE;
+
     // invoke the Nachos interrupt handler for this device
     callPeriodically->CallBack();
 
@@ -77,5 +94,6 @@ void Timer::SetInterrupt()
         }
         // schedule the next timer device interrupt
         kernel->interrupt->Schedule(this, delay, TimerInt);
+        pending = TRUE;
     }
 }
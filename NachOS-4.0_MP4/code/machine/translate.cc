@@ -81,9 +81,10 @@ ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
 //	"addr" -- the virtual address to read from
 //	"size" -- the number of bytes to read (1, 2, or 4)
 //	"value" -- the place to write the result
+//	"fetch" -- is this an instruction fetch (or a load)?
 //----------------------------------------------------------------------
 
-bool Machine::ReadMem(int addr, int size, int *value)
+bool Machine::ReadMem(int addr, int size, int *value, bool fetch)
 {
 	int data;
 	ExceptionType exception;
@@ -97,6 +98,8 @@ bool Machine::ReadMem(int addr, int size, int *value)
 		RaiseException(exception, addr);
 		return FALSE;
 	}
+	if (cachesEnabled)
+		CacheAccess(physicalAddress, fetch ? L1ICache : L1DCache);
 	switch (size)
 	{
 	case 1:
@@ -148,6 +151,8 @@ bool Machine::WriteMem(int addr, int size, int value)
 		RaiseException(exception, addr);
 		return FALSE;
 	}
+	if (cachesEnabled)
+		CacheAccess(physicalAddress, L1DCache);
 	switch (size)
 	{
 	case 1:
@@ -169,6 +174,61 @@ bool Machine::WriteMem(int addr, int size, int value)
 	return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Machine::CacheAccess
+//      Send a reference to physical address "physAddr" through the
+//	caches: the level 1 cache "level", and on a miss the level 2
+//	cache, and on a miss there main memory.  Add the time the misses
+//	take to "extraTicks", for Run to charge once the instruction is
+//	done.  A cache left out is passed straight through.
+//
+//	"physAddr" -- the physical address referenced
+//	"level" -- L1ICache for an instruction fetch, L1DCache for a
+//		load or store
+//----------------------------------------------------------------------
+
+void Machine::CacheAccess(int physAddr, CacheLevel level)
+{
+	int ticks;
+
+	if (caches[level] != NULL && CacheHit(level, physAddr))
+		return;
+	if (caches[L2Cache] == NULL)
+		ticks = MemoryTime;
+	else if (CacheHit(L2Cache, physAddr))
+		ticks = L2Time;
+	else
+		ticks = L2Time + MemoryTime;
+	extraTicks += ticks;
+	kernel->stats->cacheCounts.stallTicks += ticks;
+	if (cacheCounts != NULL)
+		cacheCounts->stallTicks += ticks;
+}
+
+//----------------------------------------------------------------------
+// Machine::CacheHit
+//      Reference physical address "physAddr" in the cache "level", and
+//	count whether it hit, for the running program and in total.
+//	Return TRUE if it did.
+//----------------------------------------------------------------------
+
+bool Machine::CacheHit(CacheLevel level, int physAddr)
+{
+	bool hit = caches[level]->Access(physAddr);
+	CacheCounts *total = &kernel->stats->cacheCounts;
+
+	total->accesses[level]++;
+	if (!hit)
+		total->misses[level]++;
+	if (cacheCounts != NULL)
+	{
+		cacheCounts->accesses[level]++;
+		if (!hit)
+			cacheCounts->misses[level]++;
+	}
+	return hit;
+}
+
 //----------------------------------------------------------------------
 // Machine::Translate
 // 	Translate a virtual address into a physical address, using
@@ -153,6 +153,8 @@ MailBox::Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data)
 PostOfficeInput::PostOfficeInput(int nBoxes)
 {
     messageAvailable = new Semaphore("message available", 0);
+    bottomHalf = new BottomHalf("message available",
+				PostOfficeInput::MessageArrived, this);
 
     numBoxes = nBoxes;
     boxes = new MailBox[nBoxes];
@@ -177,6 +179,7 @@ PostOfficeInput::~PostOfficeInput()
 {
     delete network;
     delete [] boxes;
+    delete bottomHalf;
 }
 
 //----------------------------------------------------------------------
@@ -245,12 +248,27 @@ PostOfficeInput::Receive(int box, PacketHeader *pktHdr,
 // 	Interrupt handler, called when a packet arrives from the network.
 //
 //	Signal the PostalDelivery routine that it is time to get to work!
+//	The signal itself is deferred to a bottom half.
 //----------------------------------------------------------------------
 
 void
 PostOfficeInput::CallBack()
 { 
-    messageAvailable->V(); 
+    bottomHalf->Raise();
+}
+
+//----------------------------------------------------------------------
+// PostOfficeInput::MessageArrived
+// 	Bottom half of the network receive interrupt: wake up the
+//	PostalDelivery routine.
+//----------------------------------------------------------------------
+
+void
+PostOfficeInput::MessageArrived(void *arg)
+{
+    PostOfficeInput *postOffice = (PostOfficeInput *)arg;
+
+    postOffice->messageAvailable->V();
 }
 
 //----------------------------------------------------------------------
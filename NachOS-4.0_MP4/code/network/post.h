@@ -30,6 +30,7 @@
 #include "copyright.h"
 #include "utility.h"
 #include "callback.h"
+#include "interrupt.h"
 #include "network.h"
 #include "synchlist.h"
 #include "synch.h"
@@ -125,6 +126,10 @@ class PostOfficeInput : public CallBackObj {
     MailBox *boxes;		// Table of mail boxes to hold incoming mail
     int numBoxes;		// Number of mail boxes
     Semaphore *messageAvailable;// V'ed when message has arrived from network
+    BottomHalf *bottomHalf;	// Deferred part of CallBack
+
+    static void MessageArrived(void *arg);
+				// Bottom half of CallBack
 };
 
 class PostOfficeOutput : public CallBackObj {
@@ -0,0 +1,19 @@
+# Build a "golden" disk once, then run scenarios on copy-on-write
+# overlays of it: removing DISK_0 resets the disk to the golden image,
+# with no reformat or reimport.
+if [ ! -f DISK_golden ]; then
+	rm -f DISK_0
+	../build.linux/nachos -f
+	../build.linux/nachos -mkdir /t0
+	../build.linux/nachos -cp num_100.txt /t0/f1
+	../build.linux/nachos -cp num_1000.txt /t0/f2
+	mv DISK_0 DISK_golden
+fi
+rm -f DISK_0
+../build.linux/nachos -overlay DISK_golden -cp num_100.txt /t0/f3
+../build.linux/nachos -overlay DISK_golden -l /t0
+echo "========================================="
+../build.linux/nachos -overlay DISK_golden -discard -r /t0/f1
+../build.linux/nachos -overlay DISK_golden -l /t0
+echo "========================================="
+../build.linux/nachos -overlay DISK_golden -discard -p /t0/f1
@@ -0,0 +1,87 @@
+#include "syscall.h"
+
+#define Instances	8	// runs that can have a file of their own
+#define Rounds		4	// chunks each run writes to its file
+#define Chunk		40
+
+// the bytes run "me" writes as its chunk number "round"
+void Fill(char *buffer, int me, int round)
+{
+	int i;
+	for (i = 0; i < Chunk; ++i)
+		buffer[i] = 'a' + (me * 7 + round * 3 + i) % 26;
+}
+
+int Same(char *buffer, int me, int round)
+{
+	int i;
+	for (i = 0; i < Chunk; ++i)
+	{
+		if (buffer[i] != 'a' + (me * 7 + round * 3 + i) % 26)
+			return 0;
+	}
+	return 1;
+}
+
+int main(void)
+{
+	// run several times, one after another, on the same disk (see
+	// FS_stress.script): each run claims a file of its own, the first
+	// /stressN not taken yet, and fills it with Write, while the aio
+	// worker writes the run's part of /shared and reads back what the
+	// run wrote before -- so the program's system calls and the worker
+	// use the open file table, and the same files, at the same time.
+	// Exits with 0, or with the number of the check that failed.
+	char name[] = "/stress0";
+	char data[Chunk], part[Chunk], back[Chunk];
+	char all[Instances * Chunk];
+	AioId wrote, read;
+	OpenFileId own, shared;
+	int me, round, i;
+	Create("/shared", Instances * Chunk);	// only the first run makes it
+	for (me = 0; me < Instances; ++me)
+	{
+		name[7] = '0' + me;
+		if (Create(name, Rounds * Chunk) == 1)
+			break;
+	}
+	if (me == Instances)
+		Exit(1);
+	own = Open(name);
+	shared = Open("/shared");
+	if (own < 0 || shared < 0)
+		Exit(2);
+	for (round = 0; round < Rounds; ++round)
+	{
+		Fill(part, me, Rounds + round);
+		wrote = AioWrite(part, Chunk, me * Chunk, shared);
+		read = -1;
+		if (round > 0)
+			read = AioRead(back, Chunk, (round - 1) * Chunk, own);
+		Fill(data, me, round);
+		if (Write(data, Chunk, own) != Chunk)
+			Exit(3);
+		if (AioWait(wrote) != Chunk)
+			Exit(4);
+		if (round > 0 && (AioWait(read) != Chunk || !Same(back, me, round - 1)))
+			Exit(5);
+	}
+	Close(own);
+	own = Open(name);
+	for (round = 0; round < Rounds; ++round)
+	{
+		if (Read(back, Chunk, own) != Chunk || !Same(back, me, round))
+			Exit(6);
+	}
+	Close(own);
+	// the runs before this one must have left their parts as they were
+	if (Read(all, Instances * Chunk, shared) != Instances * Chunk)
+		Exit(7);
+	for (i = 0; i <= me; ++i)
+	{
+		if (!Same(&all[i * Chunk], i, 2 * Rounds - 1))
+			Exit(8);
+	}
+	Close(shared);
+	Exit(0);
+}
@@ -0,0 +1,20 @@
+# Several threads creating, writing, reading and removing files at once:
+# each run checks that the file system is left consistent, and compares
+# the throughput of four threads with that of one.  With more than one
+# request at the disk (-qd) or more than one disk (-raid), the threads'
+# disk waits overlap.
+for opts in "" "-qd 8" "-raid 4" "-raid 4 -qd 8"; do
+	echo "========================================= $opts"
+	rm -f DISK_0 DISK_0_?
+	../build.linux/nachos $opts -f -F
+done
+
+# User programs, through the system calls and the open file table (see
+# FS_stress.script; the FS_stress program must be built with "make").
+# User programs share physical memory one to one, so they can't run at
+# once; in each run, the program and the aio worker share the files.
+echo "========================================= FS_stress.script"
+rm -f DISK_0
+../build.linux/nachos -f -script FS_stress.script -stats | \
+	grep -e "return value" -e "^Ticks"
+../../diskinspect/diskinspect DISK_0 check
@@ -0,0 +1,44 @@
+#include "syscall.h"
+
+int main(void)
+{
+	// run on a freshly formatted disk: works in /d and /d/e
+	char test[27];
+	char check[] = "abcdefghijklmnopqrstuvwxyz\n";
+	OpenFileId dir, fid;
+	int count, i;
+	if (MkdirAt(CurrentDirectory, "/d") != 1 || MkdirAt(CurrentDirectory, "/d/e") != 1)
+		MSG("Failed on making directories");
+	dir = Open("/d/e");
+	if (dir < 0)
+		MSG("Failed on opening directory");
+	if (CreateAt(dir, "file1", 27) != 1)
+		MSG("Failed on creating file");
+	fid = OpenAt(dir, "file1");
+	if (fid < 0)
+		MSG("Failed on opening file");
+	if (Write(check, 27, fid) != 27)
+		MSG("Failed on writing file");
+	Close(fid);
+	if (Chdir("/d") != 1)
+		MSG("Failed on changing directory");
+	fid = Open("e/file1");
+	if (fid < 0)
+		MSG("Failed on opening file by relative name");
+	count = Read(test, 27, fid);
+	if (count != 27)
+		MSG("Failed on reading file");
+	Close(fid);
+	for (i = 0; i < 27; ++i)
+	{
+		if (test[i] != check[i])
+			MSG("Failed: reading wrong result");
+	}
+	if (RemoveAt(CurrentDirectory, "e") != 0)
+		MSG("Failed: removed a directory that has files");
+	if (RemoveAt(dir, "file1") != 1 || RemoveAt(CurrentDirectory, "e") != 1)
+		MSG("Failed on removing");
+	Close(dir);
+	MSG("Passed! ^_^");
+	Halt();
+}
@@ -0,0 +1,69 @@
+#include "syscall.h"
+
+#define Batch	8
+
+/* Total the sizes of the files under the open directory "dir" (du),
+ * Batch names per ReadDir call; count the calls in "*calls". */
+int Usage(OpenFileId dir, int *calls)
+{
+	DirEntry entries[Batch];
+	int cursor = 0, total = 0, count, i;
+	OpenFileId sub;
+	do {
+		count = ReadDir(dir, entries, Batch, &cursor);
+		(*calls)++;
+		if (count < 0)
+			MSG("Failed on reading directory");
+		for (i = 0; i < count; ++i)
+		{
+			if (entries[i].type == DirEntryDirectory) {
+				sub = OpenAt(dir, entries[i].name);
+				if (sub < 0)
+					MSG("Failed on opening directory");
+				total += Usage(sub, calls);
+				Close(sub);
+			} else
+				total += entries[i].size;
+		}
+	} while (count > 0);
+	return total;
+}
+
+int main(void)
+{
+	// run on a freshly formatted disk: 20 files in /r, 1 in /r/s
+	DirEntry entries[Batch];
+	char name[3];
+	OpenFileId dir, fid;
+	int calls = 0, cursor = 0, i;
+	if (MkdirAt(CurrentDirectory, "/r") != 1 || MkdirAt(CurrentDirectory, "/r/s") != 1)
+		MSG("Failed on making directories");
+	dir = Open("/r");
+	if (dir < 0)
+		MSG("Failed on opening directory");
+	name[0] = 'f';
+	name[2] = '\0';
+	for (i = 0; i < 20; ++i)
+	{
+		name[1] = 'a' + i;
+		if (CreateAt(dir, name, 10 * (i + 1)) != 1)
+			MSG("Failed on creating file");
+	}
+	if (Create("/r/s/g", 100) != 1)
+		MSG("Failed on creating file");
+	// 2200 bytes in all; the 21 names in /r take 3 calls, plus one
+	// that returns none, and /r/s takes 2
+	if (Usage(dir, &calls) != 2200)
+		MSG("Failed: wrong total size");
+	if (calls != 6)
+		MSG("Failed: wrong number of ReadDir calls");
+	fid = OpenAt(dir, "fa");
+	if (fid < 0)
+		MSG("Failed on opening file");
+	if (ReadDir(fid, entries, Batch, &cursor) != -1)
+		MSG("Failed: listed a file");
+	Close(fid);
+	Close(dir);
+	MSG("Passed! ^_^");
+	Halt();
+}
@@ -0,0 +1,48 @@
+#include "syscall.h"
+
+int main(void)
+{
+	// run on a freshly formatted disk: a record in three pieces
+	char label[] = "rec 1 ", body[] = "abcdefghijklmnopqrst", newline[] = "\n";
+	char check[] = "rec 1 abcdefghijklmnopqrst\n";
+	char first[6], rest[21];
+	IoVec pieces[3];
+	OpenFileId fid;
+	int i;
+	if (Create("/file1", 27) != 1)
+		MSG("Failed on creating file");
+	fid = Open("/file1");
+	if (fid < 0)
+		MSG("Failed on opening file");
+	pieces[0].base = label;
+	pieces[0].size = 6;
+	pieces[1].base = body;
+	pieces[1].size = 20;
+	pieces[2].base = newline;
+	pieces[2].size = 1;
+	if (WriteV(pieces, 3, fid) != 27)
+		MSG("Failed on writing pieces");
+	Close(fid);
+	fid = Open("/file1");
+	if (fid < 0)
+		MSG("Failed on opening file");
+	pieces[0].base = first;
+	pieces[0].size = 6;
+	pieces[1].base = rest;
+	pieces[1].size = 21;
+	if (ReadV(pieces, 2, fid) != 27)
+		MSG("Failed on reading pieces");
+	Close(fid);
+	for (i = 0; i < 6; ++i)
+	{
+		if (first[i] != check[i])
+			MSG("Failed: reading wrong result");
+	}
+	for (i = 0; i < 21; ++i)
+	{
+		if (rest[i] != check[6 + i])
+			MSG("Failed: reading wrong result");
+	}
+	MSG("Passed! ^_^");
+	Halt();
+}
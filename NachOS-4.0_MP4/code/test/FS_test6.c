@@ -0,0 +1,44 @@
+#include "syscall.h"
+
+int main(void)
+{
+	// run on a freshly formatted disk: write two halves in the
+	// background, out of order, then read them back the same way
+	char first[] = "abcdefghijklmnopqrstuvwxyz", second[] = "0123456789";
+	char back[36];
+	AioId w1, w2, r1, r2;
+	OpenFileId fid;
+	int i, busy = 0;
+	if (Create("/file1", 36) != 1)
+		MSG("Failed on creating file");
+	fid = Open("/file1");
+	if (fid < 0)
+		MSG("Failed on opening file");
+	w2 = AioWrite(second, 10, 26, fid);
+	w1 = AioWrite(first, 26, 0, fid);
+	if (w1 < 0 || w2 < 0)
+		MSG("Failed on starting writes");
+	while (AioPoll(w1) == 0)
+		++busy;			// work while the disk is busy
+	if (AioWait(w1) != 26 || AioWait(w2) != 10)
+		MSG("Failed on writing");
+	if (AioPoll(w1) != -1)
+		MSG("Failed: handle still in use");
+	r2 = AioRead(&back[26], 10, 26, fid);
+	r1 = AioRead(back, 26, 0, fid);
+	if (AioWait(r1) != 26 || AioWait(r2) != 10)
+		MSG("Failed on reading");
+	Close(fid);
+	for (i = 0; i < 26; ++i)
+	{
+		if (back[i] != first[i])
+			MSG("Failed: reading wrong result");
+	}
+	for (i = 0; i < 10; ++i)
+	{
+		if (back[26 + i] != second[i])
+			MSG("Failed: reading wrong result");
+	}
+	MSG("Passed! ^_^");
+	Halt();
+}
@@ -0,0 +1,38 @@
+#include "syscall.h"
+
+int main(void)
+{
+	// run on a freshly formatted disk: write a file, then shrink it
+	// by name and by open file, and read what is left
+	char data[] = "abcdefghijklmnopqrstuvwxyz";
+	char back[26];
+	OpenFileId fid;
+	int i;
+	if (Create("/file1", 26) != 1)
+		MSG("Failed on creating file");
+	fid = Open("/file1");
+	if (fid < 0)
+		MSG("Failed on opening file");
+	if (Write(data, 26, fid) != 26)
+		MSG("Failed on writing file");
+	Close(fid);
+	if (Truncate("/file1", 30) != 0)
+		MSG("Failed: file grew");
+	if (Truncate("/file1", 20) != 1)
+		MSG("Failed on truncating file");
+	fid = Open("/file1");
+	if (fid < 0)
+		MSG("Failed on opening file");
+	if (FTruncate(fid, 10) != 1)
+		MSG("Failed on truncating open file");
+	if (Read(back, 26, fid) != 10)
+		MSG("Failed: wrong length after truncating");
+	Close(fid);
+	for (i = 0; i < 10; ++i)
+	{
+		if (back[i] != data[i])
+			MSG("Failed: reading wrong result");
+	}
+	MSG("Passed! ^_^");
+	Halt();
+}
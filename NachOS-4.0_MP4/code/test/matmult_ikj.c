@@ -0,0 +1,45 @@
+/* matmult_ikj.c 
+ *    The same matrix multiplication as matmult.c, with the two inner
+ *    loops swapped, so that the innermost loop walks along rows of B
+ *    and C instead of down a column of B.
+ *
+ *    Compare the two with the caches simulated (run from the test
+ *    directory):
+ *	../build.linux/nachos -f -cp matmult /matmult
+ *	../build.linux/nachos -cp matmult_ikj /matmult_ikj
+ *	../build.linux/nachos -e /matmult -cache
+ *	../build.linux/nachos -e /matmult_ikj -cache
+ *    Both make the same references; this order misses less in the
+ *    level 1 data cache, so it stalls for fewer ticks.  A bigger data
+ *    cache (eg "-l1d 4096,2,16") hides the difference.  Add
+ *    "-cost pipeline -stats" to charge the multiplies and loads more
+ *    than the adds, as a pipelined CPU would.
+ */
+
+#include "syscall.h"
+
+#define Dim 	20
+
+int A[Dim][Dim];
+int B[Dim][Dim];
+int C[Dim][Dim];
+
+int
+main()
+{
+    int i, j, k;
+
+    for (i = 0; i < Dim; i++)		/* first initialize the matrices */
+	for (j = 0; j < Dim; j++) {
+	     A[i][j] = i;
+	     B[i][j] = j;
+	     C[i][j] = 0;
+	}
+
+    for (i = 0; i < Dim; i++)		/* then multiply them together */
+	for (k = 0; k < Dim; k++)
+            for (j = 0; j < Dim; j++)
+		 C[i][j] += A[i][k] * B[k][j];
+
+    Exit(C[Dim-1][Dim-1]);		/* and then we're done */
+}
@@ -0,0 +1,45 @@
+# Run independent Nachos scenarios in parallel, one per host core, and
+# collect their statistics into one report.
+#
+# Usage: sh run_scenarios.sh <scenario list> [<report file>]
+#
+# Each line of the scenario list is a name, then the Nachos arguments
+# for that run ("#" lines and blank lines are skipped), e.g.
+#	partIII		-f -script FS_partIII.script
+#	test1		-f -script FS_test1.script
+# Every run gets a private directory runs/<name>, holding its disk and
+# socket (-ns), its console output (-co) and everything it printed, so
+# runs can't interfere with each other.  The report (runs/report by
+# default) has each run's exit status and its -stats output.
+NACHOS=${NACHOS:-../build.linux/nachos}
+JOBS=${JOBS:-$(nproc)}
+LIST=$1
+REPORT=${2:-runs/report}
+export NACHOS
+
+if [ -z "$LIST" ]; then
+	echo "usage: sh run_scenarios.sh <scenario list> [<report file>]"
+	exit 1
+fi
+mkdir -p runs
+grep -v -e '^#' -e '^[[:space:]]*$' "$LIST" |
+xargs -P "$JOBS" -L 1 sh -c '
+	name=$1; shift
+	dir=runs/$name
+	rm -rf "$dir"; mkdir -p "$dir"
+	"$NACHOS" -ns "$dir" -co "$dir/console" -stats "$@" \
+		> "$dir/output" 2>&1 < /dev/null
+	echo $? > "$dir/status"' run
+
+: > "$REPORT"
+failed=0
+for name in $(grep -v -e '^#' -e '^[[:space:]]*$' "$LIST" | awk '{print $1}'); do
+	status=$(cat "runs/$name/status")
+	[ "$status" = 0 ] || failed=$((failed + 1))
+	echo "== $name: exit status $status" >> "$REPORT"
+	grep -E '^(Ticks|Disk I/O|Console I/O|Paging|Network I/O|Flash):' \
+		"runs/$name/output" >> "$REPORT"
+done
+cat "$REPORT"
+echo "$failed failed"
+[ "$failed" = 0 ]
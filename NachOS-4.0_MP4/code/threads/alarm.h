@@ -33,6 +33,7 @@ class Alarm : public CallBackObj {
                                 // this method is not yet implemented
 	
 	void Disable() { timer->Disable(); } //2015.11.25
+	void Enable() { timer->Enable(); }	// start time slicing again
 
   private:
     Timer *timer;		// the hardware timer device
@@ -15,6 +15,8 @@
 #include "libtest.h"
 #include "string.h"
 #include "synchdisk.h"
+#include "logdisk.h"
+#include "aio.h"
 #include "post.h"
 #include "synchconsole.h"
 
@@ -27,11 +29,35 @@
 Kernel::Kernel(int argc, char **argv)
 {
     randomSlice = FALSE; 
+    deferBottomHalves = TRUE;
+    printStats = FALSE;
+    asyncHostIO = FALSE;
+    numDisks = 1;		// default is a single disk
+    stripeUnit = 8;
+    diskQueueDepth = 1;		// one disk request at a time
+    flashBlocks = 0;		// default is the hard disk
+    trimEnabled = TRUE;
+    checksums = FALSE;		// default is no checksums
+    overlayBase = NULL;		// default is a plain disk file
+    commitOverlay = FALSE;
+    discardOverlay = FALSE;
+    execDone = NULL;
+    diskFile = NULL;		// default is DISK_<hostName>
+    instanceDir = NULL;		// default is the current directory
     debugUserProg = FALSE;
+    cacheEnabled = FALSE;	// default is memory with no caches
+    cacheSpecs[L1ICache] = "512,2,16,lru";
+    cacheSpecs[L1DCache] = "512,2,16,lru";
+    cacheSpecs[L2Cache] = "8192,4,32,lru";
+    costModel = NULL;		// default is UserTick per instruction
     consoleIn = NULL;          // default is stdin
     consoleOut = NULL;         // default is stdout
 #ifndef FILESYS_STUB
     formatFlag = FALSE;
+    logStructured = FALSE;	// default is to update sectors in place
+    formatSectorSize = 0;	// default is the default geometry
+    formatSectorsPerTrack = 0;
+    formatTracks = 0;
 #endif
     reliability = 1;            // network reliability, default is 1.0
     hostName = 0;               // machine id, also UNIX socket name
@@ -49,6 +75,69 @@ Kernel::Kernel(int argc, char **argv)
 	    	i++;
         } else if (strcmp(argv[i], "-s") == 0) {
             debugUserProg = TRUE;
+        } else if (strcmp(argv[i], "-cache") == 0) {
+            cacheEnabled = TRUE;
+        } else if (strcmp(argv[i], "-l1i") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is the cache's spec
+            cacheSpecs[L1ICache] = argv[i + 1];
+            cacheEnabled = TRUE;
+            i++;
+        } else if (strcmp(argv[i], "-l1d") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is the cache's spec
+            cacheSpecs[L1DCache] = argv[i + 1];
+            cacheEnabled = TRUE;
+            i++;
+        } else if (strcmp(argv[i], "-l2") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is the cache's spec
+            cacheSpecs[L2Cache] = argv[i + 1];
+            cacheEnabled = TRUE;
+            i++;
+        } else if (strcmp(argv[i], "-cost") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is the cost model
+            costModel = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-nobh") == 0) {
+            deferBottomHalves = FALSE;
+        } else if (strcmp(argv[i], "-stats") == 0) {
+            printStats = TRUE;
+        } else if (strcmp(argv[i], "-aio") == 0) {
+            asyncHostIO = TRUE;
+        } else if (strcmp(argv[i], "-qd") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is int
+            diskQueueDepth = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "-raid") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is int
+            numDisks = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "-stripe") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is int
+            stripeUnit = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "-ssd") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is int
+            flashBlocks = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "-notrim") == 0) {
+            trimEnabled = FALSE;
+        } else if (strcmp(argv[i], "-crc") == 0) {
+            checksums = TRUE;
+        } else if (strcmp(argv[i], "-overlay") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is the base image
+            overlayBase = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-disk") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is the disk's file
+            diskFile = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-ns") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is a directory
+            instanceDir = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-commit") == 0) {
+            commitOverlay = TRUE;
+        } else if (strcmp(argv[i], "-discard") == 0) {
+            discardOverlay = TRUE;
 		} else if (strcmp(argv[i], "-e") == 0) {
         	execfile[++execfileNum]= argv[++i];
 			cout << execfile[execfileNum] << "\n";
@@ -63,6 +152,20 @@ Kernel::Kernel(int argc, char **argv)
 #ifndef FILESYS_STUB
 		} else if (strcmp(argv[i], "-f") == 0) {
 	    	formatFlag = TRUE;
+		} else if (strcmp(argv[i], "-lfs") == 0) {
+	    	logStructured = TRUE;
+		} else if (strcmp(argv[i], "-ss") == 0) {
+	    	ASSERT(i + 1 < argc);   // next argument is int
+	    	formatSectorSize = atoi(argv[i + 1]);
+	    	i++;
+		} else if (strcmp(argv[i], "-spt") == 0) {
+	    	ASSERT(i + 1 < argc);   // next argument is int
+	    	formatSectorsPerTrack = atoi(argv[i + 1]);
+	    	i++;
+		} else if (strcmp(argv[i], "-tracks") == 0) {
+	    	ASSERT(i + 1 < argc);   // next argument is int
+	    	formatTracks = atoi(argv[i + 1]);
+	    	i++;
 #endif
         } else if (strcmp(argv[i], "-n") == 0) {
             ASSERT(i + 1 < argc);   // next argument is float
@@ -74,10 +177,17 @@ Kernel::Kernel(int argc, char **argv)
             i++;
         } else if (strcmp(argv[i], "-u") == 0) {
             cout << "Partial usage: nachos [-rs randomSeed]\n";
-	   		cout << "Partial usage: nachos [-s]\n";
+	   		cout << "Partial usage: nachos [-s] [-nobh] [-stats] [-qd #] [-aio]\n";
+	   		cout << "Partial usage: nachos [-cache] [-l1i spec] [-l1d spec] [-l2 spec]\n";
+	   		cout << "Partial usage: nachos [-cost model]\n";
+	   		cout << "Partial usage: nachos [-raid #] [-stripe #]\n";
+	   		cout << "Partial usage: nachos [-ssd #] [-notrim] [-crc]\n";
+	   		cout << "Partial usage: nachos [-overlay baseImage] [-commit] [-discard]\n";
+	   		cout << "Partial usage: nachos [-disk diskFile] [-ns instanceDir]\n";
             cout << "Partial usage: nachos [-ci consoleIn] [-co consoleOut]\n";
 #ifndef FILESYS_STUB
-	    	cout << "Partial usage: nachos [-nf]\n";
+	    	cout << "Partial usage: nachos [-nf] [-lfs]\n";
+	    	cout << "Partial usage: nachos [-ss #] [-spt #] [-tracks #]\n";
 #endif
             cout << "Partial usage: nachos [-n #] [-m #]\n";
 		}
@@ -104,16 +214,63 @@ Kernel::Initialize()
 
     stats = new Statistics();		// collect statistics
     interrupt = new Interrupt;		// start up interrupt handling
+    interrupt->SetDeferBottomHalves(deferBottomHalves);
     scheduler = new Scheduler();	// initialize the ready queue
     alarm = new Alarm(randomSlice);	// start up time slicing
     machine = new Machine(debugUserProg);
+    if (cacheEnabled)
+	machine->EnableCaches(cacheSpecs[L1ICache], cacheSpecs[L1DCache],
+			      cacheSpecs[L2Cache]);
+    if (costModel != NULL)
+	machine->SetCostModel(costModel);
     synchConsoleIn = new SynchConsoleInput(consoleIn); // input from stdin
     synchConsoleOut = new SynchConsoleOutput(consoleOut); // output to stdout
-    synchDisk = new SynchDisk();    //
+    char diskName[MaxDiskName];
+    char *diskFileName = diskFile;
+    if (diskFileName == NULL) {
+	InstanceFileName(diskName, sizeof(diskName), "DISK", hostName);
+	diskFileName = diskName;
+    }
+#ifndef FILESYS_STUB
+    if ((!formatFlag || overlayBase != NULL) &&
+	(formatSectorSize != 0 || formatSectorsPerTrack != 0 ||
+	 formatTracks != 0)) {
+	// the geometry of a disk that is already there is in its label
+	cerr << "-ss, -spt and -tracks only apply when formatting a new "
+	     << "disk (-f, without -overlay)\n";
+	Abort();
+    }
+    if (formatFlag && overlayBase == NULL)
+	SetGeometry(formatSectorSize, formatSectorsPerTrack, formatTracks);
+    else
+#endif
+    {   // the disks' geometry is in the label of the first of them
+	char firstDisk[MaxDiskName];
+	char *first = (overlayBase != NULL) ? overlayBase : diskFileName;
+
+	if (numDisks > 1) {
+	    ASSERT(strlen(first) + 2 < MaxDiskName);
+	    snprintf(firstDisk, sizeof(firstDisk), "%s_a", first);
+	    first = firstDisk;
+	}
+	ReadGeometry(first);
+    }
+#ifndef FILESYS_STUB
+    if (logStructured)
+	synchDisk = new LogDisk(diskFileName, numDisks, stripeUnit,
+				diskQueueDepth, flashBlocks, trimEnabled,
+				overlayBase, checksums, formatFlag);
+    else
+#endif
+    synchDisk = new SynchDisk(diskFileName, numDisks, stripeUnit,
+			      diskQueueDepth, flashBlocks, trimEnabled,
+			      overlayBase, checksums);
 #ifdef FILESYS_STUB
     fileSystem = new FileSystem();
+    asyncIO = NULL;
 #else
     fileSystem = new FileSystem(formatFlag);
+    asyncIO = new AsyncIO();
 #endif // FILESYS_STUB
 
 	// MP4 mod tag
@@ -139,6 +296,20 @@ Kernel::PrepareToEnd()
 	synchConsoleIn->Disable();
 }
 
+//----------------------------------------------------------------------
+// Kernel::StartSync
+// 	Called with interrupts off, when no thread has anything left to do
+//	and Nachos is about to halt.  If the disk has writes buffered (a
+//	LogDisk), start a thread to write them out, and return TRUE: halt
+//	once it is done.
+//----------------------------------------------------------------------
+
+bool
+Kernel::StartSync()
+{
+    return synchDisk != NULL && synchDisk->StartSync();
+}
+
 //----------------------------------------------------------------------
 // Kernel::~Kernel
 // 	Nachos is halting.  De-allocate global data structures.
@@ -154,6 +325,7 @@ Kernel::~Kernel()
     delete synchConsoleIn;
     delete synchConsoleOut;
     delete synchDisk;
+    delete asyncIO;
     delete fileSystem;
 	
 	// Mp4 mod tag
@@ -215,6 +387,32 @@ Kernel::ConsoleTest() {
 
 }
 
+//----------------------------------------------------------------------
+// Kernel::DiskTest
+//      Measure disk throughput with several concurrent readers, and
+//      with one sequential reader; run with different "-qd" and
+//      "-raid" settings to compare queue depths and numbers of disks
+//----------------------------------------------------------------------
+
+void
+Kernel::DiskTest() {
+    synchDisk->SelfTest(8, 64);
+}
+
+//----------------------------------------------------------------------
+// Kernel::FileSystemTest
+//      Check that several threads can use the file system at once and
+//      leave it consistent, and compare their throughput with one
+//      thread's; needs a formatted disk
+//----------------------------------------------------------------------
+
+void
+Kernel::FileSystemTest() {
+#ifndef FILESYS_STUB
+    fileSystem->SelfTest(4);
+#endif
+}
+
 //----------------------------------------------------------------------
 // Kernel::NetworkTest
 //      Test whether the post office is working. On machines #0 and #1, do:
@@ -277,7 +475,7 @@ Kernel::NetworkTest() {
 void ForkExecute(Thread *t)
 {
 	if ( !t->space->Load(t->getName()) ) {
-    	return;             // executable not found
+    	kernel->ProgramDone();	// executable not found
     }
 	
     t->space->Execute(t->getName());
@@ -329,6 +527,87 @@ int Kernel::Exec(char* name)
 //  cout << "after ThreadedKernel:Run();" << endl;  // unreachable
 }
 
+//----------------------------------------------------------------------
+// Kernel::InstanceFileName
+// 	Name the UNIX file this instance of Nachos uses for a device of
+//	machine "id": <kind>_<id>, in the instance's directory (see
+//	"-ns" in main.cc), if it has one.  Instances with different
+//	directories can run side by side without sharing any files.
+//
+//	"buffer" -- where to put the name
+//	"size" -- how big "buffer" is
+//	"kind" -- what kind of file, eg "DISK" or "SOCKET"
+//	"id" -- which machine's
+//----------------------------------------------------------------------
+
+void Kernel::InstanceFileName(char *buffer, int size, char *kind, int id)
+{
+	int length;
+
+	if (instanceDir == NULL)
+		length = snprintf(buffer, size, "%s_%d", kind, id);
+	else
+		length = snprintf(buffer, size, "%s/%s_%d", instanceDir, kind, id);
+	ASSERT(length < size);
+}
+
+//----------------------------------------------------------------------
+// Kernel::ExecWait
+// 	Run a user program, and wait until it is done.  A program that
+//	calls Halt while we wait only ends itself, not all of Nachos, so
+//	that whoever is waiting (see "-script" in main.cc) can go on.
+//	The program starts in the current thread's directory.
+//----------------------------------------------------------------------
+
+void Kernel::ExecWait(char* name)
+{
+	Thread *thread = new Thread(name, threadNum++);
+
+	ASSERT(execDone == NULL);
+	execDone = new Semaphore("exec done", 0);
+#ifndef FILESYS_STUB
+	if (currentThread->cwd != NULL)
+		thread->cwd = new OpenFile(currentThread->cwd->Inode());
+#endif
+	thread->space = new AddrSpace();
+	thread->Fork((VoidFunctionPtr) &ForkExecute, (void *)thread);
+	execDone->P();
+	delete execDone;
+	execDone = NULL;
+}
+
+//----------------------------------------------------------------------
+// Kernel::ProgramDone
+// 	The current thread's user program has exited (or could not be
+//	loaded).  Wait for the reads and writes it started and left
+//	pending, since they use its memory; then wake up ExecWait, if it
+//	is waiting, and finish the thread.
+//----------------------------------------------------------------------
+
+void Kernel::ProgramDone()
+{
+#ifndef FILESYS_STUB
+	asyncIO->DrainProgram(currentThread);
+#endif
+	PrintCaches();
+	if (execDone != NULL)
+		execDone->V();
+	currentThread->Finish();
+}
+
+//----------------------------------------------------------------------
+// Kernel::PrintCaches
+// 	If the caches are simulated, print how many references the
+//	current thread's user program made to each, and how many missed.
+//	Called as the program exits or halts.
+//----------------------------------------------------------------------
+
+void Kernel::PrintCaches()
+{
+	if (machine->CachesEnabled() && currentThread->space != NULL)
+		currentThread->space->cacheCounts.Print(currentThread->getName());
+}
+
 #ifdef FILESYS_STUB
 int Kernel::CreateFile(char *filename)
 {
@@ -24,6 +24,8 @@ class PostOfficeOutput;
 class SynchConsoleInput;
 class SynchConsoleOutput;
 class SynchDisk;
+class AsyncIO;
+class Semaphore;
 
 
 
@@ -42,10 +44,22 @@ class Kernel {
 	
 	void ExecAll();
 	int Exec(char* name);
+	void ExecWait(char* name);	// run a user program, and wait
+					// until it exits (or halts)
+	void ProgramDone();		// the current user program is done
+	void PrintCaches();		// print its cache hits and misses
+	bool StartSync();		// write out what the disk has
+					// buffered, before halting
+	void InstanceFileName(char *buffer, int size, char *kind, int id);
+					// UNIX file name for a device of
+					// machine "id", in our directory
     void ThreadSelfTest();	// self test of threads and synchronization
 	
     void ConsoleTest();         // interactive console self test
     void NetworkTest();         // interactive 2-machine network test
+    void DiskTest();		// disk throughput with concurrent readers
+    void FileSystemTest();	// file system locking and throughput
+				// with concurrent workers
 	Thread* getThread(int threadID){return t[threadID];}    
 
 	#ifdef FILESYS_STUB	
@@ -65,10 +79,23 @@ class Kernel {
     SynchConsoleOutput *synchConsoleOut;
     SynchDisk *synchDisk;
     FileSystem *fileSystem;     
+    AsyncIO *asyncIO;		// reads and writes done in the background
+				// (NULL with FILESYS_STUB)
     PostOfficeInput *postOfficeIn;
     PostOfficeOutput *postOfficeOut;
 
     int hostName;               // machine identifier
+    bool printStats;		// print statistics when halting
+    bool asyncHostIO;		// do the disk's UNIX file I/O in
+				// the background
+    bool commitOverlay;		// at shutdown, copy the disk overlay
+				// into its base image, then remove it
+    bool discardOverlay;	// at shutdown, remove the disk overlay
+    char *instanceDir;		// if not NULL, the directory holding
+				// this instance's disk and socket
+    Semaphore *execDone;	// V'ed when the program ExecWait is
+				// waiting for is done; NULL if no one
+				// is waiting
 
   private:
 
@@ -77,12 +104,35 @@ class Kernel {
 	int execfileNum;
 	int threadNum;
     bool randomSlice;		// enable pseudo-random time slicing
+    bool deferBottomHalves;	// run interrupt bottom halves after
+				// the handler, with interrupts on
+    int numDisks;		// # of disks to stripe sectors over
+    int stripeUnit;		// # of consecutive sectors per disk
+    int diskQueueDepth;		// # of requests the disk may queue
+    int flashBlocks;		// if not 0, use a flash device with
+				// this many erase blocks as the disk
+    bool trimEnabled;		// tell the disk about freed sectors
+    bool checksums;		// keep a checksum of each sector
+    char *overlayBase;		// if not NULL, the disk is an overlay
+				// on this base image
+    char *diskFile;		// if not NULL, the UNIX file holding
+				// the disk
     bool debugUserProg;         // single step user program
+    bool cacheEnabled;		// simulate caches (see cache.h)
+    char *cacheSpecs[NumCacheLevels];
+    				// each cache's size, associativity,
+				// line size and policy
+    char *costModel;		// if not NULL, charge user instructions
+				// by class (see Machine::SetCostModel)
     double reliability;         // likelihood messages are dropped
     char *consoleIn;            // file to read console input from
     char *consoleOut;           // file to send console output to
 #ifndef FILESYS_STUB
     bool formatFlag;          // format the disk if this is true
+    bool logStructured;		// keep the disk as a log (logdisk.h)
+    int formatSectorSize;	// geometry to format the disk with
+    int formatSectorsPerTrack;	// (0 for the default: see
+    int formatTracks;		// SetGeometry in disk.h)
 #endif
 };
 
@@ -4,31 +4,108 @@
 //
 // Usage: nachos -d <debugflags> -rs <random seed #>
 //              -s -x <nachos file> -ci <consoleIn> -co <consoleOut>
-//              -f -cp <unix file> <nachos file>
+//              -cache -l1i <cache> -l1d <cache> -l2 <cache> -cost <model>
+//              -f -cp <unix file> <nachos file> -cpz <unix file> <nachos file>
+//              -ss <bytes> -spt <sectors> -tracks <tracks>
 //              -p <nachos file> -r <nachos file> -l -D
+//              -clone <nachos file> <nachos file>
+//              -script <unix file> -frag -defrag <nachos file>
 //              -n <network reliability> -m <machine id>
-//              -z -K -C -N
+//              -nobh -stats -qd <queue depth> -aio
+//              -raid <# of disks> -stripe <sectors>
+//              -ssd <erase blocks> -notrim -crc
+//              -overlay <base image> -commit -discard
+//              -lfs -disk <unix file> -ns <directory>
+//              -z -K -C -N -Q -F
 //
 //    -d causes certain debugging messages to be printed (see debug.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
 //    -z prints the copyright message
 //    -s causes user programs to be executed in single-step mode
+//    -cache charges user programs for cache misses: every instruction
+//	fetch, load and store goes through a split level 1 cache and a
+//	level 2 cache (see machine/cache.h), and the hits and misses of
+//	each program are printed as it exits.  -l1i, -l1d and -l2 set
+//	the instruction, data and level 2 caches (and imply -cache), as
+//	"<bytes>,<ways>,<line bytes>[,lru|fifo|random]", or "0" for none;
+//	the default is 512,2,16 for each level 1 cache, 8192,4,32 for
+//	level 2, all LRU
+//    -cost charges each user instruction by its class -- ALU, multiply
+//	or divide, load or store, branch taken (or jump), branch not
+//	taken -- instead of one tick each, and -stats counts the
+//	instructions of each class.  The model is "unit" (one tick each),
+//	"pipeline" (1,20,2,3,1), or the ticks for each class, eg
+//	"1,10,2,2,1" (see Machine::SetCostModel)
 //    -x runs a user program
 //    -ci specify file for console input (stdin is the default)
 //    -co specify file for console output (stdout is the default)
 //    -n sets the network reliability
 //    -m sets this machine's host id (needed for the network)
+//    -nobh runs the deferred part of device interrupts (bottom halves)
+//	inside the interrupt handlers, with interrupts disabled
+//    -stats prints performance statistics when Nachos halts
+//    -qd lets the disk queue up to this many requests, and service
+//	them in the order the head can reach them (default 1)
+//    -aio does the disk's UNIX file reads and writes in a helper thread,
+//	overlapped with the simulation (simulated results are the same)
+//    -raid stripes the disk's sectors over this many disks (at most 8),
+//	kept in UNIX files DISK_<id>_a, DISK_<id>_b, ...
+//    -stripe sets how many consecutive sectors go to each disk (default 8)
+//    -ssd uses a simulated flash device with this many erase blocks
+//	(of 64 sectors each) in place of the disk; 8765 blocks hold the
+//	whole disk with 7% to spare
+//    -notrim stops the file system from telling the device which
+//	sectors it has freed
+//    -crc keeps a CRC-32C checksum of each sector, in the first sector
+//	of its track, and checks every sector read against it; a sector
+//	that doesn't match is reported.  Give it on every run that uses
+//	the disk, starting with -f
+//    -overlay keeps the disk as a copy-on-write overlay on a base image
+//	(a DISK_<id> file saved from an earlier run): only the sectors
+//	written go to DISK_<id>, the rest are read from the base image,
+//	which is not changed.  The overlay is kept for the next run;
+//    -commit copies it into the base image at shutdown, and
+//    -discard throws it away
+//    -lfs keeps the disk as a log: every sector written is appended
+//	to it, in large segments, and a cleaner frees segments whose
+//	sectors have been written again (see filesys/logdisk.h).  Give
+//	it on every run that uses the disk, starting with -f
+//    -disk keeps the disk in this UNIX file instead of DISK_<id>
+//	(with -raid, in <file>_a, <file>_b, ...)
+//    -ns keeps this instance's default disk and its network socket in
+//	a directory of its own, so that several instances can run at
+//	once (all machines on a network must use the same directory)
 //    -K run a simple self test of kernel threads and synchronization
 //    -C run an interactive console test
 //    -N run a two-machine network test (see Kernel::NetworkTest)
+//    -Q run disk throughput tests, random and sequential
+//    -F run a file system stress test, with one thread and with
+//	several at once (on a formatted disk: use with -f)
 //
 //    Filesystem-related flags:
 //    -f forces the Nachos disk to be formatted
+//    -ss formats the disk with sectors of this many bytes (a power of
+//	two, 128 to 4096; default 128), -spt with this many sectors per
+//	track (default 32), and -tracks with this many tracks (default:
+//	as many as make a 64MB disk).  The geometry is kept in the disk's
+//	label, so later runs need not give it again.  Only used with -f
 //    -cp copies a file from UNIX to Nachos
+//    -cpz copies a file from UNIX to Nachos, keeping it compressed
+//	(see filesys/compfile.h)
+//    -clone makes a second Nachos file that shares the first one's
+//	sectors until either is written (see filesys/refmap.h)
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
 //    -l lists the contents of the Nachos directory
 //    -D prints the contents of the entire file system 
+//    -script runs the file system commands in a UNIX file, one per line
+//	(cp, cpz, clone, p, l, lr, du, mkdir, r, rr, D, exec, frag, defrag,
+//	cd, update, truncate, records, recordsv, stream and sync -- see
+//	RunScript), in one run of Nachos, printing the ticks and disk I/O
+//	of each
+//    -frag prints how fragmented each file and the free space are
+//    -defrag moves a Nachos file's data into contiguous sectors, and
+//	prints how long reading it through took before and after
 //
 //  Note: the file system flags are not used if the stub filesystem
 //        is being used
@@ -44,6 +121,8 @@
 #include "main.h"
 #include "filesys.h"
 #include "openfile.h"
+#include "synchdisk.h"
+#include "aio.h"
 #include "sysdep.h"
 
 // global variables
@@ -66,19 +145,24 @@ Cleanup(int x)
 //-------------------------------------------------------------------
 // Constant used by "Copy" and "Print"
 //   It is the number of bytes read from the Unix file (for Copy)
-//   or the Nachos file (for Print) by each read operation
+//   or the Nachos file (for Print) by each read operation: a sector,
+//   so that each write to the Nachos file covers whole sectors
 //-------------------------------------------------------------------
-static const int TransferSize = 128;
+#define TransferSize	SectorSize
+
+// Bytes read by each read operation of "SequentialReadTicks"
+static const int ReadThroughSize = 4096;
 
 
 #ifndef FILESYS_STUB
 //----------------------------------------------------------------------
 // Copy
-//      Copy the contents of the UNIX file "from" to the Nachos file "to"
+//      Copy the contents of the UNIX file "from" to the Nachos file "to",
+//	which is created compressed if "compressed" is set
 //----------------------------------------------------------------------
 
 static void
-Copy(char *from, char *to)
+Copy(char *from, char *to, bool compressed)
 {
     int fd;
     OpenFile* openFile;
@@ -99,15 +183,16 @@ Copy(char *from, char *to)
 // Create a Nachos file of the same length
     DEBUG('f', "Copying file " << from << " of size " << fileLength <<  " to file " << to);
     
-    char tem[20];
-	strcpy(tem,to);
+    char *name = new char[strlen(to) + 1];	// Create takes the path
+    strcpy(name, to);				// apart, so give it a copy
     
-    if (!kernel->fileSystem->Create(to, fileLength)) {   // Create Nachos file
+    if (!kernel->fileSystem->Create(name, fileLength, compressed)) {   // Create Nachos file
         printf("Copy: couldn't create output file %s\n", to);
+        delete [] name;
         Close(fd);
         return;
     }
-    strcpy(to,tem);
+    delete [] name;
     //cout << "copy in main " << to << endl;
     openFile = kernel->fileSystem->Open(to);
     //cout << "open success" << endl;
@@ -125,6 +210,249 @@ Copy(char *from, char *to)
     Close(fd);
 }
 
+//----------------------------------------------------------------------
+// CloneFile
+//      Make the Nachos file "to" a clone of the Nachos file "from"
+//----------------------------------------------------------------------
+
+static void
+CloneFile(char *from, char *to)
+{
+    if (!kernel->fileSystem->Clone(from, to))
+        printf("Clone: couldn't clone %s as %s\n", from, to);
+}
+
+//----------------------------------------------------------------------
+// DiskUsage
+//      Print the size of every file under the Nachos directory "name",
+//	and the total under each directory (UNIX du -a), and how many
+//	ReadDir calls it took.  The tree is walked the way a user program
+//	would walk it: each directory opened with OpenAt, and listed
+//	DuBatch names per ReadDir call.
+//----------------------------------------------------------------------
+
+#define DuBatch		16		// names asked for per ReadDir
+
+static int
+DiskUsageOf(OpenFileId dir, char *path, int *calls)
+{
+    DirEntry entries[DuBatch];
+    char name[256];
+    int cursor = 0, total = 0, count;
+
+    do {
+        count = kernel->fileSystem->ReadDir(dir, entries, DuBatch, &cursor);
+        (*calls)++;
+        if (count == -1) {
+            printf("du: not a directory: %s\n", path);
+            return 0;
+        }
+        for (int i = 0; i < count; i++) {
+            snprintf(name, sizeof(name), "%s/%s", path, entries[i].name);
+            if (entries[i].type == DirEntryDirectory) {
+                OpenFileId sub = kernel->fileSystem->OpenAt(dir,
+                                                      entries[i].name);
+
+                if (sub == -1) {
+                    printf("du: couldn't open %s\n", name);
+                    continue;
+                }
+                total += DiskUsageOf(sub, name, calls);
+                kernel->fileSystem->CloseFile(sub);
+            } else {
+                printf("%9d %s\n", entries[i].size, name);
+                total += entries[i].size;
+            }
+        }
+    } while (count > 0);
+    printf("%9d %s/\n", total, path);
+    return total;
+}
+
+static void
+DiskUsage(char *name)
+{
+    char path[256];
+    OpenFileId dir;
+    int calls = 0;
+
+    strncpy(path, name, sizeof(path) - 1);
+    path[sizeof(path) - 1] = '\0';
+    if (strlen(path) > 0 && path[strlen(path) - 1] == '/')
+        path[strlen(path) - 1] = '\0';	// so "/" prints as "/a", not "//a"
+    dir = kernel->fileSystem->OpenAt(CurrentDirectory, name);
+    if (dir == -1) {
+        printf("du: no such directory: %s\n", name);
+        return;
+    }
+    DiskUsageOf(dir, path, &calls);
+    kernel->fileSystem->CloseFile(dir);
+    printf("%d ReadDir calls\n", calls);
+}
+
+//----------------------------------------------------------------------
+// Update
+//      Overwrite "count" sectors of the Nachos file "name", spread over
+//	the whole file in no particular order, the way a database updates
+//	its pages.  Each write covers a whole sector, so none of them has
+//	to read the sector first.
+//----------------------------------------------------------------------
+
+#define UpdateSize	SectorSize	// bytes in a page
+
+static void
+Update(char *name, int count)
+{
+    OpenFile *openFile;
+    int numPages;
+    char *page;
+
+    if ((openFile = kernel->fileSystem->Open(name)) == NULL) {
+        printf("Update: unable to open file %s\n", name);
+        return;
+    }
+    page = new char[UpdateSize];
+    numPages = openFile->Length() / UpdateSize;
+    for (int i = 0; i < count && numPages > 0; i++) {
+        memset(page, ' ', UpdateSize);
+        sprintf(page, "update %8d", i);
+        page[strlen(page)] = ' ';
+        page[UpdateSize - 1] = '\n';
+        // a stride prime to the number of pages visits them all
+        openFile->WriteAt(page, UpdateSize,
+                          (int) ((i * 7919LL) % numPages) * UpdateSize);
+    }
+    delete [] page;
+    delete openFile;
+}
+
+//----------------------------------------------------------------------
+// Records
+//      Write "count" records over the start of the Nachos file "name",
+//	one after another, the way a user program would: through the
+//	open file table, each record in RecordPieces pieces (a label, a
+//	body, and a newline; 32 bytes in all).  Either each piece
+//	is written on its own (WriteFile), or, if "vectored", as many
+//	whole records as there is room for go in one WriteFileV.
+//----------------------------------------------------------------------
+
+#define RecordPieces	3		// pieces in a record
+#define RecordsPerCall	(MaxIoPieces / RecordPieces)
+
+static void
+Records(char *name, int count, bool vectored)
+{
+    char labels[RecordsPerCall][16];
+    char body[] = "abcdefghijklmnopqrst", newline[] = "\n";
+    char *pieces[MaxIoPieces];
+    int sizes[MaxIoPieces];
+    OpenFileId id;
+
+    if ((id = kernel->fileSystem->OpenAt(CurrentDirectory, name)) == -1) {
+        printf("Records: unable to open file %s\n", name);
+        return;
+    }
+    for (int i = 0; i < count; i += RecordsPerCall) {
+        int numPieces = 0;
+
+        for (int r = 0; r < RecordsPerCall && i + r < count; r++) {
+            sprintf(labels[r], "rec %6d ", i + r);
+            pieces[numPieces] = labels[r];
+            sizes[numPieces++] = strlen(labels[r]);
+            pieces[numPieces] = body;
+            sizes[numPieces++] = strlen(body);
+            pieces[numPieces] = newline;
+            sizes[numPieces++] = 1;
+        }
+        if (vectored)
+            kernel->fileSystem->WriteFileV(pieces, sizes, numPieces, id);
+        else
+            for (int j = 0; j < numPieces; j++)
+                kernel->fileSystem->WriteFile(pieces[j], sizes[j], id);
+    }
+    kernel->fileSystem->CloseFile(id);
+}
+
+//----------------------------------------------------------------------
+// Compute
+//      Stand in for "ticks" of work on the CPU: let the simulated time
+//	go by a tick at a time, as a user program computing would,
+//	with the other threads (and the disk) getting their turn.
+//----------------------------------------------------------------------
+
+static void
+Compute(int ticks)
+{
+    for (int t = 0; t < ticks; t += SystemTick) {
+        kernel->interrupt->SetLevel(IntOff);
+        kernel->interrupt->SetLevel(IntOn);	// advances the clock
+    }
+}
+
+//----------------------------------------------------------------------
+// Stream
+//      Read the Nachos file "name" through, StreamChunk bytes at a time,
+//	doing "compute" ticks of work on each chunk as it comes in: first
+//	reading each chunk only when it is needed, then with the read of
+//	the next chunk started (AsyncIO) before working on this one, so
+//	the disk and the CPU are busy at once.  Print how long each took,
+//	and the simulated time the overlap saved.
+//----------------------------------------------------------------------
+
+#define StreamChunk	4096		// bytes read at a time
+
+static void
+Stream(char *name, int compute)
+{
+    char *buffers[2];
+    int ticks[2], sums[2], chunks = 0;
+    OpenFileId id;
+
+    if ((id = kernel->fileSystem->OpenAt(CurrentDirectory, name)) == -1) {
+        printf("Stream: unable to open file %s\n", name);
+        return;
+    }
+    buffers[0] = new char[StreamChunk];
+    buffers[1] = new char[StreamChunk];
+
+    // one chunk after another: read it, then work on it
+    ticks[0] = kernel->stats->totalTicks;
+    sums[0] = 0;
+    for (int pos = 0, num; (num = kernel->fileSystem->ReadFileAt(buffers[0],
+                           StreamChunk, pos, id)) > 0; pos += num) {
+        for (int i = 0; i < num; i++)
+            sums[0] += (unsigned char) buffers[0][i];
+        Compute(compute);
+        chunks++;
+    }
+    ticks[0] = kernel->stats->totalTicks - ticks[0];
+
+    // double buffered: the next chunk is on its way while this one is
+    // worked on
+    ticks[1] = kernel->stats->totalTicks;
+    sums[1] = 0;
+    int next = kernel->asyncIO->Start(FALSE, buffers[0], StreamChunk, 0, id);
+    for (int pos = 0, b = 0, num; (num = kernel->asyncIO->Wait(next)) > 0;
+         pos += num, b = 1 - b) {
+        next = kernel->asyncIO->Start(FALSE, buffers[1 - b], StreamChunk,
+                                      pos + num, id);
+        for (int i = 0; i < num; i++)
+            sums[1] += (unsigned char) buffers[b][i];
+        Compute(compute);
+    }
+    ticks[1] = kernel->stats->totalTicks - ticks[1];
+
+    kernel->fileSystem->CloseFile(id);
+    delete [] buffers[0];
+    delete [] buffers[1];
+    printf("Stream %s: %d chunks of %d bytes, %d ticks of work on each\n",
+           name, chunks, StreamChunk, compute);
+    printf("  read, then work:   %d ticks (checksum %d)\n", ticks[0], sums[0]);
+    printf("  overlapped (aio):  %d ticks (checksum %d)\n", ticks[1], sums[1]);
+    printf("  saved: %d ticks (%d%%)\n", ticks[0] - ticks[1],
+           ticks[0] > 0 ? (int) ((ticks[0] - ticks[1]) * 100LL / ticks[0]) : 0);
+}
+
 #endif // FILESYS_STUB
 
 //----------------------------------------------------------------------
@@ -167,6 +495,175 @@ CreateDirectory(char *name)
 
 }
 
+//----------------------------------------------------------------------
+// SequentialReadTicks
+//      Read the Nachos file "name" from start to end, and return how
+//	many ticks it took, or -1 if there is no such file.
+//----------------------------------------------------------------------
+
+static int
+SequentialReadTicks(char *name)
+{
+    OpenFile *openFile;
+    int inode, ticks;
+    char *buffer;
+
+    if ((inode = kernel->fileSystem->FindHeader(name)) == -1)
+        return -1;
+    openFile = new OpenFile(inode);
+    ticks = kernel->stats->totalTicks;
+    buffer = new char[ReadThroughSize];
+    while (openFile->Read(buffer, ReadThroughSize) > 0)
+        ;
+    ticks = kernel->stats->totalTicks - ticks;
+    delete [] buffer;
+    delete openFile;
+    return ticks;
+}
+
+//----------------------------------------------------------------------
+// Defragment
+//      Defragment the Nachos file "name", and print how long reading
+//	it through took before and after.
+//----------------------------------------------------------------------
+
+static void
+Defragment(char *name)
+{
+    int before, after;
+
+    if ((before = SequentialReadTicks(name)) == -1) {
+        printf("Defragment: unable to open file %s\n", name);
+        return;
+    }
+    if (kernel->fileSystem->Defragment(name)) {
+        after = SequentialReadTicks(name);
+        printf("Sequential read of %s: %d ticks before, %d ticks after\n",
+               name, before, after);
+    }
+}
+
+//----------------------------------------------------------------------
+// RunScript
+//      Run the file system commands in the UNIX file "name", one per
+//	line, all in this one run of Nachos (so what the kernel has
+//	cached stays cached from one command to the next).  Each line
+//	is a command and its arguments, as they would be given on the
+//	command line (the "-" is optional):
+//
+//		cp <unix file> <nachos file>	p <nachos file>
+//		cpz <unix file> <nachos file>	clone <nachos file> <nachos file>
+//		l <directory>			lr <directory>
+//		mkdir <directory>		D
+//		r <nachos file>			rr <nachos directory>
+//		exec <nachos program>		frag
+//		defrag <nachos file>		cd <nachos directory>
+//		update <nachos file> <count>	sync
+//		truncate <nachos file> <length>
+//		du <nachos directory>
+//		records <nachos file> <count>	recordsv <nachos file> <count>
+//		stream <nachos file> <ticks>
+//
+//	"update" overwrites "count" sectors spread over the file;
+//	"truncate" shrinks a file to its first "length" bytes;
+//	"sync" writes out what the disk has buffered (see LogDisk::Sync);
+//	"du" lists the sizes of the files under a directory with ReadDir;
+//	"records" and "recordsv" write records made of several pieces,
+//	a piece or several records at a time (see Records); "stream"
+//	reads a file through, doing "ticks" of work on each chunk, with
+//	and without the next read overlapped (see Stream).
+//	After "cd", a relative name given to cp, clone, p, mkdir, r, exec,
+//	update, truncate or defrag starts at that directory instead of the
+//	root.
+//	Blank lines and lines starting with "#" are skipped.  After each
+//	command, print how long it took and how many disk sectors it
+//	read and wrote.
+//----------------------------------------------------------------------
+
+static void
+RunScript(char *name)
+{
+    FILE *script;
+    char line[256], command[256], arg1[256], arg2[256];
+    int numArgs, ticks, reads, writes;
+    char *cmd;
+
+    if ((script = fopen(name, "r")) == NULL) {
+        printf("Script: couldn't open script file %s\n", name);
+        return;
+    }
+    while (fgets(line, sizeof(line), script) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        numArgs = sscanf(line, "%255s %255s %255s", command, arg1, arg2);
+        if (numArgs < 1 || command[0] == '#')
+            continue;
+        cmd = (command[0] == '-') ? command + 1 : command;
+
+        ticks = kernel->stats->totalTicks;
+        reads = kernel->stats->numDiskReads;
+        writes = kernel->stats->numDiskWrites;
+
+        // the file system may write into the names it is given, so
+        // each command gets its own copy, fresh from the script
+        if (strcmp(cmd, "cp") == 0 && numArgs == 3)
+            Copy(arg1, arg2, FALSE);
+        else if (strcmp(cmd, "cpz") == 0 && numArgs == 3)
+            Copy(arg1, arg2, TRUE);
+        else if (strcmp(cmd, "clone") == 0 && numArgs == 3)
+            CloneFile(arg1, arg2);
+        else if (strcmp(cmd, "p") == 0 && numArgs == 2)
+            Print(arg1);
+        else if (strcmp(cmd, "l") == 0 && numArgs == 2)
+            kernel->fileSystem->List(arg1);
+        else if (strcmp(cmd, "lr") == 0 && numArgs == 2)
+            kernel->fileSystem->RecursiveList(arg1);
+        else if (strcmp(cmd, "du") == 0 && numArgs == 2)
+            DiskUsage(arg1);
+        else if (strcmp(cmd, "mkdir") == 0 && numArgs == 2)
+            CreateDirectory(arg1);
+        else if (strcmp(cmd, "r") == 0 && numArgs == 2)
+            kernel->fileSystem->Remove(arg1);
+        else if (strcmp(cmd, "rr") == 0 && numArgs == 2)
+            kernel->fileSystem->RecursiveRemove(arg1);
+        else if (strcmp(cmd, "D") == 0 && numArgs == 1)
+            kernel->fileSystem->Print();
+        else if (strcmp(cmd, "exec") == 0 && numArgs == 2)
+            kernel->ExecWait(arg1);
+        else if (strcmp(cmd, "frag") == 0 && numArgs == 1)
+            kernel->fileSystem->FragReport();
+        else if (strcmp(cmd, "defrag") == 0 && numArgs == 2)
+            Defragment(arg1);
+        else if (strcmp(cmd, "update") == 0 && numArgs == 3)
+            Update(arg1, atoi(arg2));
+        else if (strcmp(cmd, "truncate") == 0 && numArgs == 3) {
+            if (!kernel->fileSystem->Truncate(arg1, atoi(arg2)))
+                printf("Script: couldn't truncate %s\n", arg1);
+        }
+        else if (strcmp(cmd, "records") == 0 && numArgs == 3)
+            Records(arg1, atoi(arg2), FALSE);
+        else if (strcmp(cmd, "recordsv") == 0 && numArgs == 3)
+            Records(arg1, atoi(arg2), TRUE);
+        else if (strcmp(cmd, "stream") == 0 && numArgs == 3)
+            Stream(arg1, atoi(arg2));
+        else if (strcmp(cmd, "sync") == 0 && numArgs == 1)
+            kernel->synchDisk->Sync();
+        else if (strcmp(cmd, "cd") == 0 && numArgs == 2) {
+            if (!kernel->fileSystem->Chdir(arg1))
+                printf("Script: no such directory: %s\n", arg1);
+        }
+        else {
+            printf("Script: bad command: %s\n", line);
+            continue;
+        }
+
+        printf("[script] %s: %d ticks, %d disk reads, %d disk writes\n",
+               line, kernel->stats->totalTicks - ticks,
+               kernel->stats->numDiskReads - reads,
+               kernel->stats->numDiskWrites - writes);
+    }
+    fclose(script);
+}
+
 //----------------------------------------------------------------------
 // main
 // 	Bootstrap the operating system kernel.  
@@ -190,9 +687,14 @@ main(int argc, char **argv)
     bool threadTestFlag = false;
     bool consoleTestFlag = false;
     bool networkTestFlag = false;
+    bool diskTestFlag = false;
+    bool fileSystemTestFlag = false;
 #ifndef FILESYS_STUB
     char *copyUnixFileName = NULL;    // UNIX file to be copied into Nachos
     char *copyNachosFileName = NULL;  // name of copied file in Nachos
+    bool copyCompressed = false;      // keep the copy compressed?
+    char *cloneFromName = NULL;       // Nachos file to be cloned
+    char *cloneToName = NULL;         // name of the clone
     char *printFileName = NULL; 
     char *removeFileName = NULL;
     bool dirListFlag = false;
@@ -203,6 +705,9 @@ main(int argc, char **argv)
 	bool mkdirFlag = false;
 	bool recursiveListFlag = false;
 	bool recursiveRemoveFlag = false;
+	char *scriptFileName = NULL;
+	bool fragFlag = false;
+	char *defragFileName = NULL;
 #endif //FILESYS_STUB
 
     // some command line arguments are handled here.
@@ -231,6 +736,12 @@ main(int argc, char **argv)
 	else if (strcmp(argv[i], "-N") == 0) {
 	    networkTestFlag = TRUE;
 	}
+	else if (strcmp(argv[i], "-Q") == 0) {
+	    diskTestFlag = TRUE;
+	}
+	else if (strcmp(argv[i], "-F") == 0) {
+	    fileSystemTestFlag = TRUE;
+	}
 #ifndef FILESYS_STUB
 	else if (strcmp(argv[i], "-cp") == 0) {
 	    ASSERT(i + 2 < argc);
@@ -238,6 +749,19 @@ main(int argc, char **argv)
 	    copyNachosFileName = argv[i + 2];
 	    i += 2;
 	}
+	else if (strcmp(argv[i], "-cpz") == 0) {
+	    ASSERT(i + 2 < argc);
+	    copyUnixFileName = argv[i + 1];
+	    copyNachosFileName = argv[i + 2];
+	    copyCompressed = TRUE;
+	    i += 2;
+	}
+	else if (strcmp(argv[i], "-clone") == 0) {
+	    ASSERT(i + 2 < argc);
+	    cloneFromName = argv[i + 1];
+	    cloneToName = argv[i + 2];
+	    i += 2;
+	}
 	else if (strcmp(argv[i], "-p") == 0) {
 	    ASSERT(i + 1 < argc);
 	    printFileName = argv[i + 1];
@@ -283,15 +807,31 @@ main(int argc, char **argv)
 	else if (strcmp(argv[i], "-D") == 0) {
 	    dumpFlag = true;
 	}
+	else if (strcmp(argv[i], "-frag") == 0) {
+	    fragFlag = true;
+	}
+	else if (strcmp(argv[i], "-defrag") == 0) {
+	    ASSERT(i + 1 < argc);
+	    defragFileName = argv[i + 1];
+	    i++;
+	}
+	else if (strcmp(argv[i], "-script") == 0) {
+	    ASSERT(i + 1 < argc);
+	    scriptFileName = argv[i + 1];
+	    i++;
+	}
 #endif //FILESYS_STUB
 	else if (strcmp(argv[i], "-u") == 0) {
             cout << "Partial usage: nachos [-z -d debugFlags]\n";
             cout << "Partial usage: nachos [-x programName]\n";
-	    cout << "Partial usage: nachos [-K] [-C] [-N]\n";
+	    cout << "Partial usage: nachos [-K] [-C] [-N] [-Q] [-F]\n";
 #ifndef FILESYS_STUB
             cout << "Partial usage: nachos [-cp UnixFile NachosFile]\n";
+            cout << "Partial usage: nachos [-clone NachosFile NachosFile]\n";
             cout << "Partial usage: nachos [-p fileName] [-r fileName]\n";
             cout << "Partial usage: nachos [-l] [-D]\n";
+            cout << "Partial usage: nachos [-script scriptFile]\n";
+            cout << "Partial usage: nachos [-frag] [-defrag fileName]\n";
 #endif //FILESYS_STUB
 	}
 
@@ -317,6 +857,12 @@ main(int argc, char **argv)
     if (networkTestFlag) {
       kernel->NetworkTest();   // two-machine test of the network
     }
+    if (diskTestFlag) {
+      kernel->DiskTest();      // disk throughput vs. queue depth
+    }
+    if (fileSystemTestFlag) {
+      kernel->FileSystemTest(); // file system locking under load
+    }
 
 #ifndef FILESYS_STUB
     if(recursiveRemoveFlag){
@@ -327,7 +873,10 @@ main(int argc, char **argv)
     }
     
     if (copyUnixFileName != NULL && copyNachosFileName != NULL) {
-		Copy(copyUnixFileName,copyNachosFileName);
+		Copy(copyUnixFileName,copyNachosFileName,copyCompressed);
+    }
+    if (cloneFromName != NULL && cloneToName != NULL) {
+		CloneFile(cloneFromName, cloneToName);
     }
     if (dumpFlag) {
 		kernel->fileSystem->Print();
@@ -348,6 +897,15 @@ main(int argc, char **argv)
     if (printFileName != NULL) {
       Print(printFileName);
     }
+    if (defragFileName != NULL) {
+      Defragment(defragFileName);
+    }
+    if (fragFlag) {
+      kernel->fileSystem->FragReport();
+    }
+    if (scriptFileName != NULL) {
+      RunScript(scriptFileName);
+    }
 #endif // FILESYS_STUB
 
     // finally, run an initial user program if requested to do so
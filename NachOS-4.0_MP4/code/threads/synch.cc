@@ -35,6 +35,7 @@
 #include "copyright.h"
 #include "synch.h"
 #include "main.h"
+#include "slab.h"
 
 //----------------------------------------------------------------------
 // Semaphore::Semaphore
@@ -62,6 +63,31 @@ Semaphore::~Semaphore()
     delete queue;
 }
 
+//----------------------------------------------------------------------
+// Semaphore::operator new, Semaphore::operator delete
+// 	A semaphore is made for every disk transfer, every lock, and
+//	every wait on a condition, so they come from a cache instead
+//	of from the heap.
+//----------------------------------------------------------------------
+
+static ObjectCache *semaphoreCache = NULL;
+
+void *
+Semaphore::operator new(size_t size)
+{
+    ASSERT(size == sizeof(Semaphore));
+    if (semaphoreCache == NULL)
+	semaphoreCache = new ObjectCache("Semaphore", sizeof(Semaphore));
+    return semaphoreCache->Alloc();
+}
+
+void
+Semaphore::operator delete(void *semaphore)
+{
+    if (semaphore != NULL)
+	semaphoreCache->Free(semaphore);
+}
+
 //----------------------------------------------------------------------
 // Semaphore::P
 // 	Wait until semaphore value > 0, then decrement.  Checking the
@@ -295,3 +321,90 @@ void Condition::Broadcast(Lock* conditionLock)
         Signal(conditionLock);
     }
 }
+
+//----------------------------------------------------------------------
+// RWLock::RWLock
+// 	Initialize a reader/writer lock.  Initially, no one holds it.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+RWLock::RWLock(char* debugName)
+{
+    name = debugName;
+    lock = new Lock("rwlock");
+    readable = new Condition("rwlock readable");
+    writable = new Condition("rwlock writable");
+    readers = 0;
+    waitingWriters = 0;
+    writer = NULL;
+}
+
+//----------------------------------------------------------------------
+// RWLock::~RWLock
+// 	Deallocate a reader/writer lock.
+//----------------------------------------------------------------------
+
+RWLock::~RWLock()
+{
+    delete lock;
+    delete readable;
+    delete writable;
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireRead
+// 	Wait until no thread holds the lock to write, or is waiting to,
+//	then hold it to read along with any other readers.
+//----------------------------------------------------------------------
+
+void RWLock::AcquireRead()
+{
+    lock->Acquire();
+    while (writer != NULL || waitingWriters > 0)
+	readable->Wait(lock);
+    readers++;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireWrite
+// 	Wait until no thread holds the lock, then hold it to write.
+//----------------------------------------------------------------------
+
+void RWLock::AcquireWrite()
+{
+    lock->Acquire();
+    ASSERT(writer != kernel->currentThread);
+    waitingWriters++;
+    while (writer != NULL || readers > 0)
+	writable->Wait(lock);
+    waitingWriters--;
+    writer = kernel->currentThread;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RWLock::Release
+// 	Give up the current thread's hold on the lock, to write or to
+//	read.  Once no one holds it, let the next writer in if one is
+//	waiting, or else all the waiting readers.
+//----------------------------------------------------------------------
+
+void RWLock::Release()
+{
+    lock->Acquire();
+    if (writer == kernel->currentThread)
+	writer = NULL;
+    else {
+	ASSERT(writer == NULL && readers > 0);
+	readers--;
+    }
+    if (writer == NULL && readers == 0) {
+	if (waitingWriters > 0)
+	    writable->Signal(lock);
+	else
+	    readable->Broadcast(lock);
+    }
+    lock->Release();
+}
@@ -1,8 +1,8 @@
 // synch.h 
 //	Data structures for synchronizing threads.
 //
-//	Three kinds of synchronization are defined here: semaphores,
-//	locks, and condition variables.  The implementation for
+//	Four kinds of synchronization are defined here: semaphores,
+//	locks, condition variables, and reader/writer locks.  The implementation for
 //	semaphores is given; for the latter two, only the procedure
 //	interface is given -- they are to be implemented as part of 
 //	the first assignment.
@@ -41,6 +41,8 @@ class Semaphore {
   public:
     Semaphore(char* debugName, int initialValue);	// set initial value
     ~Semaphore();   					// de-allocate semaphore
+    void *operator new(size_t size);			// kept in a slab
+    void operator delete(void *semaphore);		//  cache (slab.h)
     char* getName() { return name;}			// debugging assist
     
     void P();	 	// these are the only operations on a semaphore
@@ -141,4 +143,38 @@ class Condition {
     char* name;
     List<Semaphore *> *waitQueue;	// list of waiting threads
 };
+
+// The following class defines a "reader/writer lock".  Any number of
+// threads may hold it to read, or one thread may hold it to write:
+//
+//	AcquireRead -- wait until no thread holds the lock to write, or
+//		is waiting to, then hold it to read
+//
+//	AcquireWrite -- wait until no thread holds the lock, then hold
+//		it to write
+//
+//	Release -- give up whichever kind of hold the current thread has
+//
+// Waiting writers go ahead of new readers, so a steady stream of
+// readers can't keep a writer out.
+
+class RWLock {
+  public:
+    RWLock(char* debugName);		// initialize lock to be FREE
+    ~RWLock();				// deallocate lock
+    char* getName() { return name; }
+
+    void AcquireRead();
+    void AcquireWrite();
+    void Release();
+
+  private:
+    char *name;
+    Lock *lock;				// protects the fields below
+    Condition *readable;		// signalled when readers may go on
+    Condition *writable;		// signalled when a writer may go on
+    int readers;			// # of threads holding it to read
+    int waitingWriters;			// # of threads waiting to write
+    Thread *writer;			// thread holding it to write, or NULL
+};
 #endif // SYNCH_H
@@ -46,6 +46,7 @@ Thread::Thread(char* threadName, int threadID)
 					// of machine registers
     }
     space = NULL;
+    cwd = NULL;
 }
 
 //----------------------------------------------------------------------
@@ -66,6 +67,7 @@ Thread::~Thread()
     ASSERT(this != kernel->currentThread);
     if (stack != NULL)
 	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+    delete cwd;
 }
 
 //----------------------------------------------------------------------
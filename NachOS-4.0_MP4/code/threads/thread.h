@@ -131,6 +131,9 @@ class Thread {
     void RestoreUserState();		// restore user-level register state
 
     AddrSpace *space;			// User code this thread is running.
+    OpenFile *cwd;			// Directory its relative file names
+					// start at (NULL for the root); see
+					// FileSystem::Chdir
 };
 
 // external function, dummy routine whose sole job is to call Thread::Print
@@ -251,13 +251,15 @@ void AddrSpace::SaveState()
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table, and
+//	where to count the program's cache hits and misses.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
     kernel->machine->pageTable = pageTable;
     kernel->machine->pageTableSize = numPages;
+    kernel->machine->cacheCounts = &cacheCounts;
 }
 
 
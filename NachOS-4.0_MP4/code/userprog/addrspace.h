@@ -39,6 +39,9 @@ class AddrSpace {
     // is 0 for Read, 1 for Write.
     ExceptionType Translate(unsigned int vaddr, unsigned int *paddr, int mode);
 
+    CacheCounts cacheCounts;		// this program's references to the
+					// caches, and how many missed
+
   private:
     TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
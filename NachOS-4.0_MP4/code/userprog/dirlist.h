@@ -0,0 +1,40 @@
+/* dirlist.h
+ *	Definitions for the directory system calls that user programs and
+ *	the Nachos kernel must agree on: the "dir" that stands for the
+ *	current directory, and the layout of the entries ReadDir fills in
+ *	(the kernel writes them straight into the program's memory).
+ *
+ *	This file is included by user programs (through syscall.h) and by
+ *	the Nachos kernel (through filesys.h), so there is only one copy.
+ *
+ * Copyright (c) 1992-1993 The Regents of the University of California.
+ * All rights reserved.  See copyright.h for copyright notice and limitation
+ * of liability and disclaimer of warranty provisions.
+ */
+
+#ifndef DIRLIST_H
+#define DIRLIST_H
+
+#include "copyright.h"
+
+/* The "dir" of the *At calls, and of ReadDir, that stands for the
+ * program's current directory.
+ */
+#define CurrentDirectory	-1
+
+/* What a name listed by ReadDir is */
+#define DirEntryFile		0
+#define DirEntryDirectory	1
+
+#ifndef IN_ASM
+
+typedef struct DirEntry {
+    char name[12];		/* with the trailing '\0' (names are at
+				 * most 9 characters) */
+    int type;			/* DirEntryFile or DirEntryDirectory */
+    int size;			/* bytes in it */
+} DirEntry;
+
+#endif /* IN_ASM */
+
+#endif /* DIRLIST_H */
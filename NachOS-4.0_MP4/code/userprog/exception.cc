@@ -62,6 +62,8 @@ void ExceptionHandler(ExceptionType which)
 		{
 		case SC_Halt:
 			DEBUG(dbgSys, "Shutdown, initiated by user program.\n");
+			if (kernel->execDone != NULL)
+				kernel->ProgramDone();	// only end this program
 			SysHalt();
 			cout << "in exception\n";
 			ASSERTNOTREACHED();
@@ -73,6 +75,8 @@ void ExceptionHandler(ExceptionType which)
 				char *msg = &(kernel->machine->mainMemory[val]);
 				cout << msg << endl;
 			}
+			if (kernel->execDone != NULL)
+				kernel->ProgramDone();	// only end this program
 			SysHalt();
 			ASSERTNOTREACHED();
 			break;
@@ -138,6 +142,108 @@ void ExceptionHandler(ExceptionType which)
 			//Write back to R2
 			kernel->machine->WriteRegister(2, status);
 
+			// Set Program Counter
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_WriteV:
+			DEBUG(dbgSys, "File, Mode: Write pieces.\n");
+			val = kernel->machine->ReadRegister(4);
+			numChar = kernel->machine->ReadRegister(5);
+			fileID = kernel->machine->ReadRegister(6);
+			status = SysWriteV(val, numChar, fileID);
+
+			//Write back to R2
+			kernel->machine->WriteRegister(2, status);
+
+			// Set Program Counter
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_ReadV:
+			DEBUG(dbgSys, "File, Mode: Read pieces.\n");
+			val = kernel->machine->ReadRegister(4);
+			numChar = kernel->machine->ReadRegister(5);
+			fileID = kernel->machine->ReadRegister(6);
+			status = SysReadV(val, numChar, fileID);
+
+			//Write back to R2
+			kernel->machine->WriteRegister(2, status);
+
+			// Set Program Counter
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_AioRead:
+			DEBUG(dbgSys, "File, Mode: Start reading.\n");
+			numChar = kernel->machine->ReadRegister(4);
+			val = kernel->machine->ReadRegister(5);
+			fileID = kernel->machine->ReadRegister(7);
+
+			buffer = &(kernel->machine->mainMemory[numChar]);
+			status = SysAioRead(buffer, val, kernel->machine->ReadRegister(6), fileID);
+
+			//Write back to R2
+			kernel->machine->WriteRegister(2, status);
+
+			// Set Program Counter
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_AioWrite:
+			DEBUG(dbgSys, "File, Mode: Start writing.\n");
+			numChar = kernel->machine->ReadRegister(4);
+			val = kernel->machine->ReadRegister(5);
+			fileID = kernel->machine->ReadRegister(7);
+
+			buffer = &(kernel->machine->mainMemory[numChar]);
+			status = SysAioWrite(buffer, val, kernel->machine->ReadRegister(6), fileID);
+
+			//Write back to R2
+			kernel->machine->WriteRegister(2, status);
+
+			// Set Program Counter
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_AioWait:
+			DEBUG(dbgSys, "File, Mode: Wait for a request.\n");
+			val = kernel->machine->ReadRegister(4);
+			status = SysAioWait(val);
+
+			//Write back to R2
+			kernel->machine->WriteRegister(2, status);
+
+			// Set Program Counter
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_AioPoll:
+			DEBUG(dbgSys, "File, Mode: Poll a request.\n");
+			val = kernel->machine->ReadRegister(4);
+			status = SysAioPoll(val);
+
+			//Write back to R2
+			kernel->machine->WriteRegister(2, status);
+
 			// Set Program Counter
 			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
 			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
@@ -175,6 +281,161 @@ void ExceptionHandler(ExceptionType which)
 			return;
 			ASSERTNOTREACHED();
 			break;
+		case SC_Remove:
+			DEBUG(dbgSys, "Remove file.\n");
+			val = kernel->machine->ReadRegister(4);
+			{
+				char *filename = &(kernel->machine->mainMemory[val]);
+				status = SysRemove(filename);
+				kernel->machine->WriteRegister(2, status);
+			}
+			// Set Program Counter
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_Truncate:
+			DEBUG(dbgSys, "Truncate file.\n");
+			val = kernel->machine->ReadRegister(4);
+			{
+				char *filename = &(kernel->machine->mainMemory[val]);
+				status = SysTruncate(filename, kernel->machine->ReadRegister(5));
+				kernel->machine->WriteRegister(2, status);
+			}
+			// Set Program Counter
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_FTruncate:
+			DEBUG(dbgSys, "Truncate open file.\n");
+			fileID = kernel->machine->ReadRegister(4);
+			val = kernel->machine->ReadRegister(5);
+			status = SysFTruncate(fileID, val);
+			kernel->machine->WriteRegister(2, status);
+			// Set Program Counter
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_Chdir:
+			DEBUG(dbgSys, "Change directory.\n");
+			val = kernel->machine->ReadRegister(4);
+			{
+				char *filename = &(kernel->machine->mainMemory[val]);
+				status = SysChdir(filename);
+				kernel->machine->WriteRegister(2, status);
+			}
+			// Set Program Counter
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_CreateAt:
+			DEBUG(dbgSys, "Create file at directory.\n");
+			fileID = kernel->machine->ReadRegister(4);
+			val = kernel->machine->ReadRegister(5);
+			{
+				char *filename = &(kernel->machine->mainMemory[val]);
+				status = SysCreateAt(fileID, filename, kernel->machine->ReadRegister(6));
+				kernel->machine->WriteRegister(2, status);
+			}
+			// Set Program Counter
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_OpenAt:
+			DEBUG(dbgSys, "Open file at directory.\n");
+			fileID = kernel->machine->ReadRegister(4);
+			val = kernel->machine->ReadRegister(5);
+			{
+				char *filename = &(kernel->machine->mainMemory[val]);
+				fileID = SysOpenAt(fileID, filename);
+				kernel->machine->WriteRegister(2, fileID);
+			}
+			// Set Program Counter
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_RemoveAt:
+			DEBUG(dbgSys, "Remove file at directory.\n");
+			fileID = kernel->machine->ReadRegister(4);
+			val = kernel->machine->ReadRegister(5);
+			{
+				char *filename = &(kernel->machine->mainMemory[val]);
+				status = SysRemoveAt(fileID, filename);
+				kernel->machine->WriteRegister(2, status);
+			}
+			// Set Program Counter
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_MkdirAt:
+			DEBUG(dbgSys, "Make directory at directory.\n");
+			fileID = kernel->machine->ReadRegister(4);
+			val = kernel->machine->ReadRegister(5);
+			{
+				char *filename = &(kernel->machine->mainMemory[val]);
+				status = SysMkdirAt(fileID, filename);
+				kernel->machine->WriteRegister(2, status);
+			}
+			// Set Program Counter
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_Clone:
+			DEBUG(dbgSys, "Clone file.\n");
+			val = kernel->machine->ReadRegister(4);
+			{
+				char *from = &(kernel->machine->mainMemory[val]);
+				char *to = &(kernel->machine->mainMemory[kernel->machine->ReadRegister(5)]);
+				status = SysClone(from, to);
+				kernel->machine->WriteRegister(2, status);
+			}
+			// Set Program Counter
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_ReadDir:
+			DEBUG(dbgSys, "Read directory.\n");
+			fileID = kernel->machine->ReadRegister(4);
+			val = kernel->machine->ReadRegister(5);
+			{
+				DirEntry *entries = (DirEntry *) &(kernel->machine->mainMemory[val]);
+				int *cursor = (int *) &(kernel->machine->mainMemory[kernel->machine->ReadRegister(7)]);
+				status = SysReadDir(fileID, entries, kernel->machine->ReadRegister(6), cursor);
+				kernel->machine->WriteRegister(2, status);
+			}
+			// Set Program Counter
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
 		case SC_Add:
 			DEBUG(dbgSys, "Add " << kernel->machine->ReadRegister(4) << " + " << kernel->machine->ReadRegister(5) << "\n");
 			/* Process SysAdd Systemcall*/
@@ -203,7 +464,7 @@ void ExceptionHandler(ExceptionType which)
 			DEBUG(dbgAddr, "Program exit\n");
 			val = kernel->machine->ReadRegister(4);
 			cout << "return value:" << val << endl;
-			kernel->currentThread->Finish();
+			kernel->ProgramDone();
 			break;
 		default:
 			cerr << "Unexpected system call " << type << "\n";
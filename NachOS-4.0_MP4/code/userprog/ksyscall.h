@@ -14,9 +14,13 @@
 #include "kernel.h"
 
 #include "synchconsole.h"
+#include "synchdisk.h"
+#include "aio.h"
 
 void SysHalt()
 {
+	kernel->synchDisk->Sync();	// nothing written may be lost
+	kernel->PrintCaches();
 	kernel->interrupt->Halt();
 }
 
@@ -37,7 +41,57 @@ int SysWrite(char *buffer, int size, OpenFileId id) {
     return kernel->fileSystem->WriteFile(buffer, size, id);
 }
 
+// The pieces of a user program's IoVec array, at "iov" in its memory
+// (each a pointer and a size, both 4 bytes in the program's layout),
+// with the pointers made into the kernel's.  FALSE if there are too many.
+static bool UserPieces(int iov, int count, char **pieces, int *sizes) {
+	int *vector = (int *) &(kernel->machine->mainMemory[iov]);
+
+	if (count < 0 || count > MaxIoPieces)
+		return FALSE;
+	for (int i = 0; i < count; i++) {
+		pieces[i] = &(kernel->machine->mainMemory[vector[2 * i]]);
+		sizes[i] = vector[2 * i + 1];
+	}
+	return TRUE;
+}
+
+int SysWriteV(int iov, int count, OpenFileId id) {
+	char *pieces[MaxIoPieces];
+	int sizes[MaxIoPieces];
+
+	if (!UserPieces(iov, count, pieces, sizes))
+		return -1;
+	return kernel->fileSystem->WriteFileV(pieces, sizes, count, id);
+}
+
+int SysReadV(int iov, int count, OpenFileId id) {
+	char *pieces[MaxIoPieces];
+	int sizes[MaxIoPieces];
+
+	if (!UserPieces(iov, count, pieces, sizes))
+		return -1;
+	return kernel->fileSystem->ReadFileV(pieces, sizes, count, id);
+}
+
+int SysAioRead(char *buffer, int size, int position, OpenFileId id) {
+	return kernel->asyncIO->Start(FALSE, buffer, size, position, id);
+}
+
+int SysAioWrite(char *buffer, int size, int position, OpenFileId id) {
+	return kernel->asyncIO->Start(TRUE, buffer, size, position, id);
+}
+
+int SysAioWait(int request) {
+	return kernel->asyncIO->Wait(request);
+}
+
+int SysAioPoll(int request) {
+	return kernel->asyncIO->Poll(request);
+}
+
 int SysClose(OpenFileId id) {
+    kernel->asyncIO->Drain(id);	// no request may still be using it
     return kernel->fileSystem->CloseFile(id);
 }
 
@@ -45,6 +99,46 @@ int SysCreate(char *filename, int size) {
 	return kernel->fileSystem->Create(filename, size);
 }
 
+int SysRemove(char *filename) {
+	return kernel->fileSystem->Remove(filename);
+}
+
+int SysChdir(char *name) {
+	return kernel->fileSystem->Chdir(name);
+}
+
+int SysCreateAt(OpenFileId dir, char *filename, int size) {
+	return kernel->fileSystem->CreateAt(dir, filename, size);
+}
+
+OpenFileId SysOpenAt(OpenFileId dir, char *name) {
+	return kernel->fileSystem->OpenAt(dir, name);
+}
+
+int SysRemoveAt(OpenFileId dir, char *filename) {
+	return kernel->fileSystem->RemoveAt(dir, filename);
+}
+
+int SysMkdirAt(OpenFileId dir, char *name) {
+	return kernel->fileSystem->MkdirAt(dir, name);
+}
+
+int SysClone(char *from, char *to) {
+	return kernel->fileSystem->Clone(from, to);
+}
+
+int SysTruncate(char *name, int length) {
+	return kernel->fileSystem->Truncate(name, length);
+}
+
+int SysFTruncate(OpenFileId id, int length) {
+	return kernel->fileSystem->FTruncate(id, length);
+}
+
+int SysReadDir(OpenFileId dir, DirEntry *entries, int n, int *cursor) {
+	return kernel->fileSystem->ReadDir(dir, entries, n, cursor);
+}
+
 #ifdef FILESYS_STUB
 int SysCreate(char *filename)
 {
@@ -78,6 +78,7 @@ SynchConsoleOutput::SynchConsoleOutput(char *outputFile)
     consoleOutput = new ConsoleOutput(outputFile, this);
     lock = new Lock("console out");
     waitFor = new Semaphore("console out", 0);
+    bottomHalf = new BottomHalf("console out", SynchConsoleOutput::PutDone, this);
 }
 
 //----------------------------------------------------------------------
@@ -90,6 +91,7 @@ SynchConsoleOutput::~SynchConsoleOutput()
     delete consoleOutput; 
     delete lock; 
     delete waitFor;
+    delete bottomHalf;
 }
 
 //----------------------------------------------------------------------
@@ -109,11 +111,25 @@ SynchConsoleOutput::PutChar(char ch)
 //----------------------------------------------------------------------
 // SynchConsoleOutput::CallBack
 //      Interrupt handler called when it's safe to send the next 
-//	character can be sent to the display.
+//	character can be sent to the display.  Waking up the writer is
+//	deferred to a bottom half.
 //----------------------------------------------------------------------
 
 void
 SynchConsoleOutput::CallBack()
 {
-    waitFor->V();
+    bottomHalf->Raise();
+}
+
+//----------------------------------------------------------------------
+// SynchConsoleOutput::PutDone
+//      Bottom half of the console output interrupt; wake up the writer.
+//----------------------------------------------------------------------
+
+void
+SynchConsoleOutput::PutDone(void *arg)
+{
+    SynchConsoleOutput *synchConsole = (SynchConsoleOutput *)arg;
+
+    synchConsole->waitFor->V();
 }
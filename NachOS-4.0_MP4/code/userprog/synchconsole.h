@@ -15,6 +15,7 @@
 #include "utility.h"
 #include "callback.h"
 #include "console.h"
+#include "interrupt.h"
 #include "synch.h"
 
 // The following two classes define synchronized input and output to
@@ -48,8 +49,10 @@ class SynchConsoleOutput : public CallBackObj {
     ConsoleOutput *consoleOutput;// the hardware display
     Lock *lock;			// only one writer at a time
     Semaphore *waitFor;		// wait for callBack
+    BottomHalf *bottomHalf;	// deferred part of callBack
 
     void CallBack();		// called when more data can be written
+    static void PutDone(void *arg); // bottom half of CallBack
 };
 
 #endif // SYNCHCONSOLE_H
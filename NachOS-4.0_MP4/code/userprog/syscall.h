@@ -15,6 +15,7 @@
 
 #include "copyright.h"
 #include "errno.h"
+#include "dirlist.h"
 /* system call codes -- used by the stubs to tell the kernel which system call
  * is being asked for
  */
@@ -34,6 +35,21 @@
 #define SC_ExecV	13
 #define SC_ThreadExit   14
 #define SC_ThreadJoin   15
+#define SC_Chdir	16
+#define SC_CreateAt	17
+#define SC_OpenAt	18
+#define SC_RemoveAt	19
+#define SC_MkdirAt	20
+#define SC_Clone	21
+#define SC_ReadDir	22
+#define SC_WriteV	23
+#define SC_ReadV	24
+#define SC_AioRead	25
+#define SC_AioWrite	26
+#define SC_AioWait	27
+#define SC_AioPoll	28
+#define SC_Truncate	29
+#define SC_FTruncate	30
 #define SC_Add		42
 #define SC_MSG		100
 
@@ -140,6 +156,43 @@ int Write(char *buffer, int size, OpenFileId id);
  */
 int Read(char *buffer, int size, OpenFileId id);
 
+/* Write the bytes of "count" pieces (at most 16), one after the other,
+ * to the open file, as one Write would; or Read into the pieces, filling
+ * one before the next.  A record made of several pieces takes one trap,
+ * and the sectors it shares with its neighbours are written once.
+ * Return the number of bytes written or read in all, or -1 on failure.
+ */
+typedef struct IoVec {
+    char *base;			/* where the piece is */
+    int size;			/* bytes in it */
+} IoVec;
+
+int WriteV(IoVec *pieces, int count, OpenFileId id);
+int ReadV(IoVec *pieces, int count, OpenFileId id);
+
+/* Start reading "size" bytes of the open file, from byte "position" on,
+ * into "buffer" (AioRead), or writing them there from it (AioWrite), and
+ * return at once, with a handle for the request -- or -1 if it can't be
+ * started (at most 16 may be outstanding).  The kernel does the I/O in
+ * the background, while the program goes on; "buffer" must be left
+ * alone until the request is done.  The file's seek position is not
+ * used, or changed.
+ */
+typedef int AioId;
+
+AioId AioRead(char *buffer, int size, int position, OpenFileId id);
+AioId AioWrite(char *buffer, int size, int position, OpenFileId id);
+
+/* Wait until the request is done, and return the number of bytes it
+ * read or wrote (-1 on failure).  The handle may not be used after.
+ */
+int AioWait(AioId request);
+
+/* Return 1 if the request is done (AioWait will not wait), 0 if it is
+ * still going on, or -1 if there is no such request.
+ */
+int AioPoll(AioId request);
+
 /* Set the seek position of the open file "id"
  * to the byte "position".
  */
@@ -150,6 +203,54 @@ int Seek(int position, OpenFileId id);
  */
 int Close(OpenFileId id);
 
+/* A file name that doesn't start with "/" is relative: it is looked up
+ * from the program's current directory, which starts out as the root.
+ * Change the current directory to "name".
+ * Return 1 on success, 0 if "name" is not a directory.
+ */
+int Chdir(char *name);
+
+/* Create, Open, Remove, and make a directory, with a relative "name"
+ * looked up from "dir" instead: a directory opened with Open or OpenAt,
+ * or CurrentDirectory (see dirlist.h).  A program working deep in the
+ * tree can open the directory once, and then each call only looks up
+ * the last name.  An open directory can only be passed as "dir", or
+ * closed.
+ */
+int CreateAt(OpenFileId dir, char *name, int size);
+OpenFileId OpenAt(OpenFileId dir, char *name);
+int RemoveAt(OpenFileId dir, char *name);
+int MkdirAt(OpenFileId dir, char *name);
+
+/* Make "to" a copy of the file "from" at once, however big it is: the
+ * two share their disk sectors until one of them writes to them, and
+ * then it gets copies of the sectors it writes.
+ * Return 1 on success, 0 if "from" is not a file (or is compressed) or
+ * "to" can't be created.
+ */
+int Clone(char *from, char *to);
+
+/* Shrink the file "name", or the open file "id", to its first "length"
+ * bytes, freeing the disk sectors past them.  Files can't grow, so
+ * "length" may be no more than the file's length.
+ * Return 1 on success, 0 if there is no such file (or it is a directory,
+ * or compressed) or it is shorter than "length".
+ */
+int Truncate(char *name, int length);
+int FTruncate(OpenFileId id, int length);
+
+/* List a directory: fill "entries" with up to "n" of the names in the
+ * directory open as "dir" (or CurrentDirectory), each with whether it
+ * is a file or a directory, and its size in bytes.  "*cursor" says
+ * where in the directory to start -- 0 the first time -- and is moved
+ * past the names returned, so the next call carries on from there.
+ * One call returns as many names as fit, so a program walking a tree
+ * (ls -R, du) traps once per batch, not once per name.
+ * Return how many entries were filled in (0 once there are no more),
+ * or -1 if "dir" is not a directory.  DirEntry is in dirlist.h.
+ */
+int ReadDir(OpenFileId dir, DirEntry *entries, int n, int *cursor);
+
 
 /* User-level thread operations: Fork and Yield.  To allow multiple
  * threads to run within a user program. 
@@ -0,0 +1,1154 @@
+/* diskinspect.c
+ *
+ * This program reads a Nachos disk image (the DISK_<id> file of the MP4
+ * file system) directly, without booting Nachos, to list directories,
+ * extract files, and check the file system for consistency.
+ *
+ * Usage: diskinspect [-b baseImage] [-j threads] image command
+ *	ls <directory>		list a directory, as "nachos -l" does
+ *	lr <directory>		list a directory tree, as "nachos -lr" does
+ *	cat <file>		copy a file to stdout
+ *	get <file> <unix file>	copy a file to a UNIX file
+ *	check			check the file system for consistency
+ *
+ * If the image is a copy-on-write overlay (see "-overlay" in main.cc),
+ * -b gives the base image it is an overlay on.
+ *
+ * The on-disk layout read here is the one written by the file system:
+ *	sectors 0 to InodeTableSectors - 1 -- the inode table, holding
+ *		InodesPerSector file headers ("inodes") each
+ *	inode 0 -- the file header of the free sector bitmap
+ *	inode 1 -- the file header of the root directory
+ *	inode 2 -- the file header of the free inode bitmap
+ *	inode 3 -- the file header of the sector reference counts
+ * An inode holds the file's size in bytes, then NumInodeDirect sector
+ * numbers.  A sub-header fills a sector, and holds the size in bytes
+ * and in sectors, then NumDirect sector numbers.  A header's numbers
+ * are of data sectors if they can cover the file that way; if not,
+ * of sub-headers each describing the next "bound" bytes of the file,
+ * where bound is SectorSize times the smallest power of NumDirect that
+ * lets them cover it.  A directory is a file holding a table of
+ * NumDirEntries entries, each naming an inode.
+ * The size of a compressed file has CompressedFlag set.  Its data
+ * starts with a table: the length of what it holds, then the number of
+ * bytes stored for each ChunkSize bytes of that (0 if none have been
+ * written; as many as the chunk holds if it is stored as it is).  Each
+ * chunk is stored at the start of a ChunkSize slot, after the table
+ * sectors, LZSS-compressed as described in lib/lzss.h.
+ * The size of a file that may share sectors with clones of it has
+ * SharedFlag set.  Files share sub-headers and data sectors; the
+ * reference count file holds an unsigned short for each sector on the
+ * disk: how many pointers at it there are in file headers besides the
+ * first (see filesys/refmap.h); it is empty until a file is cloned.
+ * A disk kept as a log (see "-lfs" in main.cc, and filesys/logdisk.h)
+ * has LogMagic in its first sector, and the sectors above are only
+ * names: the map in the checkpoint region says where on the disk each
+ * was last written (a chunk of the map never written, or an entry of
+ * -1, means the sector reads as zeros).  The sectors the file system
+ * may not use, from the log's capacity up, are marked in the free map
+ * but used by nothing.
+ * A disk with checksums (see "-crc" in main.cc, and filesys/synchdisk.h)
+ * has SumsMagic at the start of the first sector of each track written,
+ * followed by the CRC-32C of each of the track's other sectors (0 if
+ * not known), and the sector numbers above skip the first sector of
+ * every track.  A log may be kept on such a disk.
+ * The disk's geometry -- SectorSize, SectorsPerTrack and NumTracks,
+ * and all that depends on them -- is read from the label at the front
+ * of the image (an image from before there were labels has just a
+ * magic number, and the default geometry).
+ * The constants below must match machine/disk.h, filesys/filehdr.h,
+ * filesys/directory.h and filesys/filesys.cc.  Numbers are in the byte
+ * order of the host that wrote the image.
+ *
+ * The check walks every file and directory reachable from the root,
+ * counting how many times each sector and inode is used, and then
+ * compares the counts with the free map and the inode map.  A sector
+ * is used once by each header pointing at it; a shared sub-header is
+ * walked into only the first time.  A sector used more often than its
+ * reference count allows is doubly allocated (and one used less often
+ * has a count that is wrong, so it would be freed too late, or while
+ * still in use); one in use but free in the map will be handed out
+ * again; one marked in the map but not used by anything is an orphan.  Both passes are spread over several threads (by
+ * default, one per host CPU).  On a log, the check also counts the
+ * map entries pointing into each segment against its live count in
+ * the usage table, and checks each entry against the summary of the
+ * segment it points into.  On a disk with checksums, it checks every
+ * sector with a checksum against it, whether the file system uses the
+ * sector or not.
+ *
+ * Copyright (c) 1992-1993 The Regents of the University of California.
+ * All rights reserved.  See copyright.h for copyright notice and limitation
+ * of liability and disclaimer of warranty provisions.
+ */
+
+#define MAIN
+#include "copyright.h"
+#undef MAIN
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/* machine/disk.h, machine/disk.cc: the geometry is in the image's
+   label (see OpenImage) */
+#define MagicNumber	0x456789ab
+#define MagicSize	4
+#define LabelMagicNumber 0x456789ac
+#define LabelSize	16
+#define DefaultSectorSize 128
+#define DefaultSectorsPerTrack 32
+#define DefaultNumTracks 16384
+#define MaxSectorSize	4096
+#define OverlayMagicNumber 0x4f564c31
+#define OverlayMapSize	(NumSectors / 8)
+#define OverlayDataSize	(MagicSize + OverlayMapSize)
+
+static int SectorSize, SectorsPerTrack, NumTracks, NumSectors;
+
+/* filesys/synchdisk.h */
+#define SumsPerTrack	(SectorsPerTrack - 1)
+#define SumsMagic	0x43524331u
+
+/* filesys/filehdr.h, filesys/filehdr.cc */
+#define NumDirect	((int)((SectorSize - 2 * sizeof(int)) / sizeof(int)))
+#define MaxNumDirect	((int)((MaxSectorSize - 2 * sizeof(int)) / sizeof(int)))
+#define NumInodeDirect	7
+#define InodeSize	((NumInodeDirect + 1) * (int)sizeof(int))
+#define InodesPerSector	(SectorSize / InodeSize)
+#define NumInodes	4096
+#define InodeTableSectors (NumInodes / InodesPerSector)
+#define CompressedFlag	(1 << 30)
+#define SharedFlag	(1 << 29)
+
+/* filesys/compfile.h, lib/lzss.h */
+#define ChunkSize	(8 * SectorSize)
+#define MinMatch	3
+#define MaxOffset	1024
+
+/* filesys/directory.h, filesys/filesys.cc */
+#define FileNameMaxLen	9
+#define NumDirEntries	64
+#define FreeMapInode	0
+#define DirectoryInode	1
+#define InodeMapInode	2
+#define RefCountInode	3
+#define FreeMapFileSize	(NumSectors / 8)
+#define InodeMapFileSize (NumInodes / 8)
+
+/* filesys/refmap.h */
+#define RefCountFileSize (NumSectors * (int)sizeof(unsigned short))
+
+/* filesys/logdisk.h, filesys/logdisk.cc */
+#define LogMagic	0x4c4f4731
+#define LogSegmentSectors 256
+#define LogSummarySectors divRoundUp(LogSegmentSectors * (int)sizeof(int), \
+				     SectorSize)
+#define LogSlots	(LogSegmentSectors - LogSummarySectors)
+#define LogMapEntries	(SectorSize / (int)sizeof(int))
+#define LogMapSectors	divRoundUp(NumSectors, LogMapEntries)
+#define LogMapChunk	32
+#define LogMaxSegments	(NumSectors / LogSegmentSectors)
+#define LogUsageEntries	(SectorSize / (int)sizeof(SegmentUsage))
+#define LogUsageSectors	divRoundUp(LogMaxSegments, LogUsageEntries)
+#define LogFirstMapSector 1
+#define LogFirstUsageSector (LogFirstMapSector + LogMapSectors)
+#define LogFirstSegment	(divRoundUp(LogFirstUsageSector + LogUsageSectors, \
+				    LogSegmentSectors) * LogSegmentSectors)
+#define LogMaxUse	80
+
+#define MaxThreads	64
+#define MaxExamples	10	/* problems of each kind to print */
+
+#define divRoundUp(n, s)	(((n) / (s)) + ((((n) % (s)) > 0) ? 1 : 0))
+
+typedef struct {
+    int numBytes;
+    int numSectors;
+    int dataSectors[MaxNumDirect];	/* NumDirect of them */
+} FileHeader;
+
+typedef struct {
+    int numBytes;
+    int dataSectors[NumInodeDirect];
+} Inode;
+
+typedef struct {
+    int live;
+    int stamp;
+} SegmentUsage;
+
+typedef struct {
+    int magic;
+    int clock;
+    unsigned int chunkWritten[(MaxSectorSize - 2 * sizeof(int)) / 32];
+} LogHeader;
+
+typedef struct {
+    char inUse;
+    int inode;
+    char name[FileNameMaxLen + 1];
+    char isDirectory;
+} DirectoryEntry;
+
+/* what a walk of a file header does with each sector it finds; with
+   a sub-header, return whether to walk into it */
+typedef void (*SectorVisitor)(int sector, void *arg);
+typedef int (*HeaderVisitor)(int sector, void *arg);
+
+static char *image;		/* the disk (or overlay) file, mapped */
+static char *base;		/* the base image, if image is an overlay */
+static unsigned char *overlayMap;	/* which sectors the overlay holds */
+static LogHeader *logHeader;	/* the log's header, if the disk is one */
+static int headerSize;		/* bytes before sector 0 in a disk file */
+static int dataSectors;		/* sectors on the disk, not counting
+					   checksums */
+static int numSegments;		/* segments in the log, if a log */
+static int mapChunk;		/* map sectors in a chunk, if a log */
+static int capacity;		/* sectors the file system may use */
+static unsigned int crcTable[256];	/* for Crc32c */
+
+static pthread_mutex_t problemLock = PTHREAD_MUTEX_INITIALIZER;
+static int numProblems = 0;
+
+/****************************************************************/
+
+/* Report something wrong with the file system */
+static void
+Problem(char *format, ...)
+{
+    va_list ap;
+
+    pthread_mutex_lock(&problemLock);
+    numProblems++;
+    va_start(ap, format);
+    vprintf(format, ap);
+    va_end(ap);
+    printf("\n");
+    pthread_mutex_unlock(&problemLock);
+}
+
+static void *
+MapFile(char *name, int size, int *magic)
+{
+    int fd = open(name, O_RDONLY);
+    void *p;
+
+    if (fd < 0) {
+	perror(name);
+	exit(2);
+    }
+    p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+	perror(name);
+	exit(2);
+    }
+    close(fd);
+    *magic = *(int *)p;
+    return p;
+}
+
+/* Return the contents of a sector of the disk, as it is laid out */
+static char *
+RawSector(int sector)
+{
+    if (base == NULL)
+	return image + headerSize + (long)sector * SectorSize;
+    if (overlayMap[sector / 8] & (1 << (sector % 8)))
+	return image + OverlayDataSize + (long)sector * SectorSize;
+    return base + headerSize + (long)sector * SectorSize;
+}
+
+/* Return the contents of a sector of the disk, skipping checksums */
+static char *
+DiskSector(int sector)
+{
+    if (dataSectors == NumSectors)
+	return RawSector(sector);
+    return RawSector((sector / SumsPerTrack) * SectorsPerTrack + 1
+		     + sector % SumsPerTrack);
+}
+
+/* Return where on a log sector "sector" was last written, or -1 */
+static int
+LogPlace(int sector)
+{
+    int chunk = sector / (LogMapEntries * mapChunk);
+
+    if (!(logHeader->chunkWritten[chunk / 32] & (1u << (chunk % 32))))
+	return -1;
+    return ((int *)DiskSector(LogFirstMapSector + sector / LogMapEntries))
+	[sector % LogMapEntries];
+}
+
+/* Return the contents of a sector of the file system */
+static char *
+Sector(int sector)
+{
+    static char zeros[MaxSectorSize];
+    int where;
+
+    if (logHeader == NULL)
+	return DiskSector(sector);
+    where = LogPlace(sector);
+    if (where < LogFirstSegment || where >= dataSectors)
+	return zeros;
+    return DiskSector(where);
+}
+
+/* If the disk is a log, find its header */
+static void
+FindLog()
+{
+    if (((LogHeader *)DiskSector(0))->magic != LogMagic)
+	return;
+    logHeader = (LogHeader *)DiskSector(0);
+    numSegments = (dataSectors - LogFirstSegment) / LogSegmentSectors;
+    mapChunk = LogMapChunk;
+    while (divRoundUp(LogMapSectors, mapChunk)
+	   > (SectorSize - 2 * (int)sizeof(int)) * 8)
+	mapChunk *= 2;
+    capacity = numSegments * LogSlots / 100 * LogMaxUse;
+}
+
+/* If the disk has checksums, skip them */
+static void
+FindSums()
+{
+    if (*(unsigned int *)RawSector(0) != SumsMagic)
+	return;
+    dataSectors = capacity = NumTracks * SumsPerTrack;
+}
+
+/* Map a disk file (not an overlay), and set the geometry from its label
+   (the default geometry, if it has none) */
+static char *
+MapDisk(char *name)
+{
+    int fd = open(name, O_RDONLY);
+    int label[4];
+    void *p;
+
+    if (fd < 0) {
+	perror(name);
+	exit(2);
+    }
+    if (read(fd, label, sizeof(label)) != sizeof(label)
+	|| (label[0] != MagicNumber && label[0] != LabelMagicNumber)) {
+	fprintf(stderr, "%s is not a Nachos disk image\n", name);
+	exit(2);
+    }
+    if (label[0] == LabelMagicNumber) {
+	headerSize = LabelSize;
+	SectorSize = label[1];
+	SectorsPerTrack = label[2];
+	NumTracks = label[3];
+    } else {
+	headerSize = MagicSize;
+	SectorSize = DefaultSectorSize;
+	SectorsPerTrack = DefaultSectorsPerTrack;
+	NumTracks = DefaultNumTracks;
+    }
+    NumSectors = SectorsPerTrack * NumTracks;
+    dataSectors = capacity = NumSectors;
+    p = mmap(NULL, headerSize + (size_t)NumSectors * SectorSize, PROT_READ,
+	     MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+	perror(name);
+	exit(2);
+    }
+    close(fd);
+    return p;
+}
+
+/* Open the image (and its base image, if it is an overlay) */
+static void
+OpenImage(char *name, char *baseName)
+{
+    int fd = open(name, O_RDONLY), magic;
+
+    if (fd < 0 || read(fd, &magic, sizeof(magic)) != sizeof(magic)) {
+	perror(name);
+	exit(2);
+    }
+    close(fd);
+    if (magic == OverlayMagicNumber) {
+	if (baseName == NULL) {
+	    fprintf(stderr, "%s is an overlay: give its base image with -b\n",
+		    name);
+	    exit(2);
+	}
+	base = MapDisk(baseName);	/* the overlay's geometry is its base's */
+	image = MapFile(name, OverlayDataSize + NumSectors * SectorSize,
+			&magic);
+	overlayMap = (unsigned char *)image + MagicSize;
+    } else
+	image = MapDisk(name);
+    FindSums();
+    FindLog();
+}
+
+/****************************************************************/
+
+static int WalkHeader(int hdrSector, int numBytes, char *path,
+		      HeaderVisitor visitHeader, SectorVisitor visitData,
+		      void *arg);
+
+/*
+ * Walk the "num" sector numbers in "entries", of a header (an inode, or
+ * a sub-header) for "numBytes" bytes of a file, calling visitHeader for
+ * each sub-header, and visitData for each data sector in order.  "path"
+ * names the file, for problem reports.  Return -1 if the file is
+ * unusable.
+ */
+static int
+WalkEntries(int *entries, int num, int numBytes, char *path,
+	    HeaderVisitor visitHeader, SectorVisitor visitData, void *arg)
+{
+    long long bound = SectorSize;
+    int i;
+
+    while (numBytes > bound * num) {
+	if (bound > (long long)NumSectors * SectorSize) {
+	    Problem("%s: file of %d bytes is too big", path, numBytes);
+	    return -1;
+	}
+	bound *= NumDirect;
+    }
+    num = divRoundUp(numBytes, bound);
+    for (i = 0; i < num; i++) {
+	if (entries[i] < 0 || entries[i] >= dataSectors) {
+	    Problem("%s: %s sector %d out of range", path,
+		    bound > SectorSize ? "header" : "data", entries[i]);
+	    return -1;
+	}
+	if (bound > SectorSize) {
+	    int size = (i < num - 1) ? (int)bound : (int)(numBytes - i * bound);
+	    if (WalkHeader(entries[i], size, path,
+			   visitHeader, visitData, arg) < 0)
+		return -1;
+	} else if (visitData != NULL)
+	    (*visitData)(entries[i], arg);
+    }
+    return 0;
+}
+
+/*
+ * Walk the sub-header in sector "hdrSector", which should describe
+ * "numBytes" bytes of a file, calling visitHeader for it and each of
+ * its sub-headers, and visitData for each of its data sectors in
+ * order.  If visitHeader returns 0, the sub-header is not walked into.
+ * Return -1 if it is unusable.
+ */
+static int
+WalkHeader(int hdrSector, int numBytes, char *path,
+	   HeaderVisitor visitHeader, SectorVisitor visitData, void *arg)
+{
+    FileHeader hdr;
+
+    if (visitHeader != NULL && !(*visitHeader)(hdrSector, arg))
+	return 0;
+    memcpy(&hdr, Sector(hdrSector), SectorSize);
+    if (hdr.numBytes != numBytes) {
+	Problem("%s: header in sector %d has size %d, expected %d",
+		path, hdrSector, hdr.numBytes, numBytes);
+	return -1;
+    }
+    if (hdr.numSectors != divRoundUp(numBytes, SectorSize))
+	Problem("%s: header in sector %d has %d sectors for %d bytes",
+		path, hdrSector, hdr.numSectors, numBytes);
+    return WalkEntries(hdr.dataSectors, NumDirect, numBytes, path,
+		       visitHeader, visitData, arg);
+}
+
+/*
+ * Walk the file whose header is inode "inode", calling visitHeader for
+ * each of its sub-headers, and visitData for each of its data sectors
+ * in order.  Return the file's size, or -1 if it is unusable.
+ */
+static int
+WalkInode(int inode, char *path,
+	  HeaderVisitor visitHeader, SectorVisitor visitData, void *arg)
+{
+    Inode ind;
+
+    if (inode < 0 || inode >= NumInodes) {
+	Problem("%s: inode %d out of range", path, inode);
+	return -1;
+    }
+    memcpy(&ind, Sector(inode / InodesPerSector) +
+	   (inode % InodesPerSector) * InodeSize, sizeof(ind));
+    if (ind.numBytes >= 0)
+	ind.numBytes &= ~(CompressedFlag | SharedFlag);
+    if (ind.numBytes < 0) {
+	Problem("%s: inode %d has size %d", path, inode, ind.numBytes);
+	return -1;
+    }
+    if (WalkEntries(ind.dataSectors, NumInodeDirect, ind.numBytes, path,
+		    visitHeader, visitData, arg) < 0)
+	return -1;
+    return ind.numBytes;
+}
+
+typedef struct {
+    char *data;
+    int length;
+} FileContents;
+
+static void
+AppendSector(int sector, void *arg)
+{
+    FileContents *contents = (FileContents *)arg;
+
+    memcpy(contents->data + contents->length, Sector(sector), SectorSize);
+    contents->length += SectorSize;
+}
+
+static void
+CountSector(int sector, void *arg)
+{
+    (*(int *)arg)++;
+}
+
+/* Read a whole file; return NULL if its header is unusable */
+static char *
+ReadFile(int inode, char *path, int *numBytes)
+{
+    FileContents contents;
+    int num = 0;
+
+    /* first find out how big it is, so we know how much room it needs */
+    if (WalkInode(inode, path, NULL, CountSector, &num) < 0)
+	return NULL;
+    contents.data = malloc(num * SectorSize + 1);
+    contents.length = 0;
+    *numBytes = WalkInode(inode, path, NULL, AppendSector, &contents);
+    return contents.data;
+}
+
+/* Read a directory; return NULL if it is unusable */
+static DirectoryEntry *
+ReadDirectory(int inode, char *path)
+{
+    int numBytes;
+    char *data = ReadFile(inode, path, &numBytes);
+
+    if (data != NULL && numBytes != NumDirEntries * sizeof(DirectoryEntry)) {
+	Problem("%s: directory is %d bytes, expected %d", path, numBytes,
+		(int)(NumDirEntries * sizeof(DirectoryEntry)));
+	free(data);
+	return NULL;
+    }
+    return (DirectoryEntry *)data;
+}
+
+/*
+ * Find the inode of the file or directory named by "path" (an absolute
+ * path), or return -1.
+ */
+static int
+Lookup(char *path, int *isDirectory)
+{
+    char copy[1024], *name;
+    int inode = DirectoryInode;
+
+    *isDirectory = 1;
+    strncpy(copy, path, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = '\0';
+    for (name = strtok(copy, "/"); name != NULL; name = strtok(NULL, "/")) {
+	DirectoryEntry *table;
+	int i;
+
+	if (!*isDirectory)
+	    return -1;
+	if ((table = ReadDirectory(inode, path)) == NULL)
+	    return -1;
+	for (i = 0; i < NumDirEntries; i++)
+	    if (table[i].inUse &&
+		strncmp(table[i].name, name, FileNameMaxLen) == 0)
+		break;
+	if (i == NumDirEntries) {
+	    free(table);
+	    return -1;
+	}
+	inode = table[i].inode;
+	*isDirectory = table[i].isDirectory;
+	free(table);
+    }
+    return inode;
+}
+
+/****************************************************************/
+
+static void
+List(int inode, char *path, int recursive)
+{
+    DirectoryEntry *table = ReadDirectory(inode, path);
+    int i;
+
+    if (table == NULL)
+	return;
+    for (i = 0; i < NumDirEntries; i++) {
+	if (!table[i].inUse)
+	    continue;
+	printf("[%c]%.*s\n", table[i].isDirectory ? 'D' : 'F',
+	       FileNameMaxLen, table[i].name);
+	if (recursive && table[i].isDirectory)
+	    List(table[i].inode, path, recursive);
+    }
+    free(table);
+}
+
+/* Is the file whose header is inode "inode" compressed? */
+static int
+IsCompressed(int inode)
+{
+    Inode ind;
+
+    memcpy(&ind, Sector(inode / InodesPerSector) +
+	   (inode % InodesPerSector) * InodeSize, sizeof(ind));
+    return ind.numBytes >= 0 && (ind.numBytes & CompressedFlag) != 0;
+}
+
+/*
+ * Expand "numBytes" bytes compressed by LzCompress (lib/lzss.cc) into
+ * "into", which has room for "room" bytes.  Return how many bytes they
+ * expand to, or -1 if they are corrupt.
+ */
+static int
+LzExpand(unsigned char *in, int numBytes, char *into, int room)
+{
+    int at = 0, out = 0, bit, i;
+
+    while (at < numBytes) {
+	int flags = in[at++];
+
+	for (bit = 0; bit < 8 && at < numBytes; bit++) {
+	    if (flags & (1 << bit)) {
+		int item, offset, length;
+
+		if (at + 2 > numBytes)
+		    return -1;
+		item = in[at] | (in[at + 1] << 8);
+		at += 2;
+		offset = (item & (MaxOffset - 1)) + 1;
+		length = (item >> 10) + MinMatch;
+		if (offset > out || out + length > room)
+		    return -1;
+		for (i = 0; i < length; i++, out++)
+		    into[out] = into[out - offset];
+	    } else {
+		if (out + 1 > room)
+		    return -1;
+		into[out++] = in[at++];
+	    }
+	}
+    }
+    return out;
+}
+
+/*
+ * Expand the "numBytes" bytes of a compressed file into the data it
+ * holds; return it, setting *length, or NULL if it is corrupt.
+ */
+static char *
+ExpandFile(char *stored, int numBytes, char *path, int *length)
+{
+    unsigned short *chunkBytes = (unsigned short *)(stored + sizeof(int));
+    int numChunks, tableBytes, chunk;
+    char *data;
+
+    memcpy(length, stored, sizeof(int));
+    numChunks = divRoundUp(*length, ChunkSize);
+    tableBytes = divRoundUp(sizeof(int) + numChunks * sizeof(short),
+			    SectorSize) * SectorSize;
+    if (*length < 0 || tableBytes + *length > numBytes) {
+	Problem("%s: compressed file of %d bytes says it holds %d", path,
+		numBytes, *length);
+	return NULL;
+    }
+    data = malloc(*length + 1);
+    for (chunk = 0; chunk < numChunks; chunk++) {
+	unsigned char *slot = (unsigned char *)stored + tableBytes +
+	    chunk * ChunkSize;
+	char *into = data + chunk * ChunkSize;
+	int size = *length - chunk * ChunkSize;
+
+	if (size > ChunkSize)
+	    size = ChunkSize;
+	if (chunkBytes[chunk] == 0)
+	    memset(into, 0, size);
+	else if (chunkBytes[chunk] == size)
+	    memcpy(into, slot, size);
+	else if (chunkBytes[chunk] > size ||
+		 LzExpand(slot, chunkBytes[chunk], into, size) != size) {
+	    Problem("%s: chunk %d is corrupt", path, chunk);
+	    free(data);
+	    return NULL;
+	}
+    }
+    return data;
+}
+
+static int
+Extract(char *path, FILE *out)
+{
+    int isDirectory, numBytes;
+    int inode = Lookup(path, &isDirectory);
+    char *data;
+
+    if (inode < 0 || isDirectory) {
+	fprintf(stderr, "%s: no such file\n", path);
+	return 1;
+    }
+    if ((data = ReadFile(inode, path, &numBytes)) == NULL)
+	return 1;
+    if (IsCompressed(inode)) {
+	char *stored = data;
+
+	data = ExpandFile(stored, numBytes, path, &numBytes);
+	free(stored);
+	if (data == NULL)
+	    return 1;
+    }
+    fwrite(data, 1, numBytes, out);
+    free(data);
+    return 0;
+}
+
+/****************************************************************/
+
+/*
+ * The consistency check.  Pass 1 walks the file system from the root:
+ * a queue holds the headers still to be walked, and the worker threads
+ * take them off, count the sectors each uses, and queue the entries of
+ * each directory they find.  Pass 2 splits the disk between the
+ * threads, each comparing the counts in its part with the free map;
+ * then the (far fewer) inodes are compared with the inode map.
+ */
+
+typedef struct WorkItem {
+    int inode;			/* the file's header */
+    int isDirectory;
+    char *path;
+    struct WorkItem *next;
+} WorkItem;
+
+static int *useCount;		/* # of times each sector is used */
+static unsigned short *refCount;	/* the file system's reference counts */
+static int *inodeUseCount;	/* # of times each inode is used */
+static unsigned char *freeMap;	/* the file system's free map */
+static unsigned char *inodeMap;	/* and its free inode map */
+static int numThreads;
+
+static pthread_mutex_t workLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workReady = PTHREAD_COND_INITIALIZER;
+static WorkItem *workList = NULL;
+static int numBusy = 0;		/* items queued or being walked */
+static int numFiles = 0, numDirectories = 0;
+
+static void
+AddWork(int inode, int isDirectory, char *path)
+{
+    WorkItem *item = malloc(sizeof(WorkItem));
+
+    item->inode = inode;
+    item->isDirectory = isDirectory;
+    item->path = path;
+    pthread_mutex_lock(&workLock);
+    item->next = workList;
+    workList = item;
+    numBusy++;
+    pthread_cond_signal(&workReady);
+    pthread_mutex_unlock(&workLock);
+}
+
+static void
+UseSector(int sector, void *arg)
+{
+    __sync_fetch_and_add(&useCount[sector], 1);
+}
+
+/* Count a use of a sub-header; walk into it only the first time */
+static int
+UseHeader(int sector, void *arg)
+{
+    return __sync_fetch_and_add(&useCount[sector], 1) == 0;
+}
+
+/* Walk one file or directory, queueing a directory's entries */
+static void
+CheckFile(WorkItem *item)
+{
+    DirectoryEntry *table;
+    int i;
+
+    /* an inode we have seen before is doubly allocated; don't walk
+       it again, or a directory that contains itself would never end */
+    if (item->inode >= 0 && item->inode < NumInodes &&
+	__sync_fetch_and_add(&inodeUseCount[item->inode], 1) > 0) {
+	Problem("%s: inode %d is used more than once", item->path,
+		item->inode);
+	return;
+    }
+    if (WalkInode(item->inode, item->path, UseHeader, UseSector, NULL) < 0)
+	return;
+    if (!item->isDirectory) {
+	__sync_fetch_and_add(&numFiles, 1);
+	return;
+    }
+    __sync_fetch_and_add(&numDirectories, 1);
+    if ((table = ReadDirectory(item->inode, item->path)) == NULL)
+	return;
+    for (i = 0; i < NumDirEntries; i++) {
+	char *path;
+
+	if (!table[i].inUse)
+	    continue;
+	if (memchr(table[i].name, '\0', FileNameMaxLen + 1) == NULL)
+	    Problem("%s: entry %d has an unterminated name", item->path, i);
+	path = malloc(strlen(item->path) + FileNameMaxLen + 2);
+	sprintf(path, "%s%s%.*s", item->path,
+		strcmp(item->path, "/") == 0 ? "" : "/",
+		FileNameMaxLen, table[i].name);
+	AddWork(table[i].inode, table[i].isDirectory, path);
+    }
+    free(table);
+}
+
+static void *
+WalkWorker(void *unused)
+{
+    WorkItem *item;
+
+    pthread_mutex_lock(&workLock);
+    for (;;) {
+	while (workList == NULL && numBusy > 0)
+	    pthread_cond_wait(&workReady, &workLock);
+	if (workList == NULL)		/* nothing queued or in progress */
+	    break;
+	item = workList;
+	workList = item->next;
+	pthread_mutex_unlock(&workLock);
+
+	CheckFile(item);
+	free(item->path);
+	free(item);
+
+	pthread_mutex_lock(&workLock);
+	if (--numBusy == 0)
+	    pthread_cond_broadcast(&workReady);
+    }
+    pthread_mutex_unlock(&workLock);
+    return NULL;
+}
+
+typedef struct {
+    int first, last;		/* the sectors to compare */
+    int numUsed, numDouble, numMiscounted, numLost, numOrphans;
+} CompareWork;
+
+static int numExamples[6];
+
+static void
+Example(int kind, char *format, int sector)
+{
+    if (__sync_fetch_and_add(&numExamples[kind], 1) < MaxExamples)
+	Problem(format, sector);
+    else {
+	pthread_mutex_lock(&problemLock);
+	numProblems++;
+	pthread_mutex_unlock(&problemLock);
+    }
+}
+
+static void *
+CompareWorker(void *arg)
+{
+    CompareWork *work = (CompareWork *)arg;
+    int sector;
+
+    for (sector = work->first; sector < work->last; sector++) {
+	int inMap = (freeMap[sector / 8] >> (sector % 8)) & 1;
+	int expected = (useCount[sector] > 0) + refCount[sector];
+
+	if (useCount[sector] > 0)
+	    work->numUsed++;
+	if (useCount[sector] > expected) {
+	    work->numDouble++;
+	    Example(0, "sector %d is used more than once", sector);
+	} else if (useCount[sector] < expected) {
+	    work->numMiscounted++;
+	    Example(3, "sector %d is used less often than its count", sector);
+	}
+	if (useCount[sector] > 0 && !inMap) {
+	    work->numLost++;
+	    Example(1, "sector %d is in use, but free in the map", sector);
+	} else if (useCount[sector] == 0 && inMap) {
+	    work->numOrphans++;
+	    Example(2, "sector %d is marked in the map, but not used", sector);
+	}
+    }
+    return NULL;
+}
+
+/* On a log, check the map against the segment summaries and usage */
+static void
+CheckLog()
+{
+    int *live = calloc(numSegments, sizeof(int));
+    int sector, seg, mapped = 0, segments = 0;
+
+    for (sector = 0; sector < NumSectors; sector++) {
+	int where = LogPlace(sector), slot;
+
+	if (where == -1)
+	    continue;
+	mapped++;
+	seg = (where - LogFirstSegment) / LogSegmentSectors;
+	slot = (where - LogFirstSegment) % LogSegmentSectors;
+	if (where < LogFirstSegment || seg >= numSegments
+	    || slot >= LogSlots) {
+	    Example(4, "sector %d is mapped outside the log's slots", sector);
+	    continue;
+	}
+	live[seg]++;
+	/* (a table of several sectors is read a sector at a time: with
+	   checksums, they are not all together on the disk) */
+	if (((int *)DiskSector(where - slot + LogSlots
+			       + slot / LogMapEntries))[slot % LogMapEntries]
+	    != sector)
+	    Example(4, "sector %d is mapped to a slot whose summary names "
+		    "another", sector);
+    }
+    for (seg = 0; seg < numSegments; seg++) {
+	SegmentUsage *usage = (SegmentUsage *)
+	    DiskSector(LogFirstUsageSector + seg / LogUsageEntries);
+
+	if (live[seg] > 0)
+	    segments++;
+	if (live[seg] != usage[seg % LogUsageEntries].live)
+	    Problem("segment %d: %d live slots, but the usage table says %d",
+		    seg, live[seg], usage[seg % LogUsageEntries].live);
+    }
+    printf("log: %d sectors mapped, in %d of %d segments\n", mapped,
+	   segments, numSegments);
+    free(live);
+}
+
+/* Return the CRC-32C of a sector, a byte at a time (lib/crc32c.cc) */
+static unsigned int
+Crc32c(char *data)
+{
+    unsigned int crc = ~0u;
+    int i, bit;
+
+    if (crcTable[1] == 0)
+	for (i = 0; i < 256; i++) {
+	    crcTable[i] = i;
+	    for (bit = 0; bit < 8; bit++)
+		crcTable[i] = (crcTable[i] >> 1)
+		    ^ ((crcTable[i] & 1) ? 0x82f63b78 : 0);
+	}
+    for (i = 0; i < SectorSize; i++)
+	crc = (crc >> 8) ^ crcTable[(crc ^ (unsigned char)data[i]) & 0xff];
+    return ~crc;
+}
+
+/* On a disk with checksums, check every sector that has one */
+static void
+CheckSums()
+{
+    int track, i, checked = 0, damaged = 0;
+
+    for (track = 0; track < NumTracks; track++) {
+	unsigned int *sums =
+	    (unsigned int *)RawSector(track * SectorsPerTrack);
+
+	if (sums[0] != SumsMagic)
+	    continue;			/* never written */
+	for (i = 1; i < SectorsPerTrack; i++) {
+	    if (sums[i] == 0)
+		continue;
+	    checked++;
+	    if (Crc32c(RawSector(track * SectorsPerTrack + i)) != sums[i]) {
+		damaged++;
+		Example(5, "sector %d does not match its checksum",
+			track * SumsPerTrack + i - 1);
+	    }
+	}
+    }
+    printf("checksums: %d sectors checked, %d damaged\n", checked, damaged);
+}
+
+static int
+Check()
+{
+    pthread_t threads[MaxThreads];
+    CompareWork work[MaxThreads];
+    int i, numBytes, used = 0, doubled = 0, miscounted = 0, lost = 0;
+    int orphans = 0;
+    char *root = malloc(2);
+
+    useCount = calloc(NumSectors, sizeof(int));
+    inodeUseCount = calloc(NumInodes, sizeof(int));
+
+    /* the maps are files too; their sectors and inodes count as used,
+       as does the whole inode table */
+    freeMap = (unsigned char *)ReadFile(FreeMapInode, "free map", &numBytes);
+    if (freeMap == NULL || numBytes != FreeMapFileSize) {
+	Problem("free map: unusable, can't check sector allocation");
+	return 1;
+    }
+    inodeMap = (unsigned char *)ReadFile(InodeMapInode, "inode map",
+					 &numBytes);
+    if (inodeMap == NULL || numBytes != InodeMapFileSize) {
+	Problem("inode map: unusable, can't check inode allocation");
+	return 1;
+    }
+    refCount = (unsigned short *)ReadFile(RefCountInode, "reference counts",
+					  &numBytes);
+    if (refCount != NULL && numBytes == 0) {
+	free(refCount);			/* nothing has been cloned yet */
+	refCount = calloc(NumSectors, sizeof(unsigned short));
+    } else if (refCount == NULL || numBytes != RefCountFileSize) {
+	Problem("reference counts: unusable, can't check shared sectors");
+	return 1;
+    }
+    WalkInode(FreeMapInode, "free map", UseHeader, UseSector, NULL);
+    WalkInode(InodeMapInode, "inode map", UseHeader, UseSector, NULL);
+    WalkInode(RefCountInode, "reference counts", UseHeader, UseSector, NULL);
+    inodeUseCount[FreeMapInode] = inodeUseCount[InodeMapInode] = 1;
+    inodeUseCount[RefCountInode] = 1;
+    for (i = 0; i < InodeTableSectors; i++)
+	useCount[i]++;
+    for (i = capacity; i < NumSectors; i++)	/* kept out of a log */
+	useCount[i]++;
+
+    strcpy(root, "/");
+    AddWork(DirectoryInode, 1, root);
+    for (i = 0; i < numThreads; i++)
+	pthread_create(&threads[i], NULL, WalkWorker, NULL);
+    for (i = 0; i < numThreads; i++)
+	pthread_join(threads[i], NULL);
+
+    for (i = 0; i < numThreads; i++) {
+	memset(&work[i], 0, sizeof(CompareWork));
+	work[i].first = (int)((long long)NumSectors * i / numThreads);
+	work[i].last = (int)((long long)NumSectors * (i + 1) / numThreads);
+	pthread_create(&threads[i], NULL, CompareWorker, &work[i]);
+    }
+    for (i = 0; i < numThreads; i++) {
+	pthread_join(threads[i], NULL);
+	used += work[i].numUsed;
+	doubled += work[i].numDouble;
+	miscounted += work[i].numMiscounted;
+	lost += work[i].numLost;
+	orphans += work[i].numOrphans;
+    }
+
+    printf("%d files, %d directories, %d of %d sectors in use\n",
+	   numFiles, numDirectories, used, NumSectors);
+    printf("%d used more than once, %d used less than counted, "
+	   "%d in use but free, %d orphans\n",
+	   doubled, miscounted, lost, orphans);
+
+    used = lost = orphans = 0;
+    for (i = 0; i < NumInodes; i++) {
+	int inMap = (inodeMap[i / 8] >> (i % 8)) & 1;
+
+	if (inodeUseCount[i] > 0)
+	    used++;
+	if (inodeUseCount[i] > 0 && !inMap) {
+	    lost++;
+	    Problem("inode %d is in use, but free in the inode map", i);
+	} else if (inodeUseCount[i] == 0 && inMap) {
+	    orphans++;
+	    Problem("inode %d is marked in the inode map, but not used", i);
+	}
+    }
+    printf("%d of %d inodes in use, %d in use but free, %d orphans\n",
+	   used, NumInodes, lost, orphans);
+    if (logHeader != NULL)
+	CheckLog();
+    if (dataSectors < NumSectors)
+	CheckSums();
+    printf("%d problems\n", numProblems);
+    return numProblems > 0;
+}
+
+/****************************************************************/
+
+static void
+Usage()
+{
+    fprintf(stderr, "usage: diskinspect [-b baseImage] [-j threads] "
+	    "image command\n");
+    fprintf(stderr, "  commands: ls <dir>, lr <dir>, cat <file>, "
+	    "get <file> <unix file>, check\n");
+    exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+    char *baseName = NULL;
+    int opt, isDirectory, inode, status;
+    char *command;
+    FILE *out;
+
+    numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    while ((opt = getopt(argc, argv, "b:j:")) != -1) {
+	switch (opt) {
+	  case 'b':
+	    baseName = optarg;
+	    break;
+	  case 'j':
+	    numThreads = atoi(optarg);
+	    break;
+	  default:
+	    Usage();
+	}
+    }
+    if (numThreads < 1)
+	numThreads = 1;
+    if (numThreads > MaxThreads)
+	numThreads = MaxThreads;
+    if (argc - optind < 2)
+	Usage();
+    OpenImage(argv[optind], baseName);
+    command = argv[optind + 1];
+    argv += optind + 2;
+    argc -= optind + 2;
+
+    if ((strcmp(command, "ls") == 0 || strcmp(command, "lr") == 0)
+	&& argc == 1) {
+	inode = Lookup(argv[0], &isDirectory);
+	if (inode < 0 || !isDirectory) {
+	    fprintf(stderr, "%s: no such directory\n", argv[0]);
+	    return 1;
+	}
+	List(inode, argv[0], strcmp(command, "lr") == 0);
+	return numProblems > 0;
+    } else if (strcmp(command, "cat") == 0 && argc == 1) {
+	return Extract(argv[0], stdout);
+    } else if (strcmp(command, "get") == 0 && argc == 2) {
+	if ((out = fopen(argv[1], "w")) == NULL) {
+	    perror(argv[1]);
+	    return 2;
+	}
+	status = Extract(argv[0], out);
+	fclose(out);
+	return status;
+    } else if (strcmp(command, "check") == 0 && argc == 0) {
+	return Check();
+    }
+    Usage();
+    return 2;
+}